@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "myAppend.h"
+#include "myIO.h"
+#include "myPath.h"
+
+typedef struct
+{
+    char *path;
+    int fd;
+    dev_t device;
+    ino_t inode;
+    char *buffer;
+    size_t used;
+    uint64_t bufferedSince;
+    unsigned long lastUsed;
+} AppendEntry;
+
+static AppendEntry cache[APPEND_CACHE_SIZE];
+static int buffered = 0;
+static unsigned long useClock = 0;
+static pthread_mutex_t appendLock = PTHREAD_MUTEX_INITIALIZER;
+static pid_t ownerPid = 0;
+
+static uint64_t nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int openEntry(AppendEntry *entry)
+{
+    struct stat st;
+    entry->fd = pathOpen(entry->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (entry->fd == -1)
+    {
+        return -1;
+    }
+    if (fstat(entry->fd, &st) == 0)
+    {
+        entry->device = st.st_dev;
+        entry->inode = st.st_ino;
+    }
+    return 0;
+}
+
+/* Reopens the path if the open file is no longer the one it names. */
+static int checkRotated(AppendEntry *entry)
+{
+    struct stat st;
+    if (pathStat(entry->path, &st) == 0 && st.st_dev == entry->device && st.st_ino == entry->inode)
+    {
+        return 0;
+    }
+    close(entry->fd);
+    return openEntry(entry);
+}
+
+/* Writes the entry's buffer, followed by `extra` when it is not NULL, in one writev. */
+static int flushEntry(AppendEntry *entry, const char *extra, size_t extraLength)
+{
+    struct iovec iov[2];
+    int count = 0;
+    if (entry->used > 0)
+    {
+        iov[count++] = (struct iovec){entry->buffer, entry->used};
+    }
+    if (extra != NULL)
+    {
+        iov[count++] = (struct iovec){(void *)extra, extraLength};
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    int result = checkRotated(entry);
+    if (result == 0)
+    {
+        result = ioWritevAll(entry->fd, iov, count);
+    }
+    if (entry->used > 0)
+    {
+        // A failed buffer is dropped rather than retried with every later line.
+        entry->used = 0;
+        __atomic_sub_fetch(&buffered, 1, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+static void releaseEntry(AppendEntry *entry)
+{
+    if (entry->fd != -1)
+    {
+        close(entry->fd);
+    }
+    free(entry->path);
+    free(entry->buffer);
+    *entry = (AppendEntry){.fd = -1};
+}
+
+/* Buffered lines are written when the shell exits; forked children leave them. */
+static void flushAtExit(void)
+{
+    if (getpid() == ownerPid && appendFlush() != 0)
+    {
+        perror("Failed to flush appended data");
+    }
+}
+
+/* Returns the entry for `path`, opening the file in the least recently used slot
+   if it is not cached. Called with appendLock held. */
+static AppendEntry *findEntry(const char *path)
+{
+    AppendEntry *victim = &cache[0];
+    for (int i = 0; i < APPEND_CACHE_SIZE; i++)
+    {
+        if (cache[i].path != NULL && strcmp(cache[i].path, path) == 0)
+        {
+            cache[i].lastUsed = ++useClock;
+            return &cache[i];
+        }
+        if (cache[i].path == NULL || (victim->path != NULL && cache[i].lastUsed < victim->lastUsed))
+        {
+            victim = &cache[i];
+        }
+    }
+
+    if (victim->path != NULL)
+    {
+        if (flushEntry(victim, NULL, 0) != 0)
+        {
+            perror(victim->path);
+        }
+        releaseEntry(victim);
+    }
+    if (ownerPid == 0)
+    {
+        atexit(flushAtExit);
+    }
+    ownerPid = getpid();
+
+    victim->fd = -1;
+    victim->path = strdup(path);
+    if (victim->path == NULL || openEntry(victim) != 0)
+    {
+        int savedErrno = errno;
+        releaseEntry(victim);
+        errno = savedErrno;
+        return NULL;
+    }
+    victim->lastUsed = ++useClock;
+    return victim;
+}
+
+int appendWrite(const char *path, const char *data, size_t length)
+{
+    pthread_mutex_lock(&appendLock);
+    int result = 0;
+    AppendEntry *entry = findEntry(path);
+    if (entry == NULL)
+    {
+        result = -1;
+    }
+    else if (entry->used + length > APPEND_BUFFER_SIZE)
+    {
+        // Too big to gather: write what is buffered and the new data together.
+        result = flushEntry(entry, data, length);
+    }
+    else
+    {
+        if (entry->buffer == NULL && (entry->buffer = malloc(APPEND_BUFFER_SIZE)) == NULL)
+        {
+            pthread_mutex_unlock(&appendLock);
+            return -1;
+        }
+        uint64_t now = nowMs();
+        if (entry->used == 0)
+        {
+            entry->bufferedSince = now;
+            __atomic_add_fetch(&buffered, 1, __ATOMIC_RELAXED);
+        }
+        memcpy(entry->buffer + entry->used, data, length);
+        entry->used += length;
+        if (now - entry->bufferedSince >= APPEND_FLUSH_INTERVAL_MS)
+        {
+            result = flushEntry(entry, NULL, 0);
+        }
+    }
+    pthread_mutex_unlock(&appendLock);
+    return result;
+}
+
+int appendFlush(void)
+{
+    if (__atomic_load_n(&buffered, __ATOMIC_RELAXED) == 0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&appendLock);
+    int result = 0;
+    int savedErrno = 0;
+    for (int i = 0; i < APPEND_CACHE_SIZE; i++)
+    {
+        if (cache[i].path != NULL && cache[i].used > 0 && flushEntry(&cache[i], NULL, 0) != 0)
+        {
+            savedErrno = errno;
+            result = -1;
+        }
+    }
+    pthread_mutex_unlock(&appendLock);
+
+    if (result != 0)
+    {
+        errno = savedErrno;
+    }
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef MYAPPEND_H
+#define MYAPPEND_H
+
+#include <stddef.h>
+
+#define APPEND_CACHE_SIZE 16
+#define APPEND_BUFFER_SIZE (64 * 1024)
+/** Appended data is never held longer than this before it is written. */
+#define APPEND_FLUSH_INTERVAL_MS 200
+
+/**
+ * Appends `data` to the file at `path` through the shell's append cache. The cache
+ * keeps up to APPEND_CACHE_SIZE files open with O_APPEND across commands, so a
+ * script that logs with `echo ... >> file` in a loop opens the file once instead of
+ * once per line. Data is gathered in a buffer per file and written with a single
+ * `writev` when the buffer would overflow, when it has been held for
+ * APPEND_FLUSH_INTERVAL_MS, or when `appendFlush` runs. Writes never split a call's
+ * data, so whole lines reach the file in the order they were appended.
+ *
+ * Usage example:
+ *   appendWrite("/var/log/app.log", "started\n", 8);
+ *
+ * @param path The canonical path of the file (see `canonicalizePath`); created with
+ *             mode 0644 if it does not exist.
+ * @param data The bytes to append.
+ * @param length Number of bytes.
+ * @return 0 on success, -1 with errno set if the file could not be opened or an
+ *         earlier buffer for it could not be written.
+ */
+int appendWrite(const char *path, const char *data, size_t length);
+
+/**
+ * Writes out every buffered append. Before writing, each file is checked against
+ * its path: if it was removed or replaced, for example by log rotation, the path is
+ * opened again so the data goes to the current file. The shell flushes after each
+ * command line, before any command other than `echo` runs, from `sync` and at exit.
+ *
+ * @return 0 on success, -1 with errno set if any buffer could not be written.
+ */
+int appendFlush(void);
+
+#endif // MYAPPEND_H
@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "myArena.h"
+
+#define ARENA_ALIGNMENT 16
+#define POOL_CLASSES 9
+#define POOL_SLAB_SIZE (64 * 1024)
+
+struct ArenaChunk
+{
+    ArenaChunk *next;
+    size_t size;
+    size_t used;
+    size_t padding;
+    char data[];
+};
+
+/* Every pool block is preceded by a header recording its class, so poolFree can
+   find the right free list. The header is 16 bytes to keep blocks aligned. */
+typedef struct PoolHeader
+{
+    union
+    {
+        struct PoolHeader *next;
+        size_t sizeClass;
+    };
+    size_t padding;
+} PoolHeader;
+
+#define LARGE_CLASS ((size_t)-1)
+
+static MemoryStats stats;
+
+static PoolHeader *freeLists[POOL_CLASSES];
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t arenaKey;
+static pthread_once_t arenaKeyOnce = PTHREAD_ONCE_INIT;
+static __thread Arena *threadArena = NULL;
+
+#define COUNT(field, amount) __atomic_fetch_add(&stats.field, (amount), __ATOMIC_RELAXED)
+
+static void *heapAlloc(size_t size)
+{
+    COUNT(heapCalls, 1);
+    return malloc(size);
+}
+
+static size_t alignUp(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaChunk *newChunk(size_t minimum)
+{
+    size_t size = minimum > ARENA_CHUNK_SIZE ? alignUp(minimum) : ARENA_CHUNK_SIZE;
+    ArenaChunk *chunk = heapAlloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL)
+    {
+        perror("Failed to allocate arena chunk");
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    size = alignUp(size ? size : 1);
+
+    ArenaChunk *chunk = arena->current;
+    while (chunk != NULL && chunk->size - chunk->used < size)
+    {
+        // Chunks after `current` are leftovers from before the last reset.
+        chunk = chunk->next;
+        if (chunk != NULL)
+        {
+            chunk->used = 0;
+        }
+    }
+
+    if (chunk == NULL)
+    {
+        chunk = newChunk(size);
+        if (chunk == NULL)
+        {
+            return NULL;
+        }
+        // Put the fresh chunk right after `current`, keeping any unused ones behind it.
+        if (arena->current == NULL)
+        {
+            arena->first = chunk;
+        }
+        else
+        {
+            chunk->next = arena->current->next;
+            arena->current->next = chunk;
+        }
+    }
+
+    arena->current = chunk;
+    void *ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->lastAllocation = ptr;
+    arena->lastSize = size;
+
+    COUNT(arenaAllocations, 1);
+    COUNT(arenaBytes, size);
+    return ptr;
+}
+
+void *arenaGrow(Arena *arena, void *ptr, size_t oldSize, size_t newSize)
+{
+    if (ptr != NULL && ptr == arena->lastAllocation)
+    {
+        ArenaChunk *chunk = arena->current;
+        size_t grown = alignUp(newSize);
+        if (grown <= arena->lastSize || chunk->used - arena->lastSize + grown <= chunk->size)
+        {
+            if (grown > arena->lastSize)
+            {
+                chunk->used += grown - arena->lastSize;
+                COUNT(arenaBytes, grown - arena->lastSize);
+                arena->lastSize = grown;
+            }
+            return ptr;
+        }
+    }
+
+    void *grown = arenaAlloc(arena, newSize);
+    if (grown != NULL && ptr != NULL)
+    {
+        memcpy(grown, ptr, oldSize < newSize ? oldSize : newSize);
+    }
+    return grown;
+}
+
+char *arenaStrdup(Arena *arena, const char *str)
+{
+    size_t length = strlen(str) + 1;
+    char *copy = arenaAlloc(arena, length);
+    if (copy != NULL)
+    {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+void arenaReset(Arena *arena)
+{
+    arena->current = arena->first;
+    if (arena->first != NULL)
+    {
+        arena->first->used = 0;
+    }
+    arena->lastAllocation = NULL;
+    arena->lastSize = 0;
+    COUNT(arenaResets, 1);
+}
+
+ArenaMark arenaMark(Arena *arena)
+{
+    ArenaMark mark = {arena->current, arena->current != NULL ? arena->current->used : 0};
+    return mark;
+}
+
+void arenaRestore(Arena *arena, ArenaMark mark)
+{
+    if (mark.chunk == NULL)
+    {
+        // The mark was taken before the first allocation.
+        arenaReset(arena);
+        return;
+    }
+    arena->current = mark.chunk;
+    mark.chunk->used = mark.used;
+    arena->lastAllocation = NULL;
+    arena->lastSize = 0;
+}
+
+void arenaRelease(Arena *arena)
+{
+    ArenaChunk *chunk = arena->first;
+    while (chunk != NULL)
+    {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+static void releaseThreadArena(void *arena)
+{
+    arenaRelease(arena);
+    free(arena);
+}
+
+static void createArenaKey(void)
+{
+    pthread_key_create(&arenaKey, releaseThreadArena);
+}
+
+Arena *commandArena(void)
+{
+    if (threadArena == NULL)
+    {
+        static Arena mainArena;
+        static int mainClaimed = 0;
+
+        pthread_once(&arenaKeyOnce, createArenaKey);
+        // The first thread to ask (the prompt loop) uses a static arena; other
+        // threads get one that is released when they exit.
+        if (__atomic_exchange_n(&mainClaimed, 1, __ATOMIC_ACQ_REL) == 0)
+        {
+            threadArena = &mainArena;
+        }
+        else
+        {
+            threadArena = calloc(1, sizeof(Arena));
+            if (threadArena == NULL)
+            {
+                perror("Failed to allocate arena");
+                abort();
+            }
+            pthread_setspecific(arenaKey, threadArena);
+        }
+    }
+    return threadArena;
+}
+
+Arena *arenaSwap(Arena *arena)
+{
+    Arena *previous = threadArena;
+    threadArena = arena;
+    return previous;
+}
+
+static int classIndex(size_t size)
+{
+    size_t classSize = POOL_MIN_CLASS;
+    int index = 0;
+    while (classSize < size)
+    {
+        classSize <<= 1;
+        index++;
+    }
+    return index;
+}
+
+/* Carves a slab into blocks of one class and threads them onto its free list.
+   Called with poolLock held. */
+static int refillClass(int index)
+{
+    size_t blockSize = sizeof(PoolHeader) + ((size_t)POOL_MIN_CLASS << index);
+    size_t count = POOL_SLAB_SIZE / blockSize;
+    if (count == 0)
+    {
+        count = 1;
+    }
+
+    char *slab = heapAlloc(blockSize * count);
+    if (slab == NULL)
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        PoolHeader *block = (PoolHeader *)(slab + i * blockSize);
+        block->next = freeLists[index];
+        freeLists[index] = block;
+    }
+    return 0;
+}
+
+void *poolAlloc(size_t size)
+{
+    if (size > POOL_MAX_CLASS)
+    {
+        PoolHeader *header = heapAlloc(sizeof(PoolHeader) + size);
+        if (header == NULL)
+        {
+            return NULL;
+        }
+        header->sizeClass = LARGE_CLASS;
+        COUNT(largeAllocations, 1);
+        return header + 1;
+    }
+
+    int index = classIndex(size);
+    pthread_mutex_lock(&poolLock);
+    bool reused = freeLists[index] != NULL;
+    if (!reused && refillClass(index) != 0)
+    {
+        pthread_mutex_unlock(&poolLock);
+        return NULL;
+    }
+    PoolHeader *header = freeLists[index];
+    freeLists[index] = header->next;
+    pthread_mutex_unlock(&poolLock);
+
+    header->sizeClass = (size_t)index;
+    COUNT(poolAllocations, 1);
+    if (reused)
+    {
+        COUNT(poolReuses, 1);
+    }
+    return header + 1;
+}
+
+void poolFree(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    PoolHeader *header = (PoolHeader *)ptr - 1;
+    if (header->sizeClass == LARGE_CLASS)
+    {
+        free(header);
+        return;
+    }
+
+    int index = (int)header->sizeClass;
+    COUNT(poolFrees, 1);
+    pthread_mutex_lock(&poolLock);
+    header->next = freeLists[index];
+    freeLists[index] = header;
+    pthread_mutex_unlock(&poolLock);
+}
+
+char *poolStrdup(const char *str)
+{
+    size_t length = strlen(str) + 1;
+    char *copy = poolAlloc(length);
+    if (copy != NULL)
+    {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+MemoryStats memoryStats(void)
+{
+    MemoryStats snapshot;
+    snapshot.heapCalls = __atomic_load_n(&stats.heapCalls, __ATOMIC_RELAXED);
+    snapshot.arenaAllocations = __atomic_load_n(&stats.arenaAllocations, __ATOMIC_RELAXED);
+    snapshot.arenaBytes = __atomic_load_n(&stats.arenaBytes, __ATOMIC_RELAXED);
+    snapshot.arenaResets = __atomic_load_n(&stats.arenaResets, __ATOMIC_RELAXED);
+    snapshot.poolAllocations = __atomic_load_n(&stats.poolAllocations, __ATOMIC_RELAXED);
+    snapshot.poolReuses = __atomic_load_n(&stats.poolReuses, __ATOMIC_RELAXED);
+    snapshot.poolFrees = __atomic_load_n(&stats.poolFrees, __ATOMIC_RELAXED);
+    snapshot.largeAllocations = __atomic_load_n(&stats.largeAllocations, __ATOMIC_RELAXED);
+    return snapshot;
+}
@@ -0,0 +1,196 @@
+#ifndef MYARENA_H
+#define MYARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define POOL_MIN_CLASS 16
+#define POOL_MAX_CLASS 4096
+
+typedef struct ArenaChunk ArenaChunk;
+
+/**
+ * A bump allocator for memory that lives exactly as long as one command. Objects
+ * are carved from large chunks by advancing an offset, never freed one by one, and
+ * released all at once by `arenaReset`. Chunks are kept across resets, so after the
+ * first few commands the prompt loop stops calling malloc altogether.
+ */
+typedef struct
+{
+    ArenaChunk *first;
+    ArenaChunk *current;
+    void *lastAllocation;
+    size_t lastSize;
+} Arena;
+
+/**
+ * A position in an arena, taken with `arenaMark`. Restoring it releases everything
+ * allocated after it while keeping what came before.
+ */
+typedef struct
+{
+    ArenaChunk *chunk;
+    size_t used;
+} ArenaMark;
+
+/**
+ * Allocation counters for the arena and the size-class pools, reported by the
+ * `memstats` builtin. `heapCalls` counts every call these allocators made into
+ * malloc; in a steady-state command loop it stops increasing.
+ */
+typedef struct
+{
+    unsigned long heapCalls;
+    unsigned long arenaAllocations;
+    unsigned long arenaBytes;
+    unsigned long arenaResets;
+    unsigned long poolAllocations;
+    unsigned long poolReuses;
+    unsigned long poolFrees;
+    unsigned long largeAllocations;
+} MemoryStats;
+
+/**
+ * Returns the arena of the calling thread. The prompt loop allocates the input
+ * line, its copy and the argument vectors here and resets it after every command.
+ * Pipeline stage threads get their own arena, released when the thread ends, and
+ * so does every background job (see myCoro.h), so a job's scripts and arguments
+ * survive the prompt loop's resets.
+ *
+ * @return The calling thread's command arena. Never NULL.
+ */
+Arena *commandArena(void);
+
+/**
+ * Makes `arena` the calling thread's command arena and returns the one it replaces.
+ * The coroutine scheduler switches each job's arena in while the job runs.
+ *
+ * Usage example:
+ *   Arena *saved = arenaSwap(&job->arena);
+ *   swapcontext(&schedulerContext, &job->context);
+ *   arenaSwap(saved);
+ *
+ * @param arena The arena to use, or NULL to fall back to the thread's own on the
+ *              next `commandArena` call.
+ * @return The arena that was in use, possibly NULL.
+ */
+Arena *arenaSwap(Arena *arena);
+
+/**
+ * Allocates `size` bytes from the arena, aligned to 16 bytes.
+ *
+ * Usage example:
+ *   char **argv = arenaAlloc(commandArena(), 8 * sizeof(char *));
+ *
+ * @param arena The arena.
+ * @param size Number of bytes.
+ * @return Pointer to the memory, or NULL if a new chunk could not be allocated.
+ */
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * Resizes an arena allocation. When `ptr` is the most recent allocation and the
+ * chunk has room, it grows in place; otherwise a new block is allocated and the old
+ * content copied. Used for buffers that grow one element at a time, such as the
+ * input line and argument vectors.
+ *
+ * @param arena The arena.
+ * @param ptr A previous allocation from `arena`, or NULL.
+ * @param oldSize The current size of `ptr`.
+ * @param newSize The required size.
+ * @return Pointer to the resized memory, or NULL on failure (`ptr` stays valid).
+ */
+void *arenaGrow(Arena *arena, void *ptr, size_t oldSize, size_t newSize);
+
+/**
+ * Copies a string into the arena.
+ *
+ * @param arena The arena.
+ * @param str The string to copy.
+ * @return The copy, or NULL on failure.
+ */
+char *arenaStrdup(Arena *arena, const char *str);
+
+/**
+ * Releases everything allocated from the arena in O(1): the first chunk's offset is
+ * rewound and later chunks are reused as the arena fills up again.
+ *
+ * @param arena The arena.
+ */
+void arenaReset(Arena *arena);
+
+/**
+ * Remembers the arena's current position.
+ *
+ * Usage example:
+ *   ArenaMark mark = arenaMark(commandArena());
+ *   char **args = buildArguments(command);
+ *   runBuiltin(args);
+ *   arenaRestore(commandArena(), mark);
+ *
+ * @param arena The arena.
+ * @return The position, to be passed to `arenaRestore`.
+ */
+ArenaMark arenaMark(Arena *arena);
+
+/**
+ * Releases everything allocated from the arena since `mark` was taken, in O(1). The
+ * script executor does this around every command, so the body of a long loop runs in
+ * the same few kilobytes on every iteration while the parsed script, allocated
+ * before the first mark, stays in place.
+ *
+ * @param arena The arena.
+ * @param mark A position taken from the same arena that has not been released by a
+ *             reset or an earlier restore.
+ */
+void arenaRestore(Arena *arena, ArenaMark mark);
+
+/**
+ * Returns all of the arena's chunks to the heap.
+ *
+ * @param arena The arena.
+ */
+void arenaRelease(Arena *arena);
+
+/**
+ * Allocates `size` bytes from a size-class pool. Requests are rounded up to a power
+ * of two between POOL_MIN_CLASS and POOL_MAX_CLASS bytes, and freed blocks are kept
+ * on a per-class free list for the next request of that class, so recurring objects
+ * such as normalized paths and echo text buffers are recycled instead of going
+ * through malloc each time. Larger requests fall back to malloc.
+ *
+ * Pool memory must be released with `poolFree`, never with `free`.
+ *
+ * Usage example:
+ *   char *path = poolAlloc(strlen(input) + 1);
+ *   strcpy(path, input);
+ *   poolFree(path);
+ *
+ * @param size Number of bytes.
+ * @return Pointer to the memory, or NULL on failure.
+ */
+void *poolAlloc(size_t size);
+
+/**
+ * Returns a block obtained from `poolAlloc` to its pool. NULL is ignored.
+ *
+ * @param ptr The block to release.
+ */
+void poolFree(void *ptr);
+
+/**
+ * Copies a string into pool memory.
+ *
+ * @param str The string to copy.
+ * @return The copy, to be released with `poolFree`, or NULL on failure.
+ */
+char *poolStrdup(const char *str);
+
+/**
+ * Returns a snapshot of the allocation counters.
+ *
+ * @return The current counters.
+ */
+MemoryStats memoryStats(void);
+
+#endif // MYARENA_H
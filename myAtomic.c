@@ -0,0 +1,353 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "myAtomic.h"
+
+static AtomicFile pending[ATOMIC_BATCH_SIZE];
+static int pendingCount = 0;
+static pthread_mutex_t pendingLock = PTHREAD_MUTEX_INITIALIZER;
+static pid_t ownerPid = 0;
+static unsigned tempCounter = 0;
+
+/* Splits `path` into its directory, opened for syncing, and its last component. */
+static int openParent(const char *path, AtomicFile *file)
+{
+    const char *slash = strrchr(path, '/');
+    const char *name = slash != NULL ? slash + 1 : path;
+    if (*name == '\0' || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+    {
+        errno = EISDIR;
+        return -1;
+    }
+
+    char directory[PATH_MAX];
+    if (slash == NULL)
+    {
+        strcpy(directory, ".");
+    }
+    else if (slash == path)
+    {
+        strcpy(directory, "/");
+    }
+    else if ((size_t)(slash - path) < sizeof(directory))
+    {
+        memcpy(directory, path, slash - path);
+        directory[slash - path] = '\0';
+    }
+    else
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    struct stat st;
+    file->dirFd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (file->dirFd == -1 || fstat(file->dirFd, &st) != 0)
+    {
+        if (file->dirFd != -1)
+        {
+            close(file->dirFd);
+        }
+        return -1;
+    }
+    file->dirDevice = st.st_dev;
+    file->dirInode = st.st_ino;
+    file->name = strdup(name);
+    if (file->name == NULL)
+    {
+        close(file->dirFd);
+        return -1;
+    }
+    return 0;
+}
+
+static void makeTempName(AtomicFile *file)
+{
+    unsigned counter = __atomic_fetch_add(&tempCounter, 1, __ATOMIC_RELAXED);
+    snprintf(file->tempName, sizeof(file->tempName), ".%.32s.%d.%u", file->name, (int)getpid(), counter);
+}
+
+static void releaseFile(AtomicFile *file)
+{
+    close(file->fd);
+    close(file->dirFd);
+    free(file->name);
+    file->fd = -1;
+    file->dirFd = -1;
+    file->name = NULL;
+}
+
+int atomicOpen(const char *path, mode_t mode, AtomicFile *file)
+{
+    char resolved[PATH_MAX];
+    struct stat st;
+    bool exists = lstat(path, &st) == 0;
+    if (exists && S_ISLNK(st.st_mode))
+    {
+        // Replace the file the link points to, not the link.
+        if (realpath(path, resolved) == NULL)
+        {
+            return -1;
+        }
+        path = resolved;
+        exists = stat(path, &st) == 0;
+    }
+    if (exists && S_ISDIR(st.st_mode))
+    {
+        errno = EISDIR;
+        return -1;
+    }
+    if (exists && !S_ISREG(st.st_mode))
+    {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    if (exists)
+    {
+        mode = st.st_mode & 07777;
+    }
+
+    if (openParent(path, file) != 0)
+    {
+        return -1;
+    }
+    file->named = false;
+    file->fd = openat(file->dirFd, ".", O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+    while (file->fd == -1 && (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL || errno == EEXIST))
+    {
+        // No O_TMPFILE here: fall back to a hidden temporary name next to the target.
+        makeTempName(file);
+        file->named = true;
+        file->fd = openat(file->dirFd, file->tempName, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+    }
+    if (file->fd == -1)
+    {
+        int savedErrno = errno;
+        close(file->dirFd);
+        free(file->name);
+        errno = savedErrno;
+        return -1;
+    }
+    // The umask applies to the new file; an existing target's mode is kept exactly.
+    if (exists)
+    {
+        fchmod(file->fd, mode);
+    }
+    return 0;
+}
+
+/* Gives an O_TMPFILE file a name in its directory so it can be renamed over the
+   target: linkat cannot replace an existing file. */
+static int linkTemp(AtomicFile *file)
+{
+    if (file->named)
+    {
+        return 0;
+    }
+    char procPath[32];
+    snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", file->fd);
+    for (;;)
+    {
+        makeTempName(file);
+        // AT_EMPTY_PATH needs CAP_DAC_READ_SEARCH on older kernels; /proc does not.
+        if (linkat(file->fd, "", file->dirFd, file->tempName, AT_EMPTY_PATH) == 0 ||
+            (errno != EEXIST &&
+             linkat(AT_FDCWD, procPath, file->dirFd, file->tempName, AT_SYMLINK_FOLLOW) == 0))
+        {
+            file->named = true;
+            return 0;
+        }
+        if (errno != EEXIST)
+        {
+            return -1;
+        }
+    }
+}
+
+static int replaceTarget(AtomicFile *file)
+{
+    if (linkTemp(file) != 0)
+    {
+        return -1;
+    }
+    if (renameat(file->dirFd, file->tempName, file->dirFd, file->name) != 0)
+    {
+        int savedErrno = errno;
+        unlinkat(file->dirFd, file->tempName, 0);
+        errno = savedErrno;
+        return -1;
+    }
+    return 0;
+}
+
+void atomicAbort(AtomicFile *file)
+{
+    if (file->named)
+    {
+        unlinkat(file->dirFd, file->tempName, 0);
+    }
+    releaseFile(file);
+}
+
+/* Writes out the whole batch if the shell exits with commits still pending.
+   Forked children inherit the batch but leave it to the shell. */
+static void flushAtExit(void)
+{
+    if (getpid() == ownerPid && atomicFlush() != 0)
+    {
+        perror("Failed to flush pending writes");
+    }
+}
+
+int atomicCommit(AtomicFile *file, bool durable)
+{
+    if (!durable)
+    {
+        int result = replaceTarget(file);
+        releaseFile(file);
+        return result;
+    }
+
+    pthread_mutex_lock(&pendingLock);
+    if (ownerPid == 0)
+    {
+        atexit(flushAtExit);
+    }
+    ownerPid = getpid();
+    pending[pendingCount++] = *file;
+    bool full = pendingCount == ATOMIC_BATCH_SIZE;
+    pthread_mutex_unlock(&pendingLock);
+    return full ? atomicFlush() : 0;
+}
+
+/* Syncs the data of every pending file: one fsync when there is a single file,
+   otherwise one syncfs per file system, which covers all of its files at once. */
+static int syncBatchData(void)
+{
+    if (pendingCount == 1)
+    {
+        return fsync(pending[0].fd);
+    }
+
+    dev_t synced[ATOMIC_BATCH_SIZE];
+    int syncedCount = 0;
+    int result = 0;
+    for (int i = 0; i < pendingCount; i++)
+    {
+        bool seen = false;
+        for (int j = 0; j < syncedCount && !seen; j++)
+        {
+            seen = synced[j] == pending[i].dirDevice;
+        }
+        if (!seen)
+        {
+            synced[syncedCount++] = pending[i].dirDevice;
+            if (syncfs(pending[i].fd) != 0)
+            {
+                result = -1;
+            }
+        }
+    }
+    return result;
+}
+
+int atomicFlush(void)
+{
+    pthread_mutex_lock(&pendingLock);
+    if (pendingCount == 0)
+    {
+        pthread_mutex_unlock(&pendingLock);
+        return 0;
+    }
+
+    int result = 0;
+    int savedErrno = 0;
+    if (syncBatchData() != 0)
+    {
+        // Renaming now could publish files whose data is not on disk yet.
+        savedErrno = errno;
+        result = -1;
+    }
+    // Stop at the first failure so a later write never appears without an earlier one.
+    for (int i = 0; i < pendingCount; i++)
+    {
+        AtomicFile *file = &pending[i];
+        if (result == 0 && replaceTarget(file) != 0)
+        {
+            savedErrno = errno;
+            result = -1;
+        }
+        else if (result != 0 && file->named)
+        {
+            unlinkat(file->dirFd, file->tempName, 0);
+        }
+    }
+
+    // The renames themselves are durable once each directory involved is synced.
+    for (int i = 0; i < pendingCount; i++)
+    {
+        bool seen = false;
+        for (int j = 0; j < i && !seen; j++)
+        {
+            seen = pending[j].dirDevice == pending[i].dirDevice && pending[j].dirInode == pending[i].dirInode;
+        }
+        if (!seen && fsync(pending[i].dirFd) != 0 && savedErrno == 0)
+        {
+            savedErrno = errno;
+            result = -1;
+        }
+        releaseFile(&pending[i]);
+    }
+    pendingCount = 0;
+    pthread_mutex_unlock(&pendingLock);
+
+    if (result != 0)
+    {
+        errno = savedErrno;
+    }
+    return result;
+}
+
+int atomicPendingCount(void)
+{
+    return __atomic_load_n(&pendingCount, __ATOMIC_RELAXED);
+}
+
+bool atomicIsPending(const char *path)
+{
+    if (atomicPendingCount() == 0)
+    {
+        return false;
+    }
+
+    AtomicFile probe;
+    char resolved[PATH_MAX];
+    if (realpath(path, resolved) != NULL)
+    {
+        path = resolved;
+    }
+    if (openParent(path, &probe) != 0)
+    {
+        return false;
+    }
+
+    bool found = false;
+    pthread_mutex_lock(&pendingLock);
+    for (int i = 0; i < pendingCount && !found; i++)
+    {
+        found = pending[i].dirDevice == probe.dirDevice && pending[i].dirInode == probe.dirInode &&
+                strcmp(pending[i].name, probe.name) == 0;
+    }
+    pthread_mutex_unlock(&pendingLock);
+
+    close(probe.dirFd);
+    free(probe.name);
+    return found;
+}
@@ -0,0 +1,99 @@
+#ifndef MYATOMIC_H
+#define MYATOMIC_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/** Most durable writes held for one flush; a full batch is flushed at once. */
+#define ATOMIC_BATCH_SIZE 64
+#define ATOMIC_TEMP_NAME_SIZE 64
+
+/**
+ * A file being written in place of another. The data goes to a temporary file in
+ * the target's directory, and the target is only replaced, by a rename, once the
+ * new content is complete, so readers see either the old file or the new one and
+ * never a partly written one.
+ */
+typedef struct
+{
+    int fd;
+    int dirFd;
+    dev_t dirDevice;
+    ino_t dirInode;
+    char *name;
+    char tempName[ATOMIC_TEMP_NAME_SIZE];
+    bool named;
+} AtomicFile;
+
+/**
+ * Starts an atomic replacement of `path`. The temporary file is created with
+ * O_TMPFILE where the file system supports it, so it has no name, and nothing is
+ * left behind if the shell dies before the commit. Elsewhere a hidden file named
+ * after the target is used instead. An existing target's permissions are kept. A
+ * symbolic link is followed, so the file it points to is the one replaced.
+ *
+ * Usage example:
+ *   AtomicFile file;
+ *   if (atomicOpen("app.conf", 0644, &file) == 0 && ioWriteAll(file.fd, text, length) == 0)
+ *       atomicCommit(&file, false);
+ *
+ * @param path The file to replace or create.
+ * @param mode Permissions used when the file does not exist yet.
+ * @param file Receives the temporary file; write the new content to `file->fd`.
+ * @return 0 on success, -1 with errno set on failure. EOPNOTSUPP means the target
+ *         exists but is not a regular file.
+ */
+int atomicOpen(const char *path, mode_t mode, AtomicFile *file);
+
+/**
+ * Replaces the target with the temporary file's content.
+ *
+ * Without `durable` the rename happens at once and nothing is synced: readers never
+ * see a torn file, but a power loss can lose the latest content.
+ *
+ * With `durable` the file joins a batch that `atomicFlush` writes out: the data of
+ * every file in the batch is synced first, then the files are renamed into place in
+ * the order they were committed, then their directories are synced. A batch costs
+ * one sync of each file system involved however many files it holds, instead of an
+ * fsync per file. Until the flush, readers keep seeing the previous content.
+ *
+ * @param file A file from `atomicOpen`. It is released either way.
+ * @param durable true to batch the replacement for an ordered, durable flush.
+ * @return 0 on success, -1 with errno set on failure (the target is left as it was).
+ */
+int atomicCommit(AtomicFile *file, bool durable);
+
+/**
+ * Abandons an atomic replacement, leaving the target untouched.
+ *
+ * @param file A file from `atomicOpen`.
+ */
+void atomicAbort(AtomicFile *file);
+
+/**
+ * Makes every durable commit made so far visible and durable, as described for
+ * `atomicCommit`. The shell flushes after each command line it reads, before any
+ * command that could read a pending file, from the `sync` builtin and at exit.
+ *
+ * @return 0 on success, -1 with errno set if the data could not be synced or a
+ *         file could not be renamed. The batch stops at the failing file and the
+ *         files after it are discarded, so a later write never becomes visible
+ *         without an earlier one.
+ */
+int atomicFlush(void);
+
+/**
+ * Returns the number of durable commits waiting for `atomicFlush`.
+ */
+int atomicPendingCount(void);
+
+/**
+ * Tells whether a durable commit of `path` is waiting for `atomicFlush`, in which
+ * case reading `path` would still return the previous content.
+ *
+ * @param path The file path.
+ * @return true if `path` is waiting in the batch.
+ */
+bool atomicIsPending(const char *path);
+
+#endif // MYATOMIC_H
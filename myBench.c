@@ -0,0 +1,586 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include "myRing.h"
+
+#define BENCH_TOTAL_BYTES (1024L * 1024 * 1024)
+#define BENCH_CHUNK (64 * 1024)
+#define BENCH_PING_ROUNDS 200000
+#define BENCH_QUEUE_ITEMS 4000000
+#define BENCH_QUEUE_THREADS 4
+#define BENCH_STARTUP_RUNS 300
+#define BENCH_WORKLOAD_LINES 200000
+#define BENCH_WORKLOAD_REPEATS 3
+#define BENCH_MAX_SHELLS 8
+
+typedef struct
+{
+    ByteRing *ring;
+    ByteRing *reply;
+    int writeFd;
+    int readFd;
+} BenchPeer;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void writeFully(int fd, const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written <= 0)
+        {
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+}
+
+static void readFully(int fd, char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t got = read(fd, data, length);
+        if (got <= 0)
+        {
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+        data += got;
+        length -= (size_t)got;
+    }
+}
+
+static void *ringProducer(void *arg)
+{
+    BenchPeer *peer = arg;
+    char *chunk = calloc(1, BENCH_CHUNK);
+    for (long sent = 0; sent < BENCH_TOTAL_BYTES; sent += BENCH_CHUNK)
+    {
+        ringWrite(peer->ring, chunk, BENCH_CHUNK);
+    }
+    ringCloseWriter(peer->ring);
+    free(chunk);
+    return NULL;
+}
+
+static void *pipeProducer(void *arg)
+{
+    BenchPeer *peer = arg;
+    char *chunk = calloc(1, BENCH_CHUNK);
+    for (long sent = 0; sent < BENCH_TOTAL_BYTES; sent += BENCH_CHUNK)
+    {
+        writeFully(peer->writeFd, chunk, BENCH_CHUNK);
+    }
+    close(peer->writeFd);
+    free(chunk);
+    return NULL;
+}
+
+static void benchThroughput(void)
+{
+    char *buffer = malloc(BENCH_CHUNK);
+    pthread_t thread;
+    long received = 0;
+
+    BenchPeer peer = {ringCreate(RING_DEFAULT_CAPACITY * 16), NULL, -1, -1};
+    double start = now();
+    pthread_create(&thread, NULL, ringProducer, &peer);
+    ssize_t got;
+    while ((got = ringRead(peer.ring, buffer, BENCH_CHUNK)) > 0)
+    {
+        received += got;
+    }
+    pthread_join(thread, NULL);
+    ringCloseReader(peer.ring);
+    double ringSeconds = now() - start;
+
+    int fds[2];
+    if (pipe(fds) == -1)
+    {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    peer.readFd = fds[0];
+    peer.writeFd = fds[1];
+    received = 0;
+    start = now();
+    pthread_create(&thread, NULL, pipeProducer, &peer);
+    while ((got = read(peer.readFd, buffer, BENCH_CHUNK)) > 0)
+    {
+        received += got;
+    }
+    pthread_join(thread, NULL);
+    close(peer.readFd);
+    double pipeSeconds = now() - start;
+
+    printf("throughput  ring %7.2f GB/s   pipe %7.2f GB/s   (%ld MiB in %d KiB writes)\n",
+           BENCH_TOTAL_BYTES / ringSeconds / 1e9, BENCH_TOTAL_BYTES / pipeSeconds / 1e9,
+           BENCH_TOTAL_BYTES >> 20, BENCH_CHUNK >> 10);
+    free(buffer);
+}
+
+static void *ringEcho(void *arg)
+{
+    BenchPeer *peer = arg;
+    uint64_t message;
+    for (int i = 0; i < BENCH_PING_ROUNDS; i++)
+    {
+        ringRead(peer->ring, (char *)&message, sizeof(message));
+        ringWrite(peer->reply, (char *)&message, sizeof(message));
+    }
+    return NULL;
+}
+
+static void *pipeEcho(void *arg)
+{
+    BenchPeer *peer = arg;
+    uint64_t message;
+    for (int i = 0; i < BENCH_PING_ROUNDS; i++)
+    {
+        readFully(peer->readFd, (char *)&message, sizeof(message));
+        writeFully(peer->writeFd, (char *)&message, sizeof(message));
+    }
+    return NULL;
+}
+
+static void benchLatency(void)
+{
+    pthread_t thread;
+    uint64_t message = 0;
+
+    BenchPeer peer = {ringCreate(4096), ringCreate(4096), -1, -1};
+    pthread_create(&thread, NULL, ringEcho, &peer);
+    double start = now();
+    for (int i = 0; i < BENCH_PING_ROUNDS; i++)
+    {
+        ringWrite(peer.ring, (char *)&message, sizeof(message));
+        ringRead(peer.reply, (char *)&message, sizeof(message));
+    }
+    double ringSeconds = now() - start;
+    pthread_join(thread, NULL);
+    ringCloseWriter(peer.ring);
+    ringCloseReader(peer.ring);
+    ringCloseWriter(peer.reply);
+    ringCloseReader(peer.reply);
+
+    int there[2], back[2];
+    if (pipe(there) == -1 || pipe(back) == -1)
+    {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+    BenchPeer pipePeer = {NULL, NULL, back[1], there[0]};
+    pthread_create(&thread, NULL, pipeEcho, &pipePeer);
+    start = now();
+    for (int i = 0; i < BENCH_PING_ROUNDS; i++)
+    {
+        writeFully(there[1], (char *)&message, sizeof(message));
+        readFully(back[0], (char *)&message, sizeof(message));
+    }
+    double pipeSeconds = now() - start;
+    pthread_join(thread, NULL);
+    close(there[0]);
+    close(there[1]);
+    close(back[0]);
+    close(back[1]);
+
+    // One round trip is two hand-offs.
+    printf("latency     ring %7.0f ns      pipe %7.0f ns      (one-way, 8-byte items)\n",
+           ringSeconds / BENCH_PING_ROUNDS / 2 * 1e9, pipeSeconds / BENCH_PING_ROUNDS / 2 * 1e9);
+}
+
+static void *queueProducer(void *arg)
+{
+    RingQueue *queue = arg;
+    for (uintptr_t i = 1; i <= BENCH_QUEUE_ITEMS / BENCH_QUEUE_THREADS; i++)
+    {
+        queuePush(queue, (void *)i);
+    }
+    return NULL;
+}
+
+static void *queueConsumer(void *arg)
+{
+    RingQueue *queue = arg;
+    void *item;
+    long *count = calloc(1, sizeof(long));
+    while (queuePop(queue, &item))
+    {
+        (*count)++;
+    }
+    return count;
+}
+
+static void benchQueue(void)
+{
+    RingQueue *queue = queueCreate(4096);
+    pthread_t producers[BENCH_QUEUE_THREADS], consumers[BENCH_QUEUE_THREADS];
+
+    double start = now();
+    for (int i = 0; i < BENCH_QUEUE_THREADS; i++)
+    {
+        pthread_create(&producers[i], NULL, queueProducer, queue);
+        pthread_create(&consumers[i], NULL, queueConsumer, queue);
+    }
+    for (int i = 0; i < BENCH_QUEUE_THREADS; i++)
+    {
+        pthread_join(producers[i], NULL);
+    }
+    queueClose(queue);
+
+    long total = 0;
+    for (int i = 0; i < BENCH_QUEUE_THREADS; i++)
+    {
+        long *count;
+        pthread_join(consumers[i], (void **)&count);
+        total += *count;
+        free(count);
+    }
+    double seconds = now() - start;
+    queueDestroy(queue);
+
+    printf("mpmc queue  %7.2f M items/s   (%d producers, %d consumers, %ld items)\n",
+           total / seconds / 1e6, BENCH_QUEUE_THREADS, BENCH_QUEUE_THREADS, total);
+}
+
+static void benchRing(void)
+{
+    benchThroughput();
+    benchLatency();
+    benchQueue();
+}
+
+typedef struct
+{
+    double firstCommand;
+    double total;
+} StartupSample;
+
+/* Starts the shell once and measures how long until the output of its first command
+   arrives, and until it has exited. With `script` set the command is fed on stdin,
+   the way a driver program would; otherwise it is passed with -c. */
+static StartupSample startShell(const char *shell, const char *script)
+{
+    int output[2], input[2];
+    if (pipe(output) == -1 || pipe(input) == -1)
+    {
+        perror("pipe");
+        exit(EXIT_FAILURE);
+    }
+
+    double start = now();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        close(input[0]);
+        close(input[1]);
+        close(output[0]);
+        close(output[1]);
+        if (script != NULL)
+        {
+            execl(shell, shell, "-q", (char *)NULL);
+        }
+        else
+        {
+            execl(shell, shell, "-q", "-c", "echo ready", (char *)NULL);
+        }
+        perror("execl");
+        _exit(127);
+    }
+
+    close(input[0]);
+    close(output[1]);
+    if (script != NULL)
+    {
+        writeFully(input[1], script, strlen(script));
+    }
+    close(input[1]);
+
+    StartupSample sample = {0, 0};
+    char buffer[256];
+    ssize_t got;
+    while ((got = read(output[0], buffer, sizeof(buffer))) > 0)
+    {
+        if (sample.firstCommand == 0)
+        {
+            sample.firstCommand = now() - start;
+        }
+    }
+    close(output[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    sample.total = now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || sample.firstCommand == 0)
+    {
+        fprintf(stderr, "%s did not run the benchmark command\n", shell);
+        exit(EXIT_FAILURE);
+    }
+    return sample;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void reportStartup(const char *label, double *times, int count)
+{
+    qsort(times, count, sizeof(double), compareDoubles);
+    double sum = 0;
+    for (int i = 0; i < count; i++)
+    {
+        sum += times[i];
+    }
+    printf("%-22s median %7.0f us   p99 %7.0f us   mean %7.0f us\n", label,
+           times[count / 2] * 1e6, times[count * 99 / 100] * 1e6, sum / count * 1e6);
+}
+
+static void benchStartup(const char *shell)
+{
+    static const char *modes[] = {"-c", "stdin"};
+    double firstCommand[BENCH_STARTUP_RUNS], total[BENCH_STARTUP_RUNS];
+    char label[64];
+
+    printf("startup of %s (%d runs each)\n", shell, BENCH_STARTUP_RUNS);
+    for (int mode = 0; mode < 2; mode++)
+    {
+        startShell(shell, mode == 1 ? "echo ready\n" : NULL);
+        for (int i = 0; i < BENCH_STARTUP_RUNS; i++)
+        {
+            StartupSample sample = startShell(shell, mode == 1 ? "echo ready\n" : NULL);
+            firstCommand[i] = sample.firstCommand;
+            total[i] = sample.total;
+        }
+        snprintf(label, sizeof(label), "%s first command", modes[mode]);
+        reportStartup(label, firstCommand, BENCH_STARTUP_RUNS);
+        snprintf(label, sizeof(label), "%s exit", modes[mode]);
+        reportStartup(label, total, BENCH_STARTUP_RUNS);
+    }
+}
+
+typedef struct
+{
+    const char *name;
+    const char *script;
+} Workload;
+
+/* The phases the shell spends its time in: streaming copies, scanning files and
+   parsing and dispatching many small commands. They double as the PGO training run. */
+static const Workload workloads[] = {
+    {"cp", "for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16; do cp data.txt copy.txt; done\n"},
+    {"wc", "for i in 1 2 3 4 5 6 7 8; do wc -w data.txt; wc -l data.txt; read data.txt | wc -l; done\n"},
+    {"parse", NULL},
+};
+
+static void writeFile(const char *path, const char *text, size_t length)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL || fwrite(text, 1, length, file) != length || fclose(file) != 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* A long script of distinct lines, so that parsing and expansion dominate. */
+static char *parseScript(size_t *length)
+{
+    size_t capacity = (size_t)BENCH_WORKLOAD_LINES * 96;
+    char *script = malloc(capacity);
+    if (script == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    for (int i = 0; i < BENCH_WORKLOAD_LINES; i++)
+    {
+        switch (i % 4)
+        {
+        case 0:
+            used += snprintf(script + used, capacity - used, "NAME%d=value%d; X=\"$NAME%d suffix\"\n", i % 97, i, i % 97);
+            break;
+        case 1:
+            used += snprintf(script + used, capacity - used, "if [ \"$X\" = nothing%d ]; then false; else true; fi\n", i);
+            break;
+        case 2:
+            used += snprintf(script + used, capacity - used, "true && test %d -lt %d || false\n", i, i + 1);
+            break;
+        default:
+            used += snprintf(script + used, capacity - used, "test -n \"${NAME%d}\" ; true # line %d\n", i % 97, i);
+            break;
+        }
+    }
+    *length = used;
+    return script;
+}
+
+/* Runs `script.msh` in `dir` with the given shell, output discarded, and returns the
+   wall-clock time. */
+static double runWorkload(const char *shell, const char *dir)
+{
+    double start = now();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        int devNull = open("/dev/null", O_WRONLY);
+        if (chdir(dir) == -1 || devNull == -1)
+        {
+            perror(dir);
+            _exit(127);
+        }
+        dup2(devNull, STDOUT_FILENO);
+        execl(shell, shell, "script.msh", (char *)NULL);
+        perror("execl");
+        _exit(127);
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+    {
+        fprintf(stderr, "%s failed to run the workload\n", shell);
+        exit(EXIT_FAILURE);
+    }
+    return now() - start;
+}
+
+static void benchWorkload(int count, char **shells)
+{
+    char dir[] = "/tmp/myBench.XXXXXX";
+    char path[64];
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+
+    static const char line[] = "the quick brown fox jumps over the lazy dog 0123456789\n";
+    size_t dataLength = 16 * 1024 * 1024;
+    char *data = malloc(dataLength);
+    if (data == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < dataLength; i++)
+    {
+        data[i] = line[i % (sizeof(line) - 1)];
+    }
+    snprintf(path, sizeof(path), "%s/data.txt", dir);
+    writeFile(path, data, dataLength);
+    free(data);
+
+    printf("%-8s", "workload");
+    for (int i = 0; i < count; i++)
+    {
+        printf("  %22s", shells[i]);
+    }
+    printf("\n");
+
+    snprintf(path, sizeof(path), "%s/script.msh", dir);
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++)
+    {
+        size_t length;
+        char *script = workloads[w].script != NULL ? (char *)workloads[w].script : parseScript(&length);
+        if (workloads[w].script != NULL)
+        {
+            length = strlen(script);
+        }
+        writeFile(path, script, length);
+        if (workloads[w].script == NULL)
+        {
+            free(script);
+        }
+
+        printf("%-8s", workloads[w].name);
+        double baseline = 0;
+        for (int i = 0; i < count; i++)
+        {
+            // The shell runs inside the scratch directory, so relative paths would break.
+            char shell[PATH_MAX];
+            if (realpath(shells[i], shell) == NULL)
+            {
+                perror(shells[i]);
+                exit(EXIT_FAILURE);
+            }
+            double best = 0;
+            for (int r = 0; r < BENCH_WORKLOAD_REPEATS; r++)
+            {
+                double seconds = runWorkload(shell, dir);
+                best = r == 0 || seconds < best ? seconds : best;
+            }
+            if (i == 0)
+            {
+                baseline = best;
+                printf("  %12.1f ms         ", best * 1e3);
+            }
+            else
+            {
+                printf("  %12.1f ms (%4.2fx)", best * 1e3, baseline / best);
+            }
+        }
+        printf("\n");
+    }
+
+    const char *files[] = {"data.txt", "copy.txt", "script.msh"};
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        unlink(path);
+    }
+    rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+    const char *suite = argc > 1 ? argv[1] : "ring";
+
+    if (strcmp(suite, "ring") == 0)
+    {
+        benchRing();
+    }
+    else if (strcmp(suite, "startup") == 0)
+    {
+        benchStartup(argc > 2 ? argv[2] : "./myShell");
+    }
+    else if (strcmp(suite, "workload") == 0 && argc > 2 && argc - 2 <= BENCH_MAX_SHELLS)
+    {
+        benchWorkload(argc - 2, argv + 2);
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s [ring | startup [shell] | workload shell...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "myCache.h"
+#include "myHash.h"
+
+#define RESULT_CACHE_MAGIC 0x4d535243u
+#define RESULT_CACHE_VERSION 1
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t valueSize;
+    char reserved[48];
+} ResultCacheHeader;
+
+/* One result. `sequence` is odd while a store is writing the slot. */
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t length;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t query;
+    char value[RESULT_CACHE_VALUE_SIZE];
+} ResultSlot;
+
+typedef struct
+{
+    ResultCacheHeader header;
+    ResultSlot slots[RESULT_CACHE_SLOTS];
+} ResultCacheFile;
+
+static ResultCacheFile *cache = NULL;
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+
+/* Maps the cache file, creating it at its full size if needed. A file written by
+   an incompatible version is left alone and the cache stays off. */
+static void cacheMap(void)
+{
+    const char *home = getenv("HOME");
+    if (home == NULL || *home == '\0')
+    {
+        home = ".";
+    }
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", home, RESULT_CACHE_FILE);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    struct stat st;
+    if (fd == -1)
+    {
+        return;
+    }
+    // Concurrent creators extend the file to the same size; new bytes read as zero.
+    if (fstat(fd, &st) != 0 || (st.st_size < (off_t)sizeof(ResultCacheFile) &&
+                                ftruncate(fd, sizeof(ResultCacheFile)) != 0))
+    {
+        close(fd);
+        return;
+    }
+    ResultCacheFile *mapped = mmap(NULL, sizeof(ResultCacheFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return;
+    }
+
+    uint32_t expected = 0;
+    __atomic_compare_exchange_n(&mapped->header.magic, &expected, RESULT_CACHE_MAGIC, false,
+                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    if (expected == 0)
+    {
+        mapped->header.version = RESULT_CACHE_VERSION;
+        mapped->header.slotCount = RESULT_CACHE_SLOTS;
+        mapped->header.valueSize = RESULT_CACHE_VALUE_SIZE;
+    }
+    else if (expected != RESULT_CACHE_MAGIC || mapped->header.version != RESULT_CACHE_VERSION ||
+             mapped->header.slotCount != RESULT_CACHE_SLOTS || mapped->header.valueSize != RESULT_CACHE_VALUE_SIZE)
+    {
+        munmap(mapped, sizeof(ResultCacheFile));
+        return;
+    }
+    cache = mapped;
+}
+
+static uint64_t queryHash(const char *query)
+{
+    HashState state;
+    hashInit(&state);
+    hashUpdate(&state, query, strlen(query));
+    return hashDigest(&state);
+}
+
+static size_t firstSlot(const struct stat *st, uint64_t query)
+{
+    uint64_t key = ((uint64_t)st->st_dev * 0x9e3779b97f4a7c15ULL) ^ ((uint64_t)st->st_ino * 0xc2b2ae3d27d4eb4fULL) ^ query;
+    key ^= key >> 29;
+    return (size_t)key & (RESULT_CACHE_SLOTS - RESULT_CACHE_WAYS);
+}
+
+static bool slotMatches(const ResultSlot *slot, const struct stat *st, uint64_t query)
+{
+    return slot->ino == (uint64_t)st->st_ino && slot->dev == (uint64_t)st->st_dev && slot->query == query;
+}
+
+bool resultCacheLookup(const struct stat *st, const char *query, char *value, size_t *length)
+{
+    pthread_once(&cacheOnce, cacheMap);
+    if (cache == NULL)
+    {
+        return false;
+    }
+
+    uint64_t hash = queryHash(query);
+    size_t first = firstSlot(st, hash);
+    for (size_t way = 0; way < RESULT_CACHE_WAYS; way++)
+    {
+        ResultSlot *slot = &cache->slots[first + way];
+        uint32_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if ((before & 1) != 0 || !slotMatches(slot, st, hash))
+        {
+            continue;
+        }
+        bool current = slot->size == (uint64_t)st->st_size && slot->mtimeSec == (int64_t)st->st_mtim.tv_sec &&
+                       slot->mtimeNsec == (int64_t)st->st_mtim.tv_nsec;
+        uint32_t stored = slot->length;
+        if (!current || stored > RESULT_CACHE_VALUE_SIZE)
+        {
+            return false;
+        }
+        memcpy(value, slot->value, stored);
+        // Only a copy taken while no store ran is a whole result.
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != before)
+        {
+            return false;
+        }
+        *length = stored;
+        return true;
+    }
+    return false;
+}
+
+void resultCacheStore(const struct stat *st, const char *query, const char *value, size_t length)
+{
+    if (length > RESULT_CACHE_VALUE_SIZE || time(NULL) - st->st_mtim.tv_sec < 1)
+    {
+        return;
+    }
+    pthread_once(&cacheOnce, cacheMap);
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    // Reuse the slot holding an older result for this key, else an empty one, else
+    // the way picked by the inode so that different files rotate through the set.
+    uint64_t hash = queryHash(query);
+    size_t first = firstSlot(st, hash);
+    ResultSlot *target = NULL;
+    for (size_t way = 0; way < RESULT_CACHE_WAYS && target == NULL; way++)
+    {
+        if (slotMatches(&cache->slots[first + way], st, hash))
+        {
+            target = &cache->slots[first + way];
+        }
+    }
+    for (size_t way = 0; way < RESULT_CACHE_WAYS && target == NULL; way++)
+    {
+        if (cache->slots[first + way].ino == 0)
+        {
+            target = &cache->slots[first + way];
+        }
+    }
+    if (target == NULL)
+    {
+        target = &cache->slots[first + (size_t)(st->st_mtim.tv_nsec ^ st->st_ino) % RESULT_CACHE_WAYS];
+    }
+
+    uint32_t sequence = __atomic_load_n(&target->sequence, __ATOMIC_RELAXED);
+    // A slot another process is writing is left to it.
+    if ((sequence & 1) != 0 || !__atomic_compare_exchange_n(&target->sequence, &sequence, sequence + 1, false,
+                                                             __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    target->length = (uint32_t)length;
+    target->dev = (uint64_t)st->st_dev;
+    target->ino = (uint64_t)st->st_ino;
+    target->size = (uint64_t)st->st_size;
+    target->mtimeSec = (int64_t)st->st_mtim.tv_sec;
+    target->mtimeNsec = (int64_t)st->st_mtim.tv_nsec;
+    target->query = hash;
+    memcpy(target->value, value, length);
+    __atomic_store_n(&target->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,53 @@
+#ifndef MYCACHE_H
+#define MYCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#define RESULT_CACHE_FILE ".myshell_results"
+/** Results the cache file holds; a power of two. */
+#define RESULT_CACHE_SLOTS 4096
+/** Slots a result may be stored in, searched on every lookup. */
+#define RESULT_CACHE_WAYS 4
+/** Longest result that is cached. */
+#define RESULT_CACHE_VALUE_SIZE 200
+
+/**
+ * Looks up the output a read-only builtin produced earlier for the same file and
+ * query. Results live in a file under $HOME (RESULT_CACHE_FILE) that every myShell
+ * process maps shared, so a result stored by one session serves all of them. An
+ * entry only matches a file with the same device, inode, size and modification time
+ * to the nanosecond, so any write to the file makes its results miss. Each slot is
+ * guarded by a sequence counter, and a lookup that races with a store misses
+ * rather than returning a torn result; no locks are taken.
+ *
+ * Usage example:
+ *   char text[RESULT_CACHE_VALUE_SIZE];
+ *   size_t length;
+ *   if (fstat(fd, &st) == 0 && resultCacheLookup(&st, "wc -l", text, &length))
+ *       fwrite(text, 1, length, stdout);
+ *
+ * @param st The status of the file the result is about.
+ * @param query What was computed from the file, e.g. the builtin and its options.
+ * @param value Receives the result; must hold RESULT_CACHE_VALUE_SIZE bytes.
+ * @param length Receives the length of the result.
+ * @return true on a hit, false on a miss or if the cache file cannot be used.
+ */
+bool resultCacheLookup(const struct stat *st, const char *query, char *value, size_t *length);
+
+/**
+ * Stores a result for later `resultCacheLookup` calls in this and other processes.
+ * Results longer than RESULT_CACHE_VALUE_SIZE, and results for files modified in
+ * the last second (whose timestamp a second write could leave unchanged), are not
+ * stored. An older result for the same file and query is replaced; otherwise the
+ * least useful slot of the RESULT_CACHE_WAYS the key maps to is reused.
+ *
+ * @param st The status of the file, taken before it was read.
+ * @param query What was computed, as passed to `resultCacheLookup`.
+ * @param value The result.
+ * @param length Number of bytes in the result.
+ */
+void resultCacheStore(const struct stat *st, const char *query, const char *value, size_t length);
+
+#endif // MYCACHE_H
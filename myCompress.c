@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "myCompress.h"
+#include "myRing.h"
+
+typedef struct
+{
+    int fd;
+    Compression compression;
+    ByteRing *ring;
+    char *input;
+    int error;
+} Decoder;
+
+Compression detectCompression(int fd)
+{
+    unsigned char magic[4];
+    ssize_t length = pread(fd, magic, sizeof(magic), 0);
+    if (length >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+        return COMPRESSION_GZIP;
+    }
+    if (length == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+    {
+        return COMPRESSION_ZSTD;
+    }
+    return COMPRESSION_NONE;
+}
+
+/* Reads the next block of compressed input. Returns its length, 0 at end of file. */
+static ssize_t readInput(Decoder *decoder)
+{
+    ssize_t length;
+    while ((length = read(decoder->fd, decoder->input, DECODE_INPUT_SIZE)) == -1 && errno == EINTR)
+    {
+    }
+    return length;
+}
+
+static int inflateInto(Decoder *decoder)
+{
+    z_stream stream = {0};
+    // 15 window bits, +32 to accept a gzip or zlib header.
+    if (inflateInit2(&stream, 15 + 32) != Z_OK)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    int result = 0;
+    bool ended = false;
+    while (result == 0)
+    {
+        if (stream.avail_in == 0)
+        {
+            ssize_t length = readInput(decoder);
+            if (length <= 0)
+            {
+                // A file cut short inside a member is corrupt.
+                result = length < 0 ? -1 : 0;
+                if (length == 0 && !ended)
+                {
+                    errno = EILSEQ;
+                    result = -1;
+                }
+                break;
+            }
+            stream.next_in = (Bytef *)decoder->input;
+            stream.avail_in = (uInt)length;
+        }
+        if (ended)
+        {
+            // Another member follows the one that just ended.
+            inflateReset(&stream);
+            ended = false;
+        }
+
+        char *space;
+        ssize_t room = ringReserve(decoder->ring, &space, DECODE_INPUT_SIZE);
+        if (room < 0)
+        {
+            break;
+        }
+        stream.next_out = (Bytef *)space;
+        stream.avail_out = (uInt)room;
+        int status = inflate(&stream, Z_NO_FLUSH);
+        ringPublish(decoder->ring, room - stream.avail_out);
+        if (status == Z_STREAM_END)
+        {
+            ended = true;
+        }
+        else if (status != Z_OK && status != Z_BUF_ERROR)
+        {
+            errno = status == Z_MEM_ERROR ? ENOMEM : EILSEQ;
+            result = -1;
+        }
+    }
+    inflateEnd(&stream);
+    return result;
+}
+
+#ifdef HAVE_ZSTD
+static int zstdInto(Decoder *decoder)
+{
+    ZSTD_DStream *stream = ZSTD_createDStream();
+    if (stream == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    ZSTD_inBuffer in = {decoder->input, 0, 0};
+    size_t hint = 1;
+    int result = 0;
+    while (result == 0)
+    {
+        if (in.pos == in.size)
+        {
+            ssize_t length = readInput(decoder);
+            if (length <= 0)
+            {
+                // A non-zero hint means the last frame is incomplete.
+                result = length < 0 ? -1 : 0;
+                if (length == 0 && hint != 0)
+                {
+                    errno = EILSEQ;
+                    result = -1;
+                }
+                break;
+            }
+            in = (ZSTD_inBuffer){decoder->input, (size_t)length, 0};
+        }
+
+        char *space;
+        ssize_t room = ringReserve(decoder->ring, &space, DECODE_INPUT_SIZE);
+        if (room < 0)
+        {
+            break;
+        }
+        ZSTD_outBuffer out = {space, (size_t)room, 0};
+        hint = ZSTD_decompressStream(stream, &out, &in);
+        ringPublish(decoder->ring, out.pos);
+        if (ZSTD_isError(hint))
+        {
+            errno = EILSEQ;
+            result = -1;
+        }
+    }
+    ZSTD_freeDStream(stream);
+    return result;
+}
+#endif
+
+static void *decodeWorker(void *arg)
+{
+    Decoder *decoder = arg;
+    int result;
+#ifdef HAVE_ZSTD
+    result = decoder->compression == COMPRESSION_GZIP ? inflateInto(decoder) : zstdInto(decoder);
+#else
+    result = inflateInto(decoder);
+#endif
+    decoder->error = result == 0 ? 0 : errno;
+    ringCloseWriter(decoder->ring);
+    return NULL;
+}
+
+int decompressScan(int fd, IOConsumer consumer, void *ctx)
+{
+    Compression compression = detectCompression(fd);
+    if (compression == COMPRESSION_NONE)
+    {
+        return ioScan(fd, consumer, ctx);
+    }
+#ifndef HAVE_ZSTD
+    if (compression == COMPRESSION_ZSTD)
+    {
+        errno = ENOTSUP;
+        return -1;
+    }
+#endif
+
+    Decoder decoder = {fd, compression, NULL, NULL, 0};
+    decoder.input = malloc(DECODE_INPUT_SIZE);
+    decoder.ring = decoder.input != NULL ? ringCreate(DECODE_RING_CAPACITY) : NULL;
+    if (decoder.ring == NULL)
+    {
+        free(decoder.input);
+        errno = ENOMEM;
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    lseek(fd, 0, SEEK_SET);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, decodeWorker, &decoder) != 0)
+    {
+        ringCloseWriter(decoder.ring);
+        ringCloseReader(decoder.ring);
+        free(decoder.input);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    const char *data;
+    size_t length;
+    while ((length = ringPeek(decoder.ring, &data)) > 0)
+    {
+        int stop = consumer(data, length, ctx);
+        ringConsume(decoder.ring, length);
+        if (stop != 0)
+        {
+            break;
+        }
+    }
+    // Closing the reader makes a decoder still waiting for space give up.
+    ringCloseReader(decoder.ring);
+    pthread_join(thread, NULL);
+    free(decoder.input);
+    if (decoder.error != 0)
+    {
+        errno = decoder.error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef MYCOMPRESS_H
+#define MYCOMPRESS_H
+
+#include "myIO.h"
+
+/** Bytes of decompressed data buffered between the decoder thread and the consumer. */
+#define DECODE_RING_CAPACITY (1024 * 1024)
+/** Bytes of compressed input read per call. */
+#define DECODE_INPUT_SIZE (256 * 1024)
+
+typedef enum
+{
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD
+} Compression;
+
+/**
+ * Tells how a file is compressed from the magic bytes at its start: 1f 8b for gzip,
+ * 28 b5 2f fd for zstd. The file offset is not moved.
+ *
+ * @param fd An open file.
+ * @return The compression, or COMPRESSION_NONE for plain files and for streams that
+ *         cannot be read at an offset, such as pipes.
+ */
+Compression detectCompression(int fd);
+
+/**
+ * Like `ioScan`, but a gzip or zstd compressed file is passed to the consumer
+ * decompressed. Decompression runs on its own thread, which inflates straight into
+ * the free space of a byte ring (see myRing.h) while the calling thread hands the
+ * filled spans to the consumer, so counting or printing overlaps with decoding and
+ * the whole scan runs at about the decompressor's speed. Concatenated gzip members
+ * and zstd frames, as produced by appending to a compressed log, are all read. A
+ * file that is not compressed is scanned with `ioScan` unchanged.
+ *
+ * zstd support is compiled in only when zstd.h is installed (HAVE_ZSTD, set by the
+ * makefile); otherwise a zstd file fails with ENOTSUP.
+ *
+ * Usage example:
+ *   int fd = open("access.log.1.gz", O_RDONLY);
+ *   decompressScan(fd, countChunk, &counter);
+ *
+ * @param fd The file to read from its start.
+ * @param consumer Called with each span of decompressed data.
+ * @param ctx Opaque pointer passed through to `consumer`.
+ * @return 0 on success or when the consumer stopped early, -1 with errno set if the
+ *         file could not be read or is corrupt (EILSEQ).
+ */
+int decompressScan(int fd, IOConsumer consumer, void *ctx);
+
+#endif // MYCOMPRESS_H
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include "myCoro.h"
+#include "myArena.h"
+#include "myFunction.h"
+
+#define CORO_MAX_EVENTS 16
+
+enum
+{
+    CORO_READY,
+    CORO_WAITING,
+    CORO_DONE
+};
+
+typedef struct Coro
+{
+    int id;
+    int state;
+    char *label;
+    void (*fn)(void *);
+    void *arg;
+    void *stack;
+    // Command arena of the job, in place of the prompt loop's while it runs.
+    Arena arena;
+    // Where `exit` in the job returns to, swapped in the same way.
+    jmp_buf *exitPoint;
+    int exitStatus;
+    ucontext_t context;
+    struct Coro *next;
+} Coro;
+
+static Coro *coroList = NULL;
+static __thread Coro *current = NULL;
+static ucontext_t schedulerContext;
+static int epollFd = -1;
+static int nextId = 1;
+
+static void coroEntry(void)
+{
+    current->fn(current->arg);
+    current->state = CORO_DONE;
+    // Returning resumes schedulerContext through uc_link.
+}
+
+int coroSpawn(void (*fn)(void *), void *arg, const char *label)
+{
+    Coro *coro = calloc(1, sizeof(Coro));
+    if (coro == NULL)
+    {
+        perror("Failed to allocate coroutine");
+        return -1;
+    }
+
+    coro->stack = mmap(NULL, CORO_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (coro->stack == MAP_FAILED)
+    {
+        perror("Failed to allocate coroutine stack");
+        free(coro);
+        return -1;
+    }
+
+    if (getcontext(&coro->context) == -1)
+    {
+        perror("getcontext");
+        munmap(coro->stack, CORO_STACK_SIZE);
+        free(coro);
+        return -1;
+    }
+    coro->context.uc_stack.ss_sp = coro->stack;
+    coro->context.uc_stack.ss_size = CORO_STACK_SIZE;
+    coro->context.uc_link = &schedulerContext;
+    makecontext(&coro->context, coroEntry, 0);
+
+    coro->id = nextId++;
+    coro->state = CORO_READY;
+    coro->label = strdup(label ? label : "");
+    coro->fn = fn;
+    coro->arg = arg;
+
+    // Append so jobs are listed and scheduled in start order.
+    Coro **tail = &coroList;
+    while (*tail != NULL)
+    {
+        tail = &(*tail)->next;
+    }
+    *tail = coro;
+    return coro->id;
+}
+
+bool coroInside(void)
+{
+    return current != NULL;
+}
+
+bool coroPending(void)
+{
+    for (Coro *c = coroList; c != NULL; c = c->next)
+    {
+        if (c->state != CORO_DONE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void coroYield(void)
+{
+    if (current == NULL)
+    {
+        return;
+    }
+    swapcontext(&current->context, &schedulerContext);
+}
+
+static int ensureEpoll(void)
+{
+    if (epollFd == -1)
+    {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd == -1)
+        {
+            perror("epoll_create1");
+        }
+    }
+    return epollFd;
+}
+
+void coroWaitFd(int fd, uint32_t events)
+{
+    if (current == NULL || ensureEpoll() == -1)
+    {
+        struct pollfd pfd = {fd, (short)events, 0};
+        while (poll(&pfd, 1, -1) == -1 && errno == EINTR)
+        {
+        }
+        return;
+    }
+
+    struct epoll_event ev = {.events = events | EPOLLONESHOT, .data.ptr = current};
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        if (errno != EEXIST || epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == -1)
+        {
+            // Regular files cannot be watched and are always ready.
+            coroYield();
+            return;
+        }
+    }
+
+    current->state = CORO_WAITING;
+    swapcontext(&current->context, &schedulerContext);
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static bool runReady(void)
+{
+    bool anyReady = false;
+    for (Coro *c = coroList; c != NULL; c = c->next)
+    {
+        if (c->state == CORO_READY)
+        {
+            current = c;
+            Arena *saved = arenaSwap(&c->arena);
+            shellSwapExit(&c->exitPoint, &c->exitStatus);
+            swapcontext(&schedulerContext, &c->context);
+            shellSwapExit(&c->exitPoint, &c->exitStatus);
+            arenaSwap(saved);
+            current = NULL;
+            if (c->state == CORO_READY)
+            {
+                anyReady = true;
+            }
+        }
+    }
+    return anyReady;
+}
+
+/* One scheduler pass: run every ready coroutine once, then wait for descriptor
+   events. Returns true when `fd` (if >= 0) became readable. */
+static bool schedulerStep(int fd, bool fdWatched)
+{
+    bool anyReady = runReady();
+    if (!coroPending() || ensureEpoll() == -1)
+    {
+        return true;
+    }
+
+    struct epoll_event events[CORO_MAX_EVENTS];
+    int count = epoll_wait(epollFd, events, CORO_MAX_EVENTS, anyReady ? 0 : -1);
+    bool readable = false;
+    for (int i = 0; i < count; i++)
+    {
+        Coro *c = events[i].data.ptr;
+        if (c == NULL)
+        {
+            readable = true;
+        }
+        else if (c->state == CORO_WAITING)
+        {
+            c->state = CORO_READY;
+        }
+    }
+    return fd >= 0 && fdWatched && readable;
+}
+
+void coroRunUntilReadable(int fd)
+{
+    if (!coroPending() || ensureEpoll() == -1)
+    {
+        return;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        // Not pollable (e.g. input redirected from a file): it is always readable.
+        return;
+    }
+
+    while (coroPending() && !schedulerStep(fd, true))
+    {
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void coroWaitAll(void)
+{
+    // A job cannot wait for the scheduler it is running on.
+    if (current != NULL)
+    {
+        return;
+    }
+    while (coroPending())
+    {
+        schedulerStep(-1, false);
+    }
+}
+
+void coroReportFinished(void)
+{
+    Coro **link = &coroList;
+    while (*link != NULL)
+    {
+        Coro *c = *link;
+        if (c->state == CORO_DONE)
+        {
+            printf("[%d] Done\t%s\n", c->id, c->label);
+            *link = c->next;
+            munmap(c->stack, CORO_STACK_SIZE);
+            arenaRelease(&c->arena);
+            free(c->label);
+            free(c);
+        }
+        else
+        {
+            link = &c->next;
+        }
+    }
+    if (coroList == NULL)
+    {
+        nextId = 1;
+    }
+}
+
+void coroListJobs(void)
+{
+    for (Coro *c = coroList; c != NULL; c = c->next)
+    {
+        const char *state = c->state == CORO_DONE ? "Done" : "Running";
+        printf("[%d] %s\t%s\n", c->id, state, c->label);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef MYCORO_H
+#define MYCORO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CORO_STACK_SIZE (256 * 1024)
+
+/**
+ * Starts `fn(arg)` as a cooperative coroutine on its own stack. The coroutine does
+ * not run immediately; it is scheduled the next time the shell waits for input (see
+ * `coroRunUntilReadable`) or when `coroWaitAll` is called.
+ *
+ * Coroutines are stackful and all run on the shell's main thread, so a builtin can
+ * be run in the background without forking and without any changes other than
+ * calling `coroYield` or `coroWaitFd` at points where it would otherwise block.
+ * Each coroutine has its own command arena (see myArena.h), switched in whenever it
+ * runs and released once its "Done" notice has been printed, and its own exit point
+ * for `shellExit` (see `shellSwapExit`).
+ *
+ * Usage example:
+ *   int id = coroSpawn(copyJob, job, "cp big.iso /backup");
+ *   printf("[%d]\n", id);
+ *
+ * @param fn The function to run. When it returns, the coroutine is finished.
+ * @param arg Opaque pointer passed to `fn`.
+ * @param label Text shown by `coroListJobs` and in the "Done" notice. Copied.
+ * @return The job number of the new coroutine, or -1 if it could not be created.
+ */
+int coroSpawn(void (*fn)(void *), void *arg, const char *label);
+
+/**
+ * Gives other coroutines a chance to run. Called by long-running builtins between
+ * chunks of work. Does nothing when called outside a coroutine, so builtins can
+ * call it unconditionally.
+ */
+void coroYield(void);
+
+/**
+ * Suspends the calling coroutine until `fd` is ready for `events` (EPOLLIN,
+ * EPOLLOUT, ...). Outside a coroutine, or for descriptors epoll cannot watch such
+ * as regular files, it blocks in `poll` or returns immediately instead.
+ *
+ * @param fd The descriptor to wait on.
+ * @param events The epoll event mask to wait for.
+ */
+void coroWaitFd(int fd, uint32_t events);
+
+/**
+ * Returns true when the caller is running inside a coroutine.
+ */
+bool coroInside(void);
+
+/**
+ * Returns true when there are unfinished coroutines.
+ */
+bool coroPending(void);
+
+/**
+ * Event loop entry point for the shell's main loop. Runs ready coroutines and
+ * services their file descriptor waits until `fd` becomes readable, then returns so
+ * the caller can read from it. Returns immediately if no coroutines exist.
+ *
+ * @param fd The descriptor the caller wants to read, normally STDIN_FILENO.
+ */
+void coroRunUntilReadable(int fd);
+
+/**
+ * Runs the event loop until every coroutine has finished. Backs the `wait` builtin
+ * and is used at exit so background work is not lost.
+ */
+void coroWaitAll(void);
+
+/**
+ * Prints a "[n] Done  label" line for every coroutine that finished since the last
+ * call and releases its stack. The main loop calls this before each prompt.
+ */
+void coroReportFinished(void);
+
+/**
+ * Prints the job number, state and label of every coroutine whose "Done" notice has
+ * not been printed yet: "Running", or "Done" for one that finished since the last
+ * `coroReportFinished`. Backs the `jobs` builtin.
+ */
+void coroListJobs(void);
+
+#endif // MYCORO_H
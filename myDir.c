@@ -0,0 +1,439 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include "myDir.h"
+#include "myRing.h"
+
+/* The record format `getdents64` fills the buffer with. */
+typedef struct
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+typedef struct
+{
+    int dirFd;
+    DirEntry *entries;
+    size_t count;
+    size_t next;
+} StatJob;
+
+/* A directory waiting to be read by the walker. */
+typedef struct
+{
+    int fd;
+    char *path;
+} WalkItem;
+
+typedef struct
+{
+    dev_t device;
+    ino_t inode;
+} InodeKey;
+
+typedef struct
+{
+    RingQueue *queue;
+    int flags;
+    DirVisitor visitor;
+    void *ctx;
+    size_t pending;
+    // Queued directories hold an open descriptor each; past queueLimit of them the
+    // walk reads subdirectories in place instead.
+    size_t queued;
+    size_t queueLimit;
+    bool failed;
+    pthread_mutex_t inodeLock;
+    InodeKey *inodes;
+    size_t inodeCount;
+    size_t inodeCapacity;
+} DirWalk;
+
+int dirRead(int dirFd, Arena *arena, bool includeHidden, DirEntry **entries, size_t *count)
+{
+    char *buffer = malloc(DIR_READ_BUFFER);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+
+    size_t used = 0, capacity = 1024;
+    DirEntry *list = malloc(capacity * sizeof(DirEntry));
+    int result = list != NULL ? 0 : -1;
+    while (result == 0)
+    {
+        long length = syscall(SYS_getdents64, dirFd, buffer, DIR_READ_BUFFER);
+        if (length <= 0)
+        {
+            result = length < 0 ? -1 : 0;
+            break;
+        }
+        for (long offset = 0; offset < length;)
+        {
+            LinuxDirent64 *record = (LinuxDirent64 *)(buffer + offset);
+            offset += record->d_reclen;
+            if (record->d_name[0] == '.' && !includeHidden)
+            {
+                continue;
+            }
+            if (used == capacity)
+            {
+                DirEntry *grown = realloc(list, 2 * capacity * sizeof(DirEntry));
+                if (grown == NULL)
+                {
+                    result = -1;
+                    break;
+                }
+                list = grown;
+                capacity *= 2;
+            }
+            const char *name = arenaStrdup(arena, record->d_name);
+            if (name == NULL)
+            {
+                result = -1;
+                break;
+            }
+            list[used++] = (DirEntry){.name = name, .inode = record->d_ino, .type = record->d_type};
+        }
+    }
+
+    free(buffer);
+    if (result != 0)
+    {
+        int savedErrno = errno;
+        free(list);
+        errno = savedErrno;
+        return -1;
+    }
+    *entries = list;
+    *count = used;
+    return 0;
+}
+
+static void statEntry(int dirFd, DirEntry *entry)
+{
+    struct statx st;
+    if (statx(dirFd, entry->name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+              STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE | STATX_BLOCKS | STATX_MTIME,
+              &st) != 0)
+    {
+        return;
+    }
+    entry->mode = st.stx_mode;
+    entry->links = st.stx_nlink;
+    entry->uid = st.stx_uid;
+    entry->gid = st.stx_gid;
+    entry->size = (off_t)st.stx_size;
+    entry->blocks = (blkcnt_t)st.stx_blocks;
+    entry->mtime = st.stx_mtime.tv_sec;
+    entry->dev = makedev(st.stx_dev_major, st.stx_dev_minor);
+    entry->type = IFTODT(st.stx_mode);
+    entry->statted = true;
+}
+
+static void *statWorker(void *arg)
+{
+    StatJob *job = arg;
+    for (;;)
+    {
+        size_t start = __atomic_fetch_add(&job->next, DIR_STAT_BATCH, __ATOMIC_RELAXED);
+        if (start >= job->count)
+        {
+            return NULL;
+        }
+        size_t end = start + DIR_STAT_BATCH < job->count ? start + DIR_STAT_BATCH : job->count;
+        for (size_t i = start; i < end; i++)
+        {
+            if (!job->entries[i].statted)
+            {
+                statEntry(job->dirFd, &job->entries[i]);
+            }
+        }
+    }
+}
+
+void dirStatEntries(int dirFd, DirEntry *entries, size_t count)
+{
+    StatJob job = {dirFd, entries, count, 0};
+    int threadCount = 0;
+    pthread_t threads[DIR_STAT_THREADS];
+    if (count >= DIR_PARALLEL_THRESHOLD)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int wanted = cpus < 1 ? 1 : cpus > DIR_STAT_THREADS ? DIR_STAT_THREADS : (int)cpus;
+        // The calling thread is one of the workers.
+        for (int i = 1; i < wanted; i++)
+        {
+            if (pthread_create(&threads[threadCount], NULL, statWorker, &job) == 0)
+            {
+                threadCount++;
+            }
+        }
+    }
+    statWorker(&job);
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+/* Records a hard-linked file. Returns false if it was seen before, or true the
+   first time (also when the set cannot grow, so the file is counted rather than lost). */
+static bool firstVisit(DirWalk *walk, dev_t device, ino_t inode)
+{
+    pthread_mutex_lock(&walk->inodeLock);
+    if (walk->inodeCount * 2 >= walk->inodeCapacity)
+    {
+        size_t capacity = walk->inodeCapacity > 0 ? walk->inodeCapacity * 2 : 1024;
+        InodeKey *inodes = calloc(capacity, sizeof(InodeKey));
+        if (inodes == NULL)
+        {
+            pthread_mutex_unlock(&walk->inodeLock);
+            return true;
+        }
+        for (size_t i = 0; i < walk->inodeCapacity; i++)
+        {
+            InodeKey key = walk->inodes[i];
+            if (key.inode == 0)
+            {
+                continue;
+            }
+            size_t slot = (key.inode * 0x9e3779b97f4a7c15ULL ^ key.device) & (capacity - 1);
+            while (inodes[slot].inode != 0)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+            inodes[slot] = key;
+        }
+        free(walk->inodes);
+        walk->inodes = inodes;
+        walk->inodeCapacity = capacity;
+    }
+
+    bool first = true;
+    size_t slot = (inode * 0x9e3779b97f4a7c15ULL ^ device) & (walk->inodeCapacity - 1);
+    while (walk->inodes[slot].inode != 0)
+    {
+        if (walk->inodes[slot].inode == inode && walk->inodes[slot].device == device)
+        {
+            first = false;
+            break;
+        }
+        slot = (slot + 1) & (walk->inodeCapacity - 1);
+    }
+    if (first)
+    {
+        walk->inodes[slot] = (InodeKey){device, inode};
+        walk->inodeCount++;
+    }
+    pthread_mutex_unlock(&walk->inodeLock);
+    return first;
+}
+
+static void walkFailed(DirWalk *walk, const char *path)
+{
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    __atomic_store_n(&walk->failed, true, __ATOMIC_RELAXED);
+}
+
+/* Hands a directory to another walker thread, or reads it right away when the queue
+   is full, or holds as many descriptors as the walk may, so the walk never waits on
+   itself and never runs out of descriptors. */
+static void walkDirectory(DirWalk *walk, Arena *arena, WalkItem *item);
+
+static void scheduleDirectory(DirWalk *walk, Arena *arena, int fd, const char *path)
+{
+    WalkItem *item = malloc(sizeof(WalkItem));
+    char *copy = strdup(path);
+    if (item == NULL || copy == NULL)
+    {
+        walkFailed(walk, path);
+        free(item);
+        free(copy);
+        close(fd);
+        return;
+    }
+    *item = (WalkItem){fd, copy};
+    __atomic_add_fetch(&walk->pending, 1, __ATOMIC_ACQ_REL);
+    if (__atomic_add_fetch(&walk->queued, 1, __ATOMIC_ACQ_REL) > walk->queueLimit ||
+        !queueTryPush(walk->queue, item))
+    {
+        __atomic_sub_fetch(&walk->queued, 1, __ATOMIC_ACQ_REL);
+        __atomic_sub_fetch(&walk->pending, 1, __ATOMIC_ACQ_REL);
+        walkDirectory(walk, arena, item);
+    }
+}
+
+static void walkDirectory(DirWalk *walk, Arena *arena, WalkItem *item)
+{
+    ArenaMark mark = arenaMark(arena);
+    DirEntry *entries;
+    size_t count;
+    if (dirRead(item->fd, arena, true, &entries, &count) != 0)
+    {
+        walkFailed(walk, item->path);
+        entries = NULL;
+        count = 0;
+    }
+
+    size_t pathLength = strlen(item->path);
+    for (size_t i = 0; i < count; i++)
+    {
+        DirEntry *entry = &entries[i];
+        if (strcmp(entry->name, ".") == 0 || strcmp(entry->name, "..") == 0)
+        {
+            continue;
+        }
+        if (((walk->flags & (DIR_WALK_STAT | DIR_WALK_UNIQUE_INODES)) != 0 || entry->type == DT_UNKNOWN) && !entry->statted)
+        {
+            statEntry(item->fd, entry);
+        }
+        if ((walk->flags & DIR_WALK_UNIQUE_INODES) && entry->statted && entry->links > 1 &&
+            entry->type != DT_DIR && !firstVisit(walk, entry->dev, entry->inode))
+        {
+            continue;
+        }
+        walk->visitor(item->path, entry, walk->ctx);
+
+        if (entry->type == DT_DIR)
+        {
+            int childFd = openat(item->fd, entry->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            size_t nameLength = strlen(entry->name);
+            char *childPath = arenaAlloc(arena, pathLength + nameLength + 2);
+            if (childPath == NULL)
+            {
+                if (childFd != -1)
+                {
+                    close(childFd);
+                }
+                walkFailed(walk, entry->name);
+                continue;
+            }
+            memcpy(childPath, item->path, pathLength);
+            size_t at = pathLength;
+            if (at == 0 || childPath[at - 1] != '/')
+            {
+                childPath[at++] = '/';
+            }
+            memcpy(childPath + at, entry->name, nameLength + 1);
+            if (childFd == -1)
+            {
+                walkFailed(walk, childPath);
+                continue;
+            }
+            scheduleDirectory(walk, arena, childFd, childPath);
+        }
+    }
+
+    free(entries);
+    arenaRestore(arena, mark);
+    close(item->fd);
+    free(item->path);
+    free(item);
+}
+
+static void *walkWorker(void *arg)
+{
+    DirWalk *walk = arg;
+    Arena arena = {0};
+    void *item;
+    while (queuePop(walk->queue, &item))
+    {
+        __atomic_sub_fetch(&walk->queued, 1, __ATOMIC_ACQ_REL);
+        walkDirectory(walk, &arena, item);
+        // The last directory to finish ends the walk for every thread.
+        if (__atomic_sub_fetch(&walk->pending, 1, __ATOMIC_ACQ_REL) == 0)
+        {
+            queueClose(walk->queue);
+        }
+    }
+    arenaRelease(&arena);
+    return NULL;
+}
+
+int dirWalk(const char *root, int flags, DirVisitor visitor, void *ctx)
+{
+    DirEntry rootEntry = {.name = root};
+    statEntry(AT_FDCWD, &rootEntry);
+    if (!rootEntry.statted)
+    {
+        fprintf(stderr, "%s: %s\n", root, strerror(errno));
+        return -1;
+    }
+    visitor(NULL, &rootEntry, ctx);
+    if (rootEntry.type != DT_DIR)
+    {
+        return 0;
+    }
+
+    int fd = open(root, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1)
+    {
+        fprintf(stderr, "%s: %s\n", root, strerror(errno));
+        return -1;
+    }
+    DirWalk walk = {.flags = flags, .visitor = visitor, .ctx = ctx, .inodeLock = PTHREAD_MUTEX_INITIALIZER};
+    walk.queue = queueCreate(DIR_WALK_QUEUE);
+    WalkItem *item = malloc(sizeof(WalkItem));
+    char *path = strdup(root);
+    if (walk.queue == NULL || item == NULL || path == NULL)
+    {
+        int savedErrno = errno;
+        if (walk.queue != NULL)
+        {
+            queueDestroy(walk.queue);
+        }
+        free(item);
+        free(path);
+        close(fd);
+        errno = savedErrno;
+        return -1;
+    }
+    *item = (WalkItem){fd, path};
+    walk.pending = 1;
+    walk.queued = 1;
+    walk.queueLimit = DIR_WALK_QUEUE;
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY &&
+        limit.rlim_cur / DIR_WALK_FD_SHARE < walk.queueLimit)
+    {
+        walk.queueLimit = limit.rlim_cur / DIR_WALK_FD_SHARE;
+    }
+    queuePush(walk.queue, item);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = cpus < 1 ? 1 : cpus > DIR_WALK_THREADS ? DIR_WALK_THREADS : (int)cpus;
+    pthread_t threads[DIR_WALK_THREADS];
+    int threadCount = 0;
+    for (int i = 1; i < wanted; i++)
+    {
+        if (pthread_create(&threads[threadCount], NULL, walkWorker, &walk) == 0)
+        {
+            threadCount++;
+        }
+    }
+    walkWorker(&walk);
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    queueDestroy(walk.queue);
+    free(walk.inodes);
+    return walk.failed ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+#ifndef MYDIR_H
+#define MYDIR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include "myArena.h"
+
+/** Bytes of directory entries fetched from the kernel per getdents64 call. */
+#define DIR_READ_BUFFER (1024 * 1024)
+/** Most threads that stat the entries of one directory. */
+#define DIR_STAT_THREADS 8
+/** Directories with fewer entries to stat than this are statted by the caller alone. */
+#define DIR_PARALLEL_THRESHOLD 2048
+/** Entries a stat thread claims at a time. */
+#define DIR_STAT_BATCH 256
+/** Most threads of one directory walk. */
+#define DIR_WALK_THREADS 8
+/** Directories a walk queues for its threads before reading more of them in place. */
+#define DIR_WALK_QUEUE 1024
+/** A walk queues at most RLIMIT_NOFILE / DIR_WALK_FD_SHARE directories, each holding a descriptor. */
+#define DIR_WALK_FD_SHARE 4
+
+/** `dirWalk` flag: stat every entry, not only those whose type the directory omits. */
+#define DIR_WALK_STAT 1
+/** `dirWalk` flag: visit a file with several hard links only once. Implies DIR_WALK_STAT. */
+#define DIR_WALK_UNIQUE_INODES 2
+
+/**
+ * One directory entry. `name` and `type` (a DT_* constant) come from the directory
+ * itself; the other fields are only valid once `statted` is set by `dirStatEntries`.
+ */
+typedef struct
+{
+    const char *name;
+    dev_t dev;
+    ino_t inode;
+    unsigned char type;
+    bool statted;
+    mode_t mode;
+    nlink_t links;
+    uid_t uid;
+    gid_t gid;
+    off_t size;
+    blkcnt_t blocks;
+    time_t mtime;
+} DirEntry;
+
+/**
+ * Reads every entry of a directory with raw `getdents64` calls that each return up
+ * to DIR_READ_BUFFER bytes, so even a directory of hundreds of thousands of files
+ * takes a handful of system calls. The file type reported by the file system
+ * (`d_type`) is kept, so callers that only need to tell directories from files do
+ * not have to stat anything; it is DT_UNKNOWN on file systems that do not report it.
+ *
+ * Usage example:
+ *   Arena arena = {0};
+ *   DirEntry *entries;
+ *   size_t count;
+ *   int fd = open("logs", O_RDONLY | O_DIRECTORY);
+ *   if (dirRead(fd, &arena, false, &entries, &count) == 0)
+ *       printf("%zu files\n", count);
+ *
+ * @param dirFd A directory opened for reading.
+ * @param arena Arena that receives the names.
+ * @param includeHidden true to include names starting with '.', including "." and "..".
+ * @param entries Receives an array of `count` entries, allocated with malloc.
+ * @param count Receives the number of entries.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int dirRead(int dirFd, Arena *arena, bool includeHidden, DirEntry **entries, size_t *count);
+
+/**
+ * Fills in the status of every entry that is not `statted` yet with `statx`, without
+ * following symbolic links. Large directories are split between up to
+ * DIR_STAT_THREADS threads, one per CPU, that claim DIR_STAT_BATCH entries at a time,
+ * so the latency of each call overlaps with the others. An entry that vanished in
+ * the meantime stays unstatted.
+ *
+ * @param dirFd The directory the entries were read from.
+ * @param entries The entries.
+ * @param count Number of entries.
+ */
+void dirStatEntries(int dirFd, DirEntry *entries, size_t count);
+
+/**
+ * Called by `dirWalk` for every file and directory in the tree. Calls come from
+ * several threads at once, so anything the visitor updates must be thread-safe.
+ *
+ * @param directory Path of the directory holding the entry, or NULL for the root,
+ *                  whose `name` is then the whole path given to `dirWalk`.
+ * @param entry The entry. Its status fields are valid when `statted` is set, which
+ *              is always the case with DIR_WALK_STAT.
+ * @param ctx The context pointer passed to `dirWalk`.
+ */
+typedef void (*DirVisitor)(const char *directory, const DirEntry *entry, void *ctx);
+
+/**
+ * Walks a directory tree with up to DIR_WALK_THREADS threads, one per CPU. Every
+ * thread takes directories from a shared MPMC queue (see myRing.h), reads each with
+ * `dirRead`, visits its entries and queues the subdirectories it finds, opened with
+ * `openat` relative to their parent, so no path is resolved twice. A queued directory
+ * stays open until a thread takes it, so at most a quarter of the descriptor limit
+ * (RLIMIT_NOFILE / DIR_WALK_FD_SHARE) is queued at once. When the queue is full, or
+ * holds that many, a thread reads the subdirectory itself, depth first. Symbolic links are never
+ * followed, and entries are statted without following them. Unreadable directories
+ * are reported on stderr and skipped.
+ *
+ * This is the traversal core for tree-wide builtins such as `du` and `find`.
+ *
+ * Usage example:
+ *   static void countFile(const char *directory, const DirEntry *entry, void *ctx)
+ *   {
+ *       __atomic_add_fetch((size_t *)ctx, 1, __ATOMIC_RELAXED);
+ *   }
+ *   size_t files = 0;
+ *   dirWalk("/srv/data", 0, countFile, &files);
+ *
+ * @param root The top of the tree, relative to the working directory or absolute.
+ * @param flags 0, or DIR_WALK_STAT and DIR_WALK_UNIQUE_INODES combined with |.
+ * @param visitor Called for the root and for every entry below it.
+ * @param ctx Opaque pointer passed through to `visitor`.
+ * @return 0 on success, 1 if part of the tree could not be read, -1 if the root
+ *         itself could not be read.
+ */
+int dirWalk(const char *root, int flags, DirVisitor visitor, void *ctx);
+
+#endif // MYDIR_H
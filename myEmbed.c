@@ -0,0 +1,164 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include "myEmbed.h"
+#include "myFunction.h"
+#include "myArena.h"
+#include "myCoro.h"
+#include "myVars.h"
+#include "myScript.h"
+#include "myTrace.h"
+#include "myAtomic.h"
+#include "myAppend.h"
+
+extern char **environ;
+
+struct MshContext
+{
+    int status;
+};
+
+static pthread_once_t embedOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t embedLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void embedInit(void)
+{
+    traceInit();
+    varInit(environ);
+}
+
+/* Copies what fits into the caller's buffer and counts the rest, so a command never
+   sees a write error because its output was larger than the buffer. */
+static ssize_t captureWrite(void *cookie, const char *data, size_t size)
+{
+    MshResult *result = cookie;
+    if (result->length < result->capacity)
+    {
+        size_t room = result->capacity - result->length;
+        memcpy(result->output + result->length, data, size < room ? size : room);
+    }
+    result->length += size;
+    return (ssize_t)size;
+}
+
+static int captureClose(void *cookie)
+{
+    MshResult *result = cookie;
+    if (result->length < result->capacity)
+    {
+        result->output[result->length] = '\0';
+    }
+    return 0;
+}
+
+static const cookie_io_functions_t captureFunctions = {NULL, captureWrite, NULL, captureClose};
+
+/* Runs one command line with the lock held. */
+static int execLocked(MshContext *ctx, const char *command, MshResult *result)
+{
+    FILE *out = NULL;
+    if (result != NULL && result->output != NULL)
+    {
+        result->length = 0;
+        out = fopencookie(result, "w", captureFunctions);
+        if (out == NULL)
+        {
+            perror("msh_exec: fopencookie");
+            result->status = 1;
+            return 1;
+        }
+    }
+
+    Arena *arena = commandArena();
+    ArenaMark mark = arenaMark(arena);
+    setShellStreams(NULL, out);
+
+    // `exit` and `set -e` land here, possibly from deep inside the script, leaving
+    // the arena to be restored below.
+    jmp_buf exitPoint;
+    volatile int status;
+    if (setjmp(exitPoint) == 0)
+    {
+        shellSetExitPoint(&exitPoint);
+        status = scriptRunText(command, "msh_exec");
+    }
+    else
+    {
+        status = shellExitStatus();
+        varSetStatus(status);
+    }
+    shellSetExitPoint(NULL);
+
+    // Background jobs only make progress while the shell waits, and write into
+    // this command's output.
+    coroWaitAll();
+    coroReportFinished();
+    if (appendFlush() != 0)
+    {
+        perror("Failed to flush appended data");
+    }
+    if (atomicFlush() != 0)
+    {
+        perror("Failed to flush pending writes");
+    }
+
+    setShellStreams(NULL, NULL);
+    if (out != NULL)
+    {
+        fclose(out);
+    }
+    else
+    {
+        fflush(stdout);
+    }
+    arenaRestore(arena, mark);
+
+    if (result != NULL)
+    {
+        result->status = status;
+    }
+    ctx->status = status;
+    return status;
+}
+
+MshContext *msh_create(void)
+{
+    pthread_once(&embedOnce, embedInit);
+    return calloc(1, sizeof(MshContext));
+}
+
+void msh_destroy(MshContext *ctx)
+{
+    free(ctx);
+}
+
+int msh_exec(MshContext *ctx, const char *command, MshResult *result)
+{
+    pthread_mutex_lock(&embedLock);
+    int status = execLocked(ctx, command, result);
+    pthread_mutex_unlock(&embedLock);
+    return status;
+}
+
+size_t msh_exec_many(MshContext *ctx, const char *const *commands, MshResult *results, size_t count)
+{
+    size_t failed = 0;
+    pthread_mutex_lock(&embedLock);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (execLocked(ctx, commands[i], &results[i]) != 0)
+        {
+            failed++;
+        }
+    }
+    pthread_mutex_unlock(&embedLock);
+    return failed;
+}
+
+int msh_status(const MshContext *ctx)
+{
+    return ctx->status;
+}
@@ -0,0 +1,109 @@
+#ifndef MYEMBED_H
+#define MYEMBED_H
+
+#include <stddef.h>
+
+/*
+ * The shell as a library (libmyshell.a / libmyshell.so, built by `make lib`). A
+ * program links it and runs command lines in its own process, with the same parser,
+ * builtins and pipelines as the interactive shell, and gets each command's output in
+ * a buffer it provides. Only the msh_* functions are exported from libmyshell.so.
+ */
+
+#if defined(__GNUC__)
+#define MSH_API __attribute__((visibility("default")))
+#else
+#define MSH_API
+#endif
+
+/** A handle for running commands; see `msh_create`. */
+typedef struct MshContext MshContext;
+
+/**
+ * Where one command's output goes. `output` and `capacity` are set by the caller;
+ * `length` and `status` are filled in when the command has run.
+ */
+typedef struct
+{
+    char *output;    /* Caller's buffer, or NULL to pass the output to standard output. */
+    size_t capacity; /* Bytes available at `output`. */
+    size_t length;   /* Bytes the command wrote; more than `capacity` if it was cut short. */
+    int status;      /* Exit status of the command line. */
+} MshResult;
+
+/**
+ * Creates a context. The first call also initializes the shell: its variables are
+ * taken from the process environment.
+ *
+ * Everything a shell session keeps — variables, options such as `set -o pipefail`,
+ * the working directory — belongs to the process and is shared by all contexts, as
+ * it would be by the commands of one script. Calls from several threads are safe but
+ * run one at a time.
+ *
+ * Usage example:
+ *   MshContext *ctx = msh_create();
+ *   char text[256];
+ *   MshResult result = {text, sizeof(text)};
+ *   if (msh_exec(ctx, "wc -l access.log", &result) == 0)
+ *       printf("%.*s", (int)result.length, text);
+ *   msh_destroy(ctx);
+ *
+ * @return The new context, or NULL if it could not be allocated.
+ */
+MSH_API MshContext *msh_create(void);
+
+/**
+ * Releases a context.
+ *
+ * @param ctx The context, or NULL.
+ */
+MSH_API void msh_destroy(MshContext *ctx);
+
+/**
+ * Parses and runs a command line, which may be a whole script: pipelines, `&&`, `if`,
+ * loops and variable assignments all work. What builtins and external programs print
+ * on standard output is written to `result->output`; at most `capacity` bytes are
+ * kept and a terminating NUL is added when there is room. Error messages still go to
+ * standard error.
+ *
+ * `exit` and a failure under `set -e` end the command line, not the program. External
+ * programs run in child processes as in the shell; builtins run in the calling
+ * process without forking. Background jobs started with `&` finish before the call
+ * returns.
+ *
+ * @param ctx The context.
+ * @param command The command line.
+ * @param result Receives the output, length and status, or NULL to let the output go
+ *               to standard output.
+ * @return The exit status of the command line, 2 on a syntax error.
+ */
+MSH_API int msh_exec(MshContext *ctx, const char *command, MshResult *result);
+
+/**
+ * Runs `count` command lines one after the other, each as `msh_exec` would, with the
+ * output of command i going to `results[i]`. The lock that serializes callers is
+ * taken once for the whole batch, so other threads cannot interleave commands.
+ *
+ * Usage example:
+ *   const char *commands[] = {"wc -l a.log", "wc -l b.log"};
+ *   char first[64], second[64];
+ *   MshResult results[] = {{first, sizeof(first)}, {second, sizeof(second)}};
+ *   msh_exec_many(ctx, commands, results, 2);
+ *
+ * @param ctx The context.
+ * @param commands The command lines.
+ * @param results One result per command.
+ * @param count Number of commands.
+ * @return The number of command lines whose status was not 0.
+ */
+MSH_API size_t msh_exec_many(MshContext *ctx, const char *const *commands, MshResult *results, size_t count);
+
+/**
+ * Returns the status of the last command line run through a context.
+ *
+ * @param ctx The context.
+ * @return The exit status, 0 if nothing has run yet.
+ */
+MSH_API int msh_status(const MshContext *ctx);
+
+#endif // MYEMBED_H
@@ -6,25 +6,151 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <pwd.h>
+#include <grp.h>
+#include <time.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <ctype.h> 
+#include <fcntl.h>
+#include <fnmatch.h>
+#include "myHash.h"
+#include "myIO.h"
+#include "myCoro.h"
+#include "myRing.h"
+#include "myArena.h"
+#include "myPath.h"
+#include "myVars.h"
+#include "myScript.h"
+#include "myTrace.h"
+#include "myAtomic.h"
+#include "myAppend.h"
+#include "mySort.h"
+#include "myDir.h"
+#include "myWatch.h"
+#include "myCache.h"
+#include "myCompress.h"
+#include "myLimit.h"
+#include <pthread.h>
+#include <setjmp.h>
 
 #define BUFFER_SIZE 4096
 
+extern char **environ;
+
+static __thread FILE *threadInput = NULL;
+static __thread FILE *threadOutput = NULL;
+static __thread jmp_buf *threadExitPoint = NULL;
+static __thread int threadExitStatus = 0;
+
+static const char *builtinNames[] = {
+    "help", "cd", "cp", "delete", "move", "echo", "read", "wc", "jobs", "wait", "memstats",
+    "export", "set", "unset", "test", "[", "true", "false", "source", "exit", "trace", "sync", "sort", "uniq", "ls", "du", "find", "tail", "watch", "limit", NULL};
+
+FILE *shellOutput(void)
+{
+    return threadOutput != NULL ? threadOutput : stdout;
+}
+
+FILE *shellInput(void)
+{
+    return threadInput;
+}
+
+void setShellStreams(FILE *in, FILE *out)
+{
+    threadInput = in;
+    threadOutput = out;
+}
+
+void shellSetExitPoint(jmp_buf *point)
+{
+    threadExitPoint = point;
+}
+
+int shellExitStatus(void)
+{
+    return threadExitStatus;
+}
+
+void shellSwapExit(jmp_buf **point, int *status)
+{
+    jmp_buf *previousPoint = threadExitPoint;
+    int previousStatus = threadExitStatus;
+    threadExitPoint = *point;
+    threadExitStatus = *status;
+    *point = previousPoint;
+    *status = previousStatus;
+}
+
+void shellExit(int status)
+{
+    if (threadExitPoint != NULL)
+    {
+        threadExitStatus = status & 0xff;
+        longjmp(*threadExitPoint, 1);
+    }
+    exit(status);
+}
+
+/* True when stdio already holds unread input, so waiting on the descriptor would
+   stall even though getchar() can return immediately. */
+static bool stdinHasBufferedInput(void)
+{
+#ifdef __GLIBC__
+    return stdin->_IO_read_ptr < stdin->_IO_read_end;
+#else
+    return false;
+#endif
+}
+
 char *getInputFromUser()
 {
-    char ch;
-    int size = 1;
-    int index = 0;
-    char *str = (char *)malloc(size * sizeof(char));
-    while ((ch = getchar()) != '\n')
+    int ch;
+    size_t size = 64;
+    size_t index = 0;
+    Arena *arena = commandArena();
+    char *str = arenaAlloc(arena, size);
+    if (str == NULL)
+    {
+        return NULL;
+    }
+    for (;;)
     {
+        // Background jobs run while the shell waits for the user to type.
+        if (coroPending() && !stdinHasBufferedInput())
+        {
+            fflush(stdout);
+            coroRunUntilReadable(STDIN_FILENO);
+        }
+        ch = getchar();
+        if (ch == '\n')
+        {
+            break;
+        }
+        if (ch == EOF)
+        {
+            if (index == 0)
+            {
+                return NULL;
+            }
+            break;
+        }
+
         *(str + index) = ch;
-        size++;
         index++;
-        str = (char *)realloc(str, size * sizeof(char));
+        if (index == size)
+        {
+            // Usually the line is the arena's latest allocation and grows in place.
+            char *grown = arenaGrow(arena, str, size, size * 2);
+            if (grown == NULL)
+            {
+                break;
+            }
+            str = grown;
+            size *= 2;
+        }
     }
     *(str + index) = '\0';
 
@@ -32,39 +158,44 @@ char *getInputFromUser()
 }
 
 char *myStrtok(char *str, const char *delim) {
-    static char *nextToken = NULL;
-    if (str) nextToken = str;  
+    // Per thread, so builtin pipeline stages can split their arguments at the same time.
+    static __thread char *nextToken = NULL;
+    if (str) nextToken = str;
     if (!nextToken) return NULL;
 
+    // Consecutive delimiters separate tokens once.
+    while (*nextToken && strchr(delim, *nextToken) != NULL) {
+        nextToken++;
+    }
+    if (!*nextToken) {
+        nextToken = NULL;
+        return NULL;
+    }
+
+    // Quotes are dropped while the token is copied down over itself in a single
+    // pass, so a token full of quotes costs no more than any other.
     char *startToken = nextToken;
-    char *endToken;
+    char *endToken = startToken;
+    char *out = startToken;
     bool inQuote = false;
-
-
-    for (endToken = startToken; *endToken; ++endToken) {
+    for (; *endToken; ++endToken) {
         if (*endToken == '\"') {
             inQuote = !inQuote;
-            memmove(endToken, endToken + 1, strlen(endToken));
-            endToken--;
         } else if (!inQuote && strchr(delim, *endToken) != NULL) {
             break;
+        } else {
+            *out++ = *endToken;
         }
     }
 
-    if (!*endToken) {
-        nextToken = NULL;
-    } else {
-        *endToken = '\0';
-        nextToken = endToken + 1; 
-    }
-
-    if (startToken == nextToken) return NULL;
-
+    nextToken = *endToken ? endToken + 1 : NULL;
+    *out = '\0';
     return startToken;
 }
 
-char** splitOnPipe(const char* command) {
-    char** result = malloc(2 * sizeof(char*));
+static char **splitOnFirstPipe(const char *command) {
+    Arena *arena = commandArena();
+    char** result = arenaAlloc(arena, 2 * sizeof(char*));
     if (result == NULL) {
         perror("Failed to allocate memory for result");
         return NULL;
@@ -73,23 +204,20 @@ char** splitOnPipe(const char* command) {
     result[0] = NULL;
     result[1] = NULL;
 
-    const char* pipePos = strchr(command, '|');
-    if (pipePos == NULL) {
-        free(result);
+    int pipeIndex = findPipeSymbol(command);
+    if (pipeIndex == -1) {
         return NULL;
     }
+    const char* pipePos = command + pipeIndex;
 
     size_t beforeLength = pipePos - command;
     size_t afterLength = strlen(command) - beforeLength - 1;
 
-    result[0] = malloc(beforeLength + 1);
-    result[1] = malloc(afterLength + 1);
+    result[0] = arenaAlloc(arena, beforeLength + 1);
+    result[1] = arenaAlloc(arena, afterLength + 1);
 
     if (result[0] == NULL || result[1] == NULL) {
         perror("Failed to allocate memory for split parts");
-        free(result[0]);
-        free(result[1]);
-        free(result);
         return NULL;
     }
 
@@ -99,48 +227,52 @@ char** splitOnPipe(const char* command) {
     result[1][afterLength] = '\0';
 
     for (int i = 0; i < 2; i++) {
-        char *start = result[i], *end;
-
+        char *start = result[i];
         while (isspace((unsigned char)*start)) start++;
 
-        end = start + strlen(start) - 1;
-
-        while (end > start && isspace((unsigned char)*end)) end--;
-        
-        *(end + 1) = '\0';
+        // Counted from the length, so an empty side never steps before the buffer.
+        size_t length = strlen(start);
+        while (length > 0 && isspace((unsigned char)start[length - 1])) length--;
 
-        if (start > result[i]) {
-            memmove(result[i], start, end - start + 2);
-        }
+        memmove(result[i], start, length);
+        result[i][length] = '\0';
     }
 
     return result;
 }
+
+char** splitOnPipe(const char* command) {
+    uint64_t span = TRACE_BEGIN();
+    char **result = splitOnFirstPipe(command);
+    TRACE_END(span, "parse", "splitOnPipe", command);
+    return result;
+}
 char *normalizePath(char *path) {
     if (path == NULL) {
         return NULL;
     }
 
-    int start = 0, end = strlen(path) - 1;
-    
-    while ((path[start] == ' ' || path[start] == '"') && start <= end) {
+    // Bounds are checked before each read; an empty path has end == -1.
+    int start = 0, end = (int)strlen(path) - 1;
+
+    while (start <= end && (path[start] == ' ' || path[start] == '"')) {
         start++;
     }
 
-    while ((path[end] == ' ' || path[end] == '"') && end >= start) {
+    while (end >= start && (path[end] == ' ' || path[end] == '"')) {
         end--;
     }
 
     int length = end - start + 1;
     if (length <= 0) {
-        char *emptyPath = malloc(1);
+        char *emptyPath = poolAlloc(1);
         if (emptyPath) {
             emptyPath[0] = '\0';
         }
         return emptyPath;
     }
 
-    char *normalizedPath = malloc(length + 1);
+    char *normalizedPath = poolAlloc(length + 1);
     if (normalizedPath == NULL) {
         perror("Failed to allocate memory for normalized path");
         return NULL;
@@ -156,9 +288,16 @@ char *normalizePath(char *path) {
             }
             lastWasSlash = true;
         } else if (path[i] == ' ') {
-            if (!lastWasSlash && ((i + 1 <= end && path[i + 1] != '/') && (i - 1 >= start && path[i - 1] != '/'))) {
-                normalizedPath[j++] = path[i];
+            // A run of spaces is kept or dropped whole, by the characters around the
+            // run, so normalizing a normalized path changes nothing. path[end] is not
+            // a space, so the run ends inside the bounds.
+            int runEnd = i;
+            while (path[runEnd] == ' ') runEnd++;
+            if (!lastWasSlash && path[runEnd] != '/') {
+                memcpy(normalizedPath + j, path + i, runEnd - i);
+                j += runEnd - i;
             }
+            i = runEnd - 1;
         } else {
             normalizedPath[j++] = path[i];
             lastWasSlash = false;
@@ -172,57 +311,69 @@ char *normalizePath(char *path) {
 
 
 char **splitArgument(char *str) {
-    int size = 1, index = 0;
-    char **arguments = (char **)malloc((size + 1) * sizeof(char *));
+    uint64_t span = TRACE_BEGIN();
+    Arena *arena = commandArena();
+    int size = 8, index = 0;
+    char **arguments = arenaAlloc(arena, size * sizeof(char *));
     if (!arguments) {
-        perror("malloc failed");
+        perror("arena allocation failed");
         return NULL;
     }
 
     char *subStr = myStrtok(str, " ");
     while (subStr != NULL) {
         arguments[index++] = subStr;
-        size++;
-        arguments = (char **)realloc(arguments, (size + 1) * sizeof(char *));
-        if (!arguments) {
-            perror("realloc failed");
-            return NULL;
+        if (index == size) {
+            arguments = arenaGrow(arena, arguments, size * sizeof(char *), 2 * size * sizeof(char *));
+            if (!arguments) {
+                perror("arena allocation failed");
+                return NULL;
+            }
+            size *= 2;
         }
         subStr = myStrtok(NULL, " ");
     }
     arguments[index] = NULL;
+    TRACE_END(span, "parse", "splitArgument", arguments[0]);
 
     return arguments;
 }
 
 char* trim(char* str) {
-    while (isspace((unsigned char)*str)) str++; 
-    if (*str == 0) return str; 
+    if (str == NULL) return NULL;
+    while (isspace((unsigned char)*str)) str++;
 
-    char* end = str + strlen(str) - 1;
-    while (end > str && isspace((unsigned char)*end)) end--;
-    *(end + 1) = '\0'; 
+    // Counted from the length, like splitOnPipe, so no pointer is formed before the string.
+    size_t length = strlen(str);
+    while (length > 0 && isspace((unsigned char)str[length - 1])) length--;
+    str[length] = '\0';
 
     return str;
 }
 
 void getLocation()
 {
+    // The user and host do not change while the shell runs, so they are looked up
+    // once, at the first prompt, instead of before every command.
+    static char username[256];
+    static char hostname[256];
     char cwd[1024];
-    char hostname[1024];
 
-    struct passwd *pw = getpwuid(geteuid());
-    char *username = pw ? pw->pw_name : "unknown";
-
-    if (getcwd(cwd, sizeof(cwd)) == NULL)
+    if (hostname[0] == '\0')
     {
-        perror("getcwd() error");
-        return;
+        struct passwd *pw = getpwuid(geteuid());
+        snprintf(username, sizeof(username), "%s", pw ? pw->pw_name : "unknown");
+        if (gethostname(hostname, sizeof(hostname)) == -1)
+        {
+            perror("gethostname() error");
+            snprintf(hostname, sizeof(hostname), "unknown");
+        }
+        hostname[sizeof(hostname) - 1] = '\0';
     }
 
-    if (gethostname(hostname, sizeof(hostname)) == -1)
+    if (getcwd(cwd, sizeof(cwd)) == NULL)
     {
-        perror("gethostname() error");
+        perror("getcwd() error");
         return;
     }
 
@@ -251,196 +402,480 @@ void welcome()
            "\"Programming in C is like cooking with only a sharp knife and a block of ice - you have to be clever with what you've got!\" - Brian Kernighan\n\n");
 }
 
-void logout(char* trimmedInput) {
-    printf("Exiting program.\n");
-    exit(EXIT_SUCCESS);
+void logout(char* statusText) {
+    int status = statusText != NULL ? atoi(statusText) : varStatus();
+    // In a background job `exit` ends the job, at the exit point the job set.
+    if (coroInside()) {
+        shellExit(status);
+    }
+    if (coroPending()) {
+        printf("Waiting for background jobs to finish.\n");
+        coroWaitAll();
+        coroReportFinished();
+    }
+    if (isatty(STDIN_FILENO)) {
+        printf("Exiting program.\n");
+    }
+    shellExit(status);
 }
 
 
-void cd(char **args)
+int cd(char **args)
 {
-    if (args[1] == NULL)
+    int flags = 0;
+    int argIndex = 1;
+    if (args[1] != NULL && strcmp(args[1], "-P") == 0)
+    {
+        flags = PATH_RESOLVE_LINKS;
+        argIndex = 2;
+    }
+
+    int status = 1;
+    if (args[argIndex] == NULL)
     {
-        fprintf(stderr, "Usage: cd <path>\n");
+        fprintf(stderr, "Usage: cd [-P] <path>\n");
     }
     else
     {
-        char *normalizedPath = normalizePath(args[1]);
+        char *normalizedPath = normalizePath(args[argIndex]);
 
         if (normalizedPath != NULL)
         {
-            if (chdir(normalizedPath) != 0)
+            char *previous = canonicalizePath(".", 0);
+            if (pathChdir(normalizedPath, flags) != 0)
             {
                 perror("cd failed");
             }
-            free(normalizedPath);
+            else
+            {
+                status = 0;
+                char *current = canonicalizePath(".", 0);
+                if (previous != NULL)
+                {
+                    varSet("OLDPWD", previous, false);
+                }
+                if (current != NULL)
+                {
+                    varSet("PWD", current, false);
+                }
+                poolFree(current);
+            }
+            poolFree(previous);
+            poolFree(normalizedPath);
         }
         else
         {
             fprintf(stderr, "Error: Failed to process the path. It might be empty or invalid.\n");
         }
     }
+    return status;
 }
 
-void cp(char **args)
+static bool isCopyUpToDate(const char *sourcePath, const char *destinationPath)
 {
-    if (args[1] == NULL || args[2] == NULL)
+    struct stat sourceStat, destinationStat;
+    if (pathStat(sourcePath, &sourceStat) != 0 || pathStat(destinationPath, &destinationStat) != 0)
+    {
+        return false;
+    }
+    if (!S_ISREG(sourceStat.st_mode) || !S_ISREG(destinationStat.st_mode) ||
+        sourceStat.st_size != destinationStat.st_size)
+    {
+        return false;
+    }
+    if (sourceStat.st_dev == destinationStat.st_dev && sourceStat.st_ino == destinationStat.st_ino)
+    {
+        return true;
+    }
+    if (sourceStat.st_mtim.tv_sec == destinationStat.st_mtim.tv_sec &&
+        sourceStat.st_mtim.tv_nsec == destinationStat.st_mtim.tv_nsec)
+    {
+        return true;
+    }
+
+    uint64_t sourceHash, destinationHash;
+    if (fileContentHash(sourcePath, &sourceStat, &sourceHash) != 0 ||
+        fileContentHash(destinationPath, &destinationStat, &destinationHash) != 0 ||
+        sourceHash != destinationHash)
+    {
+        return false;
+    }
+
+    // Same content: align the mtime so the next run is decided by stat alone.
+    struct timespec times[2] = {sourceStat.st_atim, sourceStat.st_mtim};
+    if (utimensat(AT_FDCWD, destinationPath, times, 0) == 0 &&
+        pathStat(destinationPath, &destinationStat) == 0)
+    {
+        hashCacheStore(&destinationStat, destinationHash);
+    }
+    return true;
+}
+
+/* Called before the destination is closed, so it also works while an atomic copy
+   has not been renamed into place yet. */
+static void recordIncrementalCopy(const char *sourcePath, int destinationFd, uint64_t hash)
+{
+    struct stat sourceStat, destinationStat;
+    if (pathStat(sourcePath, &sourceStat) != 0)
     {
-        fprintf(stderr, "Usage: cp <source> <destination>\n");
         return;
     }
+    hashCacheStore(&sourceStat, hash);
 
-    char *sourcePathNormalized = normalizePath(args[1]);
-    char *destinationPathNormalized = normalizePath(args[2]);
+    struct timespec times[2] = {sourceStat.st_atim, sourceStat.st_mtim};
+    if (futimens(destinationFd, times) == 0 && fstat(destinationFd, &destinationStat) == 0)
+    {
+        hashCacheStore(&destinationStat, hash);
+    }
+}
+
+/* Opens a file that is about to be overwritten: in place, or through a temporary file
+   that replaces it on success when `set -o atomic` or `set -o durable` is on. */
+static int openForOverwrite(const char *path, AtomicFile *atomicFile, bool *atomic)
+{
+    *atomic = (scriptOptions() & (SCRIPT_OPTION_ATOMIC | SCRIPT_OPTION_DURABLE)) != 0;
+    if (!*atomic)
+    {
+        return pathOpen(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    return atomicOpen(path, 0644, atomicFile) == 0 ? atomicFile->fd : -1;
+}
+
+/* Closes a file from `openForOverwrite`. An atomic write is committed if it
+   succeeded and abandoned otherwise. Returns -1 with errno set if closing or
+   committing failed. */
+static int finishOverwrite(int fd, AtomicFile *atomicFile, bool atomic, bool succeeded)
+{
+    if (!atomic)
+    {
+        return close(fd);
+    }
+    if (!succeeded)
+    {
+        atomicAbort(atomicFile);
+        return 0;
+    }
+    return atomicCommit(atomicFile, (scriptOptions() & SCRIPT_OPTION_DURABLE) != 0);
+}
+
+static int hashCopiedChunk(const char *data, size_t length, void *ctx)
+{
+    hashUpdate(ctx, data, length);
+    return 0;
+}
+
+int cp(char **args)
+{
+    int argIndex = 1;
+    bool incremental = false;
+    if (args[1] != NULL && strcmp(args[1], "--incremental") == 0)
+    {
+        incremental = true;
+        argIndex = 2;
+    }
+
+    if (args[argIndex] == NULL || args[argIndex + 1] == NULL)
+    {
+        fprintf(stderr, "Usage: cp [--incremental] <source> <destination>\n");
+        return 1;
+    }
+
+    char *sourcePathNormalized = normalizePath(args[argIndex]);
+    char *destinationPathNormalized = normalizePath(args[argIndex + 1]);
 
     if (sourcePathNormalized == NULL || destinationPathNormalized == NULL)
     {
         fprintf(stderr, "Error normalizing paths.\n");
         if (sourcePathNormalized != NULL)
-            free(sourcePathNormalized);
+            poolFree(sourcePathNormalized);
         if (destinationPathNormalized != NULL)
-            free(destinationPathNormalized);
-        return;
+            poolFree(destinationPathNormalized);
+        return 1;
+    }
+
+    // Buffered appends and pending durable writes are not visible until flushed.
+    if (appendFlush() != 0)
+    {
+        perror("Failed to flush appended data");
+    }
+    if ((atomicIsPending(sourcePathNormalized) || (incremental && atomicIsPending(destinationPathNormalized))) &&
+        atomicFlush() != 0)
+    {
+        perror("Failed to flush pending writes");
     }
 
+    if (incremental && isCopyUpToDate(sourcePathNormalized, destinationPathNormalized))
+    {
+        poolFree(sourcePathNormalized);
+        poolFree(destinationPathNormalized);
+        fprintf(shellOutput(), "File unchanged, copy skipped.\n");
+        return 0;
+    }
 
-    FILE *sourceFile = fopen(sourcePathNormalized, "rb");
-    if (sourceFile == NULL)
+    int sourceFd = pathOpen(sourcePathNormalized, O_RDONLY, 0);
+    if (sourceFd == -1)
     {
         perror("Failed to open source file");
-        free(sourcePathNormalized);
-        free(destinationPathNormalized);
-        return;
+        poolFree(sourcePathNormalized);
+        poolFree(destinationPathNormalized);
+        return 1;
     }
 
-  
-    FILE *destinationFile = fopen(destinationPathNormalized, "wb");
-    if (destinationFile == NULL)
+    AtomicFile atomicFile;
+    bool atomic;
+    int destinationFd = openForOverwrite(destinationPathNormalized, &atomicFile, &atomic);
+    if (destinationFd == -1)
     {
         perror("Failed to open destination file");
-        fclose(sourceFile);
-        free(sourcePathNormalized);
-        free(destinationPathNormalized);
-        return;
+        close(sourceFd);
+        poolFree(sourcePathNormalized);
+        poolFree(destinationPathNormalized);
+        return 1;
     }
 
-    char buffer[1024];
-    size_t bytesRead;
-    while ((bytesRead = fread(buffer, 1, sizeof(buffer), sourceFile)) > 0)
+    // An incremental copy hashes the data as it is copied, for the cache; holes are
+    // hashed as zeros without being read.
+    HashState hashState;
+    hashInit(&hashState);
+    int copyResult = incremental ? ioCopyScan(sourceFd, destinationFd, hashCopiedChunk, &hashState)
+                                 : ioCopy(sourceFd, destinationFd);
+    if (copyResult != 0)
     {
-        fwrite(buffer, 1, bytesRead, destinationFile);
+        perror("Failed to copy file");
     }
 
-    fclose(sourceFile);
-    fclose(destinationFile);
-    free(sourcePathNormalized);
-    free(destinationPathNormalized);
-    printf("File copied successfully.\n");
+    close(sourceFd);
+    if (copyResult == 0 && incremental)
+    {
+        recordIncrementalCopy(sourcePathNormalized, destinationFd, hashDigest(&hashState));
+    }
+    if (finishOverwrite(destinationFd, &atomicFile, atomic, copyResult == 0) != 0 && copyResult == 0)
+    {
+        perror("Failed to replace destination file");
+        copyResult = -1;
+    }
+    poolFree(sourcePathNormalized);
+    poolFree(destinationPathNormalized);
+    if (copyResult != 0)
+    {
+        return 1;
+    }
+    fprintf(shellOutput(), "File copied successfully.\n");
+    return 0;
 }
 
-void delete(char *input)
+int delete(char **args)
 {
-    char **args = splitArgument(input);
-    if (args == NULL || args[1] == NULL)
+    if (args[1] == NULL)
     {
         fprintf(stderr, "delete: expected a file path\n");
-        if (args != NULL)
-        {
-            free(args);
-        }
-        return;
+        return 1;
     }
 
     char *normalizedPath = normalizePath(args[1]);
     if (normalizedPath == NULL)
     {
         fprintf(stderr, "Error normalizing path.\n");
-        free(args);
-        return;
+        return 1;
     }
 
-    if (remove(normalizedPath) != 0)
+    int status = 0;
+    if (pathRemove(normalizedPath) != 0)
     {
         perror("Error deleting file");
+        status = 1;
     }
     else
     {
-        printf("File deleted successfully.\n");
+        fprintf(shellOutput(), "File deleted successfully.\n");
     }
 
-    free(normalizedPath);
-    free(args);
+    poolFree(normalizedPath);
+    return status;
 }
 
-void mypipe(char **argv1, char **argv2) {
-    int pipefd[2];
-    pid_t cpid1, cpid2;
+/* In a forked pipe stage, runs a builtin in place of execvp and exits. Returns
+   without doing anything when the stage is an external program. */
+static void runPipeStage(char **argv, bool readsPipe)
+{
+    if (argv[0] == NULL || !isBuiltin(argv[0]))
+    {
+        return;
+    }
+    // A fresh stream, because stdin may still buffer command lines the shell read ahead.
+    FILE *in = readsPipe ? fdopen(STDIN_FILENO, "r") : NULL;
+    setShellStreams(in, NULL);
+    int status = runBuiltin(argv);
+    fflush(stdout);
+    _exit(status);
+}
 
-    if (pipe(pipefd) == -1) {
-        perror("pipe");
-        exit(EXIT_FAILURE);
+int mypipe(char ***stages, int count, int *statuses) {
+    pid_t *pids = arenaAlloc(commandArena(), count * sizeof(pid_t));
+    if (pids == NULL) {
+        perror("arena allocation failed");
+        return 1;
+    }
+    // A `limit` stage is parsed here, so a usage error starts nothing; the child
+    // applies the limits and then runs the command that follows them.
+    ResourceLimits **limits = arenaAlloc(commandArena(), count * sizeof(ResourceLimits *));
+    char ***commands = arenaAlloc(commandArena(), count * sizeof(char **));
+    if (limits == NULL || commands == NULL) {
+        perror("arena allocation failed");
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        limits[i] = NULL;
+        commands[i] = stages[i];
+        if (strcmp(stages[i][0], "limit") != 0) {
+            continue;
+        }
+        limits[i] = arenaAlloc(commandArena(), sizeof(ResourceLimits));
+        if (limits[i] == NULL || limitParse(stages[i], limits[i], &commands[i]) != 0) {
+            for (int j = 0; j < count; j++) {
+                statuses[j] = 2;
+            }
+            return 2;
+        }
     }
 
-    cpid1 = fork();
-    if (cpid1 == -1) {
-        perror("fork");
-        exit(EXIT_FAILURE);
+    // A builtin stage flushes stdout when it exits; it must not inherit our prompt.
+    fflush(stdout);
+    // When the calling thread's output is redirected, the last stage writes into a
+    // pipe too and the parent copies what arrives into that stream.
+    FILE *capture = threadOutput;
+    if (capture != NULL) {
+        fflush(capture);
     }
 
-    if (cpid1 == 0) { 
-        close(pipefd[0]); 
-        dup2(pipefd[1], STDOUT_FILENO); 
-        close(pipefd[1]); 
+    int inputFd = -1;
+    int started = 0;
+    uint64_t *forkedAt = arenaAlloc(commandArena(), count * sizeof(uint64_t));
+    if (forkedAt == NULL) {
+        perror("arena allocation failed");
+        return 1;
+    }
+    // Built before forking, so the children only have to point environ at it.
+    char **envp = varEnviron();
+    for (int i = 0; i < count; i++) {
+        int pipefd[2] = {-1, -1};
+        if ((i < count - 1 || capture != NULL) && pipe(pipefd) == -1) {
+            perror("pipe");
+            break;
+        }
 
-        execvp(argv1[0], argv1);
-        perror("execvp");
-        exit(EXIT_FAILURE);
-    } else {
-        cpid2 = fork();
-        if (cpid2 == -1) {
+        uint64_t span = TRACE_BEGIN();
+        pid_t pid = fork();
+        if (pid == -1) {
             perror("fork");
-            exit(EXIT_FAILURE);
+            if (pipefd[0] != -1) {
+                close(pipefd[0]);
+                close(pipefd[1]);
+            }
+            break;
         }
 
-        if (cpid2 == 0) {
-            close(pipefd[1]);
-            dup2(pipefd[0], STDIN_FILENO);
-            close(pipefd[0]);
+        if (pid == 0) {
+            if (inputFd != -1) {
+                dup2(inputFd, STDIN_FILENO);
+                close(inputFd);
+            }
+            if (pipefd[1] != -1) {
+                close(pipefd[0]);
+                dup2(pipefd[1], STDOUT_FILENO);
+                close(pipefd[1]);
+            }
 
-            execvp(argv2[0], argv2);
+            if (limits[i] != NULL && limitApply(limits[i]) != 0) {
+                _exit(126);
+            }
+            runPipeStage(commands[i], inputFd != -1);
+            environ = envp;
+            execvp(commands[i][0], commands[i]);
             perror("execvp");
-            exit(EXIT_FAILURE);
-        } else {
-            close(pipefd[0]);
+            _exit(127);
+        }
+
+        TRACE_END(span, "process", "fork", stages[i][0]);
+        forkedAt[started] = span;
+        // The parent keeps only the read end that feeds the next stage.
+        pids[started++] = pid;
+        if (inputFd != -1) {
+            close(inputFd);
+        }
+        if (pipefd[1] != -1) {
             close(pipefd[1]);
-            wait(NULL);
-            wait(NULL);
+        }
+        inputFd = pipefd[0];
+    }
+    varEnvironRelease(envp);
+    if (inputFd != -1) {
+        if (capture != NULL && started == count) {
+            char buffer[BUFFER_SIZE];
+            ssize_t got;
+            while ((got = read(inputFd, buffer, sizeof(buffer))) > 0 || (got == -1 && errno == EINTR)) {
+                if (got > 0) {
+                    fwrite(buffer, 1, got, capture);
+                }
+            }
+        }
+        close(inputFd);
+    }
+
+    for (int i = 0; i < count; i++) {
+        int status;
+        struct rusage usage;
+        uint64_t span = TRACE_BEGIN();
+        if (i >= started || wait4(pids[i], &status, 0, &usage) == -1) {
+            statuses[i] = 1;
+            continue;
+        }
+        statuses[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        TRACE_END(span, "process", "wait", stages[i][0]);
+        if (limits[i] != NULL && limits[i]->report) {
+            limitReport(commands[i][0], statuses[i], &usage, stderr);
+        }
+        // The child's whole life, from fork to exit, on a row of its own.
+        if (forkedAt[i] != 0 && traceEnabled) {
+            traceRecord("exec", stages[i][0], stages[i][1], forkedAt[i], pids[i]);
         }
     }
+    // External programs may have moved directories the path cache holds open.
+    pathCacheInvalidate();
+    return statuses[count - 1];
 }
 
+int limitCommand(char **args)
+{
+    // Always a child of its own, so the limits never touch the shell.
+    char **stages[] = {args};
+    int status;
+    return mypipe(stages, 1, &status);
+}
 
-void move(char **args)
+int move(char **args)
 {
     if (args[1] == NULL || args[2] == NULL)
     {
         fprintf(stderr, "Usage: mv <source> <destination>\n");
-        return;
+        return 1;
     }
 
     char *sourcePathNormalized = normalizePath(args[1]);
     char *destinationPathNormalized = normalizePath(args[2]);
 
-    if (access(sourcePathNormalized, F_OK) != 0)
+    if (pathAccess(sourcePathNormalized, F_OK) != 0)
     {
         perror("Source file does not exist");
-        free(sourcePathNormalized);
-        free(destinationPathNormalized);
-        return;
+        poolFree(sourcePathNormalized);
+        poolFree(destinationPathNormalized);
+        return 1;
     }
 
-    if (rename(sourcePathNormalized, destinationPathNormalized) != 0)
+    int status = 0;
+    if (pathRename(sourcePathNormalized, destinationPathNormalized) != 0)
     {
+        status = 1;
         if (errno == EISDIR)
         {
             char *fileName = strrchr(sourcePathNormalized, '/');
@@ -454,27 +889,28 @@ void move(char **args)
             }
 
             size_t newDestPathLen = strlen(destinationPathNormalized) + strlen(fileName) + 2; // +2 for '/' and '\0'
-            char *newDestPath = (char *)malloc(newDestPathLen);
+            char *newDestPath = poolAlloc(newDestPathLen);
             if (newDestPath == NULL)
             {
                 perror("Failed to allocate memory");
-                free(sourcePathNormalized);
-                free(destinationPathNormalized);
-                return;
+                poolFree(sourcePathNormalized);
+                poolFree(destinationPathNormalized);
+                return 1;
             }
 
             snprintf(newDestPath, newDestPathLen, "%s/%s", destinationPathNormalized, fileName);
 
-            if (rename(sourcePathNormalized, newDestPath) != 0)
+            if (pathRename(sourcePathNormalized, newDestPath) != 0)
             {
                 perror("Failed to move file");
             }
             else
             {
-                printf("File moved successfully.\n");
+                fprintf(shellOutput(), "File moved successfully.\n");
+                status = 0;
             }
 
-            free(newDestPath);
+            poolFree(newDestPath);
         }
         else
         {
@@ -483,14 +919,15 @@ void move(char **args)
     }
     else
     {
-        printf("File moved successfully.\n");
+        fprintf(shellOutput(), "File moved successfully.\n");
     }
 
-    free(sourcePathNormalized);
-    free(destinationPathNormalized);
+    poolFree(sourcePathNormalized);
+    poolFree(destinationPathNormalized);
+    return status;
 }
 
-void echoppend(char **args)
+int echoppend(char **args)
 {
     int i = 1;
     for (; args[i] != NULL; i++)
@@ -501,61 +938,60 @@ void echoppend(char **args)
         }
     }
 
-    char *textToAppend = NULL;
-    int length = 0;
+    if (args[i] == NULL || args[i + 1] == NULL)
+    {
+        fprintf(stderr, "Usage error: Missing file path for redirection.\n");
+        return 1;
+    }
+
+    // The line is built in the command arena, released when the command finishes.
+    size_t length = 0;
     for (int j = 1; j < i; j++)
     {
         length += strlen(args[j]) + 1;
     }
-
-    textToAppend = (char *)malloc(length);
+    char *textToAppend = arenaAlloc(commandArena(), length + 1);
     if (!textToAppend)
     {
         perror("Allocation failure");
-        return;
+        return 1;
     }
-
-    textToAppend[0] = '\0';
+    size_t textLength = 0;
     for (int j = 1; j < i; j++)
     {
-        strcat(textToAppend, args[j]);
+        size_t wordLength = strlen(args[j]);
+        memcpy(textToAppend + textLength, args[j], wordLength);
+        textLength += wordLength;
         if (j < i - 1)
         {
-            strcat(textToAppend, " ");
+            textToAppend[textLength++] = ' ';
         }
     }
+    textToAppend[textLength++] = '\n';
 
-    if (args[i] != NULL && args[i + 1] != NULL)
+    char *normalizedPath = normalizePath(args[i + 1]);
+    char *canonicalPath = normalizedPath != NULL ? canonicalizePath(normalizedPath, PATH_KEEP_DOTDOT) : NULL;
+    if (normalizedPath != NULL)
     {
-        char *normalizedPath = normalizePath(args[i + 1]);
-        if (!normalizedPath)
-        {
-            fprintf(stderr, "Path normalization error.\n");
-            free(textToAppend);
-            return;
-        }
-
-        FILE *file = fopen(normalizedPath, "a");
-        if (!file)
-        {
-            perror("File opening failure");
-            free(textToAppend);
-            free(normalizedPath);
-            return;
-        }
-        fprintf(file, "%s\n", textToAppend);
-        fclose(file);
-        free(normalizedPath);
+        poolFree(normalizedPath);
     }
-    else
+    if (!canonicalPath)
     {
-        fprintf(stderr, "Usage error: Missing file path for redirection.\n");
+        fprintf(stderr, "Path normalization error.\n");
+        return 1;
     }
 
-    free(textToAppend);
+    int status = 0;
+    if (appendWrite(canonicalPath, textToAppend, textLength) != 0)
+    {
+        perror("File write failure");
+        status = 1;
+    }
+    poolFree(canonicalPath);
+    return status;
 }
 
-void echorite(char **args)
+int echorite(char **args)
 {
     int i = 1; 
     for (; args[i] != NULL; i++)
@@ -573,11 +1009,11 @@ void echorite(char **args)
         length += strlen(args[j]) + 1;
     }
 
-    textToWrite = (char *)malloc(length);
+    textToWrite = poolAlloc(length + 1);
     if (!textToWrite)
     {
         perror("Allocation failure");
-        return;
+        return 1;
     }
 
     textToWrite[0] = '\0';
@@ -590,154 +1026,2046 @@ void echorite(char **args)
         }
     }
 
+    int status = 0;
     if (args[i] != NULL && args[i + 1] != NULL)
     {
         char *normalizedPath = normalizePath(args[i + 1]);
         if (!normalizedPath)
         {
             fprintf(stderr, "Path normalization error.\n");
-            free(textToWrite);
-            return;
+            poolFree(textToWrite);
+            return 1;
         }
 
-        FILE *file = fopen(normalizedPath, "w");
-        if (!file)
+        // Lines appended to this file earlier must not land after the new content.
+        if (appendFlush() != 0)
+        {
+            perror("Failed to flush appended data");
+        }
+        AtomicFile atomicFile;
+        bool atomic;
+        int fd = openForOverwrite(normalizedPath, &atomicFile, &atomic);
+        if (fd == -1)
         {
             perror("File opening failure");
-            free(textToWrite);
-            free(normalizedPath);
-            return;
+            poolFree(textToWrite);
+            poolFree(normalizedPath);
+            return 1;
+        }
+        size_t textLength = strlen(textToWrite);
+        textToWrite[textLength] = '\n';
+        if (ioWriteAll(fd, textToWrite, textLength + 1) != 0)
+        {
+            perror("File write failure");
+            status = 1;
+        }
+        if (finishOverwrite(fd, &atomicFile, atomic, status == 0) != 0 && status == 0)
+        {
+            perror("File replace failure");
+            status = 1;
         }
-        fprintf(file, "%s\n", textToWrite);
-        fclose(file);
-        free(normalizedPath);
+        poolFree(normalizedPath);
     }
     else
     {
         fprintf(stderr, "Usage error: Missing file path for redirection.\n");
+        status = 1;
     }
 
-    free(textToWrite);
+    poolFree(textToWrite);
+    return status;
+}
+
+static int printChunk(const char *data, size_t length, void *ctx)
+{
+    (void)ctx;
+    fwrite(data, 1, length, shellOutput());
+    return 0;
+}
+
+/* Feeds a stdio stream to an IOConsumer, for builtins reading a pipeline stage. */
+static int scanStream(FILE *in, IOConsumer consumer, void *ctx)
+{
+    char buffer[BUFFER_SIZE];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    {
+        if (consumer(buffer, bytesRead, ctx) != 0)
+        {
+            return 0;
+        }
+    }
+    return ferror(in) ? -1 : 0;
 }
 
-void readI(char **args)
+int readI(char **args)
 {
+    if (args[1] == NULL && shellInput() != NULL)
+    {
+        if (scanStream(shellInput(), printChunk, NULL) != 0)
+        {
+            perror("Failed to read input");
+            return 1;
+        }
+        return 0;
+    }
     if (args[1] == NULL)
     {
         fprintf(stderr, "Usage: read <filePath>\n");
-        return;
+        return 1;
     }
 
     char *normalizedPath = normalizePath(args[1]);
     if (normalizedPath == NULL)
     {
         fprintf(stderr, "Error normalizing path.\n");
-        return;
+        return 1;
     }
 
-    FILE *file = fopen(normalizedPath, "r");
-    if (file == NULL)
+    int fd = pathOpen(normalizedPath, O_RDONLY, 0);
+    if (fd == -1)
     {
         fprintf(stderr, "Error: File '%s' not found.\n", normalizedPath);
-        free(normalizedPath);
-        return;
+        poolFree(normalizedPath);
+        return 1;
     }
 
-
-    char buffer[1024];
-    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    int status = 0;
+    if (decompressScan(fd, printChunk, NULL) != 0)
     {
-        printf("%s", buffer);
+        perror("Failed to read file");
+        status = 1;
     }
-    printf("\n");
-    fclose(file);
-    free(normalizedPath);
+    fprintf(shellOutput(), "\n");
+    close(fd);
+    poolFree(normalizedPath);
+    return status;
 }
 
-void wordCount(char **args)
+typedef struct
 {
-    if (args[1] == NULL || args[2] == NULL)
-    {
-        fprintf(stderr, "Usage: wordCount <-l|-w> <filePath>\n");
-        return;
-    }
+    long lines;
+    long words;
+    bool inWord;
+    char lastChar;
+} WordCounter;
 
-    char *option = args[1];
-    char *filePath = args[2];
+static int countChunk(const char *data, size_t length, void *ctx)
+{
+    WordCounter *counter = ctx;
+    bool inWord = counter->inWord;
 
-    char *normalizedPath = normalizePath(filePath);
-    if (normalizedPath == NULL)
+    for (size_t i = 0; i < length; i++)
     {
-        fprintf(stderr, "Error normalizing path.\n");
-        return;
-    }
+        char c = data[i];
+        if (c == '\n')
+        {
+            counter->lines++;
+            inWord = false;
+        }
+        else if (c == ' ' || c == '\t')
+        {
+            inWord = false;
+        }
+        else if (!inWord)
+        {
+            counter->words++;
+            inWord = true;
+        }
+    }
+
+    counter->inWord = inWord;
+    if (length > 0)
+    {
+        counter->lastChar = data[length - 1];
+    }
+    return 0;
+}
+
+int wordCount(char **args)
+{
+    bool fromStream = args[1] != NULL && args[2] == NULL && shellInput() != NULL;
+    if (args[1] == NULL || (args[2] == NULL && !fromStream))
+    {
+        fprintf(stderr, "Usage: wordCount <-l|-w> <filePath>\n");
+        return 1;
+    }
+
+    char *option = args[1];
+    char *filePath = args[2];
+
+    if (strcmp(option, "-l") != 0 && strcmp(option, "-w") != 0)
+    {
+        fprintf(stderr, "Invalid option: %s\n", option);
+        return 1;
+    }
+
+    char *normalizedPath = NULL;
+    int fd = -1;
+    if (!fromStream)
+    {
+        normalizedPath = normalizePath(filePath);
+        if (normalizedPath == NULL)
+        {
+            fprintf(stderr, "Error normalizing path.\n");
+            return 1;
+        }
+
+        fd = pathOpen(normalizedPath, O_RDONLY, 0);
+        if (fd == -1)
+        {
+            perror("Failed to open file");
+            poolFree(normalizedPath);
+            return 1;
+        }
+    }
+
+    // Under `set -o cache` a file that has not changed since it was last counted, by
+    // this shell or another, is answered from the shared result cache.
+    bool cached = !fromStream && (scriptOptions() & SCRIPT_OPTION_CACHE) != 0;
+    const char *query = strcmp(option, "-l") == 0 ? "wc -l" : "wc -w";
+    char result[RESULT_CACHE_VALUE_SIZE];
+    size_t resultLength;
+    struct stat before, after;
+    // Without the file's identity from before the scan, nothing may be stored.
+    bool haveBefore = cached && fstat(fd, &before) == 0;
+    if (haveBefore && resultCacheLookup(&before, query, result, &resultLength))
+    {
+        fwrite(result, 1, resultLength, shellOutput());
+        close(fd);
+        poolFree(normalizedPath);
+        return 0;
+    }
+
+    WordCounter counter = {0, 0, false, '\n'};
+    int scanResult = fromStream ? scanStream(shellInput(), countChunk, &counter) : decompressScan(fd, countChunk, &counter);
+    if (scanResult != 0)
+    {
+        perror("Failed to read file");
+    }
+    else
+    {
+        if (strcmp(option, "-l") == 0)
+        {
+            // A final line without a trailing newline still counts as a line.
+            if (counter.lastChar != '\n')
+            {
+                counter.lines++;
+            }
+            resultLength = snprintf(result, sizeof(result), "Line count: %ld\n", counter.lines);
+        }
+        else
+        {
+            resultLength = snprintf(result, sizeof(result), "Word count: %ld\n", counter.words);
+        }
+        fwrite(result, 1, resultLength, shellOutput());
+        // A file that changed while it was read gives no reusable result.
+        if (haveBefore && fstat(fd, &after) == 0 && after.st_size == before.st_size &&
+            after.st_mtim.tv_sec == before.st_mtim.tv_sec && after.st_mtim.tv_nsec == before.st_mtim.tv_nsec)
+        {
+            resultCacheStore(&before, query, result, resultLength);
+        }
+    }
+
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    poolFree(normalizedPath);
+    return scanResult != 0 ? 1 : 0;
+}
+
+/* Feeds a file named on the command line to `consumer`. Returns 0 on success and 1
+   after reporting the error. */
+static int scanFileArgument(char *path, IOConsumer consumer, void *ctx)
+{
+    char *normalizedPath = normalizePath(path);
+    if (normalizedPath == NULL)
+    {
+        fprintf(stderr, "Error normalizing path.\n");
+        return 1;
+    }
+    int fd = pathOpen(normalizedPath, O_RDONLY, 0);
+    int status = 0;
+    if (fd == -1 || ioScan(fd, consumer, ctx) != 0)
+    {
+        perror(normalizedPath);
+        status = 1;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    poolFree(normalizedPath);
+    return status;
+}
 
-    FILE *file = fopen(normalizedPath, "r");
-    if (!file)
+int sortLines(char **args)
+{
+    SortOptions options = {false, false, false, SORT_MEMORY_BUDGET};
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        if (strcmp(args[i], "-n") == 0)
+        {
+            options.numeric = true;
+        }
+        else if (strcmp(args[i], "-r") == 0)
+        {
+            options.reverse = true;
+        }
+        else if (strcmp(args[i], "-u") == 0)
+        {
+            options.unique = true;
+        }
+        else if (strcmp(args[i], "-S") == 0 && args[i + 1] != NULL && atol(args[i + 1]) > 0)
+        {
+            options.memoryBudget = (size_t)atol(args[++i]) * 1024 * 1024;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: sort [-n] [-r] [-u] [-S MiB] [file ...]\n");
+            return 2;
+        }
+    }
+    if (args[i] == NULL && shellInput() == NULL)
+    {
+        fprintf(stderr, "Usage: sort [-n] [-r] [-u] [-S MiB] [file ...]\n");
+        return 2;
+    }
+
+    Sorter *sorter = sorterCreate(&options);
+    if (sorter == NULL)
+    {
+        perror("sort");
+        return 1;
+    }
+    int status = 0;
+    if (args[i] == NULL && scanStream(shellInput(), sorterConsume, sorter) != 0)
+    {
+        perror("sort: failed to read input");
+        status = 1;
+    }
+    for (; args[i] != NULL && status == 0; i++)
+    {
+        status = scanFileArgument(args[i], sorterConsume, sorter);
+    }
+    if (status == 0 && sorterFinish(sorter, shellOutput()) != 0)
+    {
+        perror("sort");
+        status = 1;
+    }
+    sorterDestroy(sorter);
+    return status;
+}
+
+typedef struct
+{
+    FILE *out;
+    bool count;
+    bool repeatedOnly;
+    char *line;
+    size_t lineLength;
+    size_t lineCapacity;
+    char *previous;
+    size_t previousLength;
+    size_t previousCapacity;
+    long repeats;
+    bool failed;
+} UniqState;
+
+static bool appendToLine(char **line, size_t *length, size_t *capacity, const char *data, size_t dataLength)
+{
+    if (*length + dataLength > *capacity)
+    {
+        size_t grown = *capacity > 0 ? *capacity : 256;
+        while (grown < *length + dataLength)
+        {
+            grown *= 2;
+        }
+        char *buffer = realloc(*line, grown);
+        if (buffer == NULL)
+        {
+            return false;
+        }
+        *line = buffer;
+        *capacity = grown;
+    }
+    memcpy(*line + *length, data, dataLength);
+    *length += dataLength;
+    return true;
+}
+
+/* Prints the group of equal lines that just ended. */
+static void emitUniqGroup(UniqState *state)
+{
+    if (state->repeats == 0 || (state->repeatedOnly && state->repeats < 2))
     {
-        perror("Failed to open file");
-        free(normalizedPath);
         return;
     }
+    if (state->count)
+    {
+        fprintf(state->out, "%7ld ", state->repeats);
+    }
+    fwrite(state->previous, 1, state->previousLength, state->out);
+    fputc('\n', state->out);
+}
 
-    int count = 0;
-    char buffer[1024];
+/* Compares the completed line with the previous one, then makes it the previous. */
+static void finishUniqLine(UniqState *state)
+{
+    if (state->repeats > 0 && state->lineLength == state->previousLength &&
+        memcmp(state->line, state->previous, state->lineLength) == 0)
+    {
+        state->repeats++;
+    }
+    else
+    {
+        emitUniqGroup(state);
+        char *swap = state->previous;
+        size_t swapCapacity = state->previousCapacity;
+        state->previous = state->line;
+        state->previousLength = state->lineLength;
+        state->previousCapacity = state->lineCapacity;
+        state->line = swap;
+        state->lineCapacity = swapCapacity;
+        state->repeats = 1;
+    }
+    state->lineLength = 0;
+}
+
+static int uniqChunk(const char *data, size_t length, void *ctx)
+{
+    UniqState *state = ctx;
+    while (length > 0)
+    {
+        const char *newline = memchr(data, '\n', length);
+        size_t part = newline != NULL ? (size_t)(newline - data) : length;
+        if (!appendToLine(&state->line, &state->lineLength, &state->lineCapacity, data, part))
+        {
+            state->failed = true;
+            return 1;
+        }
+        if (newline == NULL)
+        {
+            break;
+        }
+        finishUniqLine(state);
+        data += part + 1;
+        length -= part + 1;
+    }
+    return 0;
+}
 
-  if (strcmp(option, "-l") == 0)
+int uniqLines(char **args)
 {
-    int lines = 0;
-    bool isLastCharNewline = false;
+    UniqState state = {shellOutput()};
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        if (strcmp(args[i], "-c") == 0)
+        {
+            state.count = true;
+        }
+        else if (strcmp(args[i], "-d") == 0)
+        {
+            state.repeatedOnly = true;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: uniq [-c] [-d] [file]\n");
+            return 2;
+        }
+    }
+    if ((args[i] == NULL && shellInput() == NULL) || (args[i] != NULL && args[i + 1] != NULL))
+    {
+        fprintf(stderr, "Usage: uniq [-c] [-d] [file]\n");
+        return 2;
+    }
 
-    while (fgets(buffer, sizeof(buffer), file) != NULL)
+    int status = 0;
+    if (args[i] == NULL)
+    {
+        if (scanStream(shellInput(), uniqChunk, &state) != 0)
+        {
+            perror("uniq: failed to read input");
+            status = 1;
+        }
+    }
+    else
+    {
+        status = scanFileArgument(args[i], uniqChunk, &state);
+    }
+    if (state.failed)
+    {
+        perror("uniq");
+        status = 1;
+    }
+    if (status == 0)
     {
-        lines++;
-        size_t len = strlen(buffer);
-        isLastCharNewline = (buffer[len - 1] == '\n');
+        // A last line without a newline still forms a line.
+        if (state.lineLength > 0)
+        {
+            finishUniqLine(&state);
+        }
+        emitUniqGroup(&state);
     }
+    free(state.line);
+    free(state.previous);
+    return status;
+}
 
+#define LS_NAME_CACHE_SIZE 8
+
+typedef struct
+{
+    bool longFormat;
+    bool all;
+    bool recursive;
+    FILE *out;
+    Arena arena;
+    unsigned cachedIds[2][LS_NAME_CACHE_SIZE];
+    char cachedNames[2][LS_NAME_CACHE_SIZE][32];
+    int cachedCount[2];
+} ListOptions;
+
+static int compareEntryNames(const void *a, const void *b)
+{
+    return strcmp(((const DirEntry *)a)->name, ((const DirEntry *)b)->name);
+}
 
-    if (!isLastCharNewline && lines > 0) {
+static void formatMode(mode_t mode, char *text)
+{
+    const char *types = "?pc?d?b?-?l?s???";
+    text[0] = types[(mode >> 12) & 0xf];
+    const char *bits = "rwxrwxrwx";
+    for (int i = 0; i < 9; i++)
+    {
+        text[i + 1] = (mode & (0400 >> i)) ? bits[i] : '-';
+    }
+    if (mode & S_ISUID)
+    {
+        text[3] = (mode & S_IXUSR) ? 's' : 'S';
+    }
+    if (mode & S_ISGID)
+    {
+        text[6] = (mode & S_IXGRP) ? 's' : 'S';
+    }
+    if (mode & S_ISVTX)
+    {
+        text[9] = (mode & S_IXOTH) ? 't' : 'T';
+    }
+    text[10] = '\0';
+}
 
+/* Returns the user (kind 0) or group (kind 1) name for an id. A listing usually
+   shows a few owners many times, so the last names looked up are kept. */
+static const char *ownerName(ListOptions *options, int kind, unsigned id)
+{
+    for (int i = 0; i < options->cachedCount[kind]; i++)
+    {
+        if (options->cachedIds[kind][i] == id)
+        {
+            return options->cachedNames[kind][i];
+        }
+    }
+    int slot = options->cachedCount[kind] < LS_NAME_CACHE_SIZE ? options->cachedCount[kind]++ : (int)(id % LS_NAME_CACHE_SIZE);
+    char *name = options->cachedNames[kind][slot];
+    struct passwd *user = kind == 0 ? getpwuid(id) : NULL;
+    struct group *group = kind == 1 ? getgrgid(id) : NULL;
+    const char *found = user != NULL ? user->pw_name : group != NULL ? group->gr_name : NULL;
+    if (found != NULL)
+    {
+        snprintf(name, sizeof(options->cachedNames[kind][slot]), "%s", found);
     }
+    else
+    {
+        snprintf(name, sizeof(options->cachedNames[kind][slot]), "%u", id);
+    }
+    options->cachedIds[kind][slot] = id;
+    return name;
+}
 
-    printf("Line count: %d\n", lines);
+static int countDigits(unsigned long long value)
+{
+    int digits = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        digits++;
+    }
+    return digits;
 }
-    else if (strcmp(option, "-w") == 0)
+
+static void printLongEntries(ListOptions *options, int dirFd, DirEntry *entries, size_t count, bool showTotal)
+{
+    int linkWidth = 1, userWidth = 1, groupWidth = 1, sizeWidth = 1;
+    long long blocks = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        DirEntry *entry = &entries[i];
+        if (!entry->statted)
+        {
+            continue;
+        }
+        int width = countDigits(entry->links);
+        linkWidth = width > linkWidth ? width : linkWidth;
+        width = strlen(ownerName(options, 0, entry->uid));
+        userWidth = width > userWidth ? width : userWidth;
+        width = strlen(ownerName(options, 1, entry->gid));
+        groupWidth = width > groupWidth ? width : groupWidth;
+        width = countDigits((unsigned long long)entry->size);
+        sizeWidth = width > sizeWidth ? width : sizeWidth;
+        blocks += entry->blocks;
+    }
+    if (showTotal)
+    {
+        fprintf(options->out, "total %lld\n", blocks / 2);
+    }
+
+    time_t now = time(NULL);
+    for (size_t i = 0; i < count; i++)
     {
-        char *token;
-        while (fgets(buffer, sizeof(buffer), file) != NULL)
+        DirEntry *entry = &entries[i];
+        if (!entry->statted)
         {
-            token = strtok(buffer, " \t\n");
-            while (token != NULL)
+            fprintf(options->out, "?????????? %*s %-*s %-*s %*s %12s %s\n", linkWidth, "?", userWidth, "?",
+                    groupWidth, "?", sizeWidth, "?", "?", entry->name);
+            continue;
+        }
+        char mode[11], date[32];
+        formatMode(entry->mode, mode);
+        struct tm local;
+        localtime_r(&entry->mtime, &local);
+        // Like ls: the time of day for recent files, the year for old or future ones.
+        bool recent = entry->mtime <= now && now - entry->mtime < 15778476;
+        strftime(date, sizeof(date), recent ? "%b %e %H:%M" : "%b %e  %Y", &local);
+        fprintf(options->out, "%s %*lu %-*s %-*s %*lld %s %s", mode, linkWidth, (unsigned long)entry->links,
+                userWidth, ownerName(options, 0, entry->uid), groupWidth, ownerName(options, 1, entry->gid),
+                sizeWidth, (long long)entry->size, date, entry->name);
+        if (S_ISLNK(entry->mode))
+        {
+            char target[PATH_MAX];
+            ssize_t length = readlinkat(dirFd, entry->name, target, sizeof(target) - 1);
+            if (length >= 0)
             {
-                count++;
-                token = strtok(NULL, " \t\n");
+                target[length] = '\0';
+                fprintf(options->out, " -> %s", target);
             }
         }
-        printf("Word count: %d\n", count);
+        fputc('\n', options->out);
+    }
+}
+
+/* Lists one directory, then, with -R, each of its subdirectories. */
+static int listDirectory(ListOptions *options, int dirFd, const char *path, bool header)
+{
+    ArenaMark mark = arenaMark(&options->arena);
+    DirEntry *entries;
+    size_t count;
+    if (dirRead(dirFd, &options->arena, options->all, &entries, &count) != 0)
+    {
+        perror(path);
+        arenaRestore(&options->arena, mark);
+        return 1;
+    }
+    qsort(entries, count, sizeof(DirEntry), compareEntryNames);
+
+    bool needTypes = false;
+    for (size_t i = 0; i < count && options->recursive && !needTypes; i++)
+    {
+        needTypes = entries[i].type == DT_UNKNOWN;
+    }
+    // d_type already tells directories apart; only -l, or a file system that does
+    // not report types, needs a stat per entry.
+    if (options->longFormat || needTypes)
+    {
+        dirStatEntries(dirFd, entries, count);
+    }
+
+    if (header)
+    {
+        fprintf(options->out, "%s:\n", path);
+    }
+    if (options->longFormat)
+    {
+        printLongEntries(options, dirFd, entries, count, true);
     }
     else
     {
-        fprintf(stderr, "Invalid option: %s\n", option);
+        for (size_t i = 0; i < count; i++)
+        {
+            fputs(entries[i].name, options->out);
+            fputc('\n', options->out);
+        }
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < count && options->recursive; i++)
+    {
+        const char *name = entries[i].name;
+        if (entries[i].type != DT_DIR || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        {
+            continue;
+        }
+        size_t pathLength = strlen(path), nameLength = strlen(name);
+        char *childPath = arenaAlloc(&options->arena, pathLength + nameLength + 2);
+        if (childPath == NULL)
+        {
+            perror("ls");
+            status = 1;
+            break;
+        }
+        memcpy(childPath, path, pathLength);
+        childPath[pathLength] = '/';
+        memcpy(childPath + pathLength + 1, name, nameLength + 1);
+
+        fputc('\n', options->out);
+        int childFd = openat(dirFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (childFd == -1)
+        {
+            perror(childPath);
+            status = 1;
+            continue;
+        }
+        status |= listDirectory(options, childFd, childPath, true);
+        close(childFd);
+    }
+
+    free(entries);
+    arenaRestore(&options->arena, mark);
+    return status;
+}
+
+int listFiles(char **args)
+{
+    ListOptions options = {.out = shellOutput()};
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        for (const char *flag = args[i] + 1; *flag != '\0'; flag++)
+        {
+            if (*flag == 'l')
+            {
+                options.longFormat = true;
+            }
+            else if (*flag == 'a')
+            {
+                options.all = true;
+            }
+            else if (*flag == 'R')
+            {
+                options.recursive = true;
+            }
+            else
+            {
+                fprintf(stderr, "Usage: ls [-l] [-a] [-R] [path ...]\n");
+                return 2;
+            }
+        }
+    }
+
+    char *current[] = {".", NULL};
+    char **paths = args[i] != NULL ? args + i : current;
+    bool headers = options.recursive || paths[1] != NULL;
+    int status = 0;
+    for (int p = 0; paths[p] != NULL; p++)
+    {
+        char *normalizedPath = normalizePath(paths[p]);
+        if (normalizedPath == NULL)
+        {
+            fprintf(stderr, "Error normalizing path.\n");
+            status = 1;
+            continue;
+        }
+
+        // With -l a symbolic link named on the command line is shown, not followed.
+        int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (options.longFormat ? O_NOFOLLOW : 0);
+        int fd = pathOpen(normalizedPath, flags, 0);
+        if (fd == -1 && (errno == ENOTDIR || (errno == ELOOP && options.longFormat)))
+        {
+            // A file argument lists just that file.
+            DirEntry entry = {.name = normalizedPath};
+            dirStatEntries(AT_FDCWD, &entry, 1);
+            if (options.longFormat)
+            {
+                printLongEntries(&options, AT_FDCWD, &entry, 1, false);
+            }
+            else
+            {
+                fprintf(options.out, "%s\n", normalizedPath);
+            }
+        }
+        else if (fd == -1)
+        {
+            perror(normalizedPath);
+            status = 1;
+        }
+        else
+        {
+            if (p > 0)
+            {
+                fputc('\n', options.out);
+            }
+            status |= listDirectory(&options, fd, normalizedPath, headers);
+            close(fd);
+        }
+        poolFree(normalizedPath);
     }
+    arenaRelease(&options.arena);
+    return status;
+}
 
-    fclose(file);
-    free(normalizedPath);
+static void addBlocks(const char *directory, const DirEntry *entry, void *ctx)
+{
+    (void)directory;
+    __atomic_add_fetch((long long *)ctx, (long long)entry->blocks, __ATOMIC_RELAXED);
+}
+
+int diskUsage(char **args)
+{
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        if (strcmp(args[i], "-s") != 0)
+        {
+            fprintf(stderr, "Usage: du -s [path ...]\n");
+            return 2;
+        }
+    }
+
+    char *current[] = {".", NULL};
+    char **paths = args[i] != NULL ? args + i : current;
+    int status = 0;
+    for (int p = 0; paths[p] != NULL; p++)
+    {
+        char *normalizedPath = normalizePath(paths[p]);
+        if (normalizedPath == NULL)
+        {
+            fprintf(stderr, "Error normalizing path.\n");
+            status = 1;
+            continue;
+        }
+        long long blocks = 0;
+        int result = dirWalk(normalizedPath, DIR_WALK_UNIQUE_INODES, addBlocks, &blocks);
+        if (result >= 0)
+        {
+            // st_blocks counts 512-byte units; du reports KiB.
+            fprintf(shellOutput(), "%lld\t%s\n", blocks / 2, normalizedPath);
+        }
+        status |= result != 0;
+        poolFree(normalizedPath);
+    }
+    return status;
+}
+
+typedef struct
+{
+    const char *name;
+    char type;
+    int sizeSign;
+    long long size;
+    long long sizeUnit;
+    int mtimeSign;
+    long long mtimeDays;
+    time_t now;
+    FILE *out;
+} FindOptions;
+
+/* Compares like find: "+N" is more than N, "-N" less than N, "N" exactly N. */
+static bool matchesNumber(int sign, long long value, long long wanted)
+{
+    return sign > 0 ? value > wanted : sign < 0 ? value < wanted : value == wanted;
+}
+
+/* Parses "[+-]N" into its sign and value. Returns false if it is not a number. */
+static bool parseFindNumber(const char *text, int *sign, long long *value, char **end)
+{
+    *sign = *text == '+' ? 1 : *text == '-' ? -1 : 0;
+    text += *sign != 0;
+    if (!isdigit((unsigned char)*text))
+    {
+        return false;
+    }
+    *value = strtoll(text, end, 10);
+    return true;
+}
+
+static void findEntry(const char *directory, const DirEntry *entry, void *ctx)
+{
+    FindOptions *options = ctx;
+    if (options->name != NULL && fnmatch(options->name, entry->name, 0) != 0)
+    {
+        return;
+    }
+    if (options->type != 0)
+    {
+        unsigned char type = options->type == 'f' ? DT_REG : options->type == 'd' ? DT_DIR : DT_LNK;
+        if (entry->type != type)
+        {
+            return;
+        }
+    }
+    if (options->sizeUnit != 0)
+    {
+        // Sizes round up to whole units, so "-size 1k" matches any file of 1 to 1024 bytes.
+        long long units = ((long long)entry->size + options->sizeUnit - 1) / options->sizeUnit;
+        if (!entry->statted || !matchesNumber(options->sizeSign, units, options->size))
+        {
+            return;
+        }
+    }
+    if (options->mtimeSign != 2)
+    {
+        long long days = (long long)(options->now - entry->mtime) / 86400;
+        if (!entry->statted || !matchesNumber(options->mtimeSign, days, options->mtimeDays))
+        {
+            return;
+        }
+    }
+
+    // One call per line, so lines from different walker threads never interleave.
+    if (directory == NULL)
+    {
+        fprintf(options->out, "%s\n", entry->name);
+    }
+    else
+    {
+        size_t length = strlen(directory);
+        fprintf(options->out, "%s%s%s\n", directory, length > 0 && directory[length - 1] == '/' ? "" : "/", entry->name);
+    }
+}
+
+int findFiles(char **args)
+{
+    FindOptions options = {.mtimeSign = 2, .now = time(NULL), .out = shellOutput()};
+    int i = 1;
+    while (args[i] != NULL && args[i][0] != '-')
+    {
+        i++;
+    }
+    int pathEnd = i;
+    int flags = 0;
+    for (; args[i] != NULL; i += 2)
+    {
+        const char *value = args[i + 1];
+        char *end = NULL;
+        bool valid = value != NULL;
+        if (valid && strcmp(args[i], "-name") == 0)
+        {
+            options.name = value;
+        }
+        else if (valid && strcmp(args[i], "-type") == 0)
+        {
+            options.type = value[0];
+            valid = strchr("fdl", value[0]) != NULL && value[1] == '\0';
+        }
+        else if (valid && strcmp(args[i], "-size") == 0)
+        {
+            valid = parseFindNumber(value, &options.sizeSign, &options.size, &end);
+            const char *units = "cbkMG";
+            const long long unitSizes[] = {1, 512, 1024, 1024 * 1024, 1024 * 1024 * 1024};
+            const char *unit = valid && *end != '\0' ? strchr(units, *end) : NULL;
+            options.sizeUnit = unit != NULL ? unitSizes[unit - units] : 512;
+            valid = valid && (*end == '\0' || (unit != NULL && end[1] == '\0'));
+            flags |= DIR_WALK_STAT;
+        }
+        else if (valid && strcmp(args[i], "-mtime") == 0)
+        {
+            valid = parseFindNumber(value, &options.mtimeSign, &options.mtimeDays, &end) && *end == '\0';
+            flags |= DIR_WALK_STAT;
+        }
+        else
+        {
+            valid = false;
+        }
+        if (!valid)
+        {
+            fprintf(stderr, "Usage: find [path ...] [-name PATTERN] [-type f|d|l] [-size [+-]N[cbkMG]] [-mtime [+-]N]\n");
+            return 2;
+        }
+    }
+
+    char *current[] = {".", NULL};
+    char **paths = pathEnd > 1 ? args + 1 : current;
+    int count = pathEnd > 1 ? pathEnd - 1 : 1;
+    int status = 0;
+    for (int p = 0; p < count; p++)
+    {
+        // Named paths are printed as given, like find does.
+        status |= dirWalk(paths[p], flags, findEntry, &options) != 0;
+    }
+    return status;
+}
+
+#define TAIL_DEFAULT_LINES 10
+
+/* Finds where the last `lines` lines of `data` start. Returns false, with `start`
+   at 0, if it holds fewer lines than that. */
+static bool lastLinesStart(const char *data, size_t length, long lines, size_t *start)
+{
+    *start = length;
+    if (lines == 0)
+    {
+        return true;
+    }
+    // A final newline ends the last line rather than starting another.
+    size_t i = length > 0 && data[length - 1] == '\n' ? length - 1 : length;
+    for (; i > 0; i--)
+    {
+        if (data[i - 1] == '\n' && --lines == 0)
+        {
+            *start = i;
+            return true;
+        }
+    }
+    *start = 0;
+    return false;
+}
+
+typedef struct
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+    long lines;
+} TailState;
+
+/* Keeps the end of the input. Before the buffer grows, the lines that can no longer
+   be among the last ones are dropped, so memory stays near the size of the tail. */
+static int tailChunk(const char *data, size_t length, void *ctx)
+{
+    TailState *state = ctx;
+    if (state->length + length > state->capacity)
+    {
+        size_t start;
+        lastLinesStart(state->data, state->length, state->lines, &start);
+        memmove(state->data, state->data + start, state->length - start);
+        state->length -= start;
+    }
+    if (state->length + length > state->capacity)
+    {
+        size_t capacity = state->capacity > 0 ? state->capacity : BUFFER_SIZE;
+        while (capacity < state->length + length)
+        {
+            capacity *= 2;
+        }
+        char *grown = realloc(state->data, capacity);
+        if (grown == NULL)
+        {
+            return 1;
+        }
+        state->data = grown;
+        state->capacity = capacity;
+    }
+    memcpy(state->data + state->length, data, length);
+    state->length += length;
+    return 0;
+}
+
+/* Writes the last lines of a file, reading backwards from its end in growing
+   windows so the start of a large file is never read. Sets `end` to the offset
+   the output stops at. */
+static int tailFile(int fd, long lines, FILE *out, off_t *end)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        return -1;
+    }
+    off_t size = st.st_size;
+    size_t window = BUFFER_SIZE * 16;
+    char *buffer = NULL;
+    size_t length, start;
+    for (;;)
+    {
+        length = (off_t)window < size ? window : (size_t)size;
+        char *grown = realloc(buffer, length > 0 ? length : 1);
+        if (grown == NULL)
+        {
+            free(buffer);
+            return -1;
+        }
+        buffer = grown;
+        for (size_t done = 0; done < length;)
+        {
+            ssize_t bytesRead = pread(fd, buffer + done, length - done, size - length + done);
+            if (bytesRead <= 0)
+            {
+                if (bytesRead < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                // The file shrank underneath us; show what was read.
+                length = done;
+                break;
+            }
+            done += bytesRead;
+        }
+        if (lastLinesStart(buffer, length, lines, &start) || (off_t)length >= size)
+        {
+            break;
+        }
+        window *= 2;
+    }
+    fwrite(buffer + start, 1, length - start, out);
+    free(buffer);
+    *end = size;
+    return fflush(out) == 0 ? 0 : -1;
+}
+
+int tailLines(char **args)
+{
+    long lines = TAIL_DEFAULT_LINES;
+    bool follow = false;
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        char *end = NULL;
+        if (strcmp(args[i], "-f") == 0)
+        {
+            follow = true;
+        }
+        else if (strcmp(args[i], "-n") == 0 && args[i + 1] != NULL &&
+                 (lines = strtol(args[i + 1], &end, 10)) >= 0 && end != args[i + 1] && *end == '\0')
+        {
+            i++;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: tail [-n lines] [-f] [file]\n");
+            return 2;
+        }
+    }
+    if ((args[i] == NULL && (follow || shellInput() == NULL)) || (args[i] != NULL && args[i + 1] != NULL))
+    {
+        fprintf(stderr, "Usage: tail [-n lines] [-f] [file]\n");
+        return 2;
+    }
+
+    FILE *out = shellOutput();
+    if (args[i] == NULL)
+    {
+        TailState state = {.lines = lines};
+        int status = 0;
+        if (scanStream(shellInput(), tailChunk, &state) != 0 || state.length > state.capacity)
+        {
+            perror("tail: failed to read input");
+            status = 1;
+        }
+        else
+        {
+            size_t start;
+            lastLinesStart(state.data, state.length, lines, &start);
+            fwrite(state.data + start, 1, state.length - start, out);
+        }
+        free(state.data);
+        return status;
+    }
+
+    char *normalizedPath = normalizePath(args[i]);
+    if (normalizedPath == NULL)
+    {
+        fprintf(stderr, "Error normalizing path.\n");
+        return 1;
+    }
+    int status = 0;
+    off_t end = 0;
+    int fd = pathOpen(normalizedPath, O_RDONLY | O_CLOEXEC, 0);
+    if (fd == -1 || tailFile(fd, lines, out, &end) != 0)
+    {
+        perror(normalizedPath);
+        status = 1;
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    // Follows until Ctrl-C, picking up where the last lines ended.
+    if (status == 0 && follow && watchFollow(normalizedPath, end, out) != 0)
+    {
+        perror(normalizedPath);
+        status = 1;
+    }
+    poolFree(normalizedPath);
+    return status;
+}
+
+typedef struct
+{
+    char *command;
+    FILE *out;
+} WatchOptions;
+
+static int reportChange(const char *path, const char *name, uint32_t mask, void *ctx)
+{
+    WatchOptions *options = ctx;
+    if (options->command == NULL)
+    {
+        fprintf(options->out, "%s %s%s%s\n", watchEventName(mask), path, name != NULL ? "/" : "",
+                name != NULL ? name : "");
+    }
+    else
+    {
+        scriptRunText(options->command, "watch");
+    }
+    fflush(options->out);
+    return 0;
+}
+
+int watchFiles(char **args)
+{
+    WatchOptions options = {.out = shellOutput()};
+    int debounceMs = -1;
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-t") == 0)
+    {
+        char *end = NULL;
+        debounceMs = args[i + 1] != NULL ? (int)strtol(args[i + 1], &end, 10) : -1;
+        if (end == NULL || end == args[i + 1] || *end != '\0' || debounceMs < 0)
+        {
+            fprintf(stderr, "Usage: watch [-t ms] path ... [-- command]\n");
+            return 2;
+        }
+        i += 2;
+    }
+    int first = i;
+    while (args[i] != NULL && strcmp(args[i], "--") != 0)
+    {
+        i++;
+    }
+    int count = i - first;
+    if (count == 0 || (args[i] != NULL && args[i + 1] == NULL))
+    {
+        fprintf(stderr, "Usage: watch [-t ms] path ... [-- command]\n");
+        return 2;
+    }
+
+    // The words after "--" form the command line run for each change.
+    if (args[i] != NULL)
+    {
+        size_t length = 0;
+        for (int word = i + 1; args[word] != NULL; word++)
+        {
+            length += strlen(args[word]) + 1;
+        }
+        options.command = arenaAlloc(commandArena(), length);
+        if (options.command == NULL)
+        {
+            perror("watch");
+            return 1;
+        }
+        char *at = options.command;
+        for (int word = i + 1; args[word] != NULL; word++)
+        {
+            size_t wordLength = strlen(args[word]);
+            memcpy(at, args[word], wordLength);
+            at += wordLength;
+            *at++ = args[word + 1] != NULL ? ' ' : '\0';
+        }
+    }
+    // Events are listed as they come; a command waits for the burst to settle.
+    if (debounceMs < 0)
+    {
+        debounceMs = options.command != NULL ? WATCH_DEBOUNCE_MS : 0;
+    }
+
+    char **paths = arenaAlloc(commandArena(), (count + 1) * sizeof(char *));
+    if (paths == NULL)
+    {
+        perror("watch");
+        return 1;
+    }
+    int status = 0;
+    for (int p = 0; p < count; p++)
+    {
+        char *normalizedPath = normalizePath(args[first + p]);
+        paths[p] = normalizedPath != NULL ? arenaStrdup(commandArena(), normalizedPath) : NULL;
+        poolFree(normalizedPath);
+        if (paths[p] == NULL)
+        {
+            fprintf(stderr, "Error normalizing path.\n");
+            return 1;
+        }
+    }
+    paths[count] = NULL;
+    if (watchPaths(paths, debounceMs, reportChange, &options) != 0)
+    {
+        perror("watch");
+        status = 1;
+    }
+    return status;
+}
+
+int echo(char **args)
+{
+    int redirectIndex = 1;
+    for (; args[redirectIndex] != NULL; redirectIndex++)
+    {
+        if (strcmp(args[redirectIndex], ">>") == 0 || strcmp(args[redirectIndex], ">") == 0)
+        {
+            break;
+        }
+    }
+
+    if (args[redirectIndex] == NULL)
+    {
+        for (int i = 1; args[i] != NULL; i++)
+        {
+            fprintf(shellOutput(), "%s ", args[i]);
+        }
+        fprintf(shellOutput(), "\n");
+        return 0;
+    }
+    else if (args[redirectIndex + 1] == NULL)
+    {
+        fprintf(stderr, "Error: Redirection operator '%s' found but no file path specified.\n", args[redirectIndex]);
+        return 1;
+    }
+    else if (strcmp(args[redirectIndex], ">>") == 0)
+    {
+        return echoppend(args);
+    }
+    else
+    {
+        return echorite(args);
+    }
+}
+
+bool isBuiltin(const char *name)
+{
+    for (int i = 0; builtinNames[i] != NULL; i++)
+    {
+        if (strcmp(name, builtinNames[i]) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isAssignment(const char *word)
+{
+    const char *equals = strchr(word, '=');
+    return equals != NULL && varValidName(word, equals - word);
+}
+
+/* Applies leading NAME=value words and returns the index of the first other word. */
+static int applyAssignments(char **args)
+{
+    int i = 0;
+    for (; args[i] != NULL && isAssignment(args[i]); i++)
+    {
+        char *equals = strchr(args[i], '=');
+        *equals = '\0';
+        if (varSet(args[i], equals + 1, false) != 0)
+        {
+            fprintf(stderr, "Failed to set variable '%s'.\n", args[i]);
+        }
+        *equals = '=';
+    }
+    return i;
+}
+
+int exportVariables(char **args)
+{
+    if (args[1] == NULL)
+    {
+        varPrint(shellOutput(), true);
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        char *equals = strchr(args[i], '=');
+        int result;
+        if (equals != NULL)
+        {
+            *equals = '\0';
+            result = varSet(args[i], equals + 1, true);
+            *equals = '=';
+        }
+        else
+        {
+            result = varExport(args[i]);
+        }
+        if (result != 0)
+        {
+            fprintf(stderr, "export: '%s': not a valid identifier\n", args[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+int setVariables(char **args)
+{
+    if (args[1] == NULL)
+    {
+        varPrint(shellOutput(), false);
+        return 0;
+    }
+
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        bool enable = args[i][0] == '-';
+        if ((args[i][0] != '-' && args[i][0] != '+') || args[i][1] == '\0')
+        {
+            fprintf(stderr, "Usage: set [-e|+e] [-o|+o [errexit|pipefail|atomic|durable|cache]]\n");
+            return 2;
+        }
+
+        if (strcmp(args[i] + 1, "e") == 0)
+        {
+            scriptSetOption(SCRIPT_OPTION_ERREXIT, enable);
+        }
+        else if (strcmp(args[i] + 1, "o") == 0 && args[i + 1] == NULL)
+        {
+            fprintf(shellOutput(), "errexit\t%s\n", scriptOptions() & SCRIPT_OPTION_ERREXIT ? "on" : "off");
+            fprintf(shellOutput(), "pipefail\t%s\n", scriptOptions() & SCRIPT_OPTION_PIPEFAIL ? "on" : "off");
+            fprintf(shellOutput(), "atomic\t%s\n", scriptOptions() & SCRIPT_OPTION_ATOMIC ? "on" : "off");
+            fprintf(shellOutput(), "durable\t%s\n", scriptOptions() & SCRIPT_OPTION_DURABLE ? "on" : "off");
+            fprintf(shellOutput(), "cache\t%s\n", scriptOptions() & SCRIPT_OPTION_CACHE ? "on" : "off");
+        }
+        else if (strcmp(args[i] + 1, "o") == 0)
+        {
+            i++;
+            if (strcmp(args[i], "errexit") == 0)
+            {
+                scriptSetOption(SCRIPT_OPTION_ERREXIT, enable);
+            }
+            else if (strcmp(args[i], "pipefail") == 0)
+            {
+                scriptSetOption(SCRIPT_OPTION_PIPEFAIL, enable);
+            }
+            else if (strcmp(args[i], "atomic") == 0)
+            {
+                scriptSetOption(SCRIPT_OPTION_ATOMIC, enable);
+            }
+            else if (strcmp(args[i], "durable") == 0)
+            {
+                scriptSetOption(SCRIPT_OPTION_DURABLE, enable);
+            }
+            else if (strcmp(args[i], "cache") == 0)
+            {
+                scriptSetOption(SCRIPT_OPTION_CACHE, enable);
+            }
+            else
+            {
+                fprintf(stderr, "set: unknown option '%s'\n", args[i]);
+                return 2;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "set: unknown option '%s'\n", args[i]);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+int unsetVariables(char **args)
+{
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        varUnset(args[i]);
+    }
+    return 0;
+}
+
+static int dispatchBuiltin(char **args)
+{
+    if (isAssignment(args[0]))
+    {
+        int first = applyAssignments(args);
+        if (args[first] == NULL)
+        {
+            return varSubstitutionStatus();
+        }
+        args += first;
+    }
+
+    char *command = args[0];
+
+    if (strcmp(command, "help") == 0) {
+        return help();
+    } else if (strcmp(command, "cd") == 0) {
+        return cd(args);
+    } else if (strcmp(command, "cp") == 0) {
+        return cp(args);
+    } else if (strcmp(command, "delete") == 0) {
+        return delete(args);
+    } else if (strcmp(command, "move") == 0) {
+        return move(args);
+    } else if (strcmp(command, "echo") == 0) {
+        return echo(args);
+    } else if (strcmp(command, "read") == 0) {
+        return readI(args);
+    } else if (strcmp(command, "wc") == 0) {
+        return wordCount(args);
+    } else if (strcmp(command, "jobs") == 0) {
+        coroListJobs();
+        return 0;
+    } else if (strcmp(command, "wait") == 0) {
+        coroWaitAll();
+        return 0;
+    } else if (strcmp(command, "memstats") == 0) {
+        return memstats();
+    } else if (strcmp(command, "export") == 0) {
+        return exportVariables(args);
+    } else if (strcmp(command, "set") == 0) {
+        return setVariables(args);
+    } else if (strcmp(command, "unset") == 0) {
+        return unsetVariables(args);
+    } else if (strcmp(command, "test") == 0 || strcmp(command, "[") == 0) {
+        return testCondition(args);
+    } else if (strcmp(command, "true") == 0) {
+        return 0;
+    } else if (strcmp(command, "false") == 0) {
+        return 1;
+    } else if (strcmp(command, "source") == 0) {
+        return sourceScript(args);
+    } else if (strcmp(command, "trace") == 0) {
+        return trace(args);
+    } else if (strcmp(command, "sync") == 0) {
+        return syncWrites();
+    } else if (strcmp(command, "sort") == 0) {
+        return sortLines(args);
+    } else if (strcmp(command, "uniq") == 0) {
+        return uniqLines(args);
+    } else if (strcmp(command, "ls") == 0) {
+        return listFiles(args);
+    } else if (strcmp(command, "du") == 0) {
+        return diskUsage(args);
+    } else if (strcmp(command, "find") == 0) {
+        return findFiles(args);
+    } else if (strcmp(command, "tail") == 0) {
+        return tailLines(args);
+    } else if (strcmp(command, "watch") == 0) {
+        return watchFiles(args);
+    } else if (strcmp(command, "limit") == 0) {
+        return limitCommand(args);
+    } else if (strcmp(command, "exit") == 0) {
+        logout(args[1]);
+    }
+    fprintf(shellOutput(), "Command not found. Type 'help' for a list of commands.\n");
+    return 127;
+}
+
+int runBuiltin(char **args)
+{
+    uint64_t span = TRACE_BEGIN();
+    int status = dispatchBuiltin(args);
+    TRACE_END(span, "builtin", args[0], args[1]);
+    return status;
+}
+
+typedef struct
+{
+    char **args;
+    FILE *in;
+    FILE *out;
+    bool last;
+    bool contained;
+    int status;
+} PipelineStage;
+
+static void *runPipelineStage(void *arg)
+{
+    PipelineStage *stage = arg;
+    setShellStreams(stage->in, stage->out);
+
+    // When the caller catches `exit`, it ends only this stage, as in a subshell.
+    jmp_buf exitPoint;
+    if (!stage->contained)
+    {
+        stage->status = runBuiltin(stage->args);
+    }
+    else if (setjmp(exitPoint) == 0)
+    {
+        shellSetExitPoint(&exitPoint);
+        stage->status = runBuiltin(stage->args);
+    }
+    else
+    {
+        stage->status = shellExitStatus();
+    }
+
+    // Closing the write end signals end of stream to the next stage; closing the
+    // read end lets an upstream stage still writing fail instead of waiting forever.
+    // The last stage writes to the caller's stream, which stays open.
+    if (!stage->last)
+    {
+        fclose(stage->out);
+    }
+    else
+    {
+        fflush(shellOutput());
+    }
+    if (stage->in != NULL)
+    {
+        fclose(stage->in);
+    }
+    return NULL;
+}
+
+int runBuiltinPipeline(char ***stages, int count, int *statuses)
+{
+    // The prompt loop blocks until every stage has joined, so the arena outlives them.
+    PipelineStage *pipeline = arenaAlloc(commandArena(), count * sizeof(PipelineStage));
+    pthread_t *threads = arenaAlloc(commandArena(), count * sizeof(pthread_t));
+    if (pipeline == NULL || threads == NULL)
+    {
+        perror("Failed to allocate pipeline");
+        for (int i = 0; i < count; i++)
+        {
+            statuses[i] = 1;
+        }
+        return 1;
+    }
+    memset(pipeline, 0, count * sizeof(PipelineStage));
+
+    int ready = 0;
+    for (; ready < count - 1; ready++)
+    {
+        ByteRing *ring = ringCreate(RING_DEFAULT_CAPACITY);
+        FILE *out = ring != NULL ? ringOpenWriter(ring) : NULL;
+        FILE *in = out != NULL ? ringOpenReader(ring) : NULL;
+        if (in == NULL)
+        {
+            perror("Failed to create pipeline buffer");
+            if (out != NULL)
+            {
+                fclose(out);
+                ringCloseReader(ring);
+            }
+            else if (ring != NULL)
+            {
+                ringCloseWriter(ring);
+                ringCloseReader(ring);
+            }
+            break;
+        }
+        pipeline[ready].out = out;
+        pipeline[ready + 1].in = in;
+    }
+
+    if (ready < count - 1)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (pipeline[i].in != NULL)
+            {
+                fclose(pipeline[i].in);
+            }
+            if (pipeline[i].out != NULL)
+            {
+                fclose(pipeline[i].out);
+            }
+        }
+        for (int i = 0; i < count; i++)
+        {
+            statuses[i] = 1;
+        }
+        return 1;
+    }
+
+    fflush(stdout);
+    pipeline[count - 1].out = threadOutput;
+    pipeline[count - 1].last = true;
+    for (int i = 0; i < count; i++)
+    {
+        pipeline[i].args = stages[i];
+        pipeline[i].contained = threadExitPoint != NULL;
+        if (pthread_create(&threads[i], NULL, runPipelineStage, &pipeline[i]) != 0)
+        {
+            // Closing the stage's ends lets its neighbours see EOF/EPIPE and finish.
+            perror("Failed to start pipeline stage");
+            threads[i] = 0;
+            pipeline[i].status = 1;
+            if (pipeline[i].in != NULL)
+            {
+                fclose(pipeline[i].in);
+            }
+            if (pipeline[i].out != NULL && !pipeline[i].last)
+            {
+                fclose(pipeline[i].out);
+            }
+        }
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (threads[i] != 0)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        statuses[i] = pipeline[i].status;
+    }
+    return statuses[count - 1];
+}
+
+static void freeJobArguments(char **args)
+{
+    for (int i = 0; args[i] != NULL; i++)
+    {
+        poolFree(args[i]);
+    }
+    poolFree(args);
+}
+
+static void runBackgroundJob(void *arg)
+{
+    char **args = arg;
+    // `exit` and `set -e` end the job here rather than the shell. The scheduler
+    // keeps this exit point with the job while other code runs.
+    jmp_buf exitPoint;
+    if (setjmp(exitPoint) == 0)
+    {
+        shellSetExitPoint(&exitPoint);
+        runBuiltin(args);
+    }
+    shellSetExitPoint(NULL);
+    freeJobArguments(args);
+}
+
+int startBackgroundJob(char **args)
+{
+    int count = 0;
+    while (args[count] != NULL)
+    {
+        count++;
+    }
+
+    // The command arena is reset when the prompt loop moves on, so the job keeps
+    // its own copy of the arguments in pool memory.
+    char **jobArgs = poolAlloc((count + 1) * sizeof(char *));
+    if (jobArgs == NULL)
+    {
+        perror("Failed to start background job");
+        return 1;
+    }
+    memset(jobArgs, 0, (count + 1) * sizeof(char *));
+
+    size_t labelLength = 1;
+    for (int i = 0; i < count; i++)
+    {
+        jobArgs[i] = poolStrdup(args[i]);
+        if (jobArgs[i] == NULL)
+        {
+            perror("Failed to start background job");
+            freeJobArguments(jobArgs);
+            return 1;
+        }
+        labelLength += strlen(args[i]) + 1;
+    }
+
+    char *label = arenaAlloc(commandArena(), labelLength);
+    if (label != NULL)
+    {
+        label[0] = '\0';
+        for (int i = 0; i < count; i++)
+        {
+            strcat(label, args[i]);
+            if (i < count - 1)
+            {
+                strcat(label, " ");
+            }
+        }
+    }
+
+    int id = coroSpawn(runBackgroundJob, jobArgs, label);
+    if (id == -1)
+    {
+        freeJobArguments(jobArgs);
+        return 1;
+    }
+    printf("[%d] %s\n", id, label ? label : "");
+    return 0;
+}
+
+void execCommandLine(char *line)
+{
+    setShellStreams(NULL, NULL);
+    ScriptNode *script;
+    if (scriptParse(line, "command substitution", &script) != SCRIPT_OK)
+    {
+        _exit(2);
+    }
+
+    // A lone program replaces the child outright instead of being forked again.
+    char **args = scriptSimpleCommand(script);
+    if (args != NULL && args[0] != NULL && !isBuiltin(args[0]) && !isAssignment(args[0]))
+    {
+        environ = varEnviron();
+        execvp(args[0], args);
+        perror("execvp");
+        _exit(127);
+    }
+
+    int status = args != NULL ? (args[0] != NULL ? runBuiltin(args) : 0) : scriptRun(script);
+    fflush(stdout);
+    _exit(status);
+}
+
+static int fileTest(const char *option, const char *path)
+{
+    char *normalizedPath = normalizePath((char *)path);
+    if (normalizedPath == NULL)
+    {
+        return 1;
+    }
+
+    struct stat st;
+    bool exists = pathStat(normalizedPath, &st) == 0;
+    bool result = false;
+    switch (option[1])
+    {
+    case 'e':
+        result = exists;
+        break;
+    case 'f':
+        result = exists && S_ISREG(st.st_mode);
+        break;
+    case 'd':
+        result = exists && S_ISDIR(st.st_mode);
+        break;
+    case 's':
+        result = exists && st.st_size > 0;
+        break;
+    case 'r':
+        result = pathAccess(normalizedPath, R_OK) == 0;
+        break;
+    case 'w':
+        result = pathAccess(normalizedPath, W_OK) == 0;
+        break;
+    case 'x':
+        result = pathAccess(normalizedPath, X_OK) == 0;
+        break;
+    }
+    poolFree(normalizedPath);
+    return result ? 0 : 1;
+}
+
+int testCondition(char **args)
+{
+    int count = 0;
+    while (args[count] != NULL)
+    {
+        count++;
+    }
+    if (strcmp(args[0], "[") == 0)
+    {
+        if (count < 2 || strcmp(args[count - 1], "]") != 0)
+        {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        count--;
+    }
+
+    char **operands = args + 1;
+    int operandCount = count - 1;
+    bool negate = operandCount > 0 && strcmp(operands[0], "!") == 0;
+    if (negate)
+    {
+        operands++;
+        operandCount--;
+    }
+
+    int result;
+    if (operandCount == 0)
+    {
+        result = 1;
+    }
+    else if (operandCount == 1)
+    {
+        result = operands[0][0] != '\0' ? 0 : 1;
+    }
+    else if (operandCount == 2 && strcmp(operands[0], "-z") == 0)
+    {
+        result = operands[1][0] == '\0' ? 0 : 1;
+    }
+    else if (operandCount == 2 && strcmp(operands[0], "-n") == 0)
+    {
+        result = operands[1][0] != '\0' ? 0 : 1;
+    }
+    else if (operandCount == 2 && strlen(operands[0]) == 2 && operands[0][0] == '-' &&
+             strchr("efdsrwx", operands[0][1]) != NULL)
+    {
+        result = fileTest(operands[0], operands[1]);
+    }
+    else if (operandCount == 3 && strcmp(operands[1], "=") == 0)
+    {
+        result = strcmp(operands[0], operands[2]) == 0 ? 0 : 1;
+    }
+    else if (operandCount == 3 && strcmp(operands[1], "!=") == 0)
+    {
+        result = strcmp(operands[0], operands[2]) != 0 ? 0 : 1;
+    }
+    else if (operandCount == 3 && operands[1][0] == '-')
+    {
+        char *end1, *end2;
+        long left = strtol(operands[0], &end1, 10);
+        long right = strtol(operands[2], &end2, 10);
+        const char *op = operands[1] + 1;
+        if (*operands[0] == '\0' || *end1 != '\0' || *operands[2] == '\0' || *end2 != '\0')
+        {
+            fprintf(stderr, "test: integer expression expected\n");
+            return 2;
+        }
+        if (strcmp(op, "eq") == 0)
+            result = left == right ? 0 : 1;
+        else if (strcmp(op, "ne") == 0)
+            result = left != right ? 0 : 1;
+        else if (strcmp(op, "lt") == 0)
+            result = left < right ? 0 : 1;
+        else if (strcmp(op, "le") == 0)
+            result = left <= right ? 0 : 1;
+        else if (strcmp(op, "gt") == 0)
+            result = left > right ? 0 : 1;
+        else if (strcmp(op, "ge") == 0)
+            result = left >= right ? 0 : 1;
+        else
+        {
+            fprintf(stderr, "test: unknown operator '%s'\n", operands[1]);
+            return 2;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "test: unsupported expression\n");
+        return 2;
+    }
+
+    return negate ? !result : result;
+}
+
+int trace(char **args)
+{
+    if (args[1] == NULL)
+    {
+        fprintf(shellOutput(), "tracing is %s\n", traceEnabled ? "on" : "off");
+        return 0;
+    }
+    if (strcmp(args[1], "on") == 0 || strcmp(args[1], "off") == 0)
+    {
+        if (traceSetEnabled(strcmp(args[1], "on") == 0, args[2]) == -1)
+        {
+            perror("trace");
+            return 1;
+        }
+        return 0;
+    }
+    if (strcmp(args[1], "clear") == 0)
+    {
+        traceClear();
+        return 0;
+    }
+    if (strcmp(args[1], "dump") == 0)
+    {
+        int written = traceDump(args[2]);
+        if (written == -1)
+        {
+            perror(args[2] != NULL ? args[2] : "trace: no trace file; use trace dump <file>");
+            return 1;
+        }
+        fprintf(shellOutput(), "%d spans written.\n", written);
+        return 0;
+    }
+    fprintf(stderr, "Usage: trace [on [file] | off | dump [file] | clear]\n");
+    return 2;
+}
+
+int syncWrites(void)
+{
+    if (appendFlush() != 0 || atomicFlush() != 0)
+    {
+        perror("sync");
+        return 1;
+    }
+    return 0;
+}
+
+int sourceScript(char **args)
+{
+    if (args[1] == NULL)
+    {
+        fprintf(stderr, "Usage: source <script>\n");
+        return 2;
+    }
+
+    char *normalizedPath = normalizePath(args[1]);
+    if (normalizedPath == NULL)
+    {
+        fprintf(stderr, "Error normalizing path.\n");
+        return 1;
+    }
+    int status = scriptRunFile(normalizedPath);
+    poolFree(normalizedPath);
+    return status;
+}
+
+int memstats(void)
+{
+    MemoryStats stats = memoryStats();
+    FILE *out = shellOutput();
+    fprintf(out, "heap calls:          %lu\n", stats.heapCalls);
+    fprintf(out, "arena allocations:   %lu (%lu bytes, %lu resets)\n",
+            stats.arenaAllocations, stats.arenaBytes, stats.arenaResets);
+    fprintf(out, "pool allocations:    %lu (%lu reused, %lu freed)\n",
+            stats.poolAllocations, stats.poolReuses, stats.poolFrees);
+    fprintf(out, "large allocations:   %lu\n", stats.largeAllocations);
+    return 0;
 }
 
-void help(void)
+int help(void)
 {
-    printf("Available commands:\n");
-    printf("  cd <directory> - Change the current directory to <directory>.\n");
-    printf("  cp <source> <destination> - Copy <source> file to <destination>.\n");
-    printf("  delete <file> - Delete the specified <file>.\n");
-    printf("  move <source> <destination> - Move <source> to <destination>.\n");
-    printf("  echo >> <text> <file> - Append <text> to <file>.\n");
-    printf("  echo > <text> <file> - Overwrite <file> with <text>.\n");
-    printf("  readI <file> - Display the content of <file>.\n");
-    printf("  wc -l <file> - Count the number of lines in <file>.\n");
-    printf("  wc -w <file> - Count the number of words in <file>.\n");
-    printf("  exit - Exit the shell.\n");
-    printf("  help - Display this help message.\n");
+    fprintf(shellOutput(), "Available commands:\n");
+    fprintf(shellOutput(), "  cd [-P] <directory> - Change the current directory to <directory>.\n");
+    fprintf(shellOutput(), "  cp <source> <destination> - Copy <source> file to <destination>.\n");
+    fprintf(shellOutput(), "  cp --incremental <source> <destination> - Copy only if <destination> differs.\n");
+    fprintf(shellOutput(), "  ls [-l] [-a] [-R] [path ...] - List directory contents.\n");
+    fprintf(shellOutput(), "  du -s [path ...] - Show the disk space used by each tree, in KiB, counting hard links once.\n");
+    fprintf(shellOutput(), "  find [path ...] [-name PATTERN] [-type f|d|l] [-size [+-]N[cbkMG]] [-mtime [+-]N] - List files in trees that match every test.\n");
+    fprintf(shellOutput(), "  delete <file> - Delete the specified <file>.\n");
+    fprintf(shellOutput(), "  move <source> <destination> - Move <source> to <destination>.\n");
+    fprintf(shellOutput(), "  echo >> <text> <file> - Append <text> to <file>.\n");
+    fprintf(shellOutput(), "  echo > <text> <file> - Overwrite <file> with <text>.\n");
+    fprintf(shellOutput(), "  readI <file> - Display the content of <file>.\n");
+    fprintf(shellOutput(), "  wc -l <file> - Count the number of lines in <file>.\n");
+    fprintf(shellOutput(), "  wc -w <file> - Count the number of words in <file>.\n");
+    fprintf(shellOutput(), "  sort [-n] [-r] [-u] [-S MiB] [file ...] - Sort lines; input larger than the memory budget is merged from temporary runs.\n");
+    fprintf(shellOutput(), "  uniq [-c] [-d] [file] - Collapse adjacent equal lines, with counts or only repeated ones.\n");
+    fprintf(shellOutput(), "  tail [-n lines] [-f] [file] - Show the last lines; -f then streams data appended to <file> until Ctrl-C.\n");
+    fprintf(shellOutput(), "  watch [-t ms] path ... [-- command] - Print changes to the paths, or run <command> once each burst of changes settles.\n");
+    fprintf(shellOutput(), "  limit [-c cpus] [-n nice] [-i class[:level]] [-m MiB] [-t seconds] [-g cgroup [-q percent] [-M MiB]] [-r] <command> - Run <command>, or a pipeline stage, under resource limits; -r reports its usage.\n");
+    fprintf(shellOutput(), "  <command> & - Run a builtin in the background.\n");
+    fprintf(shellOutput(), "  jobs - List background jobs.\n");
+    fprintf(shellOutput(), "  wait - Wait for all background jobs to finish.\n");
+    fprintf(shellOutput(), "  memstats - Show allocator statistics.\n");
+    fprintf(shellOutput(), "  NAME=value - Set a shell variable; use it as $NAME or ${NAME}.\n");
+    fprintf(shellOutput(), "  export [NAME[=value] ...] - Export variables to programs, or list them.\n");
+    fprintf(shellOutput(), "  set - List all shell variables.\n");
+    fprintf(shellOutput(), "  unset NAME ... - Remove shell variables.\n");
+    fprintf(shellOutput(), "  $(command) - Replaced by the output of <command>.\n");
+    fprintf(shellOutput(), "  $? - Exit status of the last command.\n");
+    fprintf(shellOutput(), "  $PIPESTATUS - Exit statuses of every command in the last pipeline.\n");
+    fprintf(shellOutput(), "  set -e, set -o pipefail - Stop at the first failing command; fail a pipeline when any command in it fails.\n");
+    fprintf(shellOutput(), "  set -o atomic, set -o durable - Make 'echo >' and 'cp' replace files atomically; durable also syncs them in batches.\n");
+    fprintf(shellOutput(), "  set -o cache - Reuse 'wc' results for unchanged files, shared by every shell through ~/.myshell_results.\n");
+    fprintf(shellOutput(), "  sync - Write buffered appends and pending durable writes now.\n");
+    fprintf(shellOutput(), "  <cmd1> && <cmd2>, <cmd1> || <cmd2>, <cmd1> ; <cmd2> - Run <cmd2> after <cmd1> succeeds, fails, or always.\n");
+    fprintf(shellOutput(), "  if <list>; then <list>; [elif <list>; then <list>;] [else <list>;] fi - Conditional.\n");
+    fprintf(shellOutput(), "  for NAME in <words>; do <list>; done - Run <list> once per word.\n");
+    fprintf(shellOutput(), "  while <list>; do <list>; done - Repeat while <list> succeeds.\n");
+    fprintf(shellOutput(), "  test <expression>, [ <expression> ] - Check files (-e -f -d -s -r -w -x), strings (= != -z -n) or numbers (-eq -lt ...).\n");
+    fprintf(shellOutput(), "  true, false - Succeed or fail.\n");
+    fprintf(shellOutput(), "  source <script> - Run the commands in <script>.\n");
+    fprintf(shellOutput(), "  trace [on [file] | off | dump [file] | clear] - Record parse, builtin and process spans as Chrome trace JSON.\n");
+    fprintf(shellOutput(), "  exit [status] - Exit the shell.\n");
+    fprintf(shellOutput(), "  help - Display this help message.\n");
+    return 0;
 }
 
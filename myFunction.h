@@ -8,6 +8,8 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <stdbool.h>
+#include <setjmp.h>
 
 #define BUFF_SIZE 256
 #define blue() printf("\033[0;34m")
@@ -17,8 +19,9 @@
 #define boldOff() printf("\e[m")
 
 /**
- * Retrieves input from the user until a newline is entered. Dynamically allocates
- * memory for the input string, which must be freed by the caller to avoid memory leaks.
+ * Retrieves input from the user until a newline is entered. The input string is
+ * allocated from the command arena (see myArena.h) and stays valid until the prompt
+ * loop resets the arena after the command has run; it must not be freed.
  * This function is useful for interactive command-line applications where input from
  * the user is required. It supports input of arbitrary length, ensuring that the program
  * can handle user input flexibly.
@@ -26,10 +29,14 @@
  * Usage example:
  *   char *userInput = getInputFromUser();
  *   printf("You entered: %s\n", userInput);
- *   free(userInput); // Important to free the allocated memory
+ *   arenaReset(commandArena()); // Releases the line with everything else of this command
  *
- * @return A pointer to the dynamically allocated string containing the user's input.
- *         Returns NULL if there was an error allocating memory.
+ * While waiting for input, any background jobs started with `&` are given time to
+ * run, so a long copy keeps making progress while the user types the next command.
+ *
+ * @return A pointer to the arena-allocated string containing the user's input.
+ *         Returns NULL if there was an error allocating memory or standard input
+ *         reached end of file before any character was read.
  */
 char *getInputFromUser(void);
 
@@ -37,14 +44,16 @@ char *getInputFromUser(void);
  * Custom implementation of the string tokenization function that handles consecutive
  * delimiters and supports state persistence between calls. This function is designed
  * to be a more flexible alternative to the standard `strtok` function provided by C.
- * Unlike `strtok`, which uses a static buffer to maintain state between calls, `myStrtok`
- * manages its state in a way that makes it safe to use in concurrent or reentrant code.
+ * Unlike `strtok`, whose position is shared by the whole process, `myStrtok` keeps its
+ * position per thread, so threads can tokenize different strings at the same time.
+ * Within one thread, a new string must not be started before the previous one is done.
  *
  * The function splits the input string `str` into tokens, which are sequences of characters
  * separated by characters found in `delim`. On the first call, `str` should point to the
  * string to be tokenized. Subsequent calls should pass NULL as `str` to continue tokenizing
  * the same string. `myStrtok` allows consecutive delimiters in the input string and treats
- * them as a single delimiter.
+ * them as a single delimiter. Double quotes group delimiters into a token and are
+ * removed from it; the whole string is processed in linear time.
  *
  * Usage example:
  *   char str[] = "This,is,,a,test";
@@ -67,15 +76,15 @@ char *myStrtok(char *str, const char *delim);
  * Splits a given string into an array of substrings based on spaces as delimiters,
  * leveraging a custom string tokenization function `myStrtok`. This function is
  * particularly useful for parsing command-line inputs into separate arguments where
- * arguments are separated by spaces. It dynamically allocates memory for the array
- * of argument strings and each argument string individually.
+ * arguments are separated by spaces. The arguments point into `str`; only the array
+ * itself is allocated, from the command arena.
  *
  * The function iterates through the input string, tokenizing it by spaces. Each token
- * is added to a dynamically growing array of strings, which is resized as needed using
- * `realloc` to accommodate new tokens.
+ * is added to a growing array of strings, which doubles with `arenaGrow` as needed
+ * to accommodate new tokens.
  *
- * Note: It's essential to free the memory allocated for the array and its contents
- *       when they are no longer needed to avoid memory leaks.
+ * Note: The array is released by the next `arenaReset` of the command arena and
+ *       must not be freed.
  *
  * Usage example:
  *   char input[] = "ls -l /home/user";
@@ -83,10 +92,9 @@ char *myStrtok(char *str, const char *delim);
  *   for (int i = 0; args[i] != NULL; i++) {
  *       printf("%s\n", args[i]);
  *   }
- *   // Free allocated memory here
  *
  * @param str The input string to be split into arguments.
- * @return A pointer to a dynamically allocated array of strings, where each string
+ * @return A pointer to an arena-allocated array of strings, where each string
  *         is a space-delimited substring of the input. The array is null-terminated.
  *         Returns NULL if memory allocation fails at any point.
  */
@@ -102,6 +110,8 @@ char **splitArgument(char *str);
  * The function retrieves the current working directory using `getcwd`, the current
  * user's username from the user's UID, and the system's hostname. If retrieving the
  * working directory or hostname fails, an error message is printed to standard error.
+ * The username and hostname are looked up on the first call only and reused after
+ * that, so a shell that never shows a prompt never pays for the user database lookup.
  *
  * The output is color-coded for visual distinction, with the username and hostname
  * displayed in cyan and the working directory in blue. ANSI escape codes are used
@@ -138,19 +148,20 @@ void welcome();
 
 /**
  * Terminates the program with a message indicating the exit. This function is intended
- * to be called when the program should be exited cleanly. It displays a message to standard
- * output and then calls `exit` with `EXIT_SUCCESS` to end the program.
+ * to be called when the program should be exited cleanly. It waits for background jobs,
+ * displays a message to standard output when the user is at a terminal and then calls
+ * `shellExit`.
  *
- * The `trimmedInput` parameter, while not used within the function, signifies that this
- * function responds to a specific command, potentially after processing such as trimming.
- * However, the function's behavior does not change based on this input.
+ * This is the `exit` builtin, and is also called when standard input reaches its end.
  *
  * Usage:
- *   logout(trimmedInput);
+ *   logout(args[1]);   // "exit 3" exits with status 3
+ *   logout(NULL);      // exits with the status of the last command
  *
- * @param trimmedInput A string that led to the invocation of this function.
+ * @param statusText The exit status as typed by the user, or NULL to exit with the
+ *                   status of the last command (`$?`).
  */
-void logout(char* trimmedInput);
+void logout(char* statusText);
 
 
 /**
@@ -164,17 +175,17 @@ void logout(char* trimmedInput);
  * reporting the failure to process the path.
  *
  * The path provided in `args[1]` is first normalized to remove any extraneous characters
- * or formatting issues. This normalized path is then used in a call to `chdir()` to
- * change the directory. If `chdir()` fails, an error message is printed using `perror`.
- *
- * Note: The function dynamically allocates memory for the normalized path, which is
- * subsequently freed before the function returns.
- *
- * @param args An array of strings where `args[0]` is assumed to be "cd" and `args[1]`
- *             is the target directory path. The array is expected to end with a NULL
- *             pointer.
+ * or formatting issues, then handed to `pathChdir()` (see myPath.h), which expands `~`,
+ * resolves `.` and `..` logically and keeps the new directory open for later
+ * fd-relative lookups. With `-P` symbolic links are resolved as well. If the change
+ * fails, an error message is printed using `perror`.
+ *
+ * @param args An array of strings where `args[0]` is assumed to be "cd", optionally
+ *             followed by "-P", and then the target directory path. The array is
+ *             expected to end with a NULL pointer.
+ * @return 0 on success, 1 on failure.
  */
-void cd(char **args);
+int cd(char **args);
 
 
 /**
@@ -184,74 +195,125 @@ void cd(char **args);
  * any of the required arguments are missing, an error message is displayed, and the 
  * function returns without performing the copy.
  *
- * The function opens the source file in binary read mode ('rb') and the destination 
- * file in binary write mode ('wb'), ensuring that the copy is performed in binary 
- * mode to preserve the exact content of the file, including any special characters 
- * or binary data. The contents are read from the source file into a buffer, then 
- * written from the buffer to the destination file, until the entire file has been 
- * copied. 
+ * The function opens the source file for reading and the destination file for
+ * writing (created or truncated), and hands both descriptors to `ioCopy`, so the
+ * data is copied byte for byte through the active I/O backend (io_uring with several
+ * chunks in flight where available, a blocking read/write loop otherwise). 
+ * Holes in sparse files are skipped rather than written out as zeros, the destination
+ * is preallocated extent by extent, and very large copies drop their pages from the
+ * page cache as they go.
  *
  * After the operation is complete, the function frees the memory allocated for 
  * the normalized paths and closes both files. If the copy is successful, a 
  * confirmation message is printed to standard output.
  *
- * @param args An array of strings containing the command name, the source file path,
- *             and the destination file path.
+ * With `--incremental` as the first argument, the copy is skipped when the destination
+ * already holds the same content. Sizes are compared first, then modification times,
+ * and only when those disagree are the files compared by content hash. Hashes are kept
+ * in a persistent cache keyed by (device, inode, mtime), and the destination's mtime is
+ * set to the source's after a copy, so re-running the same copy costs one `stat` per
+ * file instead of a full read and write.
+ *
+ * Usage example:
+ *   char *args[] = {"cp", "--incremental", "build/app", "/srv/app", NULL};
+ *   cp(args);
+ *
+ * @param args An array of strings containing the command name, an optional
+ *             `--incremental` flag, the source file path, and the destination file path.
+ * @return 0 on success, 1 on failure.
  */
-void cp(char **args);
+int cp(char **args);
 
 /**
- * Deletes a file specified by the input string. The function first tokenizes the input
- * to extract the file path, then normalizes this path. If the path is successfully
+ * Deletes a file specified in the arguments. The function normalizes the path in `args[1]`. If the path is successfully
  * normalized, it attempts to delete the file using the `remove` function. If the file
  * cannot be deleted, an error message is printed.
  *
  * Before attempting deletion, the function checks for valid input and prints a usage
- * message if the expected file path argument is not provided or if the input cannot
- * be tokenized properly. It also handles errors in path normalization by reporting
+ * message if the expected file path argument is not provided. It also handles errors in path normalization by reporting
  * failure and exiting early.
  *
  * After attempting to delete the file, whether successful or not, the function frees
- * all dynamically allocated memory used for path normalization and argument tokenization.
+ * the memory allocated for path normalization.
  *
  * Note: This function is designed for use within applications that require file
  * management capabilities, allowing for the deletion of files through user commands
  * or programmatic input.
  *
- * @param input A string containing the 'delete' command followed by the file path to delete.
+ * @param args An array of strings containing "delete" and the file path to delete,
+ *             ending with a NULL pointer.
+ * @return 0 on success, 1 on failure.
  */
-void delete(char *input);
+int delete(char **args);
 
 /**
- * Sets up a unidirectional pipe between two processes, allowing the standard output of
- * the first command to be directed to the standard input of the second command, mimicking
- * the behavior of a Unix shell pipe. This function creates a pipe, then forks two child
- * processes to execute the given external commands. It is intended to showcase inter-process
- * communication through pipes in scenarios where the shell itself might not have suitable
+ * Sets up unidirectional pipes between processes, allowing the standard output of
+ * each command to be directed to the standard input of the next command, mimicking
+ * the behavior of a Unix shell pipe. This function creates the pipes, then forks one
+ * child process per command to execute the given external commands. It is intended to
+ * showcase inter-process communication through pipes in scenarios where the shell itself might not have suitable
  * built-in commands for demonstration.
  *
- * The function performs the following steps:
- * 1. Creates a pipe using `pipe()`.
- * 2. Forks the first child process:
- *    - The child redirects its standard output to the write end of the pipe, then
- *      executes the first command using `execvp`.
- * 3. Forks the second child process:
- *    - This child connects its standard input to the read end of the pipe, then
- *      executes the second command using `execvp`.
- * 4. The parent process waits for both child processes to terminate before returning.
+ * The function performs the following steps for each command:
+ * 1. Creates a pipe to the next command using `pipe()`, unless it is the last one.
+ * 2. Forks a child process:
+ *    - The child connects its standard input to the read end of the previous pipe and
+ *      its standard output to the write end of the new one, then executes the command
+ *      using `execvp`.
+ * 3. The parent closes its copies of the pipe ends the child now owns.
+ * Finally, the parent process waits for every child process to terminate and records
+ * the exit status of each.
+ *
+ * If creating a pipe or forking a process fails, an error message is printed, no
+ * further commands are started and the commands that were not started count as failed.
+ * A command that cannot be executed exits with status 127.
+ *
+ * Note: A stage naming a builtin runs that builtin in the forked child instead of calling
+ * `execvp`, so mixed pipelines such as `read log.txt | grep error` work. Pipelines made
+ * only of builtins do not come here at all; see `runBuiltinPipeline`.
+ *
+ * A stage starting with `limit` is parsed before anything is forked; its child
+ * applies the resource limits (see myLimit.h) and then runs the rest of the stage as
+ * above. Children are reaped with `wait4`, and the usage of a `limit -r` stage is
+ * reported on stderr.
+ *
+ * The last stage writes to standard output, unless the calling thread's output has
+ * been redirected with `setShellStreams`; then it writes into a pipe whose content
+ * is copied into that stream before the stages are waited for.
  *
- * If any step fails (creating a pipe, forking a process, or executing a command), an
- * error message is printed, and the program exits with `EXIT_FAILURE`.
+ * Usage example:
+ *   char *first[] = {"read", "log.txt", NULL};
+ *   char *second[] = {"grep", "error", NULL};
+ *   char *third[] = {"sort", NULL};
+ *   char **stages[] = {first, second, third};
+ *   int statuses[3];
+ *   mypipe(stages, 3, statuses);
+ *
+ * @param stages Array of `count` NULL-terminated argument vectors.
+ * @param count Number of stages, at least 1.
+ * @param statuses Receives the exit status of every stage, or 128 plus the signal
+ *                 number for a stage a signal ended. Stages that could not be started
+ *                 get 1, and every stage gets 2 if a `limit` stage is invalid.
+ * @return The exit status of the last stage.
+ */
+int mypipe(char ***stages, int count, int *statuses);
+
+/**
+ * Implements `limit`: runs a command, builtin or external, in a child process with
+ * CPU affinity, niceness, I/O priority, address-space and CPU-time limits, and
+ * optionally inside a throttled cgroup v2 group; see `limitParse` for the options.
+ * As a pipeline stage (`read big.log | limit -n 10 sort`) only that stage is limited.
+ * With `-r` the CPU time, peak memory, faults, block I/O and context switches the
+ * command used are printed to stderr when it exits.
  *
- * Note: This function assumes `argv1` and `argv2` are null-terminated arrays of strings
- * representing the command and its arguments to be executed by the child processes. The
- * use of external commands is necessary to demonstrate the functionality, as the custom
- * shell may not have suitable internal commands for such an illustration.
+ * Usage example:
+ *   > limit -c 0-1 -n 10 -i idle -m 512 -r gzip -9 big.log
  *
- * @param argv1 A null-terminated array of strings for the first command and its arguments.
- * @param argv2 A null-terminated array of strings for the second command and its arguments.
+ * @param args "limit", options and the command, NULL-terminated.
+ * @return The command's exit status, 126 if a limit could not be applied, 2 on a
+ *         usage error.
  */
-void mypipe(char **argv1, char **argv2);
+int limitCommand(char **args);
 
 
 /**
@@ -277,15 +339,22 @@ void mypipe(char **argv1, char **argv2);
  * @param args An array of strings where `args[1]` is the source file path and `args[2]`
  *             is the destination path or directory. The array should end with a NULL
  *             pointer.
+ * @return 0 on success, 1 on failure.
  */
-void move(char **args);
+int move(char **args);
 
 
 /**
  * Appends the provided text to the specified file. This function takes an array of
  * strings where the text to append is specified up to the ">>" marker, and the file path
- * follows the marker. It opens the specified file in append mode and writes the text
- * to it, creating the file if it does not exist.
+ * follows the marker. It appends the text as one line, creating the file if it does
+ * not exist.
+ *
+ * The line goes through the shell's append cache (see myAppend.h): the file stays
+ * open with O_APPEND across commands and lines are gathered and written together with
+ * `writev`, so a script logging in a loop does not open and close the file per line.
+ * Buffered lines are written after each command line, before any command that could
+ * read them, after APPEND_FLUSH_INTERVAL_MS, by `sync` and at exit.
  *
  * This functionality is similar to the shell's append redirect operation. It's useful
  * for logging or adding information to a file without overwriting its current contents.
@@ -300,8 +369,9 @@ void move(char **args);
  *
  * @param args An array of strings containing the text to append, the ">>" marker,
  *             and the path to the file. The array is expected to end with a NULL pointer.
+ * @return 0 on success, 1 on failure.
  */
-void echoppend(char **args);
+int echoppend(char **args);
 
 
 /**
@@ -324,31 +394,35 @@ void echoppend(char **args);
  *
  * @param args An array of strings containing the text to write, the ">" marker, and the
  *             path to the file. The array is expected to end with a NULL pointer.
+ * @return 0 on success, 1 on failure.
  */
-void echorite(char **args);
+int echorite(char **args);
 
 
 /**
  * Normalizes a file path by removing redundant slashes, trimming leading and trailing
  * whitespace, and eliminating surrounding quotes if present. This function is useful
  * in command-line applications or scripts where file paths may be input by the user
- * and need to be sanitized before use. It dynamically allocates memory for the
- * normalized path, which must be freed by the caller.
+ * and need to be sanitized before use. The normalized path is allocated from the
+ * size-class pools and must be released by the caller with `poolFree`.
  *
  * The normalization process includes:
  * - Trimming leading and trailing whitespace.
  * - Removing surrounding quotes (single or double).
  * - Replacing consecutive slashes with a single slash.
+ * - Dropping runs of spaces next to a slash, so "a  / b" becomes "a/b".
+ *
+ * Normalizing an already normalized path returns it unchanged.
  *
  * Usage example:
  *   char rawPath[] = "  \"/some///path/\"  ";
  *   char *normPath = normalizePath(rawPath);
  *   printf("Normalized path: %s\n", normPath);
- *   free(normPath); // Free the dynamically allocated memory
+ *   poolFree(normPath); // Returns the block to its pool
  *
  * @param path The file path string to normalize.
- * @return A dynamically allocated string containing the normalized path. The caller
- *         is responsible for freeing this memory. Returns NULL if memory allocation fails.
+ * @return A pool-allocated string containing the normalized path. The caller
+ *         releases it with `poolFree`. Returns NULL if memory allocation fails.
  */
 char *normalizePath(char *path);
 
@@ -356,10 +430,9 @@ char *normalizePath(char *path);
  * Splits a command string into two separate strings based on the first occurrence
  * of a pipe symbol ('|'). This function is particularly useful for parsing command
  * lines that involve piping between two commands in a shell-like interface. The
- * function dynamically allocates memory for an array of two strings, representing
- * the command before and after the pipe symbol. It's the caller's responsibility
- * to free the allocated memory for both the array and the strings within it to
- * prevent memory leaks.
+ * function allocates an array of two strings from the command arena, representing
+ * the command before and after the pipe symbol. Both are released by the next
+ * `arenaReset` of the command arena.
  *
  * If the input command does not contain a pipe symbol, the returned array will
  * contain the original command as its first element and NULL as its second element.
@@ -367,19 +440,14 @@ char *normalizePath(char *path);
  * Usage example:
  *   char command[] = "ls -l | grep 'Jun'";
  *   char **splitCommands = splitOnPipe(command);
- *   if (splitCommands[0] && splitCommands[1]) {
+ *   if (splitCommands != NULL) {
  *       printf("Command 1: %s\n", splitCommands[0]);
  *       printf("Command 2: %s\n", splitCommands[1]);
  *   }
- *   // Free allocated memory
- *   free(splitCommands[0]);
- *   free(splitCommands[1]);
- *   free(splitCommands);
  *
  * @param command The command string to be split on the first pipe symbol.
- * @return An array of two dynamically allocated strings split on the first pipe symbol.
- *         The caller must free the allocated memory. If there's no pipe in the command,
- *         the second string in the array will be NULL.
+ * @return An array of two arena-allocated strings split on the first pipe symbol,
+ *         or NULL if there's no pipe in the command.
  */
 char** splitOnPipe(const char* command);
 
@@ -407,7 +475,7 @@ char** splitOnPipe(const char* command);
  *
  * @param str The string to be trimmed. Must be a modifiable string, not a string literal.
  * @return A pointer to the trimmed string, which is the same as the input string modified
- *         in place.
+ *         in place, or NULL when `str` is NULL.
  */
 char* trim(char* str);
 
@@ -419,9 +487,13 @@ char* trim(char* str);
  * like redundant slashes or surrounding quotes. If the file path is not provided or the
  * normalization fails, it prints an error message to standard error.
  *
- * Upon successfully opening the file, `readI` reads the file content line by line into a
- * buffer and prints it to standard output until reaching the end of the file. It then frees
- * the dynamically allocated memory for the normalized path and closes the file.
+ * When no file path is given and the builtin is a pipeline stage, the previous
+ * stage's output is copied to the output instead, like `cat` without arguments.
+ *
+ * Upon successfully opening the file, `readI` streams the file content through `ioScan`
+ * in large chunks and prints it to standard output until reaching the end of the file.
+ * A gzip or zstd compressed file is printed decompressed (see `decompressScan`).
+ * It then frees the dynamically allocated memory for the normalized path and closes the file.
  *
  * Usage example:
  *   char *args[] = {"readI", "example.txt", NULL};
@@ -435,8 +507,9 @@ char* trim(char* str);
  * @param args An array of strings containing the function name and the path to the file
  *             to be read. The array is expected to end with a NULL pointer to mark the end
  *             of arguments.
+ * @return 0 on success, 1 on failure.
  */
-void readI(char **args);
+int readI(char **args);
 
 
 
@@ -455,14 +528,442 @@ void readI(char **args);
  *   char *args[] = {"wordCount", "-l", "example.txt", NULL};
  *   wordCount(args); // Counts lines in example.txt
  *
- * The function does not return a value but prints the count directly to standard output.
- * If the file cannot be opened or read, an error message is printed instead.
+ * When the file path is omitted in a pipeline stage, the previous stage's output is
+ * counted instead (`read log.txt | wc -l`).
+ *
+ * The file is streamed through `ioScan` in large chunks, decompressed first if it is
+ * a gzip or zstd file (see `decompressScan`); words are runs of characters
+ * separated by spaces, tabs or newlines, and a final line without a trailing newline
+ * still counts as a line.
+ *
+ * Under `set -o cache` the printed count is also stored in the shared result cache
+ * (see myCache.h), and counting a file that has not changed since, in any session,
+ * prints the stored count without reading the file.
+ *
+ * The count is printed directly to standard output. If the file cannot be opened or
+ * read, an error message is printed instead.
  *
  * @param args An array of strings containing the function name, the option ("-w" or "-l"),
  *             and the path to the file. The array is expected to end with a NULL pointer.
+ * @return 0 on success, 1 on failure.
+ */
+int wordCount(char **args);
+
+
+/**
+ * Implements `sort`: writes the lines of the named files, or of the previous pipeline
+ * stage when no file is given, in byte order. `-n` orders by the leading number of
+ * each line, `-r` reverses the order, `-u` prints one line of each run of equal lines
+ * and `-S MiB` sets the memory budget (SORT_MEMORY_BUDGET by default).
+ *
+ * The work is done by the sorter in mySort.h: lines are radix sorted on an 8-byte key,
+ * by several threads for large inputs, and input beyond the memory budget is spilled
+ * to sorted temporary runs that are merged with a k-way heap at the end.
+ *
+ * Usage example:
+ *   > read access.log | sort | uniq -c | sort -n -r
+ *
+ * @param args "sort", options and file paths, NULL-terminated.
+ * @return 0 on success, 1 if a file could not be read or a run could not be written,
+ *         2 on a usage error.
+ */
+int sortLines(char **args);
+
+/**
+ * Implements `uniq`: collapses each run of adjacent equal lines of a file, or of the
+ * previous pipeline stage, into one. `-c` prefixes every line with the length of its
+ * run and `-d` prints only lines that were repeated. Input is streamed, so only the
+ * current and previous line are held in memory.
+ *
+ * Usage example:
+ *   > sort words.txt | uniq -c
+ *
+ * @param args "uniq", options and an optional file path, NULL-terminated.
+ * @return 0 on success, 1 if the input could not be read, 2 on a usage error.
+ */
+int uniqLines(char **args);
+
+/**
+ * Implements `ls`: lists the named directories (the working directory by default)
+ * in byte order of their names, one name per line. `-a` includes names starting with
+ * '.', `-R` descends into subdirectories without following symbolic links, and `-l`
+ * prints the mode, link count, owner, group, size and modification time of each
+ * entry, and the target of symbolic links. A file argument lists only that file.
+ *
+ * Entries are read with large `getdents64` batches (see myDir.h). Without `-l` the
+ * file type the directory reports is enough, so nothing is statted; with `-l` the
+ * `statx` calls are spread over several threads.
+ *
+ * Usage example:
+ *   > ls -la /var/log
+ *
+ * @param args "ls", options and paths, NULL-terminated.
+ * @return 0 on success, 1 if a path could not be listed, 2 on a usage error.
+ */
+int listFiles(char **args);
+
+/**
+ * Implements `du -s`: prints the disk space used by each named tree (the working
+ * directory by default) in KiB, the way `du -s` does. The tree is walked by several
+ * threads with `dirWalk` (see myDir.h); symbolic links are not followed and a file
+ * with several hard links in the tree is counted once.
+ *
+ * Usage example:
+ *   > du -s build logs
+ *
+ * @param args "du", "-s" and paths, NULL-terminated.
+ * @return 0 on success, 1 if part of a tree could not be read, 2 on a usage error.
+ */
+int diskUsage(char **args);
+
+/**
+ * Implements `find`: prints the path of every file and directory in the named trees
+ * (the working directory by default) that passes all of the given tests. `-name`
+ * matches the file name against a shell pattern, `-type` the kind of file, `-size`
+ * the size in units of the suffix (512-byte blocks without one), and `-mtime` the
+ * whole days since the last modification; "+N" means more than N and "-N" less than
+ * N. Trees are walked by several threads with `dirWalk` (see myDir.h), so paths are
+ * printed in no particular order; only `-size` and `-mtime` need a stat per entry.
+ *
+ * Usage example:
+ *   > find /var/log -name "*.gz" -mtime +30
+ *
+ * @param args "find", paths and tests, NULL-terminated.
+ * @return 0 on success, 1 if part of a tree could not be read, 2 on a usage error.
+ */
+int findFiles(char **args);
+
+/**
+ * Implements `tail`: prints the last lines of a file, or of the previous pipeline
+ * stage, ten unless `-n` says otherwise. A file is read backwards from its end, so
+ * the size of the file does not matter. With `-f` the command then keeps writing
+ * the data appended to the file until Ctrl-C, woken by inotify rather than polling
+ * (see myWatch.h); it follows the name across truncation and log rotation.
+ *
+ * Usage example:
+ *   > tail -n 50 -f /var/log/app.log
+ *
+ * @param args "tail", options and an optional file path, NULL-terminated.
+ * @return 0 on success, 1 if the file could not be read or followed, 2 on a usage
+ *         error.
  */
-void wordCount(char **args);
+int tailLines(char **args);
 
+/**
+ * Implements `watch`: waits for files to be written, created, deleted, renamed or
+ * changed in attributes (and for the same in the entries of watched directories)
+ * until Ctrl-C, using inotify instead of polling. Without a command each change is
+ * printed as "EVENT path[/name]". With "-- command" the words after "--" are run as
+ * a command line once a burst of changes has been followed by `-t` milliseconds of
+ * quiet (WATCH_DEBOUNCE_MS by default), so saving many files runs it once.
+ *
+ * Usage example:
+ *   > watch src -- make
+ *
+ * @param args "watch", options, paths, and optionally "--" and a command, NULL-terminated.
+ * @return 0 when interrupted, 1 if a path could not be watched, 2 on a usage error.
+ */
+int watchFiles(char **args);
+
+/**
+ * Implements the `echo` builtin. Without a redirection operator the arguments are
+ * printed to standard output separated by spaces. With ">>" the text is appended to
+ * the file named after the operator (see `echoppend`), and with ">" the file is
+ * overwritten (see `echorite`). An operator without a file path is reported as an error.
+ *
+ * Usage example:
+ *   char *args[] = {"echo", "hello", ">", "greeting.txt", NULL};
+ *   echo(args);
+ *
+ * @param args An array of strings containing "echo", the text words, an optional
+ *             redirection operator and file path. The array is expected to end with
+ *             a NULL pointer.
+ * @return 0 on success, 1 on failure.
+ */
+int echo(char **args);
+
+/**
+ * Runs a single builtin command. This is the dispatch table of the shell: it
+ * compares `args[0]` against the names of the builtins and calls the matching
+ * function, or prints "Command not found" when nothing matches. Keeping dispatch
+ * in one function lets scripts, pipelines and background jobs run commands the same way.
+ * Leading NAME=value words set shell variables before the command runs.
+ *
+ * Builtins may modify their argument strings only temporarily: a parsed script runs
+ * the same argument vector on every iteration of a loop.
+ *
+ * Usage example:
+ *   char line[] = "wc -l notes.txt";
+ *   char **args = splitArgument(line);
+ *   int status = runBuiltin(args);
+ *
+ * @param args The tokenized command line. `args[0]` must not be NULL.
+ * @return The exit status of the builtin: 0 for success, 1 for failure, 2 for a
+ *         usage error in `test`, 127 when no builtin has that name.
+ */
+int runBuiltin(char **args);
+
+/**
+ * Returns true if `name` is the name of a builtin handled by `runBuiltin`.
+ *
+ * @param name The command name, normally `args[0]`.
+ * @return true for builtins, false for anything that would need `execvp`.
+ */
+bool isBuiltin(const char *name);
+
+/**
+ * Runs a pipeline whose stages are all builtins inside the shell process, without
+ * fork, exec or kernel pipes. Each stage runs on its own thread, and neighbouring
+ * stages are connected by a lock-free single-producer/single-consumer ring buffer
+ * (see myRing.h) wrapped in a stdio stream, so a builtin writes to the next stage
+ * with the same `fprintf` calls it uses for the terminal.
+ *
+ * Builtins that read input (`read` without a file, `wc -l` / `wc -w` without a file)
+ * consume the previous stage's output. The last stage writes to the calling
+ * thread's `shellOutput`, standard output unless redirected. The function returns
+ * when every stage has finished.
+ *
+ * Usage example:
+ *   char *first[] = {"read", "log.txt", NULL};
+ *   char *second[] = {"wc", "-l", NULL};
+ *   char **stages[] = {first, second};
+ *   int statuses[2];
+ *   int status = runBuiltinPipeline(stages, 2, statuses);
+ *
+ * @param stages Array of `count` NULL-terminated argument vectors.
+ * @param count Number of stages, at least 2.
+ * @param statuses Receives the exit status of every stage.
+ * @return The exit status of the last stage.
+ */
+int runBuiltinPipeline(char ***stages, int count, int *statuses);
+
+/**
+ * Returns the stream builtins write their normal output to. This is standard output
+ * unless the calling thread is a pipeline stage, in which case it is the ring buffer
+ * feeding the next stage. Builtins use `fprintf(shellOutput(), ...)` rather than
+ * `printf` so that they work unchanged in both places.
+ *
+ * @return The output stream of the calling thread.
+ */
+FILE *shellOutput(void);
+
+/**
+ * Returns the stream a builtin should read when it is given no file argument, or
+ * NULL when the builtin is not reading from a pipeline.
+ *
+ * @return The input stream of the calling thread, or NULL.
+ */
+FILE *shellInput(void);
+
+/**
+ * Sets the input and output streams of the calling thread. Passing NULL for `out`
+ * restores standard output; passing NULL for `in` means "not in a pipeline".
+ *
+ * @param in Stream returned by `shellInput`.
+ * @param out Stream returned by `shellOutput`.
+ */
+void setShellStreams(FILE *in, FILE *out);
+
+/**
+ * Sets where `shellExit` returns to on the calling thread instead of ending the
+ * process, so that a program running commands in-process survives `exit` and
+ * `set -e`. Builtin pipeline stages started while a point is set catch `exit` on
+ * their own thread, ending just that stage.
+ *
+ * Usage example:
+ *   jmp_buf point;
+ *   if (setjmp(point) == 0) {
+ *       shellSetExitPoint(&point);
+ *       status = scriptRunText(line, "embedded");
+ *   } else {
+ *       status = shellExitStatus();
+ *   }
+ *   shellSetExitPoint(NULL);
+ *
+ * @param point The jump buffer to return to, or NULL to let `shellExit` end the process.
+ */
+void shellSetExitPoint(jmp_buf *point);
+
+/**
+ * Returns the status passed to the `shellExit` that last jumped to an exit point on
+ * the calling thread.
+ *
+ * @return The exit status, from 0 to 255.
+ */
+int shellExitStatus(void);
+
+/**
+ * Exchanges the calling thread's exit point and last exit status with the ones in
+ * `*point` and `*status`. The coroutine scheduler calls it around every switch, so
+ * each background job has an exit point of its own.
+ *
+ * Usage example:
+ *   shellSwapExit(&job->exitPoint, &job->exitStatus);
+ *   swapcontext(&scheduler, &job->context);
+ *   shellSwapExit(&job->exitPoint, &job->exitStatus);
+ *
+ * @param point The exit point to install; receives the one that was installed.
+ * @param status The exit status to install; receives the one that was installed.
+ */
+void shellSwapExit(jmp_buf **point, int *status);
+
+/**
+ * Ends the shell with a status: jumps to the calling thread's exit point when one
+ * is set (see `shellSetExitPoint`), and calls `exit` otherwise.
+ *
+ * @param status The exit status.
+ */
+void shellExit(int status) __attribute__((noreturn));
+
+/**
+ * Starts a builtin as a background job. The arguments are copied, so the caller may
+ * release its own copies right away, and the command is run
+ * by `runBuiltin` inside a coroutine (see myCoro.h). The job number is printed in
+ * the form "[n] command", and a "[n] Done" line follows before a later prompt once
+ * it has finished.
+ *
+ * Builtins run in the background yield between chunks of file I/O, so several
+ * copies or scans can proceed concurrently with each other and with the prompt,
+ * without forking.
+ *
+ * @param args The expanded arguments of the command, without the '&' marker.
+ * @return 0 if the job was started, 1 otherwise.
+ */
+int startBackgroundJob(char **args);
+
+/**
+ * Runs a command line inside a forked child and exits with its status. Used for
+ * command substitution: when the line is a single program that is not a builtin, the
+ * child execs it directly with the exported variables as its environment; otherwise
+ * it parses and runs the line as a script (see myScript.h) and exits.
+ *
+ * @param line The command line.
+ */
+void execCommandLine(char *line);
+
+/**
+ * Implements `test` and `[`. Supports `-e`, `-f`, `-d`, `-s`, `-r`, `-w` and `-x`
+ * on a path, `-z` and `-n` on a string, `=` and `!=` between strings, and `-eq`,
+ * `-ne`, `-lt`, `-le`, `-gt` and `-ge` between integers, each optionally preceded by
+ * `!`. A single argument is true when it is not empty.
+ *
+ * Usage example:
+ *   > if [ -d backup ]; then cp notes.txt backup; fi
+ *   > test $COUNT -lt 10 && echo few
+ *
+ * @param args "test" or "[" followed by the expression; after "[" the last argument
+ *             must be "]".
+ * @return 0 if the expression is true, 1 if it is false, 2 if it is malformed.
+ */
+int testCondition(char **args);
+
+/**
+ * Implements `source`: runs the commands in a script file in the current shell, so
+ * the variables it sets and the directory it changes to remain afterwards.
+ *
+ * @param args "source" followed by the script path.
+ * @return The exit status of the script.
+ */
+int sourceScript(char **args);
+
+/**
+ * Implements `sync`. Writes out the lines `echo >>` has buffered and, under
+ * `set -o durable`, the queue of files `echo >` and `cp` have written. The shell does
+ * both by itself after each command line, before any other command and at exit (the
+ * durable queue with one sync per file system for the whole batch); `sync` does it at
+ * once, for example in the middle of a long script.
+ *
+ * Usage example:
+ *   > set -o durable
+ *   > for f in a b c; do cp staging/$f.conf /etc/app/$f.conf; done; sync
+ *
+ * @return 0 on success, 1 if a file could not be written, synced or renamed.
+ */
+int syncWrites(void);
+
+/**
+ * Implements `trace`, which controls the span recorder in myTrace.h. Spans cover
+ * parsing (`parse`, `splitArgument`, `splitOnPipe`, expansion), dispatch of each
+ * command and pipeline, every builtin, and each fork, wait and child process of a
+ * forked pipeline or command substitution. They are kept in a ring buffer and
+ * written as Chrome trace-event JSON.
+ *
+ * Usage example:
+ *   > trace on session.json
+ *   > cp big.iso /backup
+ *   > trace dump
+ *   412 spans written.
+ *
+ * `trace` alone reports whether tracing is on; `trace off` stops recording and
+ * `trace clear` empties the buffer. Setting MYSHELL_TRACE=file before starting the
+ * shell is the same as `trace on file`, and the file is also written at exit.
+ *
+ * @param args "trace", an optional subcommand and an optional file name.
+ * @return 0 on success, 1 if the file could not be written, 2 on a usage error.
+ */
+int trace(char **args);
+
+/**
+ * Implements `export`. With no arguments, prints the exported variables. Each
+ * `NAME=value` argument sets and exports a variable; each `NAME` exports an existing
+ * one. Exported variables form the environment of programs the shell starts.
+ *
+ * Usage example:
+ *   > export DATA=/srv/data
+ *   > export
+ *   export DATA=/srv/data
+ *   ...
+ *
+ * @param args "export" followed by the names or assignments, NULL-terminated.
+ * @return 0 on success, 1 if a name was invalid.
+ */
+int exportVariables(char **args);
+
+/**
+ * Implements `set`. Without arguments, prints every shell variable as NAME=value,
+ * sorted by name. Otherwise turns shell options on (`-`) or off (`+`):
+ *
+ *   set -e / set -o errexit     stop the script at the first failing command
+ *   set -o pipefail             a pipeline fails when any of its commands fails
+ *   set -o atomic               `echo >` and `cp` write a temporary file and rename it
+ *                               over the target, so readers never see partial content
+ *   set -o durable              as atomic, and the files are synced to disk in ordered
+ *                               batches (see myAtomic.h and `syncWrites`)
+ *   set -o cache                `wc` answers from results stored for unchanged files
+ *                               by any shell (see myCache.h)
+ *   set -o                      print the options
+ *
+ * Usage example:
+ *   > set -e -o pipefail
+ *
+ * @param args "set" followed by options, NULL-terminated.
+ * @return 0 on success, 2 for an unknown option.
+ */
+int setVariables(char **args);
+
+/**
+ * Implements `unset`: removes each named variable.
+ *
+ * @param args "unset" followed by the names, NULL-terminated.
+ * @return 0 on success, 1 if a name was invalid.
+ */
+int unsetVariables(char **args);
+
+/**
+ * Prints the allocation counters of the command arena and the size-class pools:
+ * how often they called malloc, how many objects and bytes they handed out and
+ * how many pool blocks were recycled. After a few commands `heap calls` should
+ * stop growing while the other counters keep increasing.
+ *
+ * Usage example:
+ *   > memstats
+ *   heap calls:          12
+ *   arena allocations:   305 (41216 bytes, 96 resets)
+ *   ...
+ *
+ * @return 0.
+ */
+int memstats(void);
 
 /**
  * Displays a list of available commands and their descriptions.
@@ -486,7 +987,9 @@ void wordCount(char **args);
  * Note:
  *   This command does not require any arguments. Typing 'help' will display
  *   the list of commands.
+ *
+ * @return 0.
  */
-void help(void);
+int help(void);
 
 #endif // MYFUNCTION_H
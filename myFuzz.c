@@ -0,0 +1,251 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include "myFunction.h"
+#include "myArena.h"
+
+/*
+ * Fuzz target for the line parsers: myStrtok (through splitArgument), splitOnPipe
+ * and normalizePath, plus trim. Every input is run through all of them and the
+ * results are checked against properties that hold for any input; a violation
+ * aborts, so the fuzzer keeps the input that caused it.
+ *
+ * Built by `make fuzz`: with clang it is a libFuzzer target (FUZZ_LIBFUZZER), and
+ * otherwise a standalone program under AddressSanitizer that replays the files
+ * given as arguments (`afl-fuzz ... ./myFuzz @@` works too) or, without arguments,
+ * runs FUZZ_RANDOM_RUNS random lines made of the characters the parsers treat
+ * specially.
+ */
+
+#define FUZZ_RANDOM_RUNS 200000
+#define FUZZ_RANDOM_MAX 96
+
+static void fail(const char *property, const char *input)
+{
+    fprintf(stderr, "myFuzz: %s, input \"%s\"\n", property, input);
+    abort();
+}
+
+static char *copyText(const char *text, size_t length)
+{
+    char *copy = malloc(length + 1);
+    if (copy == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static bool edgeIsSpace(const char *text)
+{
+    size_t length = strlen(text);
+    return length > 0 && (isspace((unsigned char)text[0]) || isspace((unsigned char)text[length - 1]));
+}
+
+/* Tokens never keep quotes; spaces and empty tokens only come from quoted text. Each
+   token, quoted and joined with spaces, splits back into the same tokens. */
+static void checkArguments(const char *input)
+{
+    bool quoted = strchr(input, '"') != NULL;
+    char *line = copyText(input, strlen(input));
+    char **arguments = splitArgument(line);
+    if (arguments == NULL)
+    {
+        fail("splitArgument failed", input);
+    }
+
+    size_t joinedLength = 1;
+    for (int i = 0; arguments[i] != NULL; i++)
+    {
+        if (strchr(arguments[i], '"') != NULL)
+        {
+            fail("token kept a quote", input);
+        }
+        if (!quoted && (arguments[i][0] == '\0' || strchr(arguments[i], ' ') != NULL))
+        {
+            fail("unquoted token is empty or has a space", input);
+        }
+        joinedLength += strlen(arguments[i]) + 3;
+    }
+
+    char *joined = malloc(joinedLength);
+    if (joined == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    for (int i = 0; arguments[i] != NULL; i++)
+    {
+        used += sprintf(joined + used, "%s\"%s\"", i > 0 ? " " : "", arguments[i]);
+    }
+    joined[used] = '\0';
+
+    char **again = splitArgument(joined);
+    int i = 0;
+    for (; arguments[i] != NULL && again != NULL && again[i] != NULL; i++)
+    {
+        if (strcmp(arguments[i], again[i]) != 0)
+        {
+            fail("quoted tokens do not split back the same", input);
+        }
+    }
+    if (again == NULL || arguments[i] != NULL || again[i] != NULL)
+    {
+        fail("quoted tokens do not split back the same", input);
+    }
+    free(joined);
+    free(line);
+}
+
+/* Only a line with a pipe is split; both sides come back trimmed, and together they
+   are no longer than the line. */
+static void checkPipe(const char *input)
+{
+    char **sides = splitOnPipe(input);
+    if (sides == NULL)
+    {
+        return;
+    }
+    if (strchr(input, '|') == NULL)
+    {
+        fail("split a line without a pipe", input);
+    }
+    if (sides[0] == NULL || sides[1] == NULL || edgeIsSpace(sides[0]) || edgeIsSpace(sides[1]))
+    {
+        fail("pipe side missing or not trimmed", input);
+    }
+    if (strlen(sides[0]) + strlen(sides[1]) >= strlen(input))
+    {
+        fail("pipe sides longer than the line", input);
+    }
+}
+
+/* The result has no doubled slash, no space or quote at either end, and normalizing
+   it again changes nothing. */
+static void checkPath(const char *input)
+{
+    char *path = copyText(input, strlen(input));
+    char *normalized = normalizePath(path);
+    if (normalized == NULL)
+    {
+        fail("normalizePath failed", input);
+    }
+    size_t length = strlen(normalized);
+    if (length > strlen(input) || strstr(normalized, "//") != NULL)
+    {
+        fail("path not shorter or has a doubled slash", input);
+    }
+    if (length > 0 && (strchr(" \"", normalized[0]) != NULL || strchr(" \"", normalized[length - 1]) != NULL))
+    {
+        fail("path starts or ends with a space or quote", input);
+    }
+    char *again = normalizePath(normalized);
+    if (again == NULL || strcmp(again, normalized) != 0)
+    {
+        fail("normalizing a normalized path changed it", input);
+    }
+    poolFree(again);
+    poolFree(normalized);
+    free(path);
+}
+
+static void checkTrim(const char *input)
+{
+    char *text = copyText(input, strlen(input));
+    char *trimmed = trim(text);
+    if (trimmed < text || trimmed > text + strlen(input) || edgeIsSpace(trimmed))
+    {
+        fail("trim left whitespace or left the string", input);
+    }
+    size_t length = strlen(trimmed);
+    if (strlen(trim(trimmed)) != length)
+    {
+        fail("trimming a trimmed string changed it", input);
+    }
+    free(text);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    // The parsers see C strings, so the input ends at its first NUL.
+    char *input = copyText((const char *)data, size);
+    checkArguments(input);
+    checkPipe(input);
+    checkPath(input);
+    checkTrim(input);
+    arenaReset(commandArena());
+    free(input);
+    return 0;
+}
+
+#ifndef FUZZ_LIBFUZZER
+static int runFile(const char *name)
+{
+    FILE *file = fopen(name, "rb");
+    if (file == NULL)
+    {
+        perror(name);
+        return -1;
+    }
+    char *data = NULL;
+    size_t size = 0, capacity = 0, got;
+    char chunk[4096];
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        if (size + got > capacity)
+        {
+            capacity = (size + got) * 2;
+            char *grown = realloc(data, capacity);
+            if (grown == NULL)
+            {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+        memcpy(data + size, chunk, got);
+        size += got;
+    }
+    fclose(file);
+    LLVMFuzzerTestOneInput((const uint8_t *)data, size);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        int failed = 0;
+        for (int i = 1; i < argc; i++)
+        {
+            failed |= runFile(argv[i]) != 0;
+        }
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // Mostly the characters the parsers act on, so short lines reach every branch.
+    static const char alphabet[] = "  \"\"||//$()\t\nab.";
+    uint8_t line[FUZZ_RANDOM_MAX];
+    srand(1);
+    for (int run = 0; run < FUZZ_RANDOM_RUNS; run++)
+    {
+        size_t size = (size_t)rand() % FUZZ_RANDOM_MAX;
+        for (size_t i = 0; i < size; i++)
+        {
+            line[i] = rand() % 16 == 0 ? (uint8_t)(rand() % 255 + 1) : (uint8_t)alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        LLVMFuzzerTestOneInput(line, size);
+    }
+    printf("myFuzz: %d random lines passed\n", FUZZ_RANDOM_RUNS);
+    return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "myHash.h"
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define HASH_CHUNK_SIZE (256 * 1024)
+
+typedef struct
+{
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t hash;
+} HashCacheEntry;
+
+static HashCacheEntry *cacheEntries = NULL;
+static size_t cacheCapacity = 0;
+static size_t cacheCount = 0;
+static size_t cacheFileRecords = 0;
+static bool cacheLoaded = false;
+static FILE *cacheFile = NULL;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static inline uint64_t mergeRound64(uint64_t acc, uint64_t lane)
+{
+    acc ^= round64(0, lane);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+void hashInit(HashState *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->lanes[0] = PRIME64_1 + PRIME64_2;
+    state->lanes[1] = PRIME64_2;
+    state->lanes[2] = 0;
+    state->lanes[3] = -PRIME64_1;
+}
+
+static void consumeStripes(HashState *state, const unsigned char *p, size_t stripes)
+{
+    uint64_t v1 = state->lanes[0], v2 = state->lanes[1];
+    uint64_t v3 = state->lanes[2], v4 = state->lanes[3];
+
+    for (size_t i = 0; i < stripes; i++, p += 32)
+    {
+        v1 = round64(v1, read64(p));
+        v2 = round64(v2, read64(p + 8));
+        v3 = round64(v3, read64(p + 16));
+        v4 = round64(v4, read64(p + 24));
+    }
+
+    state->lanes[0] = v1;
+    state->lanes[1] = v2;
+    state->lanes[2] = v3;
+    state->lanes[3] = v4;
+}
+
+void hashUpdate(HashState *state, const void *data, size_t length)
+{
+    const unsigned char *p = data;
+    state->totalLength += length;
+
+    if (state->bufferSize > 0)
+    {
+        size_t fill = 32 - state->bufferSize;
+        if (fill > length)
+        {
+            fill = length;
+        }
+        memcpy(state->buffer + state->bufferSize, p, fill);
+        state->bufferSize += fill;
+        p += fill;
+        length -= fill;
+        if (state->bufferSize < 32)
+        {
+            return;
+        }
+        consumeStripes(state, state->buffer, 1);
+        state->bufferSize = 0;
+    }
+
+    size_t stripes = length / 32;
+    consumeStripes(state, p, stripes);
+    p += stripes * 32;
+    length -= stripes * 32;
+
+    memcpy(state->buffer, p, length);
+    state->bufferSize = length;
+}
+
+uint64_t hashDigest(const HashState *state)
+{
+    uint64_t h;
+    const unsigned char *p = state->buffer;
+    size_t remaining = state->bufferSize;
+
+    if (state->totalLength >= 32)
+    {
+        h = rotl64(state->lanes[0], 1) + rotl64(state->lanes[1], 7) +
+            rotl64(state->lanes[2], 12) + rotl64(state->lanes[3], 18);
+        for (int i = 0; i < 4; i++)
+        {
+            h = mergeRound64(h, state->lanes[i]);
+        }
+    }
+    else
+    {
+        h = state->lanes[2] + PRIME64_5;
+    }
+
+    h += state->totalLength;
+
+    while (remaining >= 8)
+    {
+        h ^= round64(0, read64(p));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+        p += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4)
+    {
+        h ^= (uint64_t)read32(p) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0)
+    {
+        h ^= (*p) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+        p++;
+        remaining--;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static char *cachePath(void)
+{
+    const char *home = getenv("HOME");
+    if (home == NULL || *home == '\0')
+    {
+        home = ".";
+    }
+
+    size_t length = strlen(home) + strlen(HASH_CACHE_FILE) + 2;
+    char *path = malloc(length);
+    if (path != NULL)
+    {
+        snprintf(path, length, "%s/%s", home, HASH_CACHE_FILE);
+    }
+    return path;
+}
+
+static size_t slotFor(uint64_t dev, uint64_t ino)
+{
+    uint64_t key = (dev * PRIME64_1) ^ (ino * PRIME64_2);
+    key ^= key >> 29;
+    return (size_t)key & (cacheCapacity - 1);
+}
+
+static void cacheInsert(const HashCacheEntry *entry);
+
+static bool cacheGrow(void)
+{
+    size_t oldCapacity = cacheCapacity;
+    HashCacheEntry *oldEntries = cacheEntries;
+    size_t newCapacity = oldCapacity ? oldCapacity * 2 : 1024;
+
+    HashCacheEntry *newEntries = calloc(newCapacity, sizeof(HashCacheEntry));
+    if (newEntries == NULL)
+    {
+        perror("Failed to allocate hash cache");
+        return false;
+    }
+
+    cacheEntries = newEntries;
+    cacheCapacity = newCapacity;
+    cacheCount = 0;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldEntries[i].ino != 0)
+        {
+            cacheInsert(&oldEntries[i]);
+        }
+    }
+    free(oldEntries);
+    return true;
+}
+
+/* Later records for the same (dev, inode) replace earlier ones, so replaying the
+   append-only cache file leaves only the most recent hash of every file. */
+static void cacheInsert(const HashCacheEntry *entry)
+{
+    if ((cacheCount + 1) * 4 > cacheCapacity * 3 && !cacheGrow())
+    {
+        return;
+    }
+
+    size_t slot = slotFor(entry->dev, entry->ino);
+    while (cacheEntries[slot].ino != 0)
+    {
+        if (cacheEntries[slot].dev == entry->dev && cacheEntries[slot].ino == entry->ino)
+        {
+            cacheEntries[slot] = *entry;
+            return;
+        }
+        slot = (slot + 1) & (cacheCapacity - 1);
+    }
+    cacheEntries[slot] = *entry;
+    cacheCount++;
+}
+
+static void cacheCompact(const char *path)
+{
+    size_t length = strlen(path) + 5;
+    char *tmpPath = malloc(length);
+    if (tmpPath == NULL)
+    {
+        return;
+    }
+    snprintf(tmpPath, length, "%s.tmp", path);
+
+    FILE *out = fopen(tmpPath, "wb");
+    if (out == NULL)
+    {
+        free(tmpPath);
+        return;
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < cacheCapacity; i++)
+    {
+        if (cacheEntries[i].ino != 0)
+        {
+            written += fwrite(&cacheEntries[i], sizeof(HashCacheEntry), 1, out);
+        }
+    }
+
+    if (fclose(out) == 0 && written == cacheCount && rename(tmpPath, path) == 0)
+    {
+        cacheFileRecords = cacheCount;
+    }
+    else
+    {
+        unlink(tmpPath);
+    }
+    free(tmpPath);
+}
+
+static void cacheLoad(void)
+{
+    cacheLoaded = true;
+
+    char *path = cachePath();
+    if (path == NULL)
+    {
+        return;
+    }
+
+    FILE *in = fopen(path, "rb");
+    if (in != NULL)
+    {
+        HashCacheEntry entry;
+        while (fread(&entry, sizeof(entry), 1, in) == 1)
+        {
+            cacheFileRecords++;
+            if (entry.ino != 0)
+            {
+                cacheInsert(&entry);
+            }
+        }
+        fclose(in);
+    }
+
+    if (cacheFileRecords > 1024 && cacheFileRecords > cacheCount * 2)
+    {
+        cacheCompact(path);
+    }
+
+    cacheFile = fopen(path, "ab");
+    free(path);
+}
+
+static void fillKey(HashCacheEntry *entry, const struct stat *st)
+{
+    entry->dev = (uint64_t)st->st_dev;
+    entry->ino = (uint64_t)st->st_ino;
+    entry->size = (uint64_t)st->st_size;
+    entry->mtimeSec = (int64_t)st->st_mtim.tv_sec;
+    entry->mtimeNsec = (int64_t)st->st_mtim.tv_nsec;
+}
+
+static bool cacheLookup(const struct stat *st, uint64_t *hash)
+{
+    if (!cacheLoaded)
+    {
+        cacheLoad();
+    }
+    if (cacheCapacity == 0 || st->st_ino == 0)
+    {
+        return false;
+    }
+
+    HashCacheEntry key;
+    fillKey(&key, st);
+
+    size_t slot = slotFor(key.dev, key.ino);
+    while (cacheEntries[slot].ino != 0)
+    {
+        HashCacheEntry *e = &cacheEntries[slot];
+        if (e->dev == key.dev && e->ino == key.ino)
+        {
+            if (e->size == key.size && e->mtimeSec == key.mtimeSec && e->mtimeNsec == key.mtimeNsec)
+            {
+                *hash = e->hash;
+                return true;
+            }
+            return false;
+        }
+        slot = (slot + 1) & (cacheCapacity - 1);
+    }
+    return false;
+}
+
+void hashCacheStore(const struct stat *st, uint64_t hash)
+{
+    if (!cacheLoaded)
+    {
+        cacheLoad();
+    }
+    if (st->st_ino == 0)
+    {
+        return;
+    }
+
+    HashCacheEntry entry;
+    fillKey(&entry, st);
+    entry.hash = hash;
+    cacheInsert(&entry);
+
+    if (cacheFile != NULL)
+    {
+        if (fwrite(&entry, sizeof(entry), 1, cacheFile) == 1)
+        {
+            cacheFileRecords++;
+        }
+        fflush(cacheFile);
+    }
+}
+
+int fileContentHash(const char *path, const struct stat *st, uint64_t *hash)
+{
+    if (cacheLookup(st, hash))
+    {
+        return 0;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    char *buffer = malloc(HASH_CHUNK_SIZE);
+    if (buffer == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+
+    HashState state;
+    hashInit(&state);
+
+    ssize_t bytesRead;
+    while ((bytesRead = read(fd, buffer, HASH_CHUNK_SIZE)) > 0)
+    {
+        hashUpdate(&state, buffer, (size_t)bytesRead);
+    }
+
+    free(buffer);
+    close(fd);
+    if (bytesRead < 0)
+    {
+        return -1;
+    }
+
+    *hash = hashDigest(&state);
+    hashCacheStore(st, *hash);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef MYHASH_H
+#define MYHASH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#define HASH_CACHE_FILE ".myshell_hashes"
+
+/**
+ * Streaming state for the 64-bit content hash used by `cp --incremental`. The hash
+ * follows the xxHash64 construction: four independent accumulator lanes consume the
+ * input in 32-byte stripes, so the compiler can keep all four multiply-rotate chains
+ * in flight at once, and the lanes are folded together when the digest is requested.
+ *
+ * Data may be fed in chunks of any size; a partial stripe is kept in `buffer` until
+ * enough bytes arrive to complete it.
+ */
+typedef struct
+{
+    uint64_t totalLength;
+    uint64_t lanes[4];
+    unsigned char buffer[32];
+    size_t bufferSize;
+} HashState;
+
+/**
+ * Initializes a streaming hash state. Must be called before the first `hashUpdate`.
+ *
+ * @param state The state to initialize.
+ */
+void hashInit(HashState *state);
+
+/**
+ * Feeds `length` bytes from `data` into the hash. Can be called repeatedly with
+ * consecutive chunks of a file; the result is the same as hashing the whole input
+ * in one call.
+ *
+ * @param state The streaming state previously set up with `hashInit`.
+ * @param data Pointer to the bytes to hash.
+ * @param length Number of bytes to hash.
+ */
+void hashUpdate(HashState *state, const void *data, size_t length);
+
+/**
+ * Returns the 64-bit digest of all data fed so far. The state is not modified, so
+ * more data can still be added afterwards.
+ *
+ * @param state The streaming state.
+ * @return The 64-bit content hash.
+ */
+uint64_t hashDigest(const HashState *state);
+
+/**
+ * Returns the content hash of a regular file, consulting the persistent hash cache
+ * first. The cache is keyed by (device, inode, size, mtime), so as long as a file
+ * has not been modified since it was last hashed, the answer costs only the `stat`
+ * the caller already performed. On a cache miss the file is read in large chunks,
+ * hashed, and the result is recorded in the cache for later runs.
+ *
+ * Usage example:
+ *   struct stat st;
+ *   uint64_t hash;
+ *   if (stat("data.bin", &st) == 0 && fileContentHash("data.bin", &st, &hash) == 0)
+ *       printf("%016llx\n", (unsigned long long)hash);
+ *
+ * @param path The file to hash.
+ * @param st The result of `stat` on `path`, used as the cache key.
+ * @param hash Receives the content hash.
+ * @return 0 on success, -1 if the file could not be read.
+ */
+int fileContentHash(const char *path, const struct stat *st, uint64_t *hash);
+
+/**
+ * Records a known content hash for the file described by `st` in the persistent
+ * hash cache. `cp --incremental` uses this after a copy, when the hash of the data
+ * it just wrote was computed on the fly, so the next run does not have to read the
+ * destination again.
+ *
+ * The cache lives in `$HOME/.myshell_hashes` (falling back to the current directory
+ * when HOME is not set). New entries are appended to the file; it is rewritten in
+ * compact form when stale entries start to dominate.
+ *
+ * @param st The result of `stat` on the file.
+ * @param hash The content hash of the file.
+ */
+void hashCacheStore(const struct stat *st, uint64_t hash);
+
+#endif // MYHASH_H
@@ -0,0 +1,824 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <linux/io_uring.h>
+#include "myIO.h"
+#include "myCoro.h"
+
+enum
+{
+    SLOT_IDLE,
+    SLOT_READING,
+    SLOT_WRITING,
+    SLOT_READY
+};
+
+typedef struct
+{
+    int state;
+    off_t offset;
+    size_t length;
+    size_t chunk;
+} IOSlot;
+
+typedef struct
+{
+    int fd;
+    int eventFd;
+    bool fixedBuffers;
+    bool busy;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned toSubmit;
+    char *buffers[IO_QUEUE_DEPTH];
+    IOSlot slots[IO_QUEUE_DEPTH];
+} Uring;
+
+static Uring ring = {.fd = -1, .eventFd = -1};
+static const IOBackend *activeBackend = NULL;
+static pthread_once_t backendOnce = PTHREAD_ONCE_INIT;
+
+int ioWriteAll(int fd, const void *data, size_t length)
+{
+    const char *p = data;
+    while (length > 0)
+    {
+        ssize_t written = write(fd, p, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+int ioWritevAll(int fd, struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        // Skip the buffers that went out whole and trim the one cut short.
+        while (count > 0 && (size_t)written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+static int pwriteAll(int fd, const char *data, size_t length, off_t offset)
+{
+    while (length > 0)
+    {
+        ssize_t written = pwrite(fd, data, length, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        offset += written;
+        length -= (size_t)written;
+    }
+    return 0;
+}
+
+/* Completes a short read synchronously. Returns the number of bytes now in the
+   buffer, which is less than `wanted` only at end of file. */
+static ssize_t preadRest(int fd, char *data, size_t have, size_t wanted, off_t offset)
+{
+    while (have < wanted)
+    {
+        ssize_t got = pread(fd, data + have, wanted - have, offset + (off_t)have);
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (got == 0)
+        {
+            break;
+        }
+        have += (size_t)got;
+    }
+    return (ssize_t)have;
+}
+
+static int blockingCopy(int sourceFd, int destinationFd, off_t offset, off_t length)
+{
+    char *buffer = malloc(IO_CHUNK_SIZE);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+
+    // A negative length streams from the current positions until end of file.
+    bool stream = length < 0;
+    off_t end = offset + length;
+    int result = 0;
+    while (stream || offset < end)
+    {
+        size_t wanted = stream || end - offset > IO_CHUNK_SIZE ? IO_CHUNK_SIZE : (size_t)(end - offset);
+        ssize_t bytesRead = stream ? read(sourceFd, buffer, wanted) : pread(sourceFd, buffer, wanted, offset);
+        if (bytesRead == 0)
+        {
+            break;
+        }
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        int written = stream ? ioWriteAll(destinationFd, buffer, (size_t)bytesRead)
+                             : pwriteAll(destinationFd, buffer, (size_t)bytesRead, offset);
+        if (written != 0)
+        {
+            result = -1;
+            break;
+        }
+        offset += bytesRead;
+        coroYield();
+    }
+
+    free(buffer);
+    return result;
+}
+
+static int blockingScan(int fd, off_t length, IOConsumer consumer, void *ctx)
+{
+    (void)length;
+    char *buffer = malloc(IO_CHUNK_SIZE);
+    if (buffer == NULL)
+    {
+        return -1;
+    }
+
+    int result = 0;
+    ssize_t bytesRead;
+    while ((bytesRead = read(fd, buffer, IO_CHUNK_SIZE)) != 0)
+    {
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        if (consumer(buffer, (size_t)bytesRead, ctx) != 0)
+        {
+            break;
+        }
+        coroYield();
+    }
+
+    free(buffer);
+    return result;
+}
+
+static const IOBackend blockingBackend = {"blocking", blockingCopy, blockingScan};
+
+static int uringSetup(void)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = (int)syscall(__NR_io_uring_setup, IO_QUEUE_DEPTH, &params);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        close(fd);
+        return -1;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    size_t ringSize = sqSize > cqSize ? sqSize : cqSize;
+
+    char *rings = mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (rings == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        munmap(rings, ringSize);
+        close(fd);
+        return -1;
+    }
+
+    ring.sqHead = (unsigned *)(rings + params.sq_off.head);
+    ring.sqTail = (unsigned *)(rings + params.sq_off.tail);
+    ring.sqMask = (unsigned *)(rings + params.sq_off.ring_mask);
+    ring.sqArray = (unsigned *)(rings + params.sq_off.array);
+    ring.cqHead = (unsigned *)(rings + params.cq_off.head);
+    ring.cqTail = (unsigned *)(rings + params.cq_off.tail);
+    ring.cqMask = (unsigned *)(rings + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+    ring.sqes = sqes;
+
+    struct iovec iov[IO_QUEUE_DEPTH];
+    for (int i = 0; i < IO_QUEUE_DEPTH; i++)
+    {
+        if (posix_memalign((void **)&ring.buffers[i], 4096, IO_CHUNK_SIZE) != 0)
+        {
+            // The ring stays mapped for the session; just run without it.
+            for (int j = 0; j < i; j++)
+            {
+                free(ring.buffers[j]);
+            }
+            close(fd);
+            return -1;
+        }
+        iov[i].iov_base = ring.buffers[i];
+        iov[i].iov_len = IO_CHUNK_SIZE;
+    }
+
+    // Registration can fail under a tight RLIMIT_MEMLOCK; unregistered buffers still work.
+    ring.fixedBuffers = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, IO_QUEUE_DEPTH) == 0;
+
+    // Completions also signal an eventfd so coroutines can wait for them in the event loop.
+    ring.eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ring.eventFd != -1 && syscall(__NR_io_uring_register, fd, IORING_REGISTER_EVENTFD, &ring.eventFd, 1) != 0)
+    {
+        close(ring.eventFd);
+        ring.eventFd = -1;
+    }
+    ring.fd = fd;
+    return 0;
+}
+
+static void uringQueue(int slot, int opcode, int fd, size_t length, off_t offset)
+{
+    unsigned tail = *ring.sqTail;
+    unsigned index = tail & *ring.sqMask;
+    struct io_uring_sqe *sqe = &ring.sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (ring.fixedBuffers)
+    {
+        sqe->opcode = opcode == IORING_OP_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe->buf_index = (unsigned short)slot;
+    }
+    else
+    {
+        sqe->opcode = opcode;
+    }
+    sqe->fd = fd;
+    sqe->addr = (unsigned long)ring.buffers[slot];
+    sqe->len = (unsigned)length;
+    sqe->off = (unsigned long long)offset;
+    sqe->user_data = (unsigned long long)slot;
+
+    ring.sqArray[index] = index;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring.toSubmit++;
+}
+
+/* Submits everything queued and waits for one completion. Inside a coroutine the
+   wait happens in the event loop on the ring's eventfd, so other jobs keep running. */
+static int uringWait(int *slot, int *res)
+{
+    bool cooperative = coroInside() && ring.eventFd != -1;
+    for (;;)
+    {
+        unsigned head = *ring.cqHead;
+        if (head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE) && ring.toSubmit == 0)
+        {
+            struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+            *slot = (int)cqe->user_data;
+            *res = cqe->res;
+            __atomic_store_n(ring.cqHead, head + 1, __ATOMIC_RELEASE);
+            return 0;
+        }
+
+        if (cooperative && ring.toSubmit == 0)
+        {
+            uint64_t signals;
+            coroWaitFd(ring.eventFd, EPOLLIN);
+            while (read(ring.eventFd, &signals, sizeof(signals)) == -1 && errno == EINTR)
+            {
+            }
+            continue;
+        }
+
+        unsigned flags = cooperative ? 0 : IORING_ENTER_GETEVENTS;
+        int submitted = (int)syscall(__NR_io_uring_enter, ring.fd, ring.toSubmit, cooperative ? 0 : 1, flags, NULL, 0);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        ring.toSubmit -= (unsigned)submitted;
+    }
+}
+
+static int uringCopy(int sourceFd, int destinationFd, off_t offset, off_t length)
+{
+    off_t nextOffset = offset;
+    off_t end = offset + length;
+    int active = 0;
+    int savedErrno = 0;
+
+    for (int i = 0; i < IO_QUEUE_DEPTH && nextOffset < end; i++)
+    {
+        size_t chunk = end - nextOffset < IO_CHUNK_SIZE ? (size_t)(end - nextOffset) : IO_CHUNK_SIZE;
+        ring.slots[i] = (IOSlot){SLOT_READING, nextOffset, chunk, 0};
+        uringQueue(i, IORING_OP_READ, sourceFd, chunk, nextOffset);
+        nextOffset += (off_t)chunk;
+        active++;
+    }
+
+    while (active > 0)
+    {
+        int i, res;
+        if (uringWait(&i, &res) != 0)
+        {
+            // The kernel stopped accepting work; nothing more will complete.
+            return -1;
+        }
+        IOSlot *slot = &ring.slots[i];
+
+        if (res < 0 && savedErrno == 0)
+        {
+            savedErrno = -res;
+        }
+        if (savedErrno != 0)
+        {
+            slot->state = SLOT_IDLE;
+            active--;
+            continue;
+        }
+
+        if (slot->state == SLOT_READING)
+        {
+            ssize_t have = preadRest(sourceFd, ring.buffers[i], (size_t)res, slot->length, slot->offset);
+            if (have <= 0)
+            {
+                if (have < 0)
+                {
+                    savedErrno = errno;
+                }
+                slot->state = SLOT_IDLE;
+                active--;
+                continue;
+            }
+            slot->length = (size_t)have;
+            slot->state = SLOT_WRITING;
+            uringQueue(i, IORING_OP_WRITE, destinationFd, slot->length, slot->offset);
+        }
+        else
+        {
+            if ((size_t)res < slot->length &&
+                pwriteAll(destinationFd, ring.buffers[i] + res, slot->length - res, slot->offset + res) != 0)
+            {
+                savedErrno = errno;
+                slot->state = SLOT_IDLE;
+                active--;
+                continue;
+            }
+
+            if (nextOffset < end)
+            {
+                size_t chunk = end - nextOffset < IO_CHUNK_SIZE ? (size_t)(end - nextOffset) : IO_CHUNK_SIZE;
+                *slot = (IOSlot){SLOT_READING, nextOffset, chunk, 0};
+                uringQueue(i, IORING_OP_READ, sourceFd, chunk, nextOffset);
+                nextOffset += (off_t)chunk;
+            }
+            else
+            {
+                slot->state = SLOT_IDLE;
+                active--;
+            }
+        }
+    }
+
+    if (savedErrno != 0)
+    {
+        errno = savedErrno;
+        return -1;
+    }
+    return 0;
+}
+
+static int uringScan(int fd, off_t length, IOConsumer consumer, void *ctx)
+{
+    size_t chunks = (size_t)((length + IO_CHUNK_SIZE - 1) / IO_CHUNK_SIZE);
+    size_t nextChunk = 0;
+    size_t deliverChunk = 0;
+    int active = 0;
+    int savedErrno = 0;
+    bool stopped = false;
+
+    for (int i = 0; i < IO_QUEUE_DEPTH && nextChunk < chunks; i++, nextChunk++)
+    {
+        off_t offset = (off_t)nextChunk * IO_CHUNK_SIZE;
+        size_t chunk = length - offset < IO_CHUNK_SIZE ? (size_t)(length - offset) : IO_CHUNK_SIZE;
+        ring.slots[i] = (IOSlot){SLOT_READING, offset, chunk, nextChunk};
+        uringQueue(i, IORING_OP_READ, fd, chunk, offset);
+        active++;
+    }
+
+    while (active > 0)
+    {
+        int i, res;
+        if (uringWait(&i, &res) != 0)
+        {
+            return -1;
+        }
+        IOSlot *slot = &ring.slots[i];
+        active--;
+
+        if (res < 0 && savedErrno == 0)
+        {
+            savedErrno = -res;
+        }
+        if (savedErrno != 0 || stopped)
+        {
+            slot->state = SLOT_IDLE;
+            continue;
+        }
+
+        ssize_t have = preadRest(fd, ring.buffers[i], (size_t)res, slot->length, slot->offset);
+        if (have < 0)
+        {
+            savedErrno = errno;
+            slot->state = SLOT_IDLE;
+            continue;
+        }
+        slot->length = (size_t)have;
+        slot->state = SLOT_READY;
+
+        // Hand completed chunks to the consumer strictly in file order.
+        for (;;)
+        {
+            int ready = (int)(deliverChunk % IO_QUEUE_DEPTH);
+            IOSlot *next = &ring.slots[ready];
+            if (next->state != SLOT_READY || next->chunk != deliverChunk || stopped)
+            {
+                break;
+            }
+
+            if (next->length > 0 && consumer(ring.buffers[ready], next->length, ctx) != 0)
+            {
+                stopped = true;
+            }
+            next->state = SLOT_IDLE;
+            deliverChunk++;
+
+            if (!stopped && nextChunk < chunks)
+            {
+                off_t offset = (off_t)nextChunk * IO_CHUNK_SIZE;
+                size_t chunk = length - offset < IO_CHUNK_SIZE ? (size_t)(length - offset) : IO_CHUNK_SIZE;
+                *next = (IOSlot){SLOT_READING, offset, chunk, nextChunk};
+                uringQueue(ready, IORING_OP_READ, fd, chunk, offset);
+                nextChunk++;
+                active++;
+            }
+        }
+    }
+
+    if (savedErrno != 0)
+    {
+        errno = savedErrno;
+        return -1;
+    }
+    return 0;
+}
+
+static const IOBackend uringBackend = {"io_uring", uringCopy, uringScan};
+
+static void chooseBackend(void)
+{
+    const char *choice = getenv("MYSHELL_IO");
+    if ((choice == NULL || strcmp(choice, "blocking") != 0) && uringSetup() == 0)
+    {
+        activeBackend = &uringBackend;
+    }
+    else
+    {
+        activeBackend = &blockingBackend;
+    }
+}
+
+const IOBackend *ioBackend(void)
+{
+    pthread_once(&backendOnce, chooseBackend);
+    return activeBackend;
+}
+
+static bool isRegularFile(int fd, off_t *length)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+    *length = st.st_size;
+    return true;
+}
+
+/* Reserves the blocks of one data extent up front so the destination is laid out
+   contiguously. File systems without fallocate simply allocate as they write. */
+static int preallocate(int fd, off_t offset, off_t length)
+{
+    if (fallocate(fd, 0, offset, length) == 0 || errno == EOPNOTSUPP || errno == ENOSYS)
+    {
+        return 0;
+    }
+    return -1;
+}
+
+/* Where `ioCopyScan` sends the data it copies, in file order. */
+typedef struct
+{
+    IOConsumer consumer;
+    void *ctx;
+    char *buffer;
+} CopyObserver;
+
+/* Passes `length` zero bytes, the content of a hole, to the observer. */
+static int observeHole(CopyObserver *observer, off_t length)
+{
+    memset(observer->buffer, 0, IO_CHUNK_SIZE);
+    while (length > 0)
+    {
+        size_t chunk = length > IO_CHUNK_SIZE ? IO_CHUNK_SIZE : (size_t)length;
+        if (observer->consumer(observer->buffer, chunk, observer->ctx) != 0)
+        {
+            errno = ECANCELED;
+            return -1;
+        }
+        length -= (off_t)chunk;
+    }
+    return 0;
+}
+
+/* Passes a window that was just copied to the observer. Its pages are still in the
+   page cache, so this costs a memory copy and no device I/O. */
+static int observeCopied(CopyObserver *observer, int fd, off_t offset, off_t length)
+{
+    while (length > 0)
+    {
+        size_t wanted = length > IO_CHUNK_SIZE ? IO_CHUNK_SIZE : (size_t)length;
+        ssize_t got = preadRest(fd, observer->buffer, 0, wanted, offset);
+        if (got <= 0)
+        {
+            if (got == 0)
+            {
+                errno = EIO;
+            }
+            return -1;
+        }
+        if (observer->consumer(observer->buffer, (size_t)got, observer->ctx) != 0)
+        {
+            errno = ECANCELED;
+            return -1;
+        }
+        offset += got;
+        length -= got;
+    }
+    return 0;
+}
+
+/* Copies one data extent. Large copies go in IO_CACHE_WINDOW steps: each written
+   window is flushed and both files' pages for it are dropped, so a big copy streams
+   through the page cache instead of evicting everything else from it. With an
+   observer every window is handed over before its pages are dropped. */
+static int copyExtent(const IOBackend *backend, int sourceFd, int destinationFd, off_t offset, off_t length,
+                      bool dropCache, CopyObserver *observer)
+{
+    off_t end = offset + length;
+    bool windowed = dropCache || observer != NULL;
+    while (offset < end)
+    {
+        off_t window = windowed && end - offset > IO_CACHE_WINDOW ? IO_CACHE_WINDOW : end - offset;
+        if (backend->copy(sourceFd, destinationFd, offset, window) != 0 ||
+            (observer != NULL && observeCopied(observer, sourceFd, offset, window) != 0))
+        {
+            return -1;
+        }
+        if (dropCache)
+        {
+            // Dirty pages cannot be dropped, so write the window back first.
+            sync_file_range(destinationFd, offset, window,
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(destinationFd, offset, window, POSIX_FADV_DONTNEED);
+            posix_fadvise(sourceFd, offset, window, POSIX_FADV_DONTNEED);
+        }
+        offset += window;
+    }
+    return 0;
+}
+
+/* Copies a regular file into an empty regular file extent by extent. Holes found
+   with SEEK_DATA/SEEK_HOLE are skipped and recreated by sizing the destination, so
+   a sparse image stays sparse and only its data is read and written. */
+static int sparseCopy(const IOBackend *backend, int sourceFd, int destinationFd, off_t length,
+                      CopyObserver *observer)
+{
+    if (ftruncate(destinationFd, length) != 0)
+    {
+        return -1;
+    }
+    bool dropCache = length >= IO_DROP_CACHE_SIZE;
+
+    off_t position = 0;
+    while (position < length)
+    {
+        off_t dataStart = lseek(sourceFd, position, SEEK_DATA);
+        off_t dataEnd;
+        if (dataStart < 0)
+        {
+            if (errno == ENXIO)
+            {
+                // Only a hole is left.
+                break;
+            }
+            if (errno != EINVAL || position != 0)
+            {
+                return -1;
+            }
+            // The file system cannot report holes: copy everything.
+            dataStart = 0;
+            dataEnd = length;
+        }
+        else
+        {
+            dataEnd = lseek(sourceFd, dataStart, SEEK_HOLE);
+            if (dataEnd < 0 || dataEnd > length)
+            {
+                dataEnd = length;
+            }
+        }
+        if (dataStart >= length)
+        {
+            break;
+        }
+
+        if ((observer != NULL && observeHole(observer, dataStart - position) != 0) ||
+            preallocate(destinationFd, dataStart, dataEnd - dataStart) != 0 ||
+            copyExtent(backend, sourceFd, destinationFd, dataStart, dataEnd - dataStart, dropCache, observer) != 0)
+        {
+            return -1;
+        }
+        position = dataEnd;
+    }
+    return observer != NULL ? observeHole(observer, length - position) : 0;
+}
+
+/* Streams a source that is not a regular file: every chunk read is written out and
+   then handed to the observer. */
+typedef struct
+{
+    int destinationFd;
+    CopyObserver *observer;
+    bool failed;
+} StreamCopy;
+
+static int streamCopyChunk(const char *data, size_t length, void *ctx)
+{
+    StreamCopy *copy = ctx;
+    if (ioWriteAll(copy->destinationFd, data, length) != 0 ||
+        copy->observer->consumer(data, length, copy->observer->ctx) != 0)
+    {
+        copy->failed = true;
+        return 1;
+    }
+    return 0;
+}
+
+static int copyObserved(int sourceFd, int destinationFd, CopyObserver *observer)
+{
+    off_t length;
+    off_t destinationLength;
+    if (!isRegularFile(sourceFd, &length) || !isRegularFile(destinationFd, &destinationLength))
+    {
+        if (observer == NULL)
+        {
+            return blockingBackend.copy(sourceFd, destinationFd, 0, -1);
+        }
+        StreamCopy copy = {destinationFd, observer, false};
+        int result = blockingBackend.scan(sourceFd, 0, streamCopyChunk, &copy);
+        return result == 0 && copy.failed ? -1 : result;
+    }
+    posix_fadvise(sourceFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // The ring has one set of buffers; a second job or pipeline stage running
+    // meanwhile uses blocking I/O.
+    const IOBackend *backend = ioBackend();
+    if (backend == &uringBackend && __atomic_exchange_n(&ring.busy, true, __ATOMIC_ACQUIRE))
+    {
+        backend = &blockingBackend;
+    }
+    // Skipping holes is only correct when the destination has no old data under them.
+    int result = destinationLength == 0 ? sparseCopy(backend, sourceFd, destinationFd, length, observer)
+                                        : copyExtent(backend, sourceFd, destinationFd, 0, length, false, observer);
+    if (backend == &uringBackend)
+    {
+        __atomic_store_n(&ring.busy, false, __ATOMIC_RELEASE);
+    }
+    return result;
+}
+
+int ioCopy(int sourceFd, int destinationFd)
+{
+    return copyObserved(sourceFd, destinationFd, NULL);
+}
+
+int ioCopyScan(int sourceFd, int destinationFd, IOConsumer consumer, void *ctx)
+{
+    CopyObserver observer = {consumer, ctx, malloc(IO_CHUNK_SIZE)};
+    if (observer.buffer == NULL)
+    {
+        return -1;
+    }
+    int result = copyObserved(sourceFd, destinationFd, &observer);
+    int savedErrno = errno;
+    free(observer.buffer);
+    errno = savedErrno;
+    return result;
+}
+
+int ioScan(int fd, IOConsumer consumer, void *ctx)
+{
+    off_t length;
+    if (!isRegularFile(fd, &length))
+    {
+        return blockingBackend.scan(fd, 0, consumer, ctx);
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const IOBackend *backend = ioBackend();
+    if (backend == &uringBackend && __atomic_exchange_n(&ring.busy, true, __ATOMIC_ACQUIRE))
+    {
+        backend = &blockingBackend;
+    }
+    int result = backend->scan(fd, length, consumer, ctx);
+    if (backend == &uringBackend)
+    {
+        __atomic_store_n(&ring.busy, false, __ATOMIC_RELEASE);
+    }
+    return result;
+}
@@ -0,0 +1,147 @@
+#ifndef MYIO_H
+#define MYIO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define IO_CHUNK_SIZE (256 * 1024)
+#define IO_QUEUE_DEPTH 8
+/** Copies of at least this size drop their pages from the page cache as they go. */
+#define IO_DROP_CACHE_SIZE (64 * 1024 * 1024)
+/** Amount copied between page cache flushes in such copies. */
+#define IO_CACHE_WINDOW (8 * 1024 * 1024)
+
+/**
+ * Callback used by `ioScan` to hand file data to a builtin. Chunks are always
+ * delivered in file order, so a consumer can keep state (for example "the previous
+ * chunk ended inside a word") across calls.
+ *
+ * @param data Pointer to the chunk. Only valid for the duration of the call.
+ * @param length Number of bytes in the chunk.
+ * @param ctx The context pointer passed to `ioScan`.
+ * @return 0 to continue scanning, non-zero to stop early.
+ */
+typedef int (*IOConsumer)(const char *data, size_t length, void *ctx);
+
+/**
+ * A file I/O backend. Builtins never talk to the kernel directly for bulk file
+ * I/O; they call the `io*` wrappers below, which dispatch to the backend selected
+ * at first use.
+ *
+ * Two backends exist:
+ * - "io_uring": keeps up to IO_QUEUE_DEPTH reads and writes of IO_CHUNK_SIZE bytes
+ *   in flight against buffers registered with the kernel, so large copies and scans
+ *   are limited by device bandwidth rather than by the latency of each request.
+ * - "blocking": plain `read`/`write` loops, used on kernels without io_uring, for
+ *   non-regular files such as pipes and terminals, or when the environment variable
+ *   MYSHELL_IO is set to "blocking".
+ */
+typedef struct
+{
+    const char *name;
+    /* Copies `length` bytes at `offset` of the source to the same offset of the
+       destination; a negative length streams from the current positions to EOF. */
+    int (*copy)(int sourceFd, int destinationFd, off_t offset, off_t length);
+    int (*scan)(int fd, off_t length, IOConsumer consumer, void *ctx);
+} IOBackend;
+
+/**
+ * Returns the active I/O backend, choosing it on the first call. io_uring is used
+ * when the kernel supports it and MYSHELL_IO is not set to "blocking".
+ *
+ * @return A pointer to the active backend. Never NULL.
+ */
+const IOBackend *ioBackend(void);
+
+/**
+ * Copies the whole content of `sourceFd` to `destinationFd`, starting at offset 0
+ * of both. Regular files are copied with positioned I/O; other file types are
+ * streamed with the blocking backend.
+ *
+ * When the destination is an empty regular file, only the data extents of the
+ * source are copied: holes found with SEEK_DATA/SEEK_HOLE are recreated by setting
+ * the destination's size, so sparse files stay sparse. Each extent is preallocated
+ * with `fallocate` before it is written, and copies of IO_DROP_CACHE_SIZE bytes or
+ * more flush and drop their pages every IO_CACHE_WINDOW bytes so they do not push
+ * other data out of the page cache.
+ *
+ * Usage example:
+ *   int in = open("a.bin", O_RDONLY), out = open("b.bin", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+ *   if (ioCopy(in, out) != 0)
+ *       perror("copy");
+ *
+ * @param sourceFd Descriptor opened for reading.
+ * @param destinationFd Descriptor opened for writing.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int ioCopy(int sourceFd, int destinationFd);
+
+/**
+ * Copies like `ioCopy`, with the same sparse, preallocated and cache-dropping path,
+ * and hands every byte of the source to `consumer` in file order, as `ioScan` would:
+ * data extents as they are copied, read back while their pages are still cached,
+ * and holes as runs of zeros, without reading them. Used to hash a file while it is
+ * copied.
+ *
+ * Usage example:
+ *   HashState state;
+ *   hashInit(&state);
+ *   if (ioCopyScan(in, out, hashChunk, &state) == 0)
+ *       printf("%016llx\n", (unsigned long long)hashDigest(&state));
+ *
+ * @param sourceFd Descriptor opened for reading.
+ * @param destinationFd Descriptor opened for writing.
+ * @param consumer Callback receiving the content in order. Returning non-zero
+ *                 aborts the copy with errno set to ECANCELED.
+ * @param ctx Opaque pointer passed through to `consumer`.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int ioCopyScan(int sourceFd, int destinationFd, IOConsumer consumer, void *ctx);
+
+/**
+ * Reads `fd` from the start to the end of file and passes the data to `consumer`
+ * chunk by chunk, in order.
+ *
+ * Usage example:
+ *   static int printChunk(const char *data, size_t length, void *ctx)
+ *   {
+ *       fwrite(data, 1, length, stdout);
+ *       return 0;
+ *   }
+ *   ioScan(fd, printChunk, NULL);
+ *
+ * @param fd Descriptor opened for reading.
+ * @param consumer Callback receiving each chunk.
+ * @param ctx Opaque pointer passed through to `consumer`.
+ * @return 0 on success or when the consumer stopped early, -1 on read error.
+ */
+int ioScan(int fd, IOConsumer consumer, void *ctx);
+
+/**
+ * Writes all `length` bytes of `data` to `fd`, retrying on short writes and EINTR.
+ *
+ * @param fd Descriptor opened for writing.
+ * @param data The bytes to write.
+ * @param length Number of bytes to write.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int ioWriteAll(int fd, const void *data, size_t length);
+
+/**
+ * Writes every buffer of `iov` to `fd` with `writev`, in order, retrying on short
+ * writes and EINTR. On a file opened with O_APPEND each `writev` call lands in one
+ * piece at the end of the file.
+ *
+ * Usage example:
+ *   struct iovec parts[2] = {{header, headerLength}, {body, bodyLength}};
+ *   ioWritevAll(fd, parts, 2);
+ *
+ * @param fd Descriptor opened for writing.
+ * @param iov The buffers. Modified as data is written.
+ * @param count Number of buffers.
+ * @return 0 on success, -1 on error with errno set.
+ */
+int ioWritevAll(int fd, struct iovec *iov, int count);
+
+#endif // MYIO_H
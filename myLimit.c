@@ -0,0 +1,317 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "myLimit.h"
+
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+
+#define LIMIT_USAGE "Usage: limit [-c cpus] [-n nice] [-i class[:level]] [-m MiB] [-t seconds] " \
+                    "[-g cgroup [-q percent] [-M MiB]] [-r] command [args ...]\n"
+
+/* Parses a whole non-negative decimal number. */
+static bool parseCount(const char *text, unsigned long long *value)
+{
+    char *end;
+    errno = 0;
+    *value = strtoull(text, &end, 10);
+    return text[0] >= '0' && text[0] <= '9' && *end == '\0' && errno == 0;
+}
+
+/* Parses a CPU list such as "0-3,6" into the affinity mask. */
+static bool parseCpuList(const char *text, ResourceLimits *limits)
+{
+    memset(limits->cpus, 0, sizeof(limits->cpus));
+    while (*text != '\0')
+    {
+        char *end;
+        unsigned long first = strtoul(text, &end, 10), last = first;
+        if (end == text)
+        {
+            return false;
+        }
+        if (*end == '-')
+        {
+            text = end + 1;
+            last = strtoul(text, &end, 10);
+            if (end == text)
+            {
+                return false;
+            }
+        }
+        if (first > last || last >= LIMIT_MAX_CPUS || (*end != ',' && *end != '\0'))
+        {
+            return false;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+        {
+            limits->cpus[cpu / 64] |= 1ULL << (cpu % 64);
+        }
+        text = *end == ',' ? end + 1 : end;
+    }
+    limits->affinity = true;
+    return true;
+}
+
+/* Tells whether the first `length` bytes of `text` are exactly `word`. */
+static bool isWord(const char *text, size_t length, const char *word)
+{
+    return strlen(word) == length && strncmp(text, word, length) == 0;
+}
+
+static bool parseIoClass(const char *text, ResourceLimits *limits)
+{
+    const char *colon = strchr(text, ':');
+    size_t length = colon != NULL ? (size_t)(colon - text) : strlen(text);
+    if (isWord(text, length, "rt") || isWord(text, length, "realtime"))
+    {
+        limits->ioClass = 1;
+    }
+    else if (isWord(text, length, "be") || isWord(text, length, "best-effort"))
+    {
+        limits->ioClass = 2;
+    }
+    else if (isWord(text, length, "idle"))
+    {
+        limits->ioClass = 3;
+    }
+    else
+    {
+        return false;
+    }
+    // The kernel's default best-effort level.
+    limits->ioLevel = 4;
+    unsigned long long level;
+    if (colon != NULL && (!parseCount(colon + 1, &level) || level > 7))
+    {
+        return false;
+    }
+    if (colon != NULL)
+    {
+        limits->ioLevel = (int)level;
+    }
+    return true;
+}
+
+int limitParse(char **args, ResourceLimits *limits, char ***command)
+{
+    memset(limits, 0, sizeof(*limits));
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i += 2)
+    {
+        const char *option = args[i];
+        const char *value = args[i + 1];
+        unsigned long long number = 0;
+        bool valid = true;
+        if (strcmp(option, "--") == 0)
+        {
+            i++;
+            break;
+        }
+        if (strcmp(option, "-r") == 0)
+        {
+            limits->report = true;
+            i--;
+            continue;
+        }
+        if (value == NULL)
+        {
+            valid = false;
+        }
+        else if (strcmp(option, "-c") == 0)
+        {
+            valid = parseCpuList(value, limits);
+        }
+        else if (strcmp(option, "-n") == 0)
+        {
+            char *end;
+            limits->nice = (int)strtol(value, &end, 10);
+            limits->niceSet = true;
+            valid = end != value && *end == '\0';
+        }
+        else if (strcmp(option, "-i") == 0)
+        {
+            valid = parseIoClass(value, limits);
+        }
+        else if (strcmp(option, "-m") == 0)
+        {
+            valid = parseCount(value, &number) && number > 0;
+            limits->addressSpace = (rlim_t)number * 1024 * 1024;
+        }
+        else if (strcmp(option, "-t") == 0)
+        {
+            valid = parseCount(value, &number) && number > 0;
+            limits->cpuSeconds = (rlim_t)number;
+        }
+        else if (strcmp(option, "-g") == 0)
+        {
+            limits->cgroup = value;
+        }
+        else if (strcmp(option, "-q") == 0)
+        {
+            valid = parseCount(value, &number) && number > 0 && number <= 100 * LIMIT_MAX_CPUS;
+            limits->cpuPercent = (int)number;
+        }
+        else if (strcmp(option, "-M") == 0)
+        {
+            valid = parseCount(value, &number) && number > 0;
+            limits->memoryMax = number * 1024 * 1024;
+        }
+        else
+        {
+            valid = false;
+        }
+        if (!valid)
+        {
+            fprintf(stderr, LIMIT_USAGE);
+            return 2;
+        }
+    }
+    // Throttling is a property of a group, so it needs one.
+    if (args[i] == NULL || ((limits->cpuPercent != 0 || limits->memoryMax != 0) && limits->cgroup == NULL))
+    {
+        fprintf(stderr, LIMIT_USAGE);
+        return 2;
+    }
+    *command = args + i;
+    return 0;
+}
+
+/* Writes a value to one of a group's control files, printing the path on failure. */
+static int writeControl(const char *group, const char *file, const char *value)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", group, file);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    ssize_t written = fd != -1 ? write(fd, value, strlen(value)) : -1;
+    if (written != (ssize_t)strlen(value))
+    {
+        perror(path);
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    return written == (ssize_t)strlen(value) ? 0 : -1;
+}
+
+static int joinCgroup(const ResourceLimits *limits)
+{
+    char group[PATH_MAX], value[64];
+    if (limits->cgroup[0] == '/')
+    {
+        snprintf(group, sizeof(group), "%s", limits->cgroup);
+    }
+    else
+    {
+        snprintf(group, sizeof(group), "%s/%s", LIMIT_CGROUP_ROOT, limits->cgroup);
+    }
+    if (mkdir(group, 0755) != 0 && errno != EEXIST)
+    {
+        perror(group);
+        return -1;
+    }
+    if (limits->cpuPercent != 0)
+    {
+        snprintf(value, sizeof(value), "%d %d", limits->cpuPercent * (LIMIT_CPU_PERIOD / 100), LIMIT_CPU_PERIOD);
+        if (writeControl(group, "cpu.max", value) != 0)
+        {
+            return -1;
+        }
+    }
+    if (limits->memoryMax != 0)
+    {
+        snprintf(value, sizeof(value), "%llu", limits->memoryMax);
+        if (writeControl(group, "memory.max", value) != 0)
+        {
+            return -1;
+        }
+    }
+    snprintf(value, sizeof(value), "%d", (int)getpid());
+    if (writeControl(group, "cgroup.procs", value) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int limitApply(const ResourceLimits *limits)
+{
+    if (limits->cgroup != NULL && joinCgroup(limits) != 0)
+    {
+        return -1;
+    }
+    if (limits->affinity)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < LIMIT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+        {
+            if (limits->cpus[cpu / 64] & (1ULL << (cpu % 64)))
+            {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+        {
+            perror("limit: sched_setaffinity");
+            return -1;
+        }
+    }
+    if (limits->niceSet)
+    {
+        // nice() may legitimately return -1, so only errno tells of a failure.
+        errno = 0;
+        if (nice(limits->nice) == -1 && errno != 0)
+        {
+            perror("limit: nice");
+            return -1;
+        }
+    }
+    if (limits->ioClass != 0 &&
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, (limits->ioClass << IOPRIO_CLASS_SHIFT) | limits->ioLevel) != 0)
+    {
+        perror("limit: ioprio_set");
+        return -1;
+    }
+    struct rlimit limit;
+    if (limits->addressSpace != 0)
+    {
+        limit = (struct rlimit){limits->addressSpace, limits->addressSpace};
+        if (setrlimit(RLIMIT_AS, &limit) != 0)
+        {
+            perror("limit: RLIMIT_AS");
+            return -1;
+        }
+    }
+    if (limits->cpuSeconds != 0)
+    {
+        // SIGXCPU at the soft limit, SIGKILL a second later if it is ignored.
+        limit = (struct rlimit){limits->cpuSeconds, limits->cpuSeconds + 1};
+        if (setrlimit(RLIMIT_CPU, &limit) != 0)
+        {
+            perror("limit: RLIMIT_CPU");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void limitReport(const char *name, int status, const struct rusage *usage, FILE *out)
+{
+    fprintf(out,
+            "limit: %s: status %d, user %ld.%03lds, sys %ld.%03lds, max rss %ld KiB, %ld major faults, "
+            "%ld/%ld blocks in/out, %ld/%ld voluntary/involuntary switches\n",
+            name, status, (long)usage->ru_utime.tv_sec, (long)usage->ru_utime.tv_usec / 1000,
+            (long)usage->ru_stime.tv_sec, (long)usage->ru_stime.tv_usec / 1000, usage->ru_maxrss, usage->ru_majflt,
+            usage->ru_inblock, usage->ru_oublock, usage->ru_nvcsw, usage->ru_nivcsw);
+}
@@ -0,0 +1,90 @@
+#ifndef MYLIMIT_H
+#define MYLIMIT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/resource.h>
+
+/** CPUs that `limit -c` can name. */
+#define LIMIT_MAX_CPUS 1024
+/** Where relative cgroup paths given to `limit -g` live. */
+#define LIMIT_CGROUP_ROOT "/sys/fs/cgroup"
+/** cgroup v2 CPU period, in microseconds, that `limit -q` quotas are a share of. */
+#define LIMIT_CPU_PERIOD 100000
+
+/**
+ * What `limit` applies to a command before it starts. Fields left at zero (or
+ * false) leave the inherited setting alone.
+ */
+typedef struct
+{
+    bool affinity;
+    uint64_t cpus[LIMIT_MAX_CPUS / 64];
+    bool niceSet;
+    int nice;
+    int ioClass;
+    int ioLevel;
+    rlim_t addressSpace;
+    rlim_t cpuSeconds;
+    const char *cgroup;
+    int cpuPercent;
+    unsigned long long memoryMax;
+    bool report;
+} ResourceLimits;
+
+/**
+ * Parses the options of a `limit` command line:
+ *
+ *   -c LIST          run only on these CPUs, e.g. "0-3,6" (sched_setaffinity)
+ *   -n N             add N to the niceness, like `nice -n`
+ *   -i CLASS[:LEVEL] I/O scheduling class: idle, be (best-effort) or rt, with a
+ *                    level from 0 (highest) to 7, like `ionice`
+ *   -m MiB           cap the address space (RLIMIT_AS)
+ *   -t SECONDS       cap the CPU time (RLIMIT_CPU)
+ *   -g CGROUP        move the command into a cgroup v2 group, created if missing;
+ *                    a relative path is under LIMIT_CGROUP_ROOT
+ *   -q PERCENT       with -g, throttle the group to this share of one CPU (cpu.max)
+ *   -M MiB           with -g, cap the memory of the group (memory.max)
+ *   -r               report what the command consumed when it exits
+ *
+ * The command starts at the first argument that is not an option, or after "--".
+ * Prints a usage message to stderr when the options are invalid.
+ *
+ * Usage example:
+ *   ResourceLimits limits;
+ *   char **command;
+ *   char *args[] = {"limit", "-n", "10", "-r", "gzip", "big.log", NULL};
+ *   if (limitParse(args, &limits, &command) == 0)
+ *       execvp(command[0], command);   // after limitApply in the child
+ *
+ * @param args "limit", options and the command, NULL-terminated.
+ * @param limits Receives the parsed limits.
+ * @param command Receives a pointer to the command's arguments within `args`.
+ * @return 0 on success, 2 on a usage error.
+ */
+int limitParse(char **args, ResourceLimits *limits, char ***command);
+
+/**
+ * Applies limits to the calling process, meant for a child between fork and exec so
+ * that the command and everything it starts inherit them. The cgroup is joined
+ * first, so the throttling covers the whole life of the command.
+ *
+ * @param limits The limits from `limitParse`.
+ * @return 0 on success, -1 after printing to stderr which limit could not be set.
+ */
+int limitApply(const ResourceLimits *limits);
+
+/**
+ * Prints one line describing the resources an exited command used, from the
+ * `rusage` that `wait4` returned for it: CPU time, peak memory, faults, block I/O
+ * and context switches.
+ *
+ * @param name The command.
+ * @param status Its exit status.
+ * @param usage Its resource usage.
+ * @param out The stream to print to.
+ */
+void limitReport(const char *name, int status, const struct rusage *usage, FILE *out);
+
+#endif // MYLIMIT_H
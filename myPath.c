@@ -0,0 +1,641 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "myPath.h"
+#include "myArena.h"
+#include "myVars.h"
+
+typedef struct
+{
+    char *input;
+    char *canonical;
+    const char *name;
+    uint64_t inputHash;
+    uint64_t cwdHash;
+    int flags;
+    int parentFd;
+    int users;
+    bool stale;
+    bool temporary;
+    unsigned long lastUsed;
+} PathEntry;
+
+static PathEntry cache[PATH_CACHE_SIZE];
+static unsigned long useClock = 0;
+static pthread_mutex_t pathLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int heldCwdFd = -1;
+static char *cwdPath = NULL;
+static size_t cwdLength = 0;
+static uint64_t cwdHash = 0;
+
+static uint64_t hashString(const char *str)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (; *str; str++)
+    {
+        hash ^= (unsigned char)*str;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void setCwd(int fd, char *path)
+{
+    if (heldCwdFd != -1)
+    {
+        close(heldCwdFd);
+    }
+    free(cwdPath);
+    heldCwdFd = fd;
+    cwdPath = path;
+    cwdLength = strlen(path);
+    cwdHash = hashString(path);
+}
+
+/* Opens the working directory the first time it is needed. $PWD is preferred over
+   getcwd when it names the same directory, so a logical path survives startup.
+   Called with pathLock held. */
+static int ensureCwd(void)
+{
+    if (heldCwdFd != -1)
+    {
+        return 0;
+    }
+
+    int fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    char *path = NULL;
+    const char *pwd = getenv("PWD");
+    struct stat pwdStat, dotStat;
+    if (pwd != NULL && pwd[0] == '/' && stat(pwd, &pwdStat) == 0 && fstat(fd, &dotStat) == 0 &&
+        pwdStat.st_dev == dotStat.st_dev && pwdStat.st_ino == dotStat.st_ino)
+    {
+        path = strdup(pwd);
+    }
+    else
+    {
+        path = getcwd(NULL, 0);
+    }
+    if (path == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+    setCwd(fd, path);
+    return 0;
+}
+
+/* Rewrites an absolute path in place, dropping empty and `.` components. When
+   `logical`, `..` removes the component before it; otherwise it is kept for the
+   kernel, which goes to the parent of wherever a symbolic link led. The result never
+   grows. */
+static void collapseComponents(char *path, bool logical)
+{
+    char *out = path;
+    const char *in = path;
+
+    while (*in != '\0')
+    {
+        while (*in == '/')
+        {
+            in++;
+        }
+        if (*in == '\0')
+        {
+            break;
+        }
+
+        const char *end = in;
+        while (*end != '\0' && *end != '/')
+        {
+            end++;
+        }
+        size_t length = end - in;
+
+        if (logical && length == 2 && in[0] == '.' && in[1] == '.')
+        {
+            while (out > path && *--out != '/')
+            {
+            }
+        }
+        else if (!(length == 1 && in[0] == '.'))
+        {
+            *out++ = '/';
+            memmove(out, in, length);
+            out += length;
+        }
+        in = end;
+    }
+
+    if (out == path)
+    {
+        *out++ = '/';
+    }
+    *out = '\0';
+}
+
+/* Called with pathLock held, since getpwnam is not reentrant. */
+static char *lexicalPath(const char *path, bool logical)
+{
+    const char *prefix = "";
+    const char *rest = path;
+    char *home = NULL;
+
+    if (path[0] == '~')
+    {
+        const char *slash = strchr(path, '/');
+        size_t userLength = slash != NULL ? (size_t)(slash - path - 1) : strlen(path) - 1;
+        if (userLength == 0)
+        {
+            home = varDup("HOME");
+            prefix = home;
+            if (prefix == NULL)
+            {
+                struct passwd *pw = getpwuid(getuid());
+                prefix = pw != NULL ? pw->pw_dir : "/";
+            }
+        }
+        else
+        {
+            char user[LOGIN_NAME_MAX];
+            struct passwd *pw = NULL;
+            if (userLength < sizeof(user))
+            {
+                memcpy(user, path + 1, userLength);
+                user[userLength] = '\0';
+                pw = getpwnam(user);
+            }
+            if (pw == NULL)
+            {
+                errno = ENOENT;
+                return NULL;
+            }
+            prefix = pw->pw_dir;
+        }
+        rest = slash != NULL ? slash : "";
+    }
+    else if (path[0] != '/')
+    {
+        prefix = cwdPath;
+    }
+
+    size_t size = strlen(prefix) + strlen(rest) + 2;
+    char *joined = poolAlloc(size);
+    if (joined != NULL)
+    {
+        snprintf(joined, size, "%s/%s", prefix, rest);
+        collapseComponents(joined, logical);
+    }
+    poolFree(home);
+    return joined;
+}
+
+/* Resolves symbolic links in the longest existing prefix of a lexical path and
+   appends the components that do not exist yet. Consumes `lexical`. */
+static char *physicalPath(char *lexical)
+{
+    char *probe = poolStrdup(lexical);
+    if (probe == NULL)
+    {
+        poolFree(lexical);
+        return NULL;
+    }
+
+    size_t prefixLength = strlen(probe);
+    char *resolved;
+    while ((resolved = realpath(probe, NULL)) == NULL)
+    {
+        char *slash = strrchr(probe, '/');
+        if ((errno != ENOENT && errno != ENOTDIR) || slash == NULL || prefixLength <= 1)
+        {
+            int saved = errno;
+            poolFree(probe);
+            poolFree(lexical);
+            errno = saved;
+            return NULL;
+        }
+        prefixLength = slash == probe ? 1 : (size_t)(slash - probe);
+        probe[prefixLength] = '\0';
+    }
+
+    const char *rest = lexical + prefixLength;
+    while (*rest == '/')
+    {
+        rest++;
+    }
+    size_t resolvedLength = strlen(resolved);
+    bool needSlash = *rest != '\0' && resolved[resolvedLength - 1] != '/';
+    size_t size = resolvedLength + strlen(rest) + 2;
+    char *result = poolAlloc(size);
+    if (result != NULL)
+    {
+        snprintf(result, size, "%s%s%s", resolved, needSlash ? "/" : "", rest);
+    }
+    free(resolved);
+    poolFree(probe);
+    poolFree(lexical);
+    return result;
+}
+
+static void clearEntry(PathEntry *entry)
+{
+    if (entry->parentFd != -1)
+    {
+        close(entry->parentFd);
+    }
+    poolFree(entry->input);
+    poolFree(entry->canonical);
+    memset(entry, 0, sizeof(*entry));
+    entry->parentFd = -1;
+}
+
+/* Returns the directory holding the entry's last component, in pool memory. */
+static char *parentPath(const PathEntry *entry)
+{
+    size_t parentLength = 1;
+    if (strcmp(entry->canonical, "/") != 0 && entry->name - entry->canonical > 1)
+    {
+        parentLength = entry->name - entry->canonical - 1;
+    }
+
+    char *parent = poolAlloc(parentLength + 1);
+    if (parent == NULL)
+    {
+        return NULL;
+    }
+    memcpy(parent, entry->canonical, parentLength);
+    parent[parentLength] = '\0';
+    return parent;
+}
+
+/* Tells how to reach a directory: relative to the held working-directory descriptor
+   when it lies inside the working directory, so that it is never walked from the
+   root, or by its absolute path. Returns the base descriptor and sets `*relative`;
+   returns -1 when the directory is the working directory itself. Called with
+   pathLock held. */
+static int parentBase(const char *parent, const char **relative)
+{
+    if (strcmp(parent, cwdPath) == 0)
+    {
+        *relative = ".";
+        return -1;
+    }
+    if (cwdLength == 1 && parent[0] == '/')
+    {
+        *relative = parent + 1;
+        return heldCwdFd;
+    }
+    if (strncmp(parent, cwdPath, cwdLength) == 0 && parent[cwdLength] == '/')
+    {
+        *relative = parent + cwdLength + 1;
+        return heldCwdFd;
+    }
+    *relative = parent;
+    return AT_FDCWD;
+}
+
+/* Opens the directory holding the entry's last component. Called with pathLock
+   held. */
+static int openParent(PathEntry *entry)
+{
+    char *parent = parentPath(entry);
+    if (parent == NULL)
+    {
+        return -1;
+    }
+    const char *relative;
+    int base = parentBase(parent, &relative);
+    int fd = base == -1 ? fcntl(heldCwdFd, F_DUPFD_CLOEXEC, 0) : openat(base, relative, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    poolFree(parent);
+    return fd;
+}
+
+/* Closes every held parent descriptor, keeping the canonical paths; an entry in
+   use is looked up afresh next time instead. Called with pathLock held. */
+static void dropParents(void)
+{
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    {
+        PathEntry *entry = &cache[i];
+        if (entry->input == NULL || entry->parentFd == -1)
+        {
+            continue;
+        }
+        if (entry->users == 0)
+        {
+            close(entry->parentFd);
+            entry->parentFd = -1;
+        }
+        else
+        {
+            entry->stale = true;
+        }
+    }
+}
+
+/* Picks a free slot, or the least recently used one nobody is using right now.
+   Called with pathLock held. */
+static PathEntry *victimEntry(void)
+{
+    PathEntry *victim = NULL;
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    {
+        PathEntry *entry = &cache[i];
+        if (entry->input == NULL)
+        {
+            return entry;
+        }
+        if (entry->users == 0 && (victim == NULL || entry->lastUsed < victim->lastUsed))
+        {
+            victim = entry;
+        }
+    }
+    if (victim != NULL)
+    {
+        clearEntry(victim);
+    }
+    return victim;
+}
+
+/* Looks a path up in the cache, canonicalizing and inserting it on a miss, and pins
+   the entry until `releaseEntry`. With `needParent`, the parent directory is opened
+   too; if that fails the entry still works through its absolute path. */
+static PathEntry *acquireEntry(const char *path, int flags, bool needParent)
+{
+    if (path == NULL || path[0] == '\0')
+    {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pathLock);
+    if (ensureCwd() != 0)
+    {
+        pthread_mutex_unlock(&pathLock);
+        return NULL;
+    }
+
+    uint64_t inputHash = hashString(path);
+    // Relative paths depend on the working directory and `~` paths on $HOME.
+    uint64_t keyCwd = path[0] == '/' ? 0 : cwdHash;
+    if (path[0] == '~')
+    {
+        char *home = varDup("HOME");
+        keyCwd = home != NULL ? hashString(home) : 0;
+        poolFree(home);
+    }
+    PathEntry *entry = NULL;
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    {
+        PathEntry *candidate = &cache[i];
+        if (candidate->input != NULL && !candidate->stale && candidate->inputHash == inputHash &&
+            candidate->cwdHash == keyCwd && candidate->flags == flags && strcmp(candidate->input, path) == 0)
+        {
+            entry = candidate;
+            break;
+        }
+    }
+
+    if (entry == NULL)
+    {
+        char *canonical = lexicalPath(path, !(flags & PATH_KEEP_DOTDOT));
+        if (canonical != NULL && (flags & PATH_RESOLVE_LINKS))
+        {
+            canonical = physicalPath(canonical);
+        }
+        char *input = canonical != NULL ? poolStrdup(path) : NULL;
+        if (input == NULL)
+        {
+            int saved = errno;
+            poolFree(canonical);
+            pthread_mutex_unlock(&pathLock);
+            errno = saved;
+            return NULL;
+        }
+
+        entry = victimEntry();
+        if (entry == NULL)
+        {
+            // Every slot is pinned by another thread; use a one-off entry.
+            entry = poolAlloc(sizeof(PathEntry));
+            if (entry == NULL)
+            {
+                poolFree(canonical);
+                poolFree(input);
+                pthread_mutex_unlock(&pathLock);
+                errno = ENOMEM;
+                return NULL;
+            }
+            memset(entry, 0, sizeof(*entry));
+            entry->temporary = true;
+        }
+
+        entry->input = input;
+        entry->canonical = canonical;
+        entry->inputHash = inputHash;
+        entry->cwdHash = keyCwd;
+        entry->flags = flags;
+        entry->parentFd = -1;
+        entry->name = strcmp(canonical, "/") == 0 ? "." : strrchr(canonical, '/') + 1;
+    }
+
+    if (needParent && entry->parentFd == -1)
+    {
+        entry->parentFd = openParent(entry);
+    }
+    entry->lastUsed = ++useClock;
+    entry->users++;
+    pthread_mutex_unlock(&pathLock);
+    return entry;
+}
+
+static void releaseEntry(PathEntry *entry)
+{
+    int saved = errno;
+    pthread_mutex_lock(&pathLock);
+    entry->users--;
+    if (entry->users == 0 && (entry->stale || entry->temporary))
+    {
+        bool temporary = entry->temporary;
+        clearEntry(entry);
+        if (temporary)
+        {
+            poolFree(entry);
+        }
+    }
+    pthread_mutex_unlock(&pathLock);
+    errno = saved;
+}
+
+static int entryDir(const PathEntry *entry)
+{
+    return entry->parentFd != -1 ? entry->parentFd : AT_FDCWD;
+}
+
+static const char *entryName(const PathEntry *entry)
+{
+    return entry->parentFd != -1 ? entry->name : entry->canonical;
+}
+
+char *canonicalizePath(const char *path, int flags)
+{
+    PathEntry *entry = acquireEntry(path, flags, false);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+    char *copy = poolStrdup(entry->canonical);
+    releaseEntry(entry);
+    return copy;
+}
+
+int pathOpen(const char *path, int flags, mode_t mode)
+{
+    PathEntry *entry = acquireEntry(path, PATH_KEEP_DOTDOT, true);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    int fd = openat(entryDir(entry), entryName(entry), flags, mode);
+    releaseEntry(entry);
+    return fd;
+}
+
+int pathStat(const char *path, struct stat *st)
+{
+    PathEntry *entry = acquireEntry(path, PATH_KEEP_DOTDOT, true);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    int result = fstatat(entryDir(entry), entryName(entry), st, 0);
+    releaseEntry(entry);
+    return result;
+}
+
+int pathAccess(const char *path, int mode)
+{
+    PathEntry *entry = acquireEntry(path, PATH_KEEP_DOTDOT, true);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    int result = faccessat(entryDir(entry), entryName(entry), mode, 0);
+    releaseEntry(entry);
+    return result;
+}
+
+int pathRemove(const char *path)
+{
+    PathEntry *entry = acquireEntry(path, PATH_KEEP_DOTDOT, true);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    int result = unlinkat(entryDir(entry), entryName(entry), 0);
+    if (result != 0 && errno == EISDIR)
+    {
+        result = unlinkat(entryDir(entry), entryName(entry), AT_REMOVEDIR);
+    }
+    releaseEntry(entry);
+    pathCacheInvalidate();
+    return result;
+}
+
+int pathRename(const char *from, const char *to)
+{
+    PathEntry *source = acquireEntry(from, PATH_KEEP_DOTDOT, true);
+    if (source == NULL)
+    {
+        return -1;
+    }
+    PathEntry *destination = acquireEntry(to, PATH_KEEP_DOTDOT, true);
+    if (destination == NULL)
+    {
+        releaseEntry(source);
+        return -1;
+    }
+    int result = renameat(entryDir(source), entryName(source), entryDir(destination), entryName(destination));
+    releaseEntry(destination);
+    releaseEntry(source);
+    pathCacheInvalidate();
+    return result;
+}
+
+int pathChdir(const char *path, int flags)
+{
+    PathEntry *entry = acquireEntry(path, flags, true);
+    if (entry == NULL)
+    {
+        return -1;
+    }
+    int fd = openat(entryDir(entry), entryName(entry), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    char *canonical = fd != -1 ? strdup(entry->canonical) : NULL;
+    releaseEntry(entry);
+
+    if (fd == -1 || canonical == NULL || fchdir(fd) != 0)
+    {
+        int saved = errno;
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        free(canonical);
+        errno = saved;
+        return -1;
+    }
+
+    // Relative entries cached for the old directory keep their key and become
+    // useful again if the shell comes back. Directories may have moved since the
+    // parents were opened, so those are opened again.
+    pthread_mutex_lock(&pathLock);
+    setCwd(fd, canonical);
+    dropParents();
+    pthread_mutex_unlock(&pathLock);
+    return 0;
+}
+
+int cwdFd(void)
+{
+    pthread_mutex_lock(&pathLock);
+    int fd = ensureCwd() == 0 ? heldCwdFd : -1;
+    pthread_mutex_unlock(&pathLock);
+    return fd;
+}
+
+void pathCacheInvalidate(void)
+{
+    pthread_mutex_lock(&pathLock);
+    for (int i = 0; i < PATH_CACHE_SIZE; i++)
+    {
+        PathEntry *entry = &cache[i];
+        if (entry->input == NULL)
+        {
+            continue;
+        }
+        if (entry->users == 0)
+        {
+            clearEntry(entry);
+        }
+        else
+        {
+            entry->stale = true;
+        }
+    }
+    pthread_mutex_unlock(&pathLock);
+}
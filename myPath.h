@@ -0,0 +1,135 @@
+#ifndef MYPATH_H
+#define MYPATH_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define PATH_CACHE_SIZE 64
+
+/** Flag for `canonicalizePath` and `pathChdir`: also resolve symbolic links. */
+#define PATH_RESOLVE_LINKS 1
+/**
+ * Flag for `canonicalizePath`: keep `..` components for the kernel to resolve, so
+ * that `lnk/../file` names the file next to the link's target, as it does for any
+ * other program. Every file operation in this module works this way; only `cd` is
+ * logical.
+ */
+#define PATH_KEEP_DOTDOT 2
+
+/**
+ * Turns a path typed by the user into an absolute canonical path. The lexical pass
+ * expands a leading `~` or `~user`, makes relative paths absolute against the shell's
+ * working directory, collapses repeated slashes and removes `.` and `..` components,
+ * the way a shell's logical `cd` treats them (unless PATH_KEEP_DOTDOT is given). With
+ * PATH_RESOLVE_LINKS, symbolic links
+ * in the existing part of the path are resolved as well; components that do not exist
+ * yet are appended unchanged.
+ *
+ * Results are kept in a small LRU cache keyed on the path, the flags and, for relative
+ * paths, the working directory (for `~` paths, the value of $HOME), so a builtin that
+ * is handed the same path again (or a loop of commands in one directory) does not
+ * repeat the work.
+ *
+ * Usage example:
+ *   char *canonical = canonicalizePath("~/notes/../todo.txt", 0);
+ *   // "/home/user/todo.txt"
+ *   poolFree(canonical);
+ *
+ * @param path The path to canonicalize. Quotes and spaces should already have been
+ *             stripped by `normalizePath`.
+ * @param flags 0, PATH_RESOLVE_LINKS or PATH_KEEP_DOTDOT.
+ * @return The canonical path in pool memory, to be released with `poolFree`, or NULL
+ *         with errno set if the path is empty or a `~user` prefix names no user.
+ */
+char *canonicalizePath(const char *path, int flags);
+
+/**
+ * Opens a file like `open`, but through the cache: the canonical path's parent
+ * directory is opened once and held, and the file is opened with `openat` relative
+ * to it, so repeated operations in a deep directory skip the kernel's walk over every
+ * leading component. Paths directly inside the working directory use the held
+ * working-directory descriptor. A cache hit costs one `openat` and no path walk, so
+ * the held directory is not checked on use: held directories are dropped whenever
+ * the shell did something that may have moved directories, namely an external
+ * command or command substitution, `cd`, `pathRemove`, `pathRename` and any other
+ * call to `pathCacheInvalidate`. A directory that an unrelated process renames
+ * in between is still reached through the descriptor. `..` is resolved by the
+ * kernel, as for any other program.
+ *
+ * Usage example:
+ *   int fd = pathOpen("logs/today.txt", O_WRONLY | O_CREAT | O_APPEND, 0644);
+ *
+ * @param path The file path, relative to the shell's working directory or absolute.
+ * @param flags Flags for `open`.
+ * @param mode Permissions used when the file is created.
+ * @return A file descriptor, or -1 with errno set.
+ */
+int pathOpen(const char *path, int flags, mode_t mode);
+
+/**
+ * `stat` through the path cache.
+ *
+ * @param path The file path.
+ * @param st Receives the file status.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int pathStat(const char *path, struct stat *st);
+
+/**
+ * `access` through the path cache.
+ *
+ * @param path The file path.
+ * @param mode F_OK or a combination of R_OK, W_OK and X_OK.
+ * @return 0 if the check passes, -1 with errno set otherwise.
+ */
+int pathAccess(const char *path, int mode);
+
+/**
+ * Removes a file or an empty directory, like `remove`, through the path cache.
+ * Invalidates the cache, since held directory descriptors may refer to what was
+ * removed.
+ *
+ * @param path The path to remove.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int pathRemove(const char *path);
+
+/**
+ * Renames a file, like `rename`, through the path cache. Invalidates the cache.
+ *
+ * @param from The current path.
+ * @param to The new path.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int pathRename(const char *from, const char *to);
+
+/**
+ * Changes the working directory of the shell. The new directory is opened and held,
+ * the process moves there with `fchdir`, and the canonical path becomes the new key
+ * for relative paths in the cache. Held parent directories are closed and opened
+ * again on their next use.
+ *
+ * @param path The directory to change to.
+ * @param flags 0 for a logical change (`..` removes the last component typed) or
+ *              PATH_RESOLVE_LINKS for a physical one.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+int pathChdir(const char *path, int flags);
+
+/**
+ * Returns the held descriptor of the shell's working directory, opened with O_PATH.
+ * It stays owned by the path module.
+ *
+ * @return The descriptor, or -1 if the working directory cannot be opened.
+ */
+int cwdFd(void);
+
+/**
+ * Forgets every cached path and closes the held parent-directory descriptors. Called
+ * after anything that may have renamed or removed directories behind the cache's
+ * back, such as an external program in a pipeline or a command substitution.
+ */
+void pathCacheInvalidate(void);
+
+#endif // MYPATH_H
@@ -0,0 +1,515 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "myRing.h"
+
+#define RING_SPIN_LIMIT 128
+
+struct RingQueueSlot
+{
+    atomic_size_t sequence;
+    void *item;
+};
+
+static void futexWait(atomic_uint *word, unsigned expected)
+{
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futexWake(atomic_uint *word, int count)
+{
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/* Spinning only helps when the other side runs on another CPU at the same time. */
+static int spinLimit(void)
+{
+    static atomic_int limit = -1;
+    int value = atomic_load_explicit(&limit, memory_order_relaxed);
+    if (value < 0)
+    {
+        value = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN_LIMIT : 0;
+        atomic_store_explicit(&limit, value, memory_order_relaxed);
+    }
+    return value;
+}
+
+static inline void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/* Bumps an event word and wakes sleepers, but only if someone announced it is
+   asleep; the seq_cst fence pairs with the one in the sleeper's re-check. */
+static void signalEvent(atomic_uint *event, atomic_uint *sleeping, int count)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(sleeping, memory_order_relaxed) != 0)
+    {
+        atomic_fetch_add_explicit(event, 1, memory_order_release);
+        futexWake(event, count);
+    }
+}
+
+static void *allocateAligned(size_t size)
+{
+    size_t rounded = (size + RING_CACHE_LINE - 1) / RING_CACHE_LINE * RING_CACHE_LINE;
+    void *memory = aligned_alloc(RING_CACHE_LINE, rounded);
+    if (memory != NULL)
+    {
+        memset(memory, 0, rounded);
+    }
+    return memory;
+}
+
+static size_t roundUpPowerOfTwo(size_t value)
+{
+    size_t size = 1;
+    while (size < value)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+ByteRing *ringCreate(size_t capacity)
+{
+    size_t size = roundUpPowerOfTwo(capacity);
+
+    ByteRing *ring = allocateAligned(sizeof(ByteRing));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    ring->data = malloc(size);
+    if (ring->data == NULL)
+    {
+        free(ring);
+        return NULL;
+    }
+
+    ring->capacity = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dataEvent, 0);
+    atomic_init(&ring->spaceEvent, 0);
+    atomic_init(&ring->readerSleeping, 0);
+    atomic_init(&ring->writerSleeping, 0);
+    atomic_init(&ring->writerClosed, 0);
+    atomic_init(&ring->readerClosed, 0);
+    atomic_init(&ring->references, 2);
+    return ring;
+}
+
+static void ringRelease(ByteRing *ring)
+{
+    if (atomic_fetch_sub_explicit(&ring->references, 1, memory_order_acq_rel) == 1)
+    {
+        free(ring->data);
+        free(ring);
+    }
+}
+
+ssize_t ringReserve(ByteRing *ring, char **space, size_t wanted)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    int spins = 0;
+
+    for (;;)
+    {
+        if (atomic_load_explicit(&ring->readerClosed, memory_order_acquire))
+        {
+            errno = EPIPE;
+            return -1;
+        }
+
+        size_t used = tail - ring->cachedHead;
+        if (used == ring->capacity)
+        {
+            ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+            used = tail - ring->cachedHead;
+        }
+
+        if (used < ring->capacity)
+        {
+            size_t offset = tail & (ring->capacity - 1);
+            size_t contiguous = ring->capacity - offset;
+            size_t unused = ring->capacity - used;
+            size_t length = contiguous < unused ? contiguous : unused;
+            *space = ring->data + offset;
+            return (ssize_t)(length < wanted ? length : wanted);
+        }
+
+        if (++spins < spinLimit())
+        {
+            cpuRelax();
+            continue;
+        }
+
+        unsigned seen = atomic_load_explicit(&ring->spaceEvent, memory_order_acquire);
+        atomic_store_explicit(&ring->writerSleeping, 1, memory_order_seq_cst);
+        if (tail - atomic_load_explicit(&ring->head, memory_order_seq_cst) == ring->capacity &&
+            !atomic_load_explicit(&ring->readerClosed, memory_order_seq_cst))
+        {
+            futexWait(&ring->spaceEvent, seen);
+        }
+        atomic_store_explicit(&ring->writerSleeping, 0, memory_order_relaxed);
+        spins = 0;
+    }
+}
+
+void ringPublish(ByteRing *ring, size_t length)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + length, memory_order_release);
+    signalEvent(&ring->dataEvent, &ring->readerSleeping, 1);
+}
+
+size_t ringPeek(ByteRing *ring, const char **data)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    int spins = 0;
+
+    for (;;)
+    {
+        size_t available = ring->cachedTail - head;
+        if (available == 0)
+        {
+            ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            available = ring->cachedTail - head;
+        }
+
+        if (available > 0)
+        {
+            size_t offset = head & (ring->capacity - 1);
+            size_t contiguous = ring->capacity - offset;
+            *data = ring->data + offset;
+            return available < contiguous ? available : contiguous;
+        }
+
+        if (atomic_load_explicit(&ring->writerClosed, memory_order_acquire))
+        {
+            // The writer may have published its last bytes right before closing.
+            ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (ring->cachedTail == head)
+            {
+                return 0;
+            }
+            continue;
+        }
+
+        if (++spins < spinLimit())
+        {
+            cpuRelax();
+            continue;
+        }
+
+        unsigned seen = atomic_load_explicit(&ring->dataEvent, memory_order_acquire);
+        atomic_store_explicit(&ring->readerSleeping, 1, memory_order_seq_cst);
+        if (atomic_load_explicit(&ring->tail, memory_order_seq_cst) == head &&
+            !atomic_load_explicit(&ring->writerClosed, memory_order_seq_cst))
+        {
+            futexWait(&ring->dataEvent, seen);
+        }
+        atomic_store_explicit(&ring->readerSleeping, 0, memory_order_relaxed);
+        spins = 0;
+    }
+}
+
+void ringConsume(ByteRing *ring, size_t length)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + length, memory_order_release);
+    signalEvent(&ring->spaceEvent, &ring->writerSleeping, 1);
+}
+
+ssize_t ringWrite(ByteRing *ring, const char *data, size_t length)
+{
+    size_t written = 0;
+    while (written < length)
+    {
+        char *space;
+        ssize_t room = ringReserve(ring, &space, length - written);
+        if (room < 0)
+        {
+            return -1;
+        }
+        memcpy(space, data + written, (size_t)room);
+        ringPublish(ring, (size_t)room);
+        written += (size_t)room;
+    }
+    return (ssize_t)written;
+}
+
+ssize_t ringRead(ByteRing *ring, char *buffer, size_t length)
+{
+    size_t total = 0;
+    while (total < length)
+    {
+        const char *data;
+        size_t available = ringPeek(ring, &data);
+        if (available == 0)
+        {
+            break;
+        }
+
+        size_t chunk = length - total < available ? length - total : available;
+        memcpy(buffer + total, data, chunk);
+        ringConsume(ring, chunk);
+        total += chunk;
+
+        // Return what we have rather than waiting for more to fill the buffer.
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (tail == atomic_load_explicit(&ring->head, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    return (ssize_t)total;
+}
+
+void ringCloseWriter(ByteRing *ring)
+{
+    atomic_store_explicit(&ring->writerClosed, 1, memory_order_seq_cst);
+    atomic_fetch_add_explicit(&ring->dataEvent, 1, memory_order_release);
+    futexWake(&ring->dataEvent, INT_MAX);
+    ringRelease(ring);
+}
+
+void ringCloseReader(ByteRing *ring)
+{
+    atomic_store_explicit(&ring->readerClosed, 1, memory_order_seq_cst);
+    atomic_fetch_add_explicit(&ring->spaceEvent, 1, memory_order_release);
+    futexWake(&ring->spaceEvent, INT_MAX);
+    ringRelease(ring);
+}
+
+static ssize_t cookieWrite(void *cookie, const char *data, size_t length)
+{
+    return ringWrite(cookie, data, length);
+}
+
+static ssize_t cookieRead(void *cookie, char *buffer, size_t length)
+{
+    return ringRead(cookie, buffer, length);
+}
+
+static int cookieCloseWriter(void *cookie)
+{
+    ringCloseWriter(cookie);
+    return 0;
+}
+
+static int cookieCloseReader(void *cookie)
+{
+    ringCloseReader(cookie);
+    return 0;
+}
+
+FILE *ringOpenWriter(ByteRing *ring)
+{
+    cookie_io_functions_t functions = {NULL, cookieWrite, NULL, cookieCloseWriter};
+    return fopencookie(ring, "w", functions);
+}
+
+FILE *ringOpenReader(ByteRing *ring)
+{
+    cookie_io_functions_t functions = {cookieRead, NULL, NULL, cookieCloseReader};
+    return fopencookie(ring, "r", functions);
+}
+
+RingQueue *queueCreate(size_t capacity)
+{
+    size_t size = roundUpPowerOfTwo(capacity < 2 ? 2 : capacity);
+
+    RingQueue *queue = allocateAligned(sizeof(RingQueue));
+    if (queue == NULL)
+    {
+        return NULL;
+    }
+    queue->slots = allocateAligned(size * sizeof(struct RingQueueSlot));
+    if (queue->slots == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+
+    queue->capacity = size;
+    for (size_t i = 0; i < size; i++)
+    {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+    atomic_init(&queue->enqueuePosition, 0);
+    atomic_init(&queue->dequeuePosition, 0);
+    atomic_init(&queue->itemEvent, 0);
+    atomic_init(&queue->spaceEvent, 0);
+    atomic_init(&queue->itemSleepers, 0);
+    atomic_init(&queue->spaceSleepers, 0);
+    atomic_init(&queue->closed, 0);
+    return queue;
+}
+
+bool queueTryPush(RingQueue *queue, void *item)
+{
+    if (atomic_load_explicit(&queue->closed, memory_order_acquire))
+    {
+        return false;
+    }
+
+    size_t position = atomic_load_explicit(&queue->enqueuePosition, memory_order_relaxed);
+    for (;;)
+    {
+        struct RingQueueSlot *slot = &queue->slots[position & (queue->capacity - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                slot->item = item;
+                atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+                signalEvent(&queue->itemEvent, &queue->itemSleepers, 1);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = atomic_load_explicit(&queue->enqueuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+bool queueTryPop(RingQueue *queue, void **item)
+{
+    size_t position = atomic_load_explicit(&queue->dequeuePosition, memory_order_relaxed);
+    for (;;)
+    {
+        struct RingQueueSlot *slot = &queue->slots[position & (queue->capacity - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                *item = slot->item;
+                atomic_store_explicit(&slot->sequence, position + queue->capacity, memory_order_release);
+                signalEvent(&queue->spaceEvent, &queue->spaceSleepers, 1);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = atomic_load_explicit(&queue->dequeuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+bool queuePush(RingQueue *queue, void *item)
+{
+    for (int spins = 0;; spins++)
+    {
+        if (queueTryPush(queue, item))
+        {
+            return true;
+        }
+        if (atomic_load_explicit(&queue->closed, memory_order_acquire))
+        {
+            return false;
+        }
+        if (spins < spinLimit())
+        {
+            cpuRelax();
+            continue;
+        }
+
+        unsigned seen = atomic_load_explicit(&queue->spaceEvent, memory_order_acquire);
+        atomic_fetch_add_explicit(&queue->spaceSleepers, 1, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (queueTryPush(queue, item))
+        {
+            atomic_fetch_sub_explicit(&queue->spaceSleepers, 1, memory_order_relaxed);
+            return true;
+        }
+        if (!atomic_load_explicit(&queue->closed, memory_order_seq_cst))
+        {
+            futexWait(&queue->spaceEvent, seen);
+        }
+        atomic_fetch_sub_explicit(&queue->spaceSleepers, 1, memory_order_relaxed);
+        spins = 0;
+    }
+}
+
+bool queuePop(RingQueue *queue, void **item)
+{
+    for (int spins = 0;; spins++)
+    {
+        if (queueTryPop(queue, item))
+        {
+            return true;
+        }
+        if (atomic_load_explicit(&queue->closed, memory_order_acquire))
+        {
+            // Items pushed just before the close are still handed out.
+            return queueTryPop(queue, item);
+        }
+        if (spins < spinLimit())
+        {
+            cpuRelax();
+            continue;
+        }
+
+        unsigned seen = atomic_load_explicit(&queue->itemEvent, memory_order_acquire);
+        atomic_fetch_add_explicit(&queue->itemSleepers, 1, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (queueTryPop(queue, item))
+        {
+            atomic_fetch_sub_explicit(&queue->itemSleepers, 1, memory_order_relaxed);
+            return true;
+        }
+        if (!atomic_load_explicit(&queue->closed, memory_order_seq_cst))
+        {
+            futexWait(&queue->itemEvent, seen);
+        }
+        atomic_fetch_sub_explicit(&queue->itemSleepers, 1, memory_order_relaxed);
+        spins = 0;
+    }
+}
+
+void queueClose(RingQueue *queue)
+{
+    atomic_store_explicit(&queue->closed, 1, memory_order_seq_cst);
+    atomic_fetch_add_explicit(&queue->itemEvent, 1, memory_order_release);
+    atomic_fetch_add_explicit(&queue->spaceEvent, 1, memory_order_release);
+    futexWake(&queue->itemEvent, INT_MAX);
+    futexWake(&queue->spaceEvent, INT_MAX);
+}
+
+void queueDestroy(RingQueue *queue)
+{
+    if (queue != NULL)
+    {
+        free(queue->slots);
+        free(queue);
+    }
+}
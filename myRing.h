@@ -0,0 +1,257 @@
+#ifndef MYRING_H
+#define MYRING_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#define RING_DEFAULT_CAPACITY (64 * 1024)
+#define RING_CACHE_LINE 64
+
+/**
+ * A single-producer/single-consumer byte ring used to stream data between two
+ * builtins running in the same process. One thread writes, another reads; neither
+ * takes a lock. The producer only advances `tail` and the consumer only advances
+ * `head`, so each index has exactly one writer.
+ *
+ * Each index sits on its own cache line together with the owning side's cached
+ * copy of the other index, so the two threads only touch each other's line when
+ * the cached value says the ring looks full (producer) or empty (consumer).
+ *
+ * A side that finds nothing to do spins briefly and then sleeps on a futex; the
+ * other side only issues a wake-up system call when it sees that someone is asleep.
+ *
+ * Either side can close its end. Once the producer has closed, the consumer reads
+ * whatever is left and then sees end of file. Once the consumer has closed, further
+ * writes fail with EPIPE, just as writing to a pipe without readers would.
+ */
+typedef struct
+{
+    _Alignas(RING_CACHE_LINE) atomic_size_t head;
+    size_t cachedTail;
+
+    _Alignas(RING_CACHE_LINE) atomic_size_t tail;
+    size_t cachedHead;
+
+    _Alignas(RING_CACHE_LINE) atomic_uint dataEvent;
+    atomic_uint spaceEvent;
+    atomic_uint readerSleeping;
+    atomic_uint writerSleeping;
+    atomic_int writerClosed;
+    atomic_int readerClosed;
+    atomic_int references;
+    char *data;
+    size_t capacity;
+} ByteRing;
+
+/**
+ * A bounded multi-producer/multi-consumer queue of pointers, for handing work items
+ * (directory entries, buffers, jobs) between a pool of threads. Every slot carries a
+ * sequence number, so producers and consumers claim slots with a single
+ * compare-and-swap on their own cache-line-padded position and never block each
+ * other on a lock. Blocking push and pop sleep on a futex when the queue is full or
+ * empty.
+ */
+typedef struct
+{
+    _Alignas(RING_CACHE_LINE) atomic_size_t enqueuePosition;
+    _Alignas(RING_CACHE_LINE) atomic_size_t dequeuePosition;
+    _Alignas(RING_CACHE_LINE) atomic_uint itemEvent;
+    atomic_uint spaceEvent;
+    atomic_uint itemSleepers;
+    atomic_uint spaceSleepers;
+    atomic_int closed;
+    size_t capacity;
+    struct RingQueueSlot *slots;
+} RingQueue;
+
+/**
+ * Creates a byte ring with room for `capacity` bytes, rounded up to a power of two.
+ * The ring starts with two references, one for each end; it is freed when both
+ * ends have been closed.
+ *
+ * @param capacity Requested size of the buffer in bytes.
+ * @return The new ring, or NULL if memory could not be allocated.
+ */
+ByteRing *ringCreate(size_t capacity);
+
+/**
+ * Batched producer API, step one: returns a pointer to contiguous free space in the
+ * ring, waiting until at least one byte is free. The caller fills up to the returned
+ * number of bytes and makes them visible with `ringPublish`. Reserving and publishing
+ * a large span costs the same synchronization as a single byte.
+ *
+ * Usage example:
+ *   char *space;
+ *   ssize_t room = ringReserve(ring, &space, sizeof(record));
+ *   if (room > 0)
+ *   {
+ *       size_t n = room < sizeof(record) ? room : sizeof(record);
+ *       memcpy(space, &record, n);
+ *       ringPublish(ring, n);
+ *   }
+ *
+ * @param ring The ring.
+ * @param space Receives a pointer into the ring's buffer.
+ * @param wanted The most the caller intends to write.
+ * @return The number of contiguous bytes available at `*space` (at most `wanted`),
+ *         or -1 with errno set to EPIPE if the consumer has closed its end.
+ */
+ssize_t ringReserve(ByteRing *ring, char **space, size_t wanted);
+
+/**
+ * Batched producer API, step two: makes `length` bytes written into the span
+ * returned by `ringReserve` visible to the consumer, waking it if it sleeps.
+ *
+ * @param ring The ring.
+ * @param length Number of bytes to publish.
+ */
+void ringPublish(ByteRing *ring, size_t length);
+
+/**
+ * Batched consumer API, step one: returns a pointer to contiguous readable data,
+ * waiting until some is available or the producer has closed. The caller processes
+ * the bytes in place and releases them with `ringConsume`.
+ *
+ * @param ring The ring.
+ * @param data Receives a pointer into the ring's buffer.
+ * @return The number of contiguous readable bytes, or 0 at end of stream.
+ */
+size_t ringPeek(ByteRing *ring, const char **data);
+
+/**
+ * Batched consumer API, step two: releases `length` bytes returned by `ringPeek`,
+ * waking the producer if it sleeps waiting for space.
+ *
+ * @param ring The ring.
+ * @param length Number of bytes to release.
+ */
+void ringConsume(ByteRing *ring, size_t length);
+
+/**
+ * Writes all `length` bytes into the ring, waiting for the consumer to make room
+ * when the ring is full.
+ *
+ * @param ring The ring.
+ * @param data The bytes to write.
+ * @param length Number of bytes to write.
+ * @return The number of bytes written, or -1 with errno set to EPIPE if the
+ *         consumer has closed its end.
+ */
+ssize_t ringWrite(ByteRing *ring, const char *data, size_t length);
+
+/**
+ * Reads up to `length` bytes from the ring, waiting until at least one byte is
+ * available or the producer has closed.
+ *
+ * @param ring The ring.
+ * @param buffer Destination buffer.
+ * @param length Size of the destination buffer.
+ * @return The number of bytes read, or 0 at end of stream.
+ */
+ssize_t ringRead(ByteRing *ring, char *buffer, size_t length);
+
+/**
+ * Closes the producer end. The consumer will see end of stream once it has drained
+ * the remaining bytes. Drops the producer's reference.
+ *
+ * @param ring The ring.
+ */
+void ringCloseWriter(ByteRing *ring);
+
+/**
+ * Closes the consumer end. Blocked and future writes fail with EPIPE. Drops the
+ * consumer's reference.
+ *
+ * @param ring The ring.
+ */
+void ringCloseReader(ByteRing *ring);
+
+/**
+ * Wraps the producer end of a ring in a stdio stream, so builtins that print with
+ * `fprintf` can write into the ring unchanged. stdio's own buffer batches small
+ * writes. Closing the stream with `fclose` flushes it and closes the producer end.
+ *
+ * Usage example:
+ *   ByteRing *ring = ringCreate(RING_DEFAULT_CAPACITY);
+ *   FILE *out = ringOpenWriter(ring);
+ *   FILE *in = ringOpenReader(ring);
+ *   // hand `out` to one thread and `in` to another
+ *
+ * @param ring The ring.
+ * @return A stream opened for writing, or NULL on failure.
+ */
+FILE *ringOpenWriter(ByteRing *ring);
+
+/**
+ * Wraps the consumer end of a ring in a stdio stream. Closing the stream closes
+ * the consumer end.
+ *
+ * @param ring The ring.
+ * @return A stream opened for reading, or NULL on failure.
+ */
+FILE *ringOpenReader(ByteRing *ring);
+
+/**
+ * Creates an MPMC pointer queue with room for `capacity` items, rounded up to a
+ * power of two.
+ *
+ * @param capacity Requested number of slots.
+ * @return The new queue, or NULL if memory could not be allocated.
+ */
+RingQueue *queueCreate(size_t capacity);
+
+/**
+ * Adds an item without waiting.
+ *
+ * @param queue The queue.
+ * @param item The pointer to enqueue.
+ * @return true if the item was added, false if the queue is full or closed.
+ */
+bool queueTryPush(RingQueue *queue, void *item);
+
+/**
+ * Adds an item, sleeping while the queue is full.
+ *
+ * @param queue The queue.
+ * @param item The pointer to enqueue.
+ * @return true if the item was added, false if the queue was closed.
+ */
+bool queuePush(RingQueue *queue, void *item);
+
+/**
+ * Removes an item without waiting.
+ *
+ * @param queue The queue.
+ * @param item Receives the dequeued pointer.
+ * @return true if an item was removed, false if the queue is empty.
+ */
+bool queueTryPop(RingQueue *queue, void **item);
+
+/**
+ * Removes an item, sleeping while the queue is empty.
+ *
+ * @param queue The queue.
+ * @param item Receives the dequeued pointer.
+ * @return true if an item was removed, false if the queue is closed and empty.
+ */
+bool queuePop(RingQueue *queue, void **item);
+
+/**
+ * Closes the queue: pushes fail from now on, and pops fail once the remaining
+ * items have been taken. Wakes every sleeping thread.
+ *
+ * @param queue The queue.
+ */
+void queueClose(RingQueue *queue);
+
+/**
+ * Frees the queue. No thread may use it afterwards.
+ *
+ * @param queue The queue.
+ */
+void queueDestroy(RingQueue *queue);
+
+#endif // MYRING_H
@@ -0,0 +1,1077 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "myScript.h"
+#include "myFunction.h"
+#include "myArena.h"
+#include "myVars.h"
+#include "myPath.h"
+#include "myCoro.h"
+#include "myTrace.h"
+#include "myAtomic.h"
+#include "myAppend.h"
+
+typedef enum
+{
+    TOKEN_WORD,
+    TOKEN_SEMICOLON,
+    TOKEN_NEWLINE,
+    TOKEN_AND,
+    TOKEN_OR,
+    TOKEN_PIPE,
+    TOKEN_AMPERSAND,
+    TOKEN_END
+} TokenType;
+
+typedef struct
+{
+    TokenType type;
+    const char *start;
+    int length;
+    int line;
+    bool unterminated;
+} Token;
+
+typedef struct
+{
+    const char *text;
+    const char *origin;
+    int position;
+    int line;
+    Token current;
+    bool hasToken;
+    bool failed;
+    bool incomplete;
+    Arena *arena;
+} Parser;
+
+static const char *closingKeywords[] = {"then", "elif", "else", "fi", "do", "done", NULL};
+
+static int options = 0;
+
+/* Greater than zero while a condition runs, where a failure must not stop the script. */
+static int conditionDepth = 0;
+
+int scriptOptions(void)
+{
+    return options;
+}
+
+void scriptSetOption(int option, bool enabled)
+{
+    options = enabled ? options | option : options & ~option;
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool endsWord(char c)
+{
+    return c == '\0' || c == '\n' || c == ';' || c == '&' || c == '|' || isBlank(c);
+}
+
+/* Reads one word, keeping quotes, `$(...)` and `${...}` together with their contents. */
+static void scanWord(Parser *p, Token *token)
+{
+    const char *text = p->text;
+    int i = p->position;
+    bool inQuote = false;
+    int parentheses = 0;
+    int braces = 0;
+
+    while (text[i] != '\0')
+    {
+        char c = text[i];
+        if (!inQuote && parentheses == 0 && braces == 0 && endsWord(c))
+        {
+            break;
+        }
+        if (c == '\\')
+        {
+            if (text[i + 1] == '\0')
+            {
+                token->unterminated = true;
+                i++;
+                break;
+            }
+            if (text[i + 1] == '\n')
+            {
+                p->line++;
+            }
+            i += 2;
+            continue;
+        }
+        if (c == '\n')
+        {
+            p->line++;
+        }
+        else if (c == '"')
+        {
+            inQuote = !inQuote;
+        }
+        else if (c == '$' && text[i + 1] == '(')
+        {
+            parentheses++;
+            i++;
+        }
+        else if (c == '$' && text[i + 1] == '{')
+        {
+            braces++;
+            i++;
+        }
+        else if (c == ')' && parentheses > 0)
+        {
+            parentheses--;
+        }
+        else if (c == '}' && braces > 0)
+        {
+            braces--;
+        }
+        i++;
+    }
+
+    if (inQuote || parentheses > 0 || braces > 0)
+    {
+        token->unterminated = true;
+    }
+    token->length = i - p->position;
+    p->position = i;
+}
+
+static Token scanToken(Parser *p)
+{
+    const char *text = p->text;
+    for (;;)
+    {
+        while (isBlank(text[p->position]))
+        {
+            p->position++;
+        }
+        if (text[p->position] == '\\' && text[p->position + 1] == '\n')
+        {
+            p->position += 2;
+            p->line++;
+            continue;
+        }
+        if (text[p->position] == '#')
+        {
+            while (text[p->position] != '\0' && text[p->position] != '\n')
+            {
+                p->position++;
+            }
+        }
+        break;
+    }
+
+    Token token = {TOKEN_END, text + p->position, 0, p->line, false};
+    char c = text[p->position];
+    char following = c != '\0' ? text[p->position + 1] : '\0';
+
+    if (c == '\0')
+    {
+        return token;
+    }
+    if (c == '\n')
+    {
+        token.type = TOKEN_NEWLINE;
+        token.length = 1;
+        p->line++;
+    }
+    else if (c == ';')
+    {
+        token.type = TOKEN_SEMICOLON;
+        token.length = 1;
+    }
+    else if (c == '&')
+    {
+        token.type = following == '&' ? TOKEN_AND : TOKEN_AMPERSAND;
+        token.length = following == '&' ? 2 : 1;
+    }
+    else if (c == '|')
+    {
+        token.type = following == '|' ? TOKEN_OR : TOKEN_PIPE;
+        token.length = following == '|' ? 2 : 1;
+    }
+    else
+    {
+        token.type = TOKEN_WORD;
+        scanWord(p, &token);
+        return token;
+    }
+    p->position += token.length;
+    return token;
+}
+
+static Token *peek(Parser *p)
+{
+    if (!p->hasToken)
+    {
+        p->current = scanToken(p);
+        p->hasToken = true;
+    }
+    return &p->current;
+}
+
+static Token next(Parser *p)
+{
+    Token token = *peek(p);
+    p->hasToken = false;
+    return token;
+}
+
+static bool isKeyword(const Token *token, const char *keyword)
+{
+    return token->type == TOKEN_WORD && token->length == (int)strlen(keyword) &&
+           strncmp(token->start, keyword, token->length) == 0;
+}
+
+static bool isClosingKeyword(const Token *token)
+{
+    for (int i = 0; closingKeywords[i] != NULL; i++)
+    {
+        if (isKeyword(token, closingKeywords[i]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Reports the first error only. Running out of text means the script may go on. */
+static void syntaxError(Parser *p, const Token *token, const char *message)
+{
+    if (p->failed)
+    {
+        return;
+    }
+    p->failed = true;
+    if (token->type == TOKEN_END || token->unterminated)
+    {
+        p->incomplete = true;
+        return;
+    }
+    if (message != NULL)
+    {
+        fprintf(stderr, "%s: line %d: %s\n", p->origin, token->line, message);
+    }
+    else if (token->type == TOKEN_NEWLINE)
+    {
+        fprintf(stderr, "%s: line %d: syntax error near unexpected newline\n", p->origin, token->line);
+    }
+    else
+    {
+        fprintf(stderr, "%s: line %d: syntax error near '%.*s'\n", p->origin, token->line,
+                token->length, token->start);
+    }
+}
+
+static ScriptNode *newNode(Parser *p, ScriptNodeType type)
+{
+    ScriptNode *node = arenaAlloc(p->arena, sizeof(ScriptNode));
+    if (node == NULL)
+    {
+        perror("Failed to allocate script");
+        p->failed = true;
+        return NULL;
+    }
+    memset(node, 0, sizeof(ScriptNode));
+    node->type = type;
+    return node;
+}
+
+/* Arrays double whenever the count reaches a power of two, starting at four. */
+static void *growArray(Parser *p, void *array, int count, size_t elementSize)
+{
+    if (count != 0 && (count < 4 || (count & (count - 1)) != 0))
+    {
+        return array;
+    }
+    size_t capacity = count == 0 ? 4 : 2 * count;
+    void *grown = arenaGrow(p->arena, array, count * elementSize, capacity * elementSize);
+    if (grown == NULL)
+    {
+        perror("Failed to allocate script");
+        p->failed = true;
+    }
+    return grown;
+}
+
+static bool addChild(Parser *p, ScriptNode *node, ScriptNode *child)
+{
+    ScriptNode **children = growArray(p, node->children, node->childCount, sizeof(ScriptNode *));
+    if (children == NULL)
+    {
+        return false;
+    }
+    node->children = children;
+    node->children[node->childCount++] = child;
+    return true;
+}
+
+/* Copies a word into the script, dropping line continuations; static words lose their quotes. */
+static bool addWord(Parser *p, ScriptNode *node, const Token *token)
+{
+    ScriptWord *words = growArray(p, node->words, node->wordCount, sizeof(ScriptWord));
+    char *text = arenaAlloc(p->arena, token->length + 1);
+    if (words == NULL || text == NULL)
+    {
+        p->failed = true;
+        return false;
+    }
+    node->words = words;
+
+    bool dynamic = memchr(token->start, '$', token->length) != NULL;
+    int length = 0;
+    for (int i = 0; i < token->length; i++)
+    {
+        if (token->start[i] == '\\' && i + 1 < token->length && token->start[i + 1] == '\n')
+        {
+            i++;
+        }
+        else if (dynamic || token->start[i] != '"')
+        {
+            text[length++] = token->start[i];
+        }
+    }
+    text[length] = '\0';
+
+    node->words[node->wordCount].text = text;
+    node->words[node->wordCount].dynamic = dynamic;
+    node->wordCount++;
+    return true;
+}
+
+/* When no word needs expanding, the argument vector is built once here, not on every run. */
+static void prepareArguments(Parser *p, ScriptNode *node)
+{
+    for (int i = 0; i < node->wordCount; i++)
+    {
+        if (node->words[i].dynamic)
+        {
+            return;
+        }
+    }
+    node->args = arenaAlloc(p->arena, (node->wordCount + 1) * sizeof(char *));
+    if (node->args == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < node->wordCount; i++)
+    {
+        node->args[i] = node->words[i].text;
+    }
+    node->args[node->wordCount] = NULL;
+}
+
+static void skipNewlines(Parser *p)
+{
+    while (peek(p)->type == TOKEN_NEWLINE)
+    {
+        next(p);
+    }
+}
+
+static bool expectKeyword(Parser *p, const char *keyword)
+{
+    Token *token = peek(p);
+    if (!isKeyword(token, keyword))
+    {
+        syntaxError(p, token, NULL);
+        return false;
+    }
+    next(p);
+    return true;
+}
+
+static ScriptNode *parseList(Parser *p);
+static ScriptNode *parseCommand(Parser *p);
+
+static ScriptNode *parseBody(Parser *p)
+{
+    ScriptNode *list = parseList(p);
+    if (list != NULL && list->childCount == 0)
+    {
+        syntaxError(p, peek(p), NULL);
+        return NULL;
+    }
+    return list;
+}
+
+static ScriptNode *parseIf(Parser *p)
+{
+    ScriptNode *node = newNode(p, SCRIPT_IF);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    next(p);
+
+    for (;;)
+    {
+        ScriptNode *condition = parseBody(p);
+        if (condition == NULL || !expectKeyword(p, "then"))
+        {
+            return NULL;
+        }
+        ScriptNode *body = parseBody(p);
+        if (body == NULL || !addChild(p, node, condition) || !addChild(p, node, body))
+        {
+            return NULL;
+        }
+
+        Token *token = peek(p);
+        if (isKeyword(token, "elif"))
+        {
+            next(p);
+            continue;
+        }
+        if (isKeyword(token, "else"))
+        {
+            next(p);
+            ScriptNode *otherwise = parseBody(p);
+            if (otherwise == NULL || !addChild(p, node, otherwise))
+            {
+                return NULL;
+            }
+            node->hasElse = true;
+        }
+        return expectKeyword(p, "fi") ? node : NULL;
+    }
+}
+
+static ScriptNode *parseLoopBody(Parser *p, ScriptNode *node)
+{
+    if (!expectKeyword(p, "do"))
+    {
+        return NULL;
+    }
+    ScriptNode *body = parseBody(p);
+    if (body == NULL || !addChild(p, node, body) || !expectKeyword(p, "done"))
+    {
+        return NULL;
+    }
+    return node;
+}
+
+static ScriptNode *parseFor(Parser *p)
+{
+    ScriptNode *node = newNode(p, SCRIPT_FOR);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    next(p);
+
+    Token name = next(p);
+    if (name.type != TOKEN_WORD || name.unterminated || !varValidName(name.start, name.length))
+    {
+        syntaxError(p, &name, name.type == TOKEN_WORD && !name.unterminated ? "for: invalid variable name" : NULL);
+        return NULL;
+    }
+    node->name = arenaAlloc(p->arena, name.length + 1);
+    if (node->name == NULL)
+    {
+        p->failed = true;
+        return NULL;
+    }
+    memcpy(node->name, name.start, name.length);
+    node->name[name.length] = '\0';
+
+    skipNewlines(p);
+    if (!expectKeyword(p, "in"))
+    {
+        return NULL;
+    }
+    while (peek(p)->type == TOKEN_WORD)
+    {
+        Token word = next(p);
+        if (word.unterminated)
+        {
+            syntaxError(p, &word, NULL);
+            return NULL;
+        }
+        if (!addWord(p, node, &word))
+        {
+            return NULL;
+        }
+    }
+    prepareArguments(p, node);
+
+    Token *separator = peek(p);
+    if (separator->type != TOKEN_SEMICOLON && separator->type != TOKEN_NEWLINE)
+    {
+        syntaxError(p, separator, NULL);
+        return NULL;
+    }
+    next(p);
+    skipNewlines(p);
+    return parseLoopBody(p, node);
+}
+
+static ScriptNode *parseWhile(Parser *p)
+{
+    ScriptNode *node = newNode(p, SCRIPT_WHILE);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    next(p);
+
+    ScriptNode *condition = parseBody(p);
+    if (condition == NULL || !addChild(p, node, condition))
+    {
+        return NULL;
+    }
+    return parseLoopBody(p, node);
+}
+
+static ScriptNode *parseSimpleCommand(Parser *p)
+{
+    ScriptNode *node = newNode(p, SCRIPT_COMMAND);
+    if (node == NULL)
+    {
+        return NULL;
+    }
+    while (peek(p)->type == TOKEN_WORD)
+    {
+        Token word = next(p);
+        if (word.unterminated)
+        {
+            syntaxError(p, &word, NULL);
+            return NULL;
+        }
+        if (!addWord(p, node, &word))
+        {
+            return NULL;
+        }
+    }
+    prepareArguments(p, node);
+    return node;
+}
+
+static ScriptNode *parseCommand(Parser *p)
+{
+    Token *token = peek(p);
+    if (token->type != TOKEN_WORD || isClosingKeyword(token))
+    {
+        syntaxError(p, token, NULL);
+        return NULL;
+    }
+    if (isKeyword(token, "if"))
+    {
+        return parseIf(p);
+    }
+    if (isKeyword(token, "for"))
+    {
+        return parseFor(p);
+    }
+    if (isKeyword(token, "while"))
+    {
+        return parseWhile(p);
+    }
+    return parseSimpleCommand(p);
+}
+
+static ScriptNode *parsePipeline(Parser *p)
+{
+    ScriptNode *first = parseCommand(p);
+    if (first == NULL || peek(p)->type != TOKEN_PIPE)
+    {
+        return first;
+    }
+
+    ScriptNode *pipeline = newNode(p, SCRIPT_PIPELINE);
+    if (pipeline == NULL || !addChild(p, pipeline, first))
+    {
+        return NULL;
+    }
+    while (peek(p)->type == TOKEN_PIPE)
+    {
+        Token pipe = next(p);
+        skipNewlines(p);
+        ScriptNode *stage = parseCommand(p);
+        if (stage == NULL)
+        {
+            return NULL;
+        }
+        if (stage->type != SCRIPT_COMMAND || pipeline->children[pipeline->childCount - 1]->type != SCRIPT_COMMAND)
+        {
+            syntaxError(p, &pipe, "only simple commands can be piped");
+            return NULL;
+        }
+        if (!addChild(p, pipeline, stage))
+        {
+            return NULL;
+        }
+    }
+    return pipeline;
+}
+
+static ScriptNode *parseAndOr(Parser *p)
+{
+    ScriptNode *left = parsePipeline(p);
+    while (left != NULL && (peek(p)->type == TOKEN_AND || peek(p)->type == TOKEN_OR))
+    {
+        Token operator = next(p);
+        skipNewlines(p);
+        ScriptNode *right = parsePipeline(p);
+        ScriptNode *node = newNode(p, operator.type == TOKEN_AND ? SCRIPT_AND : SCRIPT_OR);
+        if (right == NULL || node == NULL || !addChild(p, node, left) || !addChild(p, node, right))
+        {
+            return NULL;
+        }
+        left = node;
+    }
+    return left;
+}
+
+/* Parses commands up to the end of the text or a keyword that closes a compound command. */
+static ScriptNode *parseList(Parser *p)
+{
+    ScriptNode *list = newNode(p, SCRIPT_SEQUENCE);
+    if (list == NULL)
+    {
+        return NULL;
+    }
+
+    for (;;)
+    {
+        while (peek(p)->type == TOKEN_NEWLINE || peek(p)->type == TOKEN_SEMICOLON)
+        {
+            next(p);
+        }
+        Token *token = peek(p);
+        if (token->type == TOKEN_END || isClosingKeyword(token))
+        {
+            return list;
+        }
+
+        ScriptNode *item = parseAndOr(p);
+        if (item == NULL || !addChild(p, list, item))
+        {
+            return NULL;
+        }
+
+        token = peek(p);
+        if (token->type == TOKEN_AMPERSAND)
+        {
+            if (item->type != SCRIPT_COMMAND)
+            {
+                syntaxError(p, token, "only simple commands can run in the background");
+                return NULL;
+            }
+            item->background = true;
+            next(p);
+        }
+        else if (token->type != TOKEN_SEMICOLON && token->type != TOKEN_NEWLINE && token->type != TOKEN_END)
+        {
+            syntaxError(p, token, NULL);
+            return NULL;
+        }
+    }
+}
+
+ScriptParseResult scriptParse(const char *text, const char *origin, ScriptNode **script)
+{
+    Parser parser = {text, origin, 0, 1, {TOKEN_END, text, 0, 1, false}, false, false, false, commandArena()};
+
+    uint64_t span = TRACE_BEGIN();
+    ScriptNode *list = parseList(&parser);
+    if (list != NULL && peek(&parser)->type != TOKEN_END)
+    {
+        syntaxError(&parser, peek(&parser), NULL);
+    }
+    TRACE_END(span, "parse", "parse", origin);
+    if (list == NULL || parser.failed)
+    {
+        return parser.incomplete ? SCRIPT_INCOMPLETE : SCRIPT_ERROR;
+    }
+    *script = list;
+    return SCRIPT_OK;
+}
+
+/* Expands the words of a command into arguments in the command arena. */
+static char **buildArguments(ScriptNode *node)
+{
+    varClearSubstitution();
+    if (node->args != NULL)
+    {
+        return node->args;
+    }
+
+    Arena *arena = commandArena();
+    int size = node->wordCount + 1, count = 0;
+    char **args = arenaAlloc(arena, size * sizeof(char *));
+    if (args == NULL)
+    {
+        perror("arena allocation failed");
+        return NULL;
+    }
+
+    for (int i = 0; i < node->wordCount; i++)
+    {
+        ScriptWord *word = &node->words[i];
+        if (!word->dynamic)
+        {
+            args[count++] = word->text;
+            continue;
+        }
+
+        char *expanded = expandLine(word->text);
+        char **parts = expanded != NULL ? splitArgument(expanded) : NULL;
+        if (parts == NULL)
+        {
+            return NULL;
+        }
+        // An unquoted expansion of nothing leaves no argument behind.
+        bool quoted = strchr(word->text, '"') != NULL;
+        for (int j = 0; parts[j] != NULL; j++)
+        {
+            if (parts[j][0] == '\0' && !quoted)
+            {
+                continue;
+            }
+            if (count + 1 == size)
+            {
+                args = arenaGrow(arena, args, size * sizeof(char *), 2 * size * sizeof(char *));
+                if (args == NULL)
+                {
+                    perror("arena allocation failed");
+                    return NULL;
+                }
+                size *= 2;
+            }
+            args[count++] = parts[j];
+        }
+    }
+    args[count] = NULL;
+    return args;
+}
+
+/* Publishes the statuses of the last pipeline as $PIPESTATUS and applies pipefail. */
+static int pipelineStatus(const int *statuses, int count)
+{
+    char text[256];
+    size_t length = 0;
+    text[0] = '\0';
+    for (int i = 0; i < count && length < sizeof(text) - 12; i++)
+    {
+        length += snprintf(text + length, sizeof(text) - length, i == 0 ? "%d" : " %d", statuses[i]);
+    }
+    varSet("PIPESTATUS", text, false);
+
+    int status = statuses[count - 1];
+    if (options & SCRIPT_OPTION_PIPEFAIL)
+    {
+        for (int i = count - 1; i >= 0 && status == 0; i--)
+        {
+            status = statuses[i];
+        }
+    }
+    return status;
+}
+
+/* With `set -e`, a command that fails outside a condition ends the shell. */
+static void checkErrexit(int status)
+{
+    if (status != 0 && (options & SCRIPT_OPTION_ERREXIT) && conditionDepth == 0)
+    {
+        fflush(stdout);
+        coroWaitAll();
+        shellExit(status);
+    }
+}
+
+/* Durable writes and appended lines wait in buffers. A run of `echo` and `cp`
+   commands keeps adding to them; any other command might read one of the files, so
+   they are written out first. */
+static void flushPendingWrites(char **args)
+{
+    if (args != NULL && args[0] != NULL && (strcmp(args[0], "echo") == 0 || strcmp(args[0], "cp") == 0))
+    {
+        return;
+    }
+    if (appendFlush() != 0)
+    {
+        perror("Failed to flush appended data");
+    }
+    if (atomicFlush() != 0)
+    {
+        perror("Failed to flush pending writes");
+    }
+}
+
+static int runCommand(ScriptNode *node)
+{
+    Arena *arena = commandArena();
+    ArenaMark mark = arenaMark(arena);
+    uint64_t span = TRACE_BEGIN();
+
+    int status;
+    char **args = buildArguments(node);
+    flushPendingWrites(node->background ? NULL : args);
+    if (args == NULL)
+    {
+        status = 1;
+    }
+    else if (args[0] == NULL)
+    {
+        status = 0;
+    }
+    else if (node->background)
+    {
+        status = startBackgroundJob(args);
+    }
+    else
+    {
+        status = runBuiltin(args);
+    }
+
+    TRACE_END(span, "dispatch", "command", args != NULL ? args[0] : NULL);
+    arenaRestore(arena, mark);
+    status = pipelineStatus(&status, 1);
+    checkErrexit(status);
+    return status;
+}
+
+static int runPipeline(ScriptNode *node)
+{
+    Arena *arena = commandArena();
+    ArenaMark mark = arenaMark(arena);
+
+    int count = node->childCount;
+    bool allBuiltins = true;
+    uint64_t span = TRACE_BEGIN();
+    char ***stages = arenaAlloc(arena, count * sizeof(char **));
+    int *statuses = arenaAlloc(arena, count * sizeof(int));
+    if (stages == NULL || statuses == NULL)
+    {
+        perror("arena allocation failed");
+        arenaRestore(arena, mark);
+        return 1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        stages[i] = buildArguments(node->children[i]);
+        if (stages[i] == NULL || stages[i][0] == NULL)
+        {
+            fprintf(stderr, "Empty command in pipeline.\n");
+            arenaRestore(arena, mark);
+            return 1;
+        }
+        // A limited stage needs a process of its own to hold the limits.
+        if (!isBuiltin(stages[i][0]) || strcmp(stages[i][0], "limit") == 0)
+        {
+            allBuiltins = false;
+        }
+    }
+
+    flushPendingWrites(NULL);
+    if (allBuiltins)
+    {
+        runBuiltinPipeline(stages, count, statuses);
+    }
+    else
+    {
+        mypipe(stages, count, statuses);
+    }
+
+    int status = pipelineStatus(statuses, count);
+    TRACE_END(span, "dispatch", allBuiltins ? "builtin pipeline" : "pipeline", stages[0][0]);
+    arenaRestore(arena, mark);
+    checkErrexit(status);
+    return status;
+}
+
+static int runCondition(ScriptNode *node)
+{
+    conditionDepth++;
+    int status = scriptRun(node);
+    conditionDepth--;
+    return status;
+}
+
+static int runFor(ScriptNode *node)
+{
+    Arena *arena = commandArena();
+    ArenaMark mark = arenaMark(arena);
+
+    int status = 0;
+    char **values = buildArguments(node);
+    if (values == NULL)
+    {
+        status = 1;
+    }
+    for (int i = 0; values != NULL && values[i] != NULL; i++)
+    {
+        if (varSet(node->name, values[i], false) != 0)
+        {
+            fprintf(stderr, "Failed to set variable '%s'.\n", node->name);
+            status = 1;
+            break;
+        }
+        status = scriptRun(node->children[0]);
+    }
+
+    arenaRestore(arena, mark);
+    return status;
+}
+
+int scriptRun(ScriptNode *script)
+{
+    int status = 0;
+    switch (script->type)
+    {
+    case SCRIPT_COMMAND:
+        status = runCommand(script);
+        break;
+    case SCRIPT_PIPELINE:
+        status = runPipeline(script);
+        break;
+    case SCRIPT_SEQUENCE:
+        for (int i = 0; i < script->childCount; i++)
+        {
+            status = scriptRun(script->children[i]);
+        }
+        break;
+    case SCRIPT_AND:
+        status = runCondition(script->children[0]);
+        if (status == 0)
+        {
+            status = scriptRun(script->children[1]);
+        }
+        break;
+    case SCRIPT_OR:
+        status = runCondition(script->children[0]);
+        if (status != 0)
+        {
+            status = scriptRun(script->children[1]);
+        }
+        break;
+    case SCRIPT_IF:
+    {
+        int branches = script->childCount - (script->hasElse ? 1 : 0);
+        int i = 0;
+        for (; i < branches; i += 2)
+        {
+            if (runCondition(script->children[i]) == 0)
+            {
+                status = scriptRun(script->children[i + 1]);
+                break;
+            }
+        }
+        if (i >= branches)
+        {
+            status = script->hasElse ? scriptRun(script->children[branches]) : 0;
+        }
+        break;
+    }
+    case SCRIPT_FOR:
+        status = runFor(script);
+        break;
+    case SCRIPT_WHILE:
+        while (runCondition(script->children[0]) == 0)
+        {
+            status = scriptRun(script->children[1]);
+        }
+        break;
+    }
+
+    varSetStatus(status);
+    return status;
+}
+
+int scriptRunText(const char *text, const char *origin)
+{
+    ScriptNode *script;
+    ScriptParseResult result = scriptParse(text, origin, &script);
+    if (result == SCRIPT_INCOMPLETE)
+    {
+        fprintf(stderr, "%s: syntax error: unexpected end of input\n", origin);
+    }
+    if (result != SCRIPT_OK)
+    {
+        varSetStatus(2);
+        return 2;
+    }
+    return scriptRun(script);
+}
+
+int scriptRunFile(const char *path)
+{
+    int fd = pathOpen(path, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    // The text stays in the command arena while it runs, since the parsed words point into
+    // copies of it. In a background job that is the job's arena, which the prompt never resets.
+    Arena *arena = commandArena();
+    size_t capacity = (S_ISREG(st.st_mode) ? (size_t)st.st_size : 0) + 4096;
+    size_t length = 0;
+    char *text = arenaAlloc(arena, capacity);
+    while (text != NULL)
+    {
+        if (length + 1 == capacity)
+        {
+            text = arenaGrow(arena, text, capacity, 2 * capacity);
+            capacity *= 2;
+            continue;
+        }
+        ssize_t bytesRead = read(fd, text + length, capacity - length - 1);
+        if (bytesRead == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (bytesRead == -1)
+        {
+            fprintf(stderr, "%s: %s\n", path, strerror(errno));
+            close(fd);
+            return 1;
+        }
+        if (bytesRead == 0)
+        {
+            break;
+        }
+        length += bytesRead;
+    }
+    close(fd);
+
+    if (text == NULL)
+    {
+        perror("Failed to read script");
+        return 1;
+    }
+    text[length] = '\0';
+    return scriptRunText(text, path);
+}
+
+char **scriptSimpleCommand(ScriptNode *script)
+{
+    if (script->type != SCRIPT_SEQUENCE || script->childCount != 1)
+    {
+        return NULL;
+    }
+    ScriptNode *command = script->children[0];
+    if (command->type != SCRIPT_COMMAND || command->background)
+    {
+        return NULL;
+    }
+    return buildArguments(command);
+}
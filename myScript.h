@@ -0,0 +1,169 @@
+#ifndef MYSCRIPT_H
+#define MYSCRIPT_H
+
+#include <stdbool.h>
+
+/** `set -e`: a command that fails outside a condition ends the script. */
+#define SCRIPT_OPTION_ERREXIT 1
+/** `set -o pipefail`: a pipeline fails when any of its commands fails. */
+#define SCRIPT_OPTION_PIPEFAIL 2
+/** `set -o atomic`: `echo >` and `cp` replace their target through a temporary file. */
+#define SCRIPT_OPTION_ATOMIC 4
+/** `set -o durable`: like atomic, and the replacements are synced to disk in batches. */
+#define SCRIPT_OPTION_DURABLE 8
+/** `set -o cache`: read-only builtins reuse results stored for unchanged files (see myCache.h). */
+#define SCRIPT_OPTION_CACHE 16
+
+typedef enum
+{
+    SCRIPT_COMMAND,
+    SCRIPT_PIPELINE,
+    SCRIPT_SEQUENCE,
+    SCRIPT_AND,
+    SCRIPT_OR,
+    SCRIPT_IF,
+    SCRIPT_FOR,
+    SCRIPT_WHILE
+} ScriptNodeType;
+
+/**
+ * One word of a simple command as written in the script. Words without `$` are
+ * static: their quotes are removed once, at parse time. Dynamic words keep their
+ * source text and are expanded with `expandLine` each time the command runs.
+ */
+typedef struct
+{
+    char *text;
+    bool dynamic;
+} ScriptWord;
+
+typedef struct ScriptNode ScriptNode;
+
+/**
+ * A node of a parsed script. Which fields are used depends on `type`:
+ *
+ *   SCRIPT_COMMAND   `words`, and `args` when every word is static; `background`
+ *                    when the command ended with `&`.
+ *   SCRIPT_PIPELINE  `children` are the stages, all SCRIPT_COMMAND.
+ *   SCRIPT_SEQUENCE  `children` run one after another.
+ *   SCRIPT_AND/OR    `children[1]` runs if `children[0]` succeeded / failed.
+ *   SCRIPT_IF        `children` holds condition and body pairs, followed by the
+ *                    `else` body when `hasElse` is set.
+ *   SCRIPT_FOR       `name` takes each of `words` in turn; `children[0]` is the body.
+ *   SCRIPT_WHILE     `children[0]` is the condition, `children[1]` the body.
+ */
+struct ScriptNode
+{
+    ScriptNodeType type;
+    ScriptNode **children;
+    int childCount;
+    ScriptWord *words;
+    int wordCount;
+    char **args;
+    char *name;
+    bool hasElse;
+    bool background;
+};
+
+typedef enum
+{
+    SCRIPT_OK,
+    SCRIPT_INCOMPLETE,
+    SCRIPT_ERROR
+} ScriptParseResult;
+
+/**
+ * Parses shell text into a tree that can be run any number of times without being
+ * tokenized again. Besides simple commands the language has `;` and newlines as
+ * separators, `&&`, `||`, `|`, a trailing `&` for background jobs, `#` comments,
+ * `\` line continuations and the compound commands
+ *
+ *   if LIST; then LIST; [elif LIST; then LIST;]... [else LIST;] fi
+ *   for NAME in WORDS; do LIST; done
+ *   while LIST; do LIST; done
+ *
+ * Keywords are only recognized where a command starts, so `echo done` prints "done".
+ * Syntax errors are reported on stderr with the line they occur on.
+ *
+ * Usage example:
+ *   ScriptNode *script;
+ *   if (scriptParse("for f in a b; do cp $f $f.bak; done", "input", &script) == SCRIPT_OK)
+ *       scriptRun(script);
+ *
+ * @param text The script text.
+ * @param origin Name used in error messages, such as the script's file name.
+ * @param script Receives the parsed script, allocated from the command arena.
+ * @return SCRIPT_OK, SCRIPT_INCOMPLETE if the text ended inside a quote, a compound
+ *         command or after an operator (the prompt then asks for another line; no
+ *         error is printed), or SCRIPT_ERROR.
+ */
+ScriptParseResult scriptParse(const char *text, const char *origin, ScriptNode **script);
+
+/**
+ * Runs a parsed script and records the status of every command for `$?`, and the
+ * status of every stage of the last pipeline as the space-separated `$PIPESTATUS`.
+ * `&&` and `||` skip their right side as soon as the left side decides the result.
+ * Pipelines whose stages are all builtins run in-process; others fork one process
+ * per stage. Pending durable writes and buffered appends are flushed before any
+ * command other than `echo` or `cp` runs, so nothing in the script can read a file's
+ * previous content. Everything a command allocates from the command arena is released when
+ * it finishes, so loops run in constant memory.
+ *
+ * @param script The script from `scriptParse`.
+ * @return The exit status of the last command that ran, 0 if none did.
+ */
+int scriptRun(ScriptNode *script);
+
+/**
+ * Parses and runs a string, reporting an unfinished script as a syntax error.
+ *
+ * @param text The script text.
+ * @param origin Name used in error messages.
+ * @return The exit status of the script, 2 on a syntax error.
+ */
+int scriptRunText(const char *text, const char *origin);
+
+/**
+ * Returns the shell options currently set.
+ *
+ * @return A combination of the SCRIPT_OPTION_* flags.
+ */
+int scriptOptions(void);
+
+/**
+ * Turns a shell option on or off. Used by the `set` builtin.
+ *
+ * Usage example:
+ *   scriptSetOption(SCRIPT_OPTION_PIPEFAIL, true);   // set -o pipefail
+ *
+ * @param option One of the SCRIPT_OPTION_* flags.
+ * @param enabled true to turn the option on.
+ */
+void scriptSetOption(int option, bool enabled);
+
+/**
+ * Reads a script file, parses it once and runs it. The text, the parse tree and the
+ * scratch space of every command come from the caller's command arena; a script
+ * started with `source file &` runs in its background job's own arena, so its marks
+ * and restores never touch the prompt loop's memory.
+ *
+ * Usage example:
+ *   int status = scriptRunFile("backup.msh");
+ *
+ * @param path The script file.
+ * @return The exit status of the script, 1 if the file cannot be read, 2 on a
+ *         syntax error.
+ */
+int scriptRunFile(const char *path);
+
+/**
+ * Returns the expanded arguments of a script that consists of one simple foreground
+ * command, so a caller that is about to exit can `exec` it directly.
+ *
+ * @param script The script from `scriptParse`.
+ * @return The NULL-terminated arguments in the command arena (possibly with no
+ *         words at all), or NULL if the script is anything else or expansion failed.
+ */
+char **scriptSimpleCommand(ScriptNode *script);
+
+#endif // MYSCRIPT_H
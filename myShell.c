@@ -1,117 +1,113 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/wait.h>
-#include "myFunction.h" 
+#include "myShell.h"
+#include "myCoro.h"
+#include "myArena.h"
+#include "myVars.h"
+#include "myScript.h"
+#include "myTrace.h"
+#include "myAtomic.h"
+#include "myAppend.h"
 
-int main(void) {
-    char *input;
-    char **args;
-    char *command;
-
-    welcome(); 
-
-    while (1) {
-        getLocation();              
-        printf("> ");
-        input = getInputFromUser(); 
+extern char **environ;
 
-        if (input == NULL || strlen(input) == 0) {
-            free(input);
-            continue;
-        }
-    char *inputCopy = strdup(input); 
-        if (!inputCopy) {
-        perror("Failed to copy input");
-        free(input);
-        continue;
-        }
-    char* trimmedInput = trim(input);
-    if (strncmp(trimmedInput, "exit", 4) == 0) {
-        logout(trimmedInput); 
+/* Joins a continuation line onto the text read so far, separated by a newline. */
+static char *appendLine(char *text, const char *line) {
+    size_t length = strlen(text);
+    char *joined = arenaAlloc(commandArena(), length + strlen(line) + 2);
+    if (joined != NULL) {
+        memcpy(joined, text, length);
+        joined[length] = '\n';
+        strcpy(joined + length + 1, line);
     }
-        char **splitCommands = splitOnPipe(input);
-        if (splitCommands) {
-            char **argv1 = splitArgument(splitCommands[0]);
-            char **argv2 = splitArgument(splitCommands[1]);
+    return joined;
+}
 
-            mypipe(argv1, argv2); 
+int main(int argc, char **argv) {
+    char *input;
+    const char *command = NULL;
+    bool quiet = getenv("MYSHELL_QUIET") != NULL;
+    int option;
 
-            free(argv1);
-            free(argv2);
-            free(splitCommands[0]);
-            free(splitCommands[1]);
-            free(splitCommands);
+    while ((option = getopt(argc, argv, "qc:")) != -1) {
+        if (option == 'q') {
+            quiet = true;
+        } else if (option == 'c') {
+            command = optarg;
         } else {
-            args = splitArgument(input);
+            fprintf(stderr, "Usage: %s [-q] [-c command | script]\n", argv[0]);
+            return 2;
+        }
+    }
 
-            if (args == NULL) {
-                free(input);
-                continue;
-            }
-            int i = 0;
+    traceInit();
+    varInit(environ);
+    bool interactive = command == NULL && optind == argc && isatty(STDIN_FILENO);
+    if (!interactive) {
+        // Nobody watches the output line by line, so it leaves in large writes.
+        setvbuf(stdout, NULL, _IOFBF, SHELL_OUTPUT_BUFFER);
+    }
 
+    if (command != NULL || optind < argc) {
+        int status = command != NULL ? scriptRunText(command, "-c") : scriptRunFile(argv[optind]);
+        fflush(stdout);
+        coroWaitAll();
+        return status;
+    }
+    if (interactive && !quiet) {
+        welcome();
+    }
 
-            command = args[0];
+    while (1) {
+        // Everything the previous command allocated from the arena goes at once.
+        arenaReset(commandArena());
+        coroReportFinished();
+        if (interactive) {
+            getLocation();
+            printf("> ");
+        }
+        input = getInputFromUser();
 
-            if (strcmp(command, "help") == 0) {
-                help();
-            } else if (strcmp(command, "cd") == 0) {
-                cd(args);
-            } else if (strcmp(command, "cp") == 0) {
-                cp(args);
-            } else if (strcmp(command, "delete") == 0) {
-                delete(inputCopy);
-            } else if (strcmp(command, "move") == 0) {
-                move(args);
-            }  else if (strcmp(command, "echo") == 0)
-            {
-                int redirectIndex = 1; 
-                for (; args[redirectIndex] != NULL; redirectIndex++)
-                {
-                    if (strcmp(args[redirectIndex], ">>") == 0 || strcmp(args[redirectIndex], ">") == 0)
-                    {
-                        break; 
-                    }
-                }
+        if (input == NULL) {
+            logout(NULL);
+        }
+        if (strlen(input) == 0) {
+            continue;
+        }
 
-                if (args[redirectIndex] == NULL)
-                {
-                   
-                    for (int i = 1; args[i] != NULL; i++)
-                    {
-                        printf("%s ", args[i]);
-                    }
-                    printf("\n");
-                }
-                else if (args[redirectIndex + 1] == NULL)
-                {
-                    fprintf(stderr, "Error: Redirection operator '%s' found but no file path specified.\n", args[redirectIndex]);
-                }
-                else
-                {
-                    if (strcmp(args[redirectIndex], ">>") == 0)
-                    {
-                        echoppend(args);
-                    }
-                    else
-                    {
-                        echorite(args);
-                    }
-                }
-            } else if (strcmp(command, "read") == 0) {
-                readI(args);
-            } else if (strcmp(command, "wc") == 0) {
-                wordCount(args);
-            } else {
-                printf("Command not found. Type 'help' for a list of commands.\n");
+        // Keep reading while the text ends inside a quote, an if/for/while or after an operator.
+        ScriptNode *script;
+        ScriptParseResult result;
+        while ((result = scriptParse(input, "myShell", &script)) == SCRIPT_INCOMPLETE) {
+            if (interactive) {
+                printf("> ");
+            }
+            char *line = getInputFromUser();
+            if (line == NULL) {
+                fprintf(stderr, "myShell: syntax error: unexpected end of input\n");
+                logout(NULL);
+            }
+            input = appendLine(input, line);
+            if (input == NULL) {
+                break;
             }
-
-            free(args);
         }
-
-        free(input);
+        if (result == SCRIPT_OK) {
+            scriptRun(script);
+            // Appends and durable writes of a command line land once the line is done.
+            if (appendFlush() != 0) {
+                perror("Failed to flush appended data");
+            }
+            if (atomicFlush() != 0) {
+                perror("Failed to flush pending writes");
+            }
+        } else {
+            varSetStatus(2);
+        }
     }
 
     return 0;
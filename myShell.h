@@ -3,12 +3,26 @@
 
 #include "myFunction.h"
 
+/** Size of the standard output buffer when the shell is not talking to a terminal. */
+#define SHELL_OUTPUT_BUFFER (64 * 1024)
+
 /**
  * The main function serves as the entry point for the shell application, initiating
  * the shell's interactive loop and processing user commands.
  * 
+ * Usage:
+ *   myShell                  interactive prompt
+ *   myShell -q               interactive prompt without the welcome banner
+ *   myShell script.msh       run a script file and exit with its status
+ *   myShell -c "command"     run one command line and exit with its status
+ *
  * Features and Flow:
- * 1. Display a welcome message to the user, introducing the shell.
+ * 1. Display a welcome message to the user, introducing the shell, when standard input
+ *    is a terminal, unless `-q` is given or MYSHELL_QUIET is set. When the shell is
+ *    driven by another program (`-c`, a script, or input from a pipe) there is no
+ *    banner and no prompt, the prompt's user and host lookups never happen, and
+ *    standard output is fully buffered instead of line buffered, so starting the shell
+ *    costs little more than the exec itself.
  * 2. Enter an infinite loop to continuously prompt for and handle user commands.
  *    - The loop includes prompting the user with the current location (directory),
  *      reading user input, and processing the input to execute commands.
@@ -16,10 +30,25 @@
  *    (`cp`, `delete`, `move`), text manipulation (`echo`), content display (`readI`),
  *    and informational (`wc`, `help`) commands.
  * 4. Implementation of piping between commands to allow for advanced command chaining.
- * 5. Dynamic memory management to ensure flexibility in handling user input and command
- *    processing, with appropriate cleanup to prevent memory leaks.
- * 6. Clean termination of the shell upon receiving the `exit` command, ensuring all
- *    allocated resources are freed and the shell exits gracefully.
+ * 5. Background execution of builtins with a trailing `&`. Background jobs run as
+ *    coroutines on the shell's own event loop while it waits for the next command.
+ * 6. Shell variables (`NAME=value`, `export`, `set`, `unset`) and expansion of `$NAME`,
+ *    `${NAME}` and `$(command)` before a command line is split into arguments.
+ * 7. Scripting: `;`, `&&`, `||`, `if`, `for` and `while`, with the exit status of the
+ *    last command in `$?`. Each line is parsed once into a tree (see myScript.h), so a
+ *    loop body is not tokenized again on every iteration. A line that ends inside a
+ *    quote, a compound command or after an operator is continued on the next line.
+ *    Given a file name, the shell runs that file as a script and exits with its status.
+ * 8. Tracing: with MYSHELL_TRACE=file (or the `trace` builtin), parse, dispatch,
+ *    builtin and fork/exec/wait spans are recorded and written as Chrome trace JSON.
+ *    When tracing is off each span costs one branch.
+ * 9. Atomic writes: under `set -o atomic` or `set -o durable`, `echo >` and `cp`
+ *    replace files through a temporary file and a rename; durable writes are synced
+ *    in batches after each command line (see myAtomic.h).
+ * 10. Dynamic memory management to ensure flexibility in handling user input and command
+ *     processing, with appropriate cleanup to prevent memory leaks.
+ * 11. Clean termination of the shell upon receiving the `exit` command or end of input,
+ *     waiting for background jobs and exiting with the status of the last command.
  * 
  * The `main` function leverages functions defined in `myFunction.h` for executing
  * individual commands, showcasing the modular design of the shell. It represents a
@@ -0,0 +1,578 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "mySort.h"
+
+typedef struct
+{
+    uint64_t key;
+    size_t offset;
+    size_t length;
+} SortRecord;
+
+struct Sorter
+{
+    SortOptions options;
+    char *text;
+    size_t textUsed;
+    size_t textCapacity;
+    size_t lineStart;
+    SortRecord *records;
+    size_t count;
+    size_t capacity;
+    FILE **runs;
+    int runCount;
+    bool failed;
+    int savedErrno;
+};
+
+/* One input of the k-way merge: a sorted slice of the in-memory batch or a run file. */
+typedef struct
+{
+    const char *line;
+    size_t length;
+    uint64_t key;
+    const SortRecord *next;
+    const SortRecord *end;
+    const char *text;
+    FILE *run;
+    char *buffer;
+    size_t bufferSize;
+} MergeSource;
+
+typedef struct
+{
+    SortRecord *records;
+    SortRecord *scratch;
+    size_t count;
+    const Sorter *sorter;
+} SortPart;
+
+/* Maps a double to an integer with the same order, so numbers sort as keys. */
+static uint64_t numberKey(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL;
+}
+
+/* The leading number of a line, read like `sort -n` does: blanks, an optional
+   minus sign, digits and an optional fraction. Lines without one count as 0. */
+static double leadingNumber(const char *line, size_t length)
+{
+    char number[64];
+    size_t i = 0, n = 0;
+    while (i < length && (line[i] == ' ' || line[i] == '\t'))
+    {
+        i++;
+    }
+    if (i < length && line[i] == '-')
+    {
+        number[n++] = line[i++];
+    }
+    bool seenPoint = false;
+    while (i < length && n < sizeof(number) - 1 &&
+           ((line[i] >= '0' && line[i] <= '9') || (line[i] == '.' && !seenPoint)))
+    {
+        seenPoint |= line[i] == '.';
+        number[n++] = line[i++];
+    }
+    number[n] = '\0';
+    return strtod(number, NULL);
+}
+
+static uint64_t lineKey(const Sorter *sorter, const char *line, size_t length)
+{
+    if (sorter->options.numeric)
+    {
+        return numberKey(leadingNumber(line, length));
+    }
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        key = key << 8 | (i < length ? (unsigned char)line[i] : 0);
+    }
+    return key;
+}
+
+static int compareBytes(const char *a, size_t aLength, const char *b, size_t bLength)
+{
+    int result = memcmp(a, b, aLength < bLength ? aLength : bLength);
+    if (result != 0)
+    {
+        return result;
+    }
+    return aLength < bLength ? -1 : aLength > bLength;
+}
+
+static int compareRecords(const void *a, const void *b, void *text)
+{
+    const SortRecord *left = a, *right = b;
+    return compareBytes((const char *)text + left->offset, left->length,
+                        (const char *)text + right->offset, right->length);
+}
+
+/* LSD radix sort on the 64-bit keys, one byte per pass. Passes in which every key
+   has the same byte are skipped, so short common prefixes cost nothing. Records with
+   equal keys are then put in order by their full text. */
+static void radixSort(SortRecord *records, SortRecord *scratch, size_t count, const char *text)
+{
+    SortRecord *from = records, *to = scratch;
+    for (int shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {0};
+        for (size_t i = 0; i < count; i++)
+        {
+            counts[(from[i].key >> shift) & 0xff]++;
+        }
+        if (count == 0 || counts[(from[0].key >> shift) & 0xff] == count)
+        {
+            continue;
+        }
+        size_t position = 0;
+        for (int b = 0; b < 256; b++)
+        {
+            size_t bucket = counts[b];
+            counts[b] = position;
+            position += bucket;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            to[counts[(from[i].key >> shift) & 0xff]++] = from[i];
+        }
+        SortRecord *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != records)
+    {
+        memcpy(records, from, count * sizeof(SortRecord));
+    }
+
+    for (size_t start = 0; start < count;)
+    {
+        size_t end = start + 1;
+        while (end < count && records[end].key == records[start].key)
+        {
+            end++;
+        }
+        if (end - start > 1)
+        {
+            qsort_r(records + start, end - start, sizeof(SortRecord), compareRecords, (void *)text);
+        }
+        start = end;
+    }
+}
+
+static void *sortPart(void *arg)
+{
+    SortPart *part = arg;
+    radixSort(part->records, part->scratch, part->count, part->sorter->text);
+    if (part->sorter->options.reverse)
+    {
+        for (size_t i = 0, j = part->count; i + 1 < j; i++, j--)
+        {
+            SortRecord swap = part->records[i];
+            part->records[i] = part->records[j - 1];
+            part->records[j - 1] = swap;
+        }
+    }
+    return NULL;
+}
+
+/* Sorts the batch in up to SORT_MAX_THREADS contiguous parts. Returns the number of
+   parts, each described in `parts`, or -1 if memory ran out. */
+static int sortBatch(Sorter *sorter, SortPart *parts)
+{
+    SortRecord *scratch = malloc((sorter->count > 0 ? sorter->count : 1) * sizeof(SortRecord));
+    if (scratch == NULL)
+    {
+        return -1;
+    }
+
+    int partCount = 1;
+    if (sorter->count >= SORT_PARALLEL_THRESHOLD)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        partCount = cpus < 1 ? 1 : cpus > SORT_MAX_THREADS ? SORT_MAX_THREADS : (int)cpus;
+    }
+    size_t perPart = (sorter->count + partCount - 1) / partCount;
+    pthread_t threads[SORT_MAX_THREADS];
+    bool started[SORT_MAX_THREADS] = {false};
+    for (int i = 0; i < partCount; i++)
+    {
+        size_t first = (size_t)i * perPart;
+        size_t last = first + perPart < sorter->count ? first + perPart : sorter->count;
+        parts[i] = (SortPart){sorter->records + first, scratch + first, first < last ? last - first : 0, sorter};
+        // The calling thread sorts the first part itself.
+        if (i > 0 && pthread_create(&threads[i], NULL, sortPart, &parts[i]) == 0)
+        {
+            started[i] = true;
+        }
+    }
+    for (int i = 0; i < partCount; i++)
+    {
+        if (!started[i])
+        {
+            sortPart(&parts[i]);
+        }
+    }
+    for (int i = 1; i < partCount; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    free(scratch);
+    return partCount;
+}
+
+static int compareSources(const Sorter *sorter, const MergeSource *a, const MergeSource *b)
+{
+    int result = a->key != b->key ? (a->key < b->key ? -1 : 1) : compareBytes(a->line, a->length, b->line, b->length);
+    return sorter->options.reverse ? -result : result;
+}
+
+/* Loads the next line of a source. Returns false when the source is exhausted. */
+static bool advanceSource(const Sorter *sorter, MergeSource *source)
+{
+    if (source->run == NULL)
+    {
+        if (source->next == source->end)
+        {
+            return false;
+        }
+        source->line = source->text + source->next->offset;
+        source->length = source->next->length;
+        source->key = source->next->key;
+        source->next++;
+        return true;
+    }
+
+    ssize_t length = getline(&source->buffer, &source->bufferSize, source->run);
+    if (length <= 0)
+    {
+        return false;
+    }
+    if (source->buffer[length - 1] == '\n')
+    {
+        length--;
+    }
+    source->line = source->buffer;
+    source->length = (size_t)length;
+    source->key = lineKey(sorter, source->line, source->length);
+    return true;
+}
+
+static void siftDown(const Sorter *sorter, MergeSource **heap, int size, int i)
+{
+    for (;;)
+    {
+        int smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < size && compareSources(sorter, heap[left], heap[smallest]) < 0)
+        {
+            smallest = left;
+        }
+        if (right < size && compareSources(sorter, heap[right], heap[smallest]) < 0)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+        MergeSource *swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/* Merges the sorted parts of the batch and the first `runCount` runs into `out`
+   with a binary heap. */
+static int mergeSources(Sorter *sorter, SortPart *parts, int partCount, int runCount, FILE *out)
+{
+    int total = partCount + runCount;
+    MergeSource *sources = calloc(total, sizeof(MergeSource));
+    MergeSource **heap = calloc(total, sizeof(MergeSource *));
+    if (sources == NULL || heap == NULL)
+    {
+        free(sources);
+        free(heap);
+        return -1;
+    }
+
+    int size = 0;
+    for (int i = 0; i < total; i++)
+    {
+        MergeSource *source = &sources[i];
+        if (i < partCount)
+        {
+            source->next = parts[i].records;
+            source->end = parts[i].records + parts[i].count;
+            source->text = sorter->text;
+        }
+        else
+        {
+            source->run = sorter->runs[i - partCount];
+            rewind(source->run);
+        }
+        if (advanceSource(sorter, source))
+        {
+            heap[size++] = source;
+        }
+    }
+    for (int i = size / 2 - 1; i >= 0; i--)
+    {
+        siftDown(sorter, heap, size, i);
+    }
+
+    // With -u the last line written is kept to drop the copies that follow it.
+    char *previous = NULL;
+    size_t previousLength = 0, previousCapacity = 0;
+    uint64_t previousKey = 0;
+    bool havePrevious = false;
+    int result = 0;
+    while (size > 0 && result == 0)
+    {
+        MergeSource *top = heap[0];
+        bool duplicate = sorter->options.unique && havePrevious && top->key == previousKey &&
+                         (sorter->options.numeric || compareBytes(top->line, top->length, previous, previousLength) == 0);
+        if (!duplicate)
+        {
+            if (fwrite(top->line, 1, top->length, out) != top->length || fputc('\n', out) == EOF)
+            {
+                result = -1;
+            }
+            if (sorter->options.unique)
+            {
+                if (top->length > previousCapacity)
+                {
+                    char *grown = realloc(previous, top->length);
+                    if (grown == NULL)
+                    {
+                        result = -1;
+                        break;
+                    }
+                    previous = grown;
+                    previousCapacity = top->length;
+                }
+                memcpy(previous, top->line, top->length);
+                previousLength = top->length;
+                previousKey = top->key;
+                havePrevious = true;
+            }
+        }
+        if (!advanceSource(sorter, top))
+        {
+            heap[0] = heap[--size];
+        }
+        siftDown(sorter, heap, size, 0);
+    }
+    for (int i = 0; i < total; i++)
+    {
+        if (sources[i].run != NULL && ferror(sources[i].run))
+        {
+            result = -1;
+        }
+        free(sources[i].buffer);
+    }
+    free(previous);
+    free(sources);
+    free(heap);
+    return result;
+}
+
+static FILE *openRunFile(void)
+{
+    const char *directory = getenv("TMPDIR");
+    int fd = open(directory != NULL && directory[0] != '\0' ? directory : "/tmp", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd == -1)
+    {
+        return tmpfile();
+    }
+    FILE *run = fdopen(fd, "w+");
+    if (run == NULL)
+    {
+        close(fd);
+    }
+    return run;
+}
+
+/* Sorts the batch in memory and writes it out as a new run, keeping only the line
+   that is still being read. */
+static int spillRun(Sorter *sorter)
+{
+    FILE **runs = realloc(sorter->runs, (sorter->runCount + 1) * sizeof(FILE *));
+    if (runs == NULL)
+    {
+        return -1;
+    }
+    sorter->runs = runs;
+    FILE *run = openRunFile();
+    if (run == NULL)
+    {
+        return -1;
+    }
+
+    SortPart parts[SORT_MAX_THREADS];
+    int partCount = sortBatch(sorter, parts);
+    // Runs are merged again later, so they are written in plain order; only the
+    // final merge applies -u.
+    bool unique = sorter->options.unique;
+    sorter->options.unique = false;
+    int result = partCount < 0 ? -1 : mergeSources(sorter, parts, partCount, 0, run);
+    sorter->options.unique = unique;
+    if (result != 0 || fflush(run) != 0)
+    {
+        fclose(run);
+        return -1;
+    }
+    sorter->runs[sorter->runCount++] = run;
+
+    size_t partial = sorter->textUsed - sorter->lineStart;
+    memmove(sorter->text, sorter->text + sorter->lineStart, partial);
+    sorter->textUsed = partial;
+    sorter->lineStart = 0;
+    sorter->count = 0;
+    return 0;
+}
+
+static int addRecord(Sorter *sorter, size_t offset, size_t length)
+{
+    if (sorter->count == sorter->capacity)
+    {
+        size_t capacity = sorter->capacity * 2;
+        SortRecord *records = realloc(sorter->records, capacity * sizeof(SortRecord));
+        if (records == NULL)
+        {
+            return -1;
+        }
+        sorter->records = records;
+        sorter->capacity = capacity;
+    }
+    sorter->records[sorter->count++] =
+        (SortRecord){lineKey(sorter, sorter->text + offset, length), offset, length};
+    return 0;
+}
+
+Sorter *sorterCreate(const SortOptions *options)
+{
+    Sorter *sorter = calloc(1, sizeof(Sorter));
+    if (sorter == NULL)
+    {
+        return NULL;
+    }
+    sorter->options = *options;
+    if (sorter->options.memoryBudget == 0)
+    {
+        sorter->options.memoryBudget = SORT_MEMORY_BUDGET;
+    }
+    sorter->textCapacity = 64 * 1024;
+    sorter->capacity = 1024;
+    sorter->text = malloc(sorter->textCapacity);
+    sorter->records = malloc(sorter->capacity * sizeof(SortRecord));
+    if (sorter->text == NULL || sorter->records == NULL)
+    {
+        sorterDestroy(sorter);
+        return NULL;
+    }
+    return sorter;
+}
+
+static int fail(Sorter *sorter)
+{
+    sorter->failed = true;
+    sorter->savedErrno = errno;
+    return 1;
+}
+
+int sorterConsume(const char *data, size_t length, void *ctx)
+{
+    Sorter *sorter = ctx;
+    size_t held = sorter->textUsed + sorter->count * sizeof(SortRecord);
+    if (sorter->count > 0 && held + length > sorter->options.memoryBudget && spillRun(sorter) != 0)
+    {
+        return fail(sorter);
+    }
+
+    if (sorter->textUsed + length > sorter->textCapacity)
+    {
+        size_t capacity = sorter->textCapacity;
+        while (capacity < sorter->textUsed + length)
+        {
+            capacity *= 2;
+        }
+        char *text = realloc(sorter->text, capacity);
+        if (text == NULL)
+        {
+            return fail(sorter);
+        }
+        sorter->text = text;
+        sorter->textCapacity = capacity;
+    }
+    size_t scanFrom = sorter->textUsed;
+    memcpy(sorter->text + sorter->textUsed, data, length);
+    sorter->textUsed += length;
+
+    const char *newline;
+    while ((newline = memchr(sorter->text + scanFrom, '\n', sorter->textUsed - scanFrom)) != NULL)
+    {
+        size_t end = newline - sorter->text;
+        if (addRecord(sorter, sorter->lineStart, end - sorter->lineStart) != 0)
+        {
+            return fail(sorter);
+        }
+        sorter->lineStart = end + 1;
+        scanFrom = end + 1;
+    }
+    return 0;
+}
+
+int sorterFinish(Sorter *sorter, FILE *out)
+{
+    if (!sorter->failed && sorter->lineStart < sorter->textUsed)
+    {
+        if (addRecord(sorter, sorter->lineStart, sorter->textUsed - sorter->lineStart) != 0)
+        {
+            fail(sorter);
+        }
+        sorter->lineStart = sorter->textUsed;
+    }
+    if (sorter->failed)
+    {
+        errno = sorter->savedErrno;
+        return -1;
+    }
+
+    SortPart parts[SORT_MAX_THREADS];
+    int partCount = sortBatch(sorter, parts);
+    if (partCount < 0 || mergeSources(sorter, parts, partCount, sorter->runCount, out) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+void sorterDestroy(Sorter *sorter)
+{
+    if (sorter == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < sorter->runCount; i++)
+    {
+        fclose(sorter->runs[i]);
+    }
+    free(sorter->runs);
+    free(sorter->text);
+    free(sorter->records);
+    free(sorter);
+}
@@ -0,0 +1,80 @@
+#ifndef MYSORT_H
+#define MYSORT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** Bytes of lines held in memory before a sorted run is spilled to a temporary file. */
+#define SORT_MEMORY_BUDGET (64 * 1024 * 1024)
+/** Most threads that sort one batch of lines. */
+#define SORT_MAX_THREADS 8
+/** Batches with fewer lines than this are sorted by the calling thread alone. */
+#define SORT_PARALLEL_THRESHOLD 65536
+
+typedef struct
+{
+    bool numeric;
+    bool reverse;
+    bool unique;
+    size_t memoryBudget;
+} SortOptions;
+
+typedef struct Sorter Sorter;
+
+/**
+ * Creates a line sorter. Lines are collected in memory until `memoryBudget` bytes
+ * are held; the batch is then sorted and written to an unnamed temporary file in
+ * $TMPDIR (or /tmp) as a sorted run, so input of any size can be sorted in bounded
+ * memory. `sorterFinish` merges the runs and the last batch with a k-way heap.
+ *
+ * A batch is sorted with an LSD radix sort on an 8-byte key per line: the first
+ * eight bytes of the line, or with `numeric` the value of its leading number. Lines
+ * whose keys are equal are then ordered by their full bytes. Batches of at least
+ * SORT_PARALLEL_THRESHOLD lines are split between up to SORT_MAX_THREADS threads,
+ * one per CPU, whose sorted parts are merged with the runs.
+ *
+ * Usage example:
+ *   SortOptions options = {.numeric = true, .memoryBudget = SORT_MEMORY_BUDGET};
+ *   Sorter *sorter = sorterCreate(&options);
+ *   ioScan(fd, sorterConsume, sorter);
+ *   sorterFinish(sorter, stdout);
+ *   sorterDestroy(sorter);
+ *
+ * @param options How to order the lines. `unique` keeps one line of each group of
+ *                equal lines (with `numeric`, of lines with the same value); a zero
+ *                `memoryBudget` means SORT_MEMORY_BUDGET.
+ * @return The sorter, or NULL if memory is exhausted.
+ */
+Sorter *sorterCreate(const SortOptions *options);
+
+/**
+ * Adds input to a sorter. Data is split into lines at '\n'; a line may continue
+ * from one call into the next. Matches `IOConsumer`, so it can be passed to `ioScan`.
+ *
+ * @param data The input bytes.
+ * @param length Number of bytes.
+ * @param ctx The sorter.
+ * @return 0 to continue, 1 if a run could not be spilled or memory ran out.
+ */
+int sorterConsume(const char *data, size_t length, void *ctx);
+
+/**
+ * Sorts what is left, merges it with any spilled runs and writes every line, each
+ * ending in '\n', to `out`. A last line without a newline is still sorted.
+ *
+ * @param sorter The sorter.
+ * @param out The stream receiving the sorted lines.
+ * @return 0 on success, -1 with errno set if sorting, reading a run or writing
+ *         failed (including an earlier failure in `sorterConsume`).
+ */
+int sorterFinish(Sorter *sorter, FILE *out);
+
+/**
+ * Releases a sorter and its temporary runs.
+ *
+ * @param sorter The sorter, or NULL.
+ */
+void sorterDestroy(Sorter *sorter);
+
+#endif // MYSORT_H
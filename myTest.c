@@ -0,0 +1,946 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "myFunction.h"
+#include "myArena.h"
+#include "myEmbed.h"
+
+/* Size of the file the background copies in the jobs scenario work on. */
+#define TEST_BIG_FILE (64L * 1024 * 1024)
+#define TEST_OUTPUT_MAX (1024 * 1024)
+/* A session still running this long after its last line is killed, as hung. */
+#define TEST_SESSION_TIMEOUT_MS 60000
+/* Subdirectories of the wide tree, more than the walk queue and the descriptor
+   limit the walk runs under. */
+#define TEST_WIDE_DIRS 1500
+#define TEST_WIDE_FD_LIMIT 256
+/* The sort input: TEST_SORT_VALUES distinct numbers, each on TEST_SORT_REPEATS
+   lines, over 2 MiB in all, so `sort -S 1` spills runs and merges them. */
+#define TEST_SORT_VALUES 1000
+#define TEST_SORT_REPEATS 600
+#define TEST_GZIP_LINES 6000
+/* Apparent size of the sparse file copied incrementally; only a few blocks hold data. */
+#define TEST_SPARSE_FILE (100L * 1024 * 1024)
+/* The parser timing gate runs each input at both sizes; linear work grows by
+   TEST_TIMING_LARGE / TEST_TIMING_SMALL, and a ratio above TEST_TIMING_RATIO fails. */
+#define TEST_TIMING_SMALL (256 * 1024)
+#define TEST_TIMING_LARGE (1024 * 1024)
+#define TEST_TIMING_RATIO 8.0
+#define TEST_TIMING_REPEATS 3
+#define TEST_PROPERTY_RUNS 2000
+
+static int failures = 0;
+
+static void report(const char *name, bool passed, const char *detail)
+{
+    if (passed)
+    {
+        printf("PASS %s\n", name);
+    }
+    else
+    {
+        printf("FAIL %s: %s\n", name, detail);
+        failures++;
+    }
+}
+
+static void writeFile(const char *dir, const char *name, const char *text, size_t length)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *file = fopen(path, "w");
+    if (file == NULL || fwrite(text, 1, length, file) != length || fclose(file) != 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static int removeEntry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)st;
+    (void)type;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+static void removeTree(const char *dir)
+{
+    nftw(dir, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* Runs the shell interactively in `dir`, feeding it `lines` one at a time with
+   `delayMs` between them so that background jobs run while the prompt loop reads.
+   A line starting with '!' is not sent: it is run with /bin/sh in `dir`, standing for
+   another program changing files behind the shell's back. A line "^C" sends the
+   shell SIGINT, as Ctrl-C would. Standard output and error are collected in
+   `output`. Returns the exit status, or 128 plus the signal number if the shell
+   crashed or was killed for hanging. */
+static int runSession(const char *shell, const char *dir, const char **lines, int count, int delayMs,
+                      char *output, size_t capacity)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/session.out", dir);
+    int outFd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int input[2];
+    if (outFd == -1 || pipe(input) == -1)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0)
+    {
+        if (chdir(dir) == -1)
+        {
+            perror(dir);
+            _exit(127);
+        }
+        dup2(input[0], STDIN_FILENO);
+        dup2(outFd, STDOUT_FILENO);
+        dup2(outFd, STDERR_FILENO);
+        close(input[0]);
+        close(input[1]);
+        close(outFd);
+        execl(shell, shell, "-q", (char *)NULL);
+        perror("execl");
+        _exit(127);
+    }
+
+    close(input[0]);
+    for (int i = 0; i < count; i++)
+    {
+        if (delayMs > 0)
+        {
+            usleep(delayMs * 1000);
+        }
+        if (strcmp(lines[i], "^C") == 0)
+        {
+            kill(pid, SIGINT);
+            continue;
+        }
+        if (lines[i][0] == '!')
+        {
+            char command[PATH_MAX + 256];
+            snprintf(command, sizeof(command), "cd '%s' && %s", dir, lines[i] + 1);
+            if (system(command) != 0)
+            {
+                fprintf(stderr, "%s failed\n", lines[i] + 1);
+            }
+            continue;
+        }
+        // A shell that already died closes the pipe; the status tells why.
+        if (write(input[1], lines[i], strlen(lines[i])) == -1 || write(input[1], "\n", 1) == -1)
+        {
+            break;
+        }
+    }
+    close(input[1]);
+
+    int status;
+    int waitedMs = 0;
+    while (waitpid(pid, &status, WNOHANG) == 0)
+    {
+        if (waitedMs >= TEST_SESSION_TIMEOUT_MS)
+        {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            break;
+        }
+        usleep(10 * 1000);
+        waitedMs += 10;
+    }
+    ssize_t length = pread(outFd, output, capacity - 1, 0);
+    output[length > 0 ? length : 0] = '\0';
+    close(outFd);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/* Splits `line` and compares the arguments with the NULL-terminated `expected`. */
+static bool argumentsAre(const char *line, const char **expected)
+{
+    char *copy = strdup(line);
+    char **arguments = copy != NULL ? splitArgument(copy) : NULL;
+    bool same = arguments != NULL;
+    int i = 0;
+    for (; same && expected[i] != NULL; i++)
+    {
+        same = arguments[i] != NULL && strcmp(arguments[i], expected[i]) == 0;
+    }
+    same = same && arguments[i] == NULL;
+    free(copy);
+    arenaReset(commandArena());
+    return same;
+}
+
+static void testTokens(void)
+{
+    const char *words[] = {"a", "b c", "", "d", NULL};
+    const char *spaced[] = {"a", "b", NULL};
+    const char *none[] = {NULL};
+    const char *empty[] = {"", NULL};
+    const char *joined[] = {"abc", NULL};
+    report("quoted and empty tokens", argumentsAre("a \"b c\" \"\" d", words), "a \"b c\" \"\" d");
+    report("repeated, leading and trailing spaces", argumentsAre("   a    b   ", spaced), "   a    b   ");
+    report("blank line has no tokens", argumentsAre("    ", none) && argumentsAre("", none), "\"    \"");
+    report("a lone empty quote is one token", argumentsAre("\"\"", empty), "\"\"");
+    report("quotes inside a word are dropped", argumentsAre("\"a\"b\"c\"", joined), "\"a\"b\"c\"");
+
+    // Random words, some empty and some with spaces, quoted and joined by runs of
+    // spaces, split back into the same words.
+    static const char alphabet[] = "ab |$/()'";
+    char line[512];
+    char tokens[8][16];
+    const char *expected[9];
+    bool passed = true;
+    srand(7);
+    for (int run = 0; run < TEST_PROPERTY_RUNS && passed; run++)
+    {
+        int count = rand() % 8;
+        size_t used = (size_t)(rand() % 3);
+        memset(line, ' ', used);
+        for (int w = 0; w < count; w++)
+        {
+            int length = rand() % 6;
+            for (int c = 0; c < length; c++)
+            {
+                tokens[w][c] = alphabet[rand() % (sizeof(alphabet) - 1)];
+            }
+            tokens[w][length] = '\0';
+            expected[w] = tokens[w];
+            used += sprintf(line + used, "\"%s\"%*s", tokens[w], 1 + rand() % 3, "");
+        }
+        expected[count] = NULL;
+        line[used] = '\0';
+        passed = argumentsAre(line, expected);
+    }
+    report("random quoted words split back the same", passed, line);
+}
+
+/* Splits `line` on its pipe and compares both sides, or expects no split when
+   `before` is NULL. */
+static bool pipeSidesAre(const char *line, const char *before, const char *after)
+{
+    char **sides = splitOnPipe(line);
+    bool same = before == NULL ? sides == NULL
+                               : sides != NULL && strcmp(sides[0], before) == 0 && strcmp(sides[1], after) == 0;
+    arenaReset(commandArena());
+    return same;
+}
+
+static void testPipeSides(void)
+{
+    report("lone pipe has two empty sides", pipeSidesAre("|", "", ""), "|");
+    report("empty side before the pipe", pipeSidesAre("  | x", "", "x"), "  | x");
+    report("empty side after the pipe", pipeSidesAre("x |  ", "x", ""), "x |  ");
+    report("line without a pipe is not split", pipeSidesAre("a b", NULL, NULL), "a b");
+    report("pipe inside $(...) is not split",
+           pipeSidesAre("echo $(a | b) | wc", "echo $(a | b)", "wc"), "echo $(a | b) | wc");
+}
+
+static bool pathIs(const char *raw, const char *expected)
+{
+    char *copy = strdup(raw);
+    char *path = copy != NULL ? normalizePath(copy) : NULL;
+    bool same = path != NULL && strcmp(path, expected) == 0;
+    poolFree(path);
+    free(copy);
+    return same;
+}
+
+static void testPaths(void)
+{
+    report("empty and quote-only paths", pathIs("", "") && pathIs("\"\"", "") && pathIs(" \" \" ", ""), "\" \"");
+    report("quotes, spaces and slashes", pathIs(" \"/a//b/ \" ", "/a/b/"), " \"/a//b/ \" ");
+    report("spaces before a slash", pathIs("a  /b", "a/b") && pathIs("a / /b", "a/b"), "a  /b");
+    report("spaces inside a name are kept", pathIs("my  file", "my  file"), "my  file");
+
+    static const char alphabet[] = " /\"ab";
+    char raw[32];
+    bool passed = true;
+    srand(11);
+    for (int run = 0; run < TEST_PROPERTY_RUNS && passed; run++)
+    {
+        int length = rand() % (int)(sizeof(raw) - 1);
+        for (int i = 0; i < length; i++)
+        {
+            raw[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        raw[length] = '\0';
+        char *once = normalizePath(raw);
+        passed = once != NULL && pathIs(once, once) && strstr(once, "//") == NULL;
+        poolFree(once);
+    }
+    report("normalizing a normalized path changes nothing", passed, raw);
+}
+
+static bool trimmedIs(const char *text, const char *expected)
+{
+    char *copy = strdup(text);
+    bool same = copy != NULL && strcmp(trim(copy), expected) == 0;
+    free(copy);
+    return same;
+}
+
+static void testTrim(void)
+{
+    report("trim of an empty string", trimmedIs("", ""), "\"\"");
+    report("trim of a blank string", trimmedIs(" \t\n ", ""), "\" \\t\\n \"");
+    report("trim of one character", trimmedIs("x", "x") && trimmedIs(" x", "x") && trimmedIs("x ", "x"), "x");
+    report("trim keeps inner spaces", trimmedIs(" \ta  b\n", "a  b"), "\" \\ta  b\\n\"");
+    report("trim of NULL", trim(NULL) == NULL, "not NULL");
+}
+
+static void fillQuotes(char *text, size_t size)
+{
+    memset(text, '"', size);
+}
+
+static void fillQuotedWords(char *text, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        text[i] = "\"a b\" "[i % 6];
+    }
+}
+
+static void fillPipeInSpaces(char *text, size_t size)
+{
+    memset(text, ' ', size);
+    text[size / 2] = '|';
+}
+
+static void fillSubstitutions(char *text, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        text[i] = "$()"[i % 3];
+    }
+    text[size - 1] = '|';
+}
+
+static void fillSlashesAndQuotes(char *text, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        text[i] = "/  \"/"[i % 5];
+    }
+}
+
+static void fillSpacesAroundWord(char *text, size_t size)
+{
+    memset(text, ' ', size);
+    text[size / 2] = 'x';
+}
+
+static void runSplitArgument(char *text)
+{
+    splitArgument(text);
+}
+
+static void runSplitOnPipe(char *text)
+{
+    splitOnPipe(text);
+}
+
+static void runNormalizePath(char *text)
+{
+    poolFree(normalizePath(text));
+}
+
+static void runTrim(char *text)
+{
+    trim(text);
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fill)(char *text, size_t size);
+    void (*run)(char *text);
+} TimedParse;
+
+/* Best time in seconds of `timed` on a fresh input of `size` bytes. */
+static double timeParse(const TimedParse *timed, char *text, size_t size)
+{
+    double best = 0;
+    for (int repeat = 0; repeat < TEST_TIMING_REPEATS; repeat++)
+    {
+        timed->fill(text, size);
+        text[size] = '\0';
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        timed->run(text);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        arenaReset(commandArena());
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (repeat == 0 || seconds < best)
+        {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+/* Fails a parser whose time grows faster than its input. Below a few milliseconds
+   the timer is mostly noise, and no quadratic pass over a megabyte is that fast. */
+static void testParserTiming(void)
+{
+    static const TimedParse cases[] = {
+        {"quotes through splitArgument", fillQuotes, runSplitArgument},
+        {"quoted words through splitArgument", fillQuotedWords, runSplitArgument},
+        {"spaces around a pipe through splitOnPipe", fillPipeInSpaces, runSplitOnPipe},
+        {"$() before a pipe through splitOnPipe", fillSubstitutions, runSplitOnPipe},
+        {"quotes through splitOnPipe", fillQuotes, runSplitOnPipe},
+        {"slashes, spaces and quotes through normalizePath", fillSlashesAndQuotes, runNormalizePath},
+        {"quotes through normalizePath", fillQuotes, runNormalizePath},
+        {"spaces through trim", fillSpacesAroundWord, runTrim},
+    };
+    char *text = malloc(TEST_TIMING_LARGE + 1);
+    if (text == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        double small = timeParse(&cases[i], text, TEST_TIMING_SMALL);
+        double large = timeParse(&cases[i], text, TEST_TIMING_LARGE);
+        double ratio = large / (small > 1e-9 ? small : 1e-9);
+        char name[96], detail[96];
+        snprintf(name, sizeof(name), "linear time: %s", cases[i].name);
+        snprintf(detail, sizeof(detail), "%.2f ms for 256 KB, %.2f ms for 1 MB", small * 1e3, large * 1e3);
+        report(name, ratio <= TEST_TIMING_RATIO || large < 0.005, detail);
+    }
+    free(text);
+}
+
+static void testParser(void)
+{
+    testTokens();
+    testPipeSides();
+    testPaths();
+    testTrim();
+    testParserTiming();
+}
+
+static char *makeDir(void)
+{
+    static char dir[64];
+    snprintf(dir, sizeof(dir), "/tmp/myTest.XXXXXX");
+    if (mkdtemp(dir) == NULL)
+    {
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+    return dir;
+}
+
+/* A script run with `source ... &` keeps its text, parse tree and arguments while
+   the prompt loop runs and resets its own arena for every foreground command. */
+static void testBackgroundScript(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    char *data = malloc(TEST_BIG_FILE);
+    if (data == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (long i = 0; i < TEST_BIG_FILE; i++)
+    {
+        data[i] = (char)(i * 7 + i / 4096);
+    }
+    writeFile(dir, "big.bin", data, TEST_BIG_FILE);
+    free(data);
+    const char *script = "echo step1\ncp big.bin c1.bin\necho step2\ncp big.bin c2.bin\n"
+                         "echo step3\ncp big.bin c3.bin\necho step4\ncp big.bin c4.bin\necho step5\n";
+    writeFile(dir, "s2.msh", script, strlen(script));
+
+    // Long foreground lines fill and reset the prompt's arena while the job runs.
+    static char echo[3100];
+    memcpy(echo, "echo ", 5);
+    memset(echo + 5, 'x', 3000);
+    echo[3005] = '\0';
+    const char *lines[43];
+    int count = 0;
+    lines[count++] = "source s2.msh &";
+    for (int i = 0; i < 40; i++)
+    {
+        lines[count++] = echo;
+    }
+    lines[count++] = "wait";
+    lines[count++] = "echo finished";
+
+    int status = runSession(shell, dir, lines, count, 20, output, TEST_OUTPUT_MAX);
+    bool steps = true;
+    for (int i = 1; i <= 5; i++)
+    {
+        char step[16];
+        snprintf(step, sizeof(step), "step%d", i);
+        steps = steps && strstr(output, step) != NULL;
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "status %d, all steps printed: %s", status, steps ? "yes" : "no");
+    report("background script survives foreground commands", status == 0 && steps && strstr(output, "finished") != NULL,
+           detail);
+    removeTree(dir);
+}
+
+/* A looping script in the background takes and restores arena marks for every
+   command, interleaved with the foreground's own loops; each side must see only
+   its own words. */
+static void testBackgroundLoop(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    char *data = calloc(1, TEST_BIG_FILE / 4);
+    if (data == NULL)
+    {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    writeFile(dir, "big.bin", data, TEST_BIG_FILE / 4);
+    free(data);
+    const char *script = "for i in 1 2 3 4 5 6 7 8; do\n"
+                         "    X=\"job $i\"\n"
+                         "    cp big.bin loop.bin\n"
+                         "    echo \"$X done\"\n"
+                         "done\n";
+    writeFile(dir, "s3.msh", script, strlen(script));
+
+    // The foreground loops carry a long word, so they overwrite whatever the job
+    // would still be using from a shared arena.
+    static char loop[2200];
+    int length = snprintf(loop, sizeof(loop), "for w in alpha beta gamma; do Y=\"");
+    memset(loop + length, 'y', 2000);
+    snprintf(loop + length + 2000, sizeof(loop) - length - 2000, "\"; echo \"fg $w\" > fg.txt; done");
+    const char *lines[34];
+    int count = 0;
+    lines[count++] = "source s3.msh &";
+    for (int i = 0; i < 30; i++)
+    {
+        lines[count++] = loop;
+    }
+    lines[count++] = "wait";
+    lines[count++] = "read fg.txt";
+
+    int status = runSession(shell, dir, lines, count, 20, output, TEST_OUTPUT_MAX);
+    bool iterations = true;
+    for (int i = 1; i <= 8; i++)
+    {
+        char line[32];
+        snprintf(line, sizeof(line), "job %d done", i);
+        iterations = iterations && strstr(output, line) != NULL;
+    }
+    char detail[64];
+    snprintf(detail, sizeof(detail), "status %d, every iteration printed: %s", status, iterations ? "yes" : "no");
+    report("background loop keeps its words", status == 0 && iterations && strstr(output, "fg gamma") != NULL, detail);
+    removeTree(dir);
+}
+
+/* A directory renamed and recreated by a command the shell ran, through a command
+   substitution, an external pipeline stage or the move builtin, is written to under
+   its new identity, not through the descriptor the path cache held for the old one. */
+static void testRenamedDirectory(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/d", dir);
+    mkdir(path, 0755);
+    const char *lines[] = {"echo one > d/f", "read d/f",
+                           "X=$(/bin/sh -c \"mv d d_sub && mkdir d\")", "echo two > d/f", "read d_sub/f",
+                           "/bin/sh -c \"mv d d_pipe && mkdir d\" | wc -l", "echo three > d/f", "read d_pipe/f",
+                           "move d d_move", "X=$(/bin/mkdir d)", "echo four > d/f", "read d_move/f", "read d/f"};
+    int status = runSession(shell, dir, lines, 13, 0, output, TEST_OUTPUT_MAX);
+    // Each renamed directory keeps the line written before its rename.
+    const char *expected[] = {"one", "one", "two", "three", "four"};
+    const char *at = output;
+    for (int i = 0; i < 5 && at != NULL; i++)
+    {
+        at = strstr(at, expected[i]);
+        at = at != NULL ? at + strlen(expected[i]) : NULL;
+    }
+    char detail[96];
+    snprintf(detail, sizeof(detail), "status %d, output \"%.60s\"", status, output);
+    report("rename by a command the shell ran", status == 0 && at != NULL, detail);
+    removeTree(dir);
+}
+
+/* `..` after a symbolic link goes to the parent of the link's target for file
+   operations, as the kernel resolves it, while `cd ..` stays logical. */
+static void testDotDotAfterLink(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/real", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/real/sub", dir);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/lnk", dir);
+    if (symlink("real/sub", path) != 0)
+    {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    writeFile(dir, "real/file", "inside real\n", 12);
+    writeFile(dir, "file", "at the top\n", 11);
+    const char *lines[] = {"read lnk/../file", "cd lnk", "cd ..", "read file"};
+    int status = runSession(shell, dir, lines, 4, 0, output, TEST_OUTPUT_MAX);
+    char *physical = strstr(output, "inside real");
+    char *logical = strstr(output, "at the top");
+    char detail[64];
+    snprintf(detail, sizeof(detail), "status %d, output \"%.30s\"", status, output);
+    report("dot-dot after a link", status == 0 && physical != NULL && logical != NULL && physical < logical, detail);
+    removeTree(dir);
+}
+
+/* An assignment from a failing command substitution fails, as in other shells. */
+static void testSubstitutionStatus(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    const char *lines[] = {"X=$(false); echo \"status $?\"", "if X=$(false); then echo taken; else echo skipped; fi",
+                           "Y=$(true); echo \"status $?\"", "echo $(false) && echo \"echo ok\""};
+    int status = runSession(shell, dir, lines, 4, 0, output, TEST_OUTPUT_MAX);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "status %d, output \"%.60s\"", status, output);
+    char *failed = strstr(output, "status 1");
+    report("status of an assignment from $(...)",
+           status == 0 && failed != NULL && strstr(output, "skipped") != NULL && strstr(output, "taken") == NULL &&
+               strstr(failed, "status 0") != NULL && strstr(output, "echo ok") != NULL,
+           detail);
+    removeTree(dir);
+}
+
+/* `tail -f` in the background is a job like any other: the prompt keeps reading
+   commands while it follows the file, and Ctrl-C ends it. */
+static void testBackgroundTail(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    writeFile(dir, "f.log", "start\n", 6);
+    // The shell writes alive.txt only if it still runs commands; the tail then
+    // shows its text once it is appended to the log.
+    const char *lines[] = {"tail -f f.log &", "echo prompt-alive > alive.txt", "!cat alive.txt >> f.log",
+                           "echo after", "^C"};
+    int status = runSession(shell, dir, lines, 5, 300, output, TEST_OUTPUT_MAX);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "status %d, output \"%.60s\"", status, output);
+    report("tail -f in the background", status == 0 && strstr(output, "prompt-alive") != NULL &&
+                                            strstr(output, "after") != NULL,
+           detail);
+    removeTree(dir);
+}
+
+/* A tree wider than the walk queue and than the descriptor limit is walked whole:
+   find and du see every directory, and du agrees with the system's du. */
+static void testWideTree(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/wide", dir);
+    mkdir(path, 0755);
+    for (int i = 0; i < TEST_WIDE_DIRS; i++)
+    {
+        char name[32];
+        snprintf(path, sizeof(path), "%s/wide/d%d", dir, i);
+        mkdir(path, 0755);
+        snprintf(name, sizeof(name), "wide/d%d/f", i);
+        writeFile(dir, name, "data\n", 5);
+    }
+    char command[PATH_MAX + 32];
+    snprintf(command, sizeof(command), "cd '%s' && du -s wide", dir);
+    char expected[64] = "";
+    FILE *du = popen(command, "r");
+    if (du != NULL)
+    {
+        if (fgets(expected, sizeof(expected), du) == NULL)
+        {
+            expected[0] = '\0';
+        }
+        pclose(du);
+    }
+
+    // The shell inherits the lower limit; the tests themselves keep theirs.
+    struct rlimit saved, lowered;
+    getrlimit(RLIMIT_NOFILE, &saved);
+    lowered = saved;
+    lowered.rlim_cur = TEST_WIDE_FD_LIMIT;
+    setrlimit(RLIMIT_NOFILE, &lowered);
+    const char *lines[] = {"find wide -type d | wc -l", "du -s wide"};
+    int status = runSession(shell, dir, lines, 2, 0, output, TEST_OUTPUT_MAX);
+    setrlimit(RLIMIT_NOFILE, &saved);
+
+    char count[32];
+    snprintf(count, sizeof(count), "Line count: %d\n", TEST_WIDE_DIRS + 1);
+    char detail[192];
+    snprintf(detail, sizeof(detail), "status %d, expected \"%.40s\", output \"%.60s\"", status, expected, output);
+    report("find and du over a wide tree", status == 0 && expected[0] != '\0' && strstr(output, count) != NULL &&
+                                               strstr(output, expected) != NULL && strstr(output, "Too many") == NULL,
+           detail);
+    removeTree(dir);
+}
+
+/* `exit` in a background job ends the job; the shell goes on and exits with the
+   status of its own `exit`. */
+static void testBackgroundExit(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    const char *script = "echo job-start\nexit 5\necho job-after-exit\n";
+    writeFile(dir, "ex.msh", script, strlen(script));
+    const char *lines[] = {"source ex.msh &", "exit 3 &", "wait", "echo prompt-alive", "jobs", "exit 4"};
+    int status = runSession(shell, dir, lines, 6, 50, output, TEST_OUTPUT_MAX);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "status %d, output \"%.60s\"", status, output);
+    report("exit in a background job", status == 4 && strstr(output, "job-start") != NULL &&
+                                            strstr(output, "job-after-exit") == NULL &&
+                                            strstr(output, "prompt-alive") != NULL,
+           detail);
+    removeTree(dir);
+}
+
+static int compareText(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Runs one sort command line on the generated input and compares all of its output. */
+static void checkSort(const char *shell, const char *dir, const char *line, const char *expected, char *output)
+{
+    int status = runSession(shell, dir, &line, 1, 0, output, TEST_OUTPUT_MAX);
+    char name[96];
+    snprintf(name, sizeof(name), "%s", line);
+    char detail[192];
+    size_t same = 0;
+    while (output[same] != '\0' && output[same] == expected[same])
+    {
+        same++;
+    }
+    snprintf(detail, sizeof(detail), "status %d, differs at byte %zu: \"%.40s\" instead of \"%.40s\"", status, same,
+             output + same, expected + same);
+    report(name, status == 0 && strcmp(output, expected) == 0, detail);
+}
+
+static void testSortSpill(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    size_t capacity = (size_t)TEST_SORT_VALUES * TEST_SORT_REPEATS * 8;
+    char *text = malloc(capacity);
+    char *expected = malloc(TEST_OUTPUT_MAX);
+    char **values = malloc(TEST_SORT_VALUES * sizeof(char *));
+    if (text == NULL || expected == NULL || values == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    // Stepping by a number prime to the count visits every value once per pass, out of order.
+    size_t length = 0;
+    for (long i = 0; i < (long)TEST_SORT_VALUES * TEST_SORT_REPEATS; i++)
+    {
+        length += sprintf(text + length, "%ld\n", i * 7 % TEST_SORT_VALUES);
+    }
+    writeFile(dir, "numbers.txt", text, length);
+
+    // Numeric order, checked run by run: uniq -c only counts adjacent lines.
+    length = 0;
+    for (int value = 0; value < TEST_SORT_VALUES; value++)
+    {
+        length += sprintf(expected + length, "%7d %d\n", TEST_SORT_REPEATS, value);
+    }
+    checkSort(shell, dir, "sort -S 1 -n numbers.txt | uniq -c", expected, output);
+
+    length = 0;
+    for (int value = TEST_SORT_VALUES - 1; value >= 0; value--)
+    {
+        length += sprintf(expected + length, "%d\n", value);
+    }
+    checkSort(shell, dir, "sort -S 1 -n -r -u numbers.txt", expected, output);
+
+    // Byte order puts "10" before "2"; read ends its output with an empty line, which sorts first.
+    for (int value = 0; value < TEST_SORT_VALUES; value++)
+    {
+        values[value] = text + value * 8;
+        sprintf(values[value], "%d", value);
+    }
+    qsort(values, TEST_SORT_VALUES, sizeof(char *), compareText);
+    length = sprintf(expected, "\n");
+    for (int value = 0; value < TEST_SORT_VALUES; value++)
+    {
+        length += sprintf(expected + length, "%s\n", values[value]);
+    }
+    checkSort(shell, dir, "read numbers.txt | sort -S 1 -u", expected, output);
+
+    free(values);
+    free(expected);
+    free(text);
+    removeTree(dir);
+}
+
+static void testCompressedRead(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    // Two gzip members, as appending to a compressed log leaves them.
+    char generate[128];
+    snprintf(generate, sizeof(generate), "!seq 1 %d | gzip -c > log.gz && seq %d %d | gzip -c >> log.gz",
+             TEST_GZIP_LINES / 2, TEST_GZIP_LINES / 2 + 1, TEST_GZIP_LINES);
+    const char *lines[] = {generate, "read log.gz | wc -l", "wc -l log.gz"};
+    int status = runSession(shell, dir, lines, 3, 0, output, TEST_OUTPUT_MAX);
+    // read ends its output with an empty line, so the pipeline counts one more.
+    char expected[64];
+    snprintf(expected, sizeof(expected), "Line count: %d\nLine count: %d\n", TEST_GZIP_LINES + 1, TEST_GZIP_LINES);
+    char detail[96];
+    snprintf(detail, sizeof(detail), "status %d, output \"%.60s\"", status, output);
+    report("read and wc of a gzip file", status == 0 && strcmp(output, expected) == 0, detail);
+    removeTree(dir);
+}
+
+static void testSparseIncrementalCopy(const char *shell, char *output)
+{
+    char *dir = makeDir();
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/sparse.img", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool made = fd >= 0 && ftruncate(fd, TEST_SPARSE_FILE) == 0 &&
+                pwrite(fd, "middle", 6, TEST_SPARSE_FILE / 2) == 6 && pwrite(fd, "end", 3, TEST_SPARSE_FILE - 3) == 3;
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    const char *lines[] = {"cp --incremental sparse.img copy.img", "cp --incremental sparse.img copy.img"};
+    int status = made ? runSession(shell, dir, lines, 2, 0, output, TEST_OUTPUT_MAX) : -1;
+
+    struct stat source, copy;
+    snprintf(path, sizeof(path), "%s/sparse.img", dir);
+    bool sourceSparse = stat(path, &source) == 0 && source.st_blocks * 512L < TEST_SPARSE_FILE / 4;
+    snprintf(path, sizeof(path), "%s/copy.img", dir);
+    bool copied = stat(path, &copy) == 0 && copy.st_size == TEST_SPARSE_FILE;
+    char command[PATH_MAX + 32];
+    snprintf(command, sizeof(command), "cmp -s '%s/sparse.img' '%s/copy.img'", dir, dir);
+    bool same = copied && system(command) == 0;
+
+    char detail[160];
+    snprintf(detail, sizeof(detail), "status %d, %lld of %lld bytes allocated, output \"%.60s\"", status,
+             copied ? (long long)copy.st_blocks * 512 : -1LL, (long long)TEST_SPARSE_FILE, output);
+    // A file system that cannot hold holes leaves nothing to check for sparseness.
+    report("incremental copy of a sparse file", status == 0 && same &&
+                                                     (!sourceSparse || copy.st_blocks <= source.st_blocks) &&
+                                                     strstr(output, "File unchanged, copy skipped.") != NULL,
+           detail);
+    removeTree(dir);
+}
+
+/* Runs one command through the library and compares its status and captured output. */
+static void checkEmbed(MshContext *ctx, const char *name, const char *command, int expectedStatus,
+                       const char *expected)
+{
+    char output[256];
+    MshResult result = {output, sizeof(output)};
+    int status = msh_exec(ctx, command, &result);
+    char detail[160];
+    snprintf(detail, sizeof(detail), "status %d, result status %d, output \"%.*s\"", status, result.status,
+             (int)(result.length < sizeof(output) ? result.length : sizeof(output)), output);
+    report(name, status == expectedStatus && result.status == expectedStatus && msh_status(ctx) == expectedStatus &&
+                     result.length == strlen(expected) && memcmp(output, expected, result.length) == 0,
+           detail);
+}
+
+/* The shell linked in as libmyshell.a: output is captured per command, and neither
+   `exit` nor `set -e` ends the program running the commands. echo ends each word
+   with a space. */
+static void testEmbed(void)
+{
+    MshContext *ctx = msh_create();
+    if (ctx == NULL)
+    {
+        perror("msh_create");
+        exit(EXIT_FAILURE);
+    }
+    checkEmbed(ctx, "msh_exec captures output", "echo hello", 0, "hello \n");
+    checkEmbed(ctx, "msh_exec captures a pipeline", "echo a b c | wc -w", 0, "Word count: 3\n");
+    checkEmbed(ctx, "exit ends only the command line", "echo before; exit 7; echo after", 7, "before \n");
+    checkEmbed(ctx, "exit in a background job", "exit 3 &", 0, "");
+    checkEmbed(ctx, "set -e ends only the command line", "set -e; false; echo after", 1, "");
+    checkEmbed(ctx, "the program still runs commands", "set +e; X=kept; echo $X", 0, "kept \n");
+
+    // Output beyond the buffer is counted but not written.
+    char output[4];
+    MshResult results[] = {{output, sizeof(output)}, {NULL, 0}};
+    const char *commands[] = {"echo abcdefgh", "true"};
+    size_t failed = msh_exec_many(ctx, commands, results, 2);
+    report("msh_exec_many cuts output at the capacity",
+           failed == 0 && results[0].length == 10 && memcmp(output, "abcd", 4) == 0 && results[1].status == 0,
+           "output not cut at the capacity");
+    msh_destroy(ctx);
+}
+
+static void testShell(const char *shell)
+{
+    char *output = malloc(TEST_OUTPUT_MAX);
+    if (output == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    testBackgroundScript(shell, output);
+    testBackgroundLoop(shell, output);
+    testRenamedDirectory(shell, output);
+    testDotDotAfterLink(shell, output);
+    testSubstitutionStatus(shell, output);
+    testBackgroundTail(shell, output);
+    testBackgroundExit(shell, output);
+    testWideTree(shell, output);
+    testSparseIncrementalCopy(shell, output);
+    testSortSpill(shell, output);
+    testCompressedRead(shell, output);
+    free(output);
+}
+
+int main(int argc, char **argv)
+{
+    const char *suite = argc > 1 ? argv[1] : "shell";
+    // A shell that crashed is reported from its status, not by killing the tests.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (strcmp(suite, "shell") == 0)
+    {
+        // The sessions run in their own directories, so a relative path would not work.
+        char shell[PATH_MAX];
+        if (realpath(argc > 2 ? argv[2] : "./myShell", shell) == NULL)
+        {
+            perror("shell");
+            return EXIT_FAILURE;
+        }
+        testShell(shell);
+    }
+    else if (strcmp(suite, "parser") == 0)
+    {
+        testParser();
+    }
+    else if (strcmp(suite, "embed") == 0)
+    {
+        testEmbed();
+    }
+    else
+    {
+        fprintf(stderr, "Usage: %s [parser | embed | shell [shell]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    printf("%d failed\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
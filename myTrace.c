@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "myTrace.h"
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t duration;
+    pid_t pid;
+    pid_t tid;
+    char category[16];
+    char name[TRACE_NAME_SIZE];
+    char detail[TRACE_DETAIL_SIZE];
+} TraceEvent;
+
+bool traceEnabled = false;
+
+static TraceEvent *events = NULL;
+static uint64_t nextEvent = 0;
+static char *tracePath = NULL;
+static pid_t ownerPid = 0;
+static bool exitHandlerInstalled = false;
+static __thread pid_t threadId = 0;
+
+uint64_t traceNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void copyText(char *destination, size_t size, const char *text)
+{
+    if (text == NULL)
+    {
+        destination[0] = '\0';
+        return;
+    }
+    size_t length = strnlen(text, size - 1);
+    memcpy(destination, text, length);
+    destination[length] = '\0';
+}
+
+void traceRecord(const char *category, const char *name, const char *detail, uint64_t start, pid_t pid)
+{
+    uint64_t end = traceNow();
+    if (events == NULL)
+    {
+        return;
+    }
+    if (threadId == 0)
+    {
+        threadId = syscall(SYS_gettid);
+    }
+
+    // Threads claim slots with one atomic increment; the ring wraps onto the oldest spans.
+    uint64_t index = __atomic_fetch_add(&nextEvent, 1, __ATOMIC_RELAXED);
+    TraceEvent *event = &events[index % TRACE_CAPACITY];
+    event->start = start;
+    event->duration = end - start;
+    event->pid = pid != 0 ? pid : ownerPid;
+    event->tid = pid != 0 ? pid : threadId;
+    copyText(event->category, sizeof(event->category), category);
+    copyText(event->name, sizeof(event->name), name);
+    copyText(event->detail, sizeof(event->detail), detail);
+}
+
+/* Writes `text` as the contents of a JSON string. */
+static void writeJsonString(FILE *out, const char *text)
+{
+    for (; *text != '\0'; text++)
+    {
+        unsigned char c = *text;
+        if (c == '"' || c == '\\')
+        {
+            fprintf(out, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(out, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, out);
+        }
+    }
+}
+
+int traceDump(const char *path)
+{
+    if (path == NULL)
+    {
+        path = tracePath;
+    }
+    if (path == NULL)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+    {
+        return -1;
+    }
+
+    uint64_t last = __atomic_load_n(&nextEvent, __ATOMIC_RELAXED);
+    uint64_t first = last > TRACE_CAPACITY ? last - TRACE_CAPACITY : 0;
+    fprintf(out, "{\"traceEvents\":[\n");
+    fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"myShell\"}}", (int)ownerPid);
+    for (uint64_t i = first; events != NULL && i < last; i++)
+    {
+        TraceEvent *event = &events[i % TRACE_CAPACITY];
+        fprintf(out, ",\n{\"name\":\"");
+        writeJsonString(out, event->name);
+        fprintf(out, "\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+                event->category, event->start / 1000.0, event->duration / 1000.0, (int)event->pid, (int)event->tid);
+        if (event->detail[0] != '\0')
+        {
+            fprintf(out, ",\"args\":{\"detail\":\"");
+            writeJsonString(out, event->detail);
+            fprintf(out, "\"}");
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    if (fclose(out) != 0)
+    {
+        return -1;
+    }
+    return (int)(last - first);
+}
+
+void traceClear(void)
+{
+    __atomic_store_n(&nextEvent, 0, __ATOMIC_RELAXED);
+}
+
+/* Forked children inherit the buffer; only the shell itself writes the file. */
+static void dumpAtExit(void)
+{
+    if (events != NULL && tracePath != NULL && getpid() == ownerPid)
+    {
+        if (traceDump(NULL) == -1)
+        {
+            perror(tracePath);
+        }
+    }
+}
+
+int traceSetEnabled(bool enabled, const char *path)
+{
+    if (path != NULL)
+    {
+        char *copy = strdup(path);
+        if (copy == NULL)
+        {
+            return -1;
+        }
+        free(tracePath);
+        tracePath = copy;
+    }
+    if (enabled && events == NULL)
+    {
+        events = calloc(TRACE_CAPACITY, sizeof(TraceEvent));
+        if (events == NULL)
+        {
+            return -1;
+        }
+    }
+    if (!exitHandlerInstalled)
+    {
+        atexit(dumpAtExit);
+        exitHandlerInstalled = true;
+    }
+    ownerPid = getpid();
+    traceEnabled = enabled;
+    return 0;
+}
+
+void traceInit(void)
+{
+    const char *path = getenv("MYSHELL_TRACE");
+    if (path != NULL && path[0] != '\0' && traceSetEnabled(true, path) == -1)
+    {
+        perror("Failed to start tracing");
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef MYTRACE_H
+#define MYTRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define TRACE_CAPACITY 65536
+#define TRACE_NAME_SIZE 32
+#define TRACE_DETAIL_SIZE 64
+
+/** True while spans are being recorded. Checked inline before any other trace work. */
+extern bool traceEnabled;
+
+/**
+ * Reads MYSHELL_TRACE at startup. When it names a file, recording starts at once and
+ * the recorded spans are written to that file, in Chrome trace-event JSON, when the
+ * shell exits. The file can be opened in chrome://tracing or Perfetto.
+ *
+ * Usage example:
+ *   $ MYSHELL_TRACE=session.json myShell
+ */
+void traceInit(void);
+
+/**
+ * Returns the current time in nanoseconds on the monotonic clock.
+ */
+uint64_t traceNow(void);
+
+/**
+ * Starts a span: returns its start time when tracing is on, and 0 without reading the
+ * clock when it is off, so an untraced shell pays one predictable branch per span.
+ *
+ * Usage example:
+ *   uint64_t span = TRACE_BEGIN();
+ *   int status = cp(args);
+ *   TRACE_END(span, "builtin", "cp", args[1]);
+ */
+#define TRACE_BEGIN() (traceEnabled ? traceNow() : 0)
+
+/** Ends a span started with TRACE_BEGIN. Does nothing if it was started while off. */
+#define TRACE_END(start, category, name, detail)                   \
+    do                                                             \
+    {                                                              \
+        if (start)                                                 \
+            traceRecord((category), (name), (detail), (start), 0); \
+    } while (0)
+
+/**
+ * Records a finished span in the trace ring buffer. Once the buffer is full the
+ * oldest spans are overwritten, so a long session keeps its most recent history.
+ * Safe to call from pipeline stage threads.
+ *
+ * @param category Span category, such as "parse", "builtin" or "process".
+ * @param name Span name. Copied, truncated to TRACE_NAME_SIZE - 1 characters.
+ * @param detail Extra text shown with the span, or NULL. Copied and truncated.
+ * @param start Start time from `traceNow`.
+ * @param pid Process the span belongs to, or 0 for the shell's current thread. Used to
+ *            show forked children on their own rows.
+ */
+void traceRecord(const char *category, const char *name, const char *detail, uint64_t start, pid_t pid);
+
+/**
+ * Turns recording on or off. Turning it on allocates the ring buffer the first time.
+ *
+ * @param enabled true to record spans.
+ * @param path File written at exit, or NULL to keep the current one.
+ * @return 0 on success, -1 if the buffer could not be allocated.
+ */
+int traceSetEnabled(bool enabled, const char *path);
+
+/**
+ * Writes the spans currently in the ring buffer to a file as Chrome trace-event JSON.
+ *
+ * @param path The file to write, or NULL for the MYSHELL_TRACE file.
+ * @return The number of spans written, or -1 with errno set on failure.
+ */
+int traceDump(const char *path);
+
+/**
+ * Forgets all recorded spans.
+ */
+void traceClear(void);
+
+#endif // MYTRACE_H
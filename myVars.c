@@ -0,0 +1,684 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "myVars.h"
+#include "myArena.h"
+#include "myFunction.h"
+#include "myTrace.h"
+#include "myPath.h"
+
+typedef struct
+{
+    char *name;
+    char *value;
+    uint64_t hash;
+    bool exported;
+} Variable;
+
+typedef struct
+{
+    Arena *arena;
+    char *data;
+    size_t length;
+    size_t capacity;
+} ExpandBuffer;
+
+/* Marks a deleted slot, so probes for other names continue past it. */
+static char tombstone[1];
+
+static Variable *table = NULL;
+static size_t capacity = 0;
+static size_t count = 0;
+static size_t used = 0;
+static pthread_mutex_t varLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* An environment built for child processes. The store holds one reference to the
+   current one and every `varEnviron` caller another, so a rebuild never frees an
+   array a pipeline is still forking with. Counted under varLock. */
+typedef struct
+{
+    size_t references;
+    char *entries[];
+} Environment;
+
+static Environment *environCache = NULL;
+static bool environDirty = true;
+
+// Set by the main thread and by the threads running builtin pipeline stages.
+static int lastStatus = 0;
+// Status of the last $(...) expanded on this thread since the command's words were started.
+static __thread int substitutionStatus = 0;
+
+static uint64_t hashName(const char *name, size_t length)
+{
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool varValidName(const char *name, size_t length)
+{
+    if (length == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+    {
+        return false;
+    }
+    for (size_t i = 1; i < length; i++)
+    {
+        if (!(isalnum((unsigned char)name[i]) || name[i] == '_'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Returns the slot holding `name`, or the slot where it should be inserted (the
+   first tombstone passed, else the empty slot that ended the probe). Called with
+   varLock held and a table allocated. */
+static Variable *findSlot(const char *name, size_t length, uint64_t hash)
+{
+    size_t mask = capacity - 1;
+    Variable *insertAt = NULL;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        Variable *slot = &table[i];
+        if (slot->name == NULL)
+        {
+            return insertAt != NULL ? insertAt : slot;
+        }
+        if (slot->name == tombstone)
+        {
+            if (insertAt == NULL)
+            {
+                insertAt = slot;
+            }
+        }
+        else if (slot->hash == hash && strncmp(slot->name, name, length) == 0 && slot->name[length] == '\0')
+        {
+            return slot;
+        }
+    }
+}
+
+static int growTable(void)
+{
+    size_t newCapacity = capacity == 0 ? VARS_INITIAL_CAPACITY : capacity * 2;
+    Variable *newTable = calloc(newCapacity, sizeof(Variable));
+    if (newTable == NULL)
+    {
+        return -1;
+    }
+
+    Variable *oldTable = table;
+    size_t oldCapacity = capacity;
+    table = newTable;
+    capacity = newCapacity;
+    used = count;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldTable[i].name != NULL && oldTable[i].name != tombstone)
+        {
+            *findSlot(oldTable[i].name, strlen(oldTable[i].name), oldTable[i].hash) = oldTable[i];
+        }
+    }
+    free(oldTable);
+    return 0;
+}
+
+/* Looks a name up, creating an empty unexported variable when `create` is set.
+   Called with varLock held. */
+static Variable *lookup(const char *name, size_t length, bool create)
+{
+    if ((used + 1) * 10 > capacity * 7 && growTable() != 0)
+    {
+        return NULL;
+    }
+
+    uint64_t hash = hashName(name, length);
+    Variable *slot = findSlot(name, length, hash);
+    if (slot->name != NULL && slot->name != tombstone)
+    {
+        return slot;
+    }
+    if (!create)
+    {
+        return NULL;
+    }
+
+    char *copy = poolAlloc(length + 1);
+    char *value = poolStrdup("");
+    if (copy == NULL || value == NULL)
+    {
+        poolFree(copy);
+        poolFree(value);
+        return NULL;
+    }
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    if (slot->name == NULL)
+    {
+        used++;
+    }
+    count++;
+    slot->name = copy;
+    slot->value = value;
+    slot->hash = hash;
+    slot->exported = false;
+    return slot;
+}
+
+void varInit(char **envp)
+{
+    for (int i = 0; envp != NULL && envp[i] != NULL; i++)
+    {
+        const char *equals = strchr(envp[i], '=');
+        if (equals == NULL || !varValidName(envp[i], equals - envp[i]))
+        {
+            continue;
+        }
+
+        pthread_mutex_lock(&varLock);
+        Variable *variable = lookup(envp[i], equals - envp[i], true);
+        char *value = variable != NULL ? poolStrdup(equals + 1) : NULL;
+        if (value != NULL)
+        {
+            poolFree(variable->value);
+            variable->value = value;
+            variable->exported = true;
+        }
+        pthread_mutex_unlock(&varLock);
+    }
+    environDirty = true;
+}
+
+int varSet(const char *name, const char *value, bool exported)
+{
+    size_t length = strlen(name);
+    if (!varValidName(name, length))
+    {
+        return -1;
+    }
+
+    char *copy = poolStrdup(value);
+    if (copy == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&varLock);
+    Variable *variable = lookup(name, length, true);
+    if (variable == NULL)
+    {
+        pthread_mutex_unlock(&varLock);
+        poolFree(copy);
+        return -1;
+    }
+    poolFree(variable->value);
+    variable->value = copy;
+    variable->exported = variable->exported || exported;
+    if (variable->exported)
+    {
+        environDirty = true;
+    }
+    pthread_mutex_unlock(&varLock);
+    return 0;
+}
+
+int varExport(const char *name)
+{
+    size_t length = strlen(name);
+    if (!varValidName(name, length))
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&varLock);
+    Variable *variable = lookup(name, length, true);
+    if (variable != NULL)
+    {
+        variable->exported = true;
+        environDirty = true;
+    }
+    pthread_mutex_unlock(&varLock);
+    return variable != NULL ? 0 : -1;
+}
+
+void varUnset(const char *name)
+{
+    pthread_mutex_lock(&varLock);
+    Variable *variable = capacity > 0 ? lookup(name, strlen(name), false) : NULL;
+    if (variable != NULL)
+    {
+        if (variable->exported)
+        {
+            environDirty = true;
+        }
+        poolFree(variable->name);
+        poolFree(variable->value);
+        variable->name = tombstone;
+        variable->value = NULL;
+        count--;
+    }
+    pthread_mutex_unlock(&varLock);
+}
+
+/* Copies a variable's value into the expansion buffer under the lock, so a
+   concurrent `varSet` cannot free it halfway through. */
+static char *lookupCopy(const char *name, size_t length, Arena *arena)
+{
+    char *copy = NULL;
+    pthread_mutex_lock(&varLock);
+    Variable *variable = capacity > 0 ? lookup(name, length, false) : NULL;
+    if (variable != NULL)
+    {
+        copy = arena != NULL ? arenaStrdup(arena, variable->value) : poolStrdup(variable->value);
+    }
+    pthread_mutex_unlock(&varLock);
+    return copy;
+}
+
+char *varDup(const char *name)
+{
+    return lookupCopy(name, strlen(name), NULL);
+}
+
+/* Drops one reference to an environment. Called with varLock held. */
+static void releaseEnvironment(Environment *environment)
+{
+    if (environment == NULL || --environment->references > 0)
+    {
+        return;
+    }
+    for (int i = 0; environment->entries[i] != NULL; i++)
+    {
+        free(environment->entries[i]);
+    }
+    free(environment);
+}
+
+char **varEnviron(void)
+{
+    pthread_mutex_lock(&varLock);
+    if (environDirty || environCache == NULL)
+    {
+        size_t exported = 0;
+        for (size_t i = 0; i < capacity; i++)
+        {
+            if (table[i].name != NULL && table[i].name != tombstone && table[i].exported)
+            {
+                exported++;
+            }
+        }
+
+        Environment *environment = calloc(1, sizeof(Environment) + (exported + 1) * sizeof(char *));
+        if (environment != NULL)
+        {
+            environment->references = 1;
+            size_t index = 0;
+            for (size_t i = 0; i < capacity; i++)
+            {
+                Variable *variable = &table[i];
+                if (variable->name == NULL || variable->name == tombstone || !variable->exported)
+                {
+                    continue;
+                }
+                size_t size = strlen(variable->name) + strlen(variable->value) + 2;
+                environment->entries[index] = malloc(size);
+                if (environment->entries[index] != NULL)
+                {
+                    snprintf(environment->entries[index], size, "%s=%s", variable->name, variable->value);
+                    index++;
+                }
+            }
+
+            releaseEnvironment(environCache);
+            environCache = environment;
+            environDirty = false;
+        }
+    }
+    char **envp = NULL;
+    if (environCache != NULL)
+    {
+        environCache->references++;
+        envp = environCache->entries;
+    }
+    pthread_mutex_unlock(&varLock);
+    return envp;
+}
+
+void varEnvironRelease(char **envp)
+{
+    if (envp == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&varLock);
+    releaseEnvironment((Environment *)((char *)envp - offsetof(Environment, entries)));
+    pthread_mutex_unlock(&varLock);
+}
+
+static int compareByName(const void *a, const void *b)
+{
+    return strcmp(((const Variable *)a)->name, ((const Variable *)b)->name);
+}
+
+void varPrint(FILE *out, bool exportedOnly)
+{
+    Arena *arena = commandArena();
+
+    // Take a snapshot and print it unlocked: `out` may be a pipeline ring whose
+    // reader is itself waiting for the variable lock.
+    pthread_mutex_lock(&varLock);
+    Variable *snapshot = arenaAlloc(arena, (count + 1) * sizeof(Variable));
+    size_t taken = 0;
+    for (size_t i = 0; snapshot != NULL && i < capacity; i++)
+    {
+        Variable *variable = &table[i];
+        if (variable->name == NULL || variable->name == tombstone || (exportedOnly && !variable->exported))
+        {
+            continue;
+        }
+        snapshot[taken].name = arenaStrdup(arena, variable->name);
+        snapshot[taken].value = arenaStrdup(arena, variable->value);
+        if (snapshot[taken].name != NULL && snapshot[taken].value != NULL)
+        {
+            taken++;
+        }
+    }
+    pthread_mutex_unlock(&varLock);
+
+    if (snapshot == NULL)
+    {
+        return;
+    }
+    qsort(snapshot, taken, sizeof(Variable), compareByName);
+    for (size_t i = 0; i < taken; i++)
+    {
+        fprintf(out, "%s%s=%s\n", exportedOnly ? "export " : "", snapshot[i].name, snapshot[i].value);
+    }
+}
+
+static int reserve(ExpandBuffer *buffer, size_t extra)
+{
+    if (buffer->length + extra + 1 <= buffer->capacity)
+    {
+        return 0;
+    }
+
+    size_t newCapacity = buffer->capacity * 2;
+    while (newCapacity < buffer->length + extra + 1)
+    {
+        newCapacity *= 2;
+    }
+    char *grown = arenaGrow(buffer->arena, buffer->data, buffer->capacity, newCapacity);
+    if (grown == NULL)
+    {
+        return -1;
+    }
+    buffer->data = grown;
+    buffer->capacity = newCapacity;
+    return 0;
+}
+
+static int append(ExpandBuffer *buffer, const char *text, size_t length)
+{
+    if (reserve(buffer, length) != 0)
+    {
+        return -1;
+    }
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    return 0;
+}
+
+/* Returns the index just past the `)` closing a `$(` that starts at `start`, or -1
+   if it is never closed. Nested substitutions are skipped as a whole. */
+static int closingParenthesis(const char *text, int start)
+{
+    int depth = 0;
+    for (int i = start; text[i] != '\0'; i++)
+    {
+        if (text[i] == '$' && text[i + 1] == '(')
+        {
+            depth++;
+            i++;
+        }
+        else if (text[i] == ')' && --depth == 0)
+        {
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+int findPipeSymbol(const char *command)
+{
+    for (int i = 0; command[i] != '\0'; i++)
+    {
+        if (command[i] == '$' && command[i + 1] == '(')
+        {
+            int end = closingParenthesis(command, i);
+            if (end == -1)
+            {
+                return -1;
+            }
+            i = end - 1;
+        }
+        else if (command[i] == '|')
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Runs `command` in a child process and appends its standard output. */
+static int substituteCommand(ExpandBuffer *buffer, const char *command, size_t length)
+{
+    char *line = arenaAlloc(buffer->arena, length + 1);
+    if (line == NULL)
+    {
+        return -1;
+    }
+    memcpy(line, command, length);
+    line[length] = '\0';
+
+    int fds[2];
+    if (pipe(fds) == -1)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    uint64_t span = TRACE_BEGIN();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[1]);
+        execCommandLine(line);
+    }
+
+    close(fds[1]);
+    size_t start = buffer->length;
+    int result = 0;
+    for (;;)
+    {
+        if (reserve(buffer, BUFSIZ) != 0)
+        {
+            result = -1;
+            break;
+        }
+        ssize_t got = read(fds[0], buffer->data + buffer->length, buffer->capacity - buffer->length - 1);
+        if (got == 0)
+        {
+            break;
+        }
+        if (got < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("read");
+            result = -1;
+            break;
+        }
+        buffer->length += got;
+    }
+    close(fds[0]);
+    int status;
+    if (waitpid(pid, &status, 0) == pid)
+    {
+        substitutionStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    TRACE_END(span, "process", "substitution", line);
+    // The command may have moved directories the path cache holds open.
+    pathCacheInvalidate();
+
+    while (buffer->length > start && buffer->data[buffer->length - 1] == '\n')
+    {
+        buffer->length--;
+    }
+    for (size_t i = start; i < buffer->length; i++)
+    {
+        if (buffer->data[i] == '\n')
+        {
+            buffer->data[i] = ' ';
+        }
+    }
+    return result;
+}
+
+static int appendVariable(ExpandBuffer *buffer, const char *name, size_t length)
+{
+    char *value = lookupCopy(name, length, buffer->arena);
+    if (value == NULL)
+    {
+        return 0;
+    }
+    return append(buffer, value, strlen(value));
+}
+
+void varSetStatus(int status)
+{
+    __atomic_store_n(&lastStatus, status, __ATOMIC_RELAXED);
+}
+
+void varClearSubstitution(void)
+{
+    substitutionStatus = 0;
+}
+
+int varSubstitutionStatus(void)
+{
+    return substitutionStatus;
+}
+
+int varStatus(void)
+{
+    return __atomic_load_n(&lastStatus, __ATOMIC_RELAXED);
+}
+
+char *expandLine(const char *line)
+{
+    if (strchr(line, '$') == NULL && strchr(line, '\\') == NULL)
+    {
+        return arenaStrdup(commandArena(), line);
+    }
+
+    uint64_t span = TRACE_BEGIN();
+    ExpandBuffer buffer = {commandArena(), NULL, 0, 64};
+    buffer.data = arenaAlloc(buffer.arena, buffer.capacity);
+    if (buffer.data == NULL)
+    {
+        return NULL;
+    }
+
+    int i = 0;
+    while (line[i] != '\0')
+    {
+        int status = 0;
+        if (line[i] == '\\' && line[i + 1] == '$')
+        {
+            status = append(&buffer, "$", 1);
+            i += 2;
+        }
+        else if (line[i] == '$' && line[i + 1] == '(')
+        {
+            int end = closingParenthesis(line, i);
+            if (end == -1)
+            {
+                fprintf(stderr, "Missing ')' in command substitution.\n");
+                return NULL;
+            }
+            status = substituteCommand(&buffer, line + i + 2, end - i - 3);
+            i = end;
+        }
+        else if (line[i] == '$' && line[i + 1] == '{')
+        {
+            const char *close = strchr(line + i + 2, '}');
+            if (close == NULL || !varValidName(line + i + 2, close - (line + i + 2)))
+            {
+                fprintf(stderr, "Bad substitution.\n");
+                return NULL;
+            }
+            status = appendVariable(&buffer, line + i + 2, close - (line + i + 2));
+            i = close - line + 1;
+        }
+        else if (line[i] == '$' && line[i + 1] == '?')
+        {
+            char number[16];
+            snprintf(number, sizeof(number), "%d", varStatus());
+            status = append(&buffer, number, strlen(number));
+            i += 2;
+        }
+        else if (line[i] == '$' && (isalpha((unsigned char)line[i + 1]) || line[i + 1] == '_'))
+        {
+            int end = i + 1;
+            while (isalnum((unsigned char)line[end]) || line[end] == '_')
+            {
+                end++;
+            }
+            status = appendVariable(&buffer, line + i + 1, end - i - 1);
+            i = end;
+        }
+        else
+        {
+            status = append(&buffer, line + i, 1);
+            i++;
+        }
+
+        if (status != 0)
+        {
+            return NULL;
+        }
+    }
+
+    buffer.data[buffer.length] = '\0';
+    TRACE_END(span, "parse", "expand", line);
+    return buffer.data;
+}
@@ -0,0 +1,164 @@
+#ifndef MYVARS_H
+#define MYVARS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define VARS_INITIAL_CAPACITY 64
+
+/**
+ * Loads the process environment into the shell's variable store, marking every
+ * variable as exported. Called once at startup, before the first command runs.
+ *
+ * The store is an open-addressing hash table, so looking a variable up during
+ * expansion costs one hash and usually one probe, no matter how many variables the
+ * user or the environment has defined.
+ *
+ * @param envp The environment to import, normally `environ`.
+ */
+void varInit(char **envp);
+
+/**
+ * Sets a shell variable, creating it if needed. An existing variable keeps its export
+ * flag unless `exported` is true.
+ *
+ * Usage example:
+ *   varSet("SRC", "/data/in", false);   // SRC=/data/in
+ *   varSet("LANG", "C", true);          // export LANG=C
+ *
+ * @param name The variable name: a letter or underscore followed by letters, digits
+ *             or underscores.
+ * @param value The new value.
+ * @param exported true to also mark the variable for export to child processes.
+ * @return 0 on success, -1 if the name is invalid or memory ran out.
+ */
+int varSet(const char *name, const char *value, bool exported);
+
+/**
+ * Marks an existing variable for export, or creates it empty and exported.
+ *
+ * @param name The variable name.
+ * @return 0 on success, -1 if the name is invalid or memory ran out.
+ */
+int varExport(const char *name);
+
+/**
+ * Removes a variable. Removing a variable that does not exist is not an error.
+ *
+ * @param name The variable name.
+ */
+void varUnset(const char *name);
+
+/**
+ * Returns a copy of a variable's value.
+ *
+ * @param name The variable name.
+ * @return The value in pool memory, to be released with `poolFree`, or NULL if the
+ *         variable is not set.
+ */
+char *varDup(const char *name);
+
+/**
+ * Returns true if `name` is a valid variable name.
+ *
+ * @param name The name to check.
+ * @param length Number of characters of `name` to check.
+ * @return true if the characters form a valid name.
+ */
+bool varValidName(const char *name, size_t length);
+
+/**
+ * Builds the environment for a child process from the exported variables. The array
+ * is rebuilt only when an exported variable has changed since the previous call;
+ * callers share it, and it stays valid, even across an `export` on another thread,
+ * until they release it with `varEnvironRelease`.
+ *
+ * Usage example:
+ *   char **envp = varEnviron();
+ *   if (fork() == 0)
+ *   {
+ *       environ = envp;
+ *       execvp(argv[0], argv);
+ *   }
+ *   varEnvironRelease(envp);
+ *
+ * @return A NULL-terminated array of "NAME=value" strings, or NULL if memory is
+ *         exhausted.
+ */
+char **varEnviron(void);
+
+/**
+ * Releases an environment returned by `varEnviron`. A forked child that goes on to
+ * exec does not need to.
+ *
+ * @param envp The environment, or NULL.
+ */
+void varEnvironRelease(char **envp);
+
+/**
+ * Prints variables as `NAME=value` lines, sorted by name.
+ *
+ * @param out The stream to print to.
+ * @param exportedOnly true to print only exported variables, prefixed with "export ".
+ */
+void varPrint(FILE *out, bool exportedOnly);
+
+/**
+ * Records the exit status of the command that just finished, for `$?`.
+ *
+ * @param status The exit status, 0 for success.
+ */
+void varSetStatus(int status);
+
+/**
+ * Returns the exit status of the last command, as recorded by `varSetStatus`.
+ *
+ * @return The exit status, 0 if no command has run yet.
+ */
+int varStatus(void);
+
+/**
+ * Forgets the status of earlier command substitutions on the calling thread. Called
+ * before the words of a command are expanded.
+ */
+void varClearSubstitution(void);
+
+/**
+ * Returns the exit status of the last command substitution `expandLine` ran on the
+ * calling thread since `varClearSubstitution`. A command made only of assignments
+ * exits with it, so `X=$(false)` fails like it does in other shells.
+ *
+ * @return The exit status, 0 if no substitution ran.
+ */
+int varSubstitutionStatus(void);
+
+/**
+ * Expands `$NAME`, `${NAME}`, `$?` and `$(command)` in a command line. Unset variables
+ * expand to the empty string; `\$` stands for a literal dollar sign. A command
+ * substitution runs the command in a child shell process and reads its output
+ * through a pipe into a buffer that grows as needed; trailing newlines are removed
+ * and inner newlines become spaces, so the output can be used as arguments.
+ *
+ * Expansion happens on the text before it is split into arguments, so an expanded
+ * value containing spaces becomes several arguments unless it is written inside
+ * double quotes.
+ *
+ * Usage example:
+ *   char *line = expandLine("cp $SRC/${NAME}.txt $(read target.txt)");
+ *
+ * @param line The command line.
+ * @return The expanded line, allocated from the command arena, or NULL if memory ran
+ *         out. When there is nothing to expand the result is a copy of `line`.
+ */
+char *expandLine(const char *line);
+
+/**
+ * Returns the index of the first `|` in `command` that is not inside a `$(...)`
+ * command substitution, or -1 if there is none.
+ *
+ * @param command The command line.
+ * @return The index of the pipe symbol, or -1.
+ */
+int findPipeSymbol(const char *command);
+
+#endif // MYVARS_H
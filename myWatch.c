@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "myWatch.h"
+#include "myCoro.h"
+
+#define FOLLOW_FILE_EVENTS (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+#define FOLLOW_DIR_EVENTS (IN_CREATE | IN_MOVED_TO)
+#define WATCH_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                      IN_MOVE_SELF | IN_DELETE_SELF)
+
+typedef struct
+{
+    const char *path;
+    const char *base;
+    int fd;
+    off_t offset;
+    int fileWatch;
+    char *buffer;
+    FILE *out;
+} Follow;
+
+/* What a watch sleeps on. In a background job `set` is an epoll set holding the
+   inotify descriptor, the Ctrl-C eventfd and `timer`, so the job can hand the
+   single descriptor to coroWaitFd and let the prompt and other jobs run; in the
+   foreground both are -1 and the watch blocks in poll. */
+typedef struct
+{
+    int inotifyFd;
+    int set;
+    int timer;
+} Waiter;
+
+/* Ctrl-C during a watch is turned into a readable eventfd, so a watch blocked in
+   poll notices it whichever thread the signal is delivered to. */
+static int interruptFd = -1;
+static int watchers = 0;
+static struct sigaction previousAction;
+static pthread_mutex_t watchLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void onInterrupt(int signal)
+{
+    (void)signal;
+    uint64_t one = 1;
+    ssize_t written = write(interruptFd, &one, sizeof(one));
+    (void)written;
+}
+
+static int beginWatch(void)
+{
+    pthread_mutex_lock(&watchLock);
+    if (interruptFd == -1 && (interruptFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+    {
+        pthread_mutex_unlock(&watchLock);
+        return -1;
+    }
+    if (watchers++ == 0)
+    {
+        // Forget a Ctrl-C that ended an earlier watch.
+        uint64_t stale;
+        ssize_t drained = read(interruptFd, &stale, sizeof(stale));
+        (void)drained;
+        struct sigaction action = {.sa_handler = onInterrupt};
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, &previousAction);
+    }
+    pthread_mutex_unlock(&watchLock);
+    return 0;
+}
+
+static void endWatch(void)
+{
+    pthread_mutex_lock(&watchLock);
+    if (--watchers == 0)
+    {
+        sigaction(SIGINT, &previousAction, NULL);
+    }
+    pthread_mutex_unlock(&watchLock);
+}
+
+static void closeWaiter(Waiter *waiter)
+{
+    if (waiter->set != -1)
+    {
+        close(waiter->set);
+        waiter->set = -1;
+    }
+    if (waiter->timer != -1)
+    {
+        close(waiter->timer);
+        waiter->timer = -1;
+    }
+}
+
+static int openWaiter(Waiter *waiter, int inotifyFd)
+{
+    waiter->inotifyFd = inotifyFd;
+    waiter->set = -1;
+    waiter->timer = -1;
+    if (!coroInside())
+    {
+        return 0;
+    }
+    waiter->set = epoll_create1(EPOLL_CLOEXEC);
+    waiter->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    int fds[3] = {inotifyFd, interruptFd, waiter->timer};
+    bool added = waiter->set != -1 && waiter->timer != -1;
+    for (int i = 0; i < 3 && added; i++)
+    {
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = fds[i]};
+        added = epoll_ctl(waiter->set, EPOLL_CTL_ADD, fds[i], &event) == 0;
+    }
+    if (!added)
+    {
+        int savedErrno = errno;
+        closeWaiter(waiter);
+        errno = savedErrno;
+        return -1;
+    }
+    return 0;
+}
+
+/* Suspends the background job until the inotify descriptor or the eventfd is
+   readable or `timeoutMs` (-1 for ever) has passed, then polls them without
+   blocking. */
+static int pollInJob(Waiter *waiter, struct pollfd *fds, int timeoutMs)
+{
+    struct itimerspec due = {{0, 0}, {timeoutMs / 1000, (timeoutMs % 1000) * 1000000L}};
+    if (timeoutMs >= 0 && timerfd_settime(waiter->timer, 0, &due, NULL) == -1)
+    {
+        return -1;
+    }
+    int ready;
+    for (;;)
+    {
+        if ((ready = poll(fds, 2, 0)) != 0 && !(ready == -1 && errno == EINTR))
+        {
+            break;
+        }
+        uint64_t expirations;
+        if (timeoutMs >= 0 && read(waiter->timer, &expirations, sizeof(expirations)) > 0)
+        {
+            ready = 0;
+            break;
+        }
+        coroWaitFd(waiter->set, EPOLLIN);
+    }
+    struct itimerspec off = {{0, 0}, {0, 0}};
+    timerfd_settime(waiter->timer, 0, &off, NULL);
+    return ready;
+}
+
+/* Waits up to `timeoutMs` (-1 for ever) for inotify events. Returns 1 when events
+   are ready, 0 on timeout or Ctrl-C (setting `interrupted`), -1 on failure. */
+static int waitForEvents(Waiter *waiter, int timeoutMs, bool *interrupted)
+{
+    struct pollfd fds[2] = {{waiter->inotifyFd, POLLIN, 0}, {interruptFd, POLLIN, 0}};
+    int ready;
+    if (waiter->set != -1)
+    {
+        ready = pollInJob(waiter, fds, timeoutMs);
+    }
+    else
+    {
+        while ((ready = poll(fds, 2, timeoutMs)) == -1 && errno == EINTR)
+        {
+            // The handler has made the eventfd readable; the next poll returns at once.
+        }
+    }
+    if (ready == -1)
+    {
+        return -1;
+    }
+    if (fds[1].revents & POLLIN)
+    {
+        *interrupted = true;
+        return 0;
+    }
+    return ready > 0 ? 1 : 0;
+}
+
+/* Writes everything past the followed offset to the output. */
+static int copyAppended(Follow *follow)
+{
+    struct stat st;
+    if (fstat(follow->fd, &st) != 0)
+    {
+        return -1;
+    }
+    if (st.st_size < follow->offset)
+    {
+        fprintf(stderr, "%s: file truncated\n", follow->path);
+        follow->offset = 0;
+    }
+    for (;;)
+    {
+        ssize_t length = pread(follow->fd, follow->buffer, WATCH_BUFFER_SIZE, follow->offset);
+        if (length < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (length < 0)
+        {
+            return -1;
+        }
+        if (length == 0)
+        {
+            break;
+        }
+        if (fwrite(follow->buffer, 1, length, follow->out) != (size_t)length)
+        {
+            return -1;
+        }
+        follow->offset += length;
+    }
+    return fflush(follow->out) == 0 ? 0 : -1;
+}
+
+/* Switches to the file now at the followed path once the old one is drained. Does
+   nothing while no file has the name, or when it is still the same file. */
+static int reopenFollowed(Follow *follow, int inotifyFd)
+{
+    int fd = open(follow->path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return errno == ENOENT ? 0 : -1;
+    }
+    struct stat current, followed;
+    if (fstat(fd, &current) == 0 && fstat(follow->fd, &followed) == 0 &&
+        current.st_dev == followed.st_dev && current.st_ino == followed.st_ino)
+    {
+        close(fd);
+        return 0;
+    }
+
+    int result = copyAppended(follow);
+    close(follow->fd);
+    if (follow->fileWatch != -1)
+    {
+        inotify_rm_watch(inotifyFd, follow->fileWatch);
+    }
+    follow->fd = fd;
+    follow->offset = 0;
+    follow->fileWatch = inotify_add_watch(inotifyFd, follow->path, FOLLOW_FILE_EVENTS);
+    if (follow->fileWatch == -1)
+    {
+        return -1;
+    }
+    return result == 0 ? copyAppended(follow) : result;
+}
+
+int watchFollow(const char *path, off_t offset, FILE *out)
+{
+    const char *slash = strrchr(path, '/');
+    char *directory = slash == NULL ? strdup(".") : slash == path ? strdup("/") : strndup(path, slash - path);
+    Follow follow = {.path = path, .base = slash != NULL ? slash + 1 : path, .offset = offset, .out = out};
+    follow.buffer = malloc(WATCH_BUFFER_SIZE);
+    follow.fd = open(path, O_RDONLY | O_CLOEXEC);
+    int inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    int result = -1;
+    if (directory != NULL && follow.buffer != NULL && follow.fd != -1 && inotifyFd != -1 &&
+        (follow.fileWatch = inotify_add_watch(inotifyFd, path, FOLLOW_FILE_EVENTS)) != -1 &&
+        inotify_add_watch(inotifyFd, directory, FOLLOW_DIR_EVENTS) != -1 && beginWatch() == 0)
+    {
+        Waiter waiter;
+        // Catch up on data written before the watch was in place.
+        result = openWaiter(&waiter, inotifyFd) == 0 ? copyAppended(&follow) : -1;
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        while (result == 0)
+        {
+            bool interrupted = false;
+            if (waitForEvents(&waiter, -1, &interrupted) < 0)
+            {
+                result = -1;
+                break;
+            }
+            if (interrupted)
+            {
+                break;
+            }
+            ssize_t length = read(inotifyFd, events, sizeof(events));
+            if (length < 0)
+            {
+                result = errno == EAGAIN || errno == EINTR ? 0 : -1;
+                continue;
+            }
+            for (ssize_t at = 0; at < length && result == 0;)
+            {
+                struct inotify_event *event = (struct inotify_event *)(events + at);
+                at += sizeof(struct inotify_event) + event->len;
+                if (event->wd == follow.fileWatch && (event->mask & IN_IGNORED))
+                {
+                    follow.fileWatch = -1;
+                }
+                else if (event->wd == follow.fileWatch && (event->mask & (IN_MOVE_SELF | IN_DELETE_SELF)))
+                {
+                    // Rotated away: finish the old file, then take the new one if it is there yet.
+                    result = copyAppended(&follow);
+                    result = result == 0 ? reopenFollowed(&follow, inotifyFd) : result;
+                }
+                else if (event->wd == follow.fileWatch)
+                {
+                    result = copyAppended(&follow);
+                }
+                else if (event->len > 0 && strcmp(event->name, follow.base) == 0)
+                {
+                    result = reopenFollowed(&follow, inotifyFd);
+                }
+            }
+        }
+        closeWaiter(&waiter);
+        endWatch();
+    }
+
+    int savedErrno = errno;
+    if (inotifyFd != -1)
+    {
+        close(inotifyFd);
+    }
+    if (follow.fd != -1)
+    {
+        close(follow.fd);
+    }
+    free(follow.buffer);
+    free(directory);
+    errno = savedErrno;
+    return result;
+}
+
+int watchPaths(char **paths, int debounceMs, WatchCallback callback, void *ctx)
+{
+    int count = 0;
+    while (paths[count] != NULL)
+    {
+        count++;
+    }
+    int *watches = malloc((count > 0 ? count : 1) * sizeof(int));
+    int inotifyFd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (watches == NULL || inotifyFd == -1)
+    {
+        int savedErrno = errno;
+        free(watches);
+        if (inotifyFd != -1)
+        {
+            close(inotifyFd);
+        }
+        errno = savedErrno;
+        return -1;
+    }
+    int result = 0;
+    for (int i = 0; i < count && result == 0; i++)
+    {
+        watches[i] = inotify_add_watch(inotifyFd, paths[i], WATCH_EVENTS);
+        result = watches[i] == -1 ? -1 : 0;
+    }
+    Waiter waiter;
+    if (result == 0 && (result = beginWatch()) == 0 && (result = openWaiter(&waiter, inotifyFd)) != 0)
+    {
+        int savedErrno = errno;
+        endWatch();
+        errno = savedErrno;
+    }
+    if (result != 0)
+    {
+        int savedErrno = errno;
+        free(watches);
+        close(inotifyFd);
+        errno = savedErrno;
+        return -1;
+    }
+
+    // The last change of the current burst, reported once the burst is over.
+    bool pending = false;
+    int pendingIndex = 0;
+    uint32_t pendingMask = 0;
+    char pendingName[NAME_MAX + 1];
+    bool pendingHasName = false;
+    int active = count;
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool stop = false;
+    while (!stop && (active > 0 || pending))
+    {
+        bool interrupted = false;
+        int ready = waitForEvents(&waiter, pending ? debounceMs : -1, &interrupted);
+        if (ready < 0)
+        {
+            result = -1;
+            break;
+        }
+        if (interrupted)
+        {
+            break;
+        }
+        if (ready == 0)
+        {
+            pending = false;
+            stop = callback(paths[pendingIndex], pendingHasName ? pendingName : NULL, pendingMask, ctx) != 0;
+            continue;
+        }
+
+        ssize_t length = read(inotifyFd, events, sizeof(events));
+        if (length < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                result = -1;
+                break;
+            }
+            continue;
+        }
+        for (ssize_t at = 0; at < length && !stop;)
+        {
+            struct inotify_event *event = (struct inotify_event *)(events + at);
+            at += sizeof(struct inotify_event) + event->len;
+            int index = 0;
+            while (index < count && watches[index] != event->wd)
+            {
+                index++;
+            }
+            if (index == count)
+            {
+                continue;
+            }
+            if (event->mask & IN_IGNORED)
+            {
+                // The watched path is gone; stop once nothing is left to watch.
+                watches[index] = -1;
+                active--;
+                continue;
+            }
+            if (debounceMs == 0)
+            {
+                stop = callback(paths[index], event->len > 0 ? event->name : NULL, event->mask, ctx) != 0;
+                continue;
+            }
+            pending = true;
+            pendingIndex = index;
+            pendingMask = event->mask;
+            pendingHasName = event->len > 0;
+            if (pendingHasName)
+            {
+                snprintf(pendingName, sizeof(pendingName), "%s", event->name);
+            }
+        }
+    }
+
+    closeWaiter(&waiter);
+    endWatch();
+    int savedErrno = errno;
+    free(watches);
+    close(inotifyFd);
+    errno = savedErrno;
+    return result;
+}
+
+const char *watchEventName(uint32_t mask)
+{
+    static const struct
+    {
+        uint32_t mask;
+        const char *name;
+    } names[] = {{IN_DELETE_SELF, "DELETE_SELF"}, {IN_MOVE_SELF, "MOVE_SELF"}, {IN_CREATE, "CREATE"},
+                 {IN_DELETE, "DELETE"}, {IN_MOVED_FROM, "MOVED_FROM"}, {IN_MOVED_TO, "MOVED_TO"},
+                 {IN_MODIFY, "MODIFY"}, {IN_ATTRIB, "ATTRIB"}};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (mask & names[i].mask)
+        {
+            return names[i].name;
+        }
+    }
+    return "CHANGE";
+}
@@ -0,0 +1,83 @@
+#ifndef MYWATCH_H
+#define MYWATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** Bytes read from a followed file per call. */
+#define WATCH_BUFFER_SIZE (64 * 1024)
+/** Default quiet period after a change before `watchPaths` reports it. */
+#define WATCH_DEBOUNCE_MS 100
+
+/**
+ * Called by `watchPaths` for a change. With debouncing, a burst of changes is
+ * reported once, with its last event.
+ *
+ * @param path The watched path the change happened to or in.
+ * @param name The name of the changed entry in a watched directory, or NULL when
+ *             the change was to `path` itself.
+ * @param mask The inotify event bits (IN_MODIFY, IN_CREATE, ...).
+ * @param ctx The context pointer passed to `watchPaths`.
+ * @return 0 to keep watching, anything else to stop.
+ */
+typedef int (*WatchCallback)(const char *path, const char *name, uint32_t mask, void *ctx);
+
+/**
+ * Writes the bytes appended to a file to `out` as they arrive, from `offset` on,
+ * until the user presses Ctrl-C. The file is watched with inotify, so nothing runs
+ * between writes. A file that shrinks is read again from the start. The file is
+ * followed by name: when it is renamed or deleted, for example by log rotation, the
+ * rest of the old file is written and the new file with the same name is followed
+ * from its start as soon as it appears. In a background job the wait suspends only
+ * the job, so the prompt and other jobs keep running.
+ *
+ * Usage example:
+ *   struct stat st;
+ *   stat("/var/log/app.log", &st);
+ *   watchFollow("/var/log/app.log", st.st_size, stdout);
+ *
+ * @param path The file, relative to the working directory or absolute.
+ * @param offset Where the new data starts, usually the current size of the file.
+ * @param out The stream receiving the data; flushed after every change.
+ * @return 0 when interrupted, -1 with errno set if the file could not be watched,
+ *         read or written out.
+ */
+int watchFollow(const char *path, off_t offset, FILE *out);
+
+/**
+ * Reports changes to files and directories (and to the entries of directories)
+ * until the callback asks to stop or the user presses Ctrl-C. Writes, attribute
+ * changes, creations, deletions and renames are watched with inotify. With a
+ * `debounceMs` above zero a change is reported only after no further change came for
+ * that long, so a command run for it sees the result of a whole burst of writes,
+ * and changes made while the callback runs are folded into the next report. As with
+ * `watchFollow`, a background job waits without blocking the shell.
+ *
+ * Usage example:
+ *   static int rebuild(const char *path, const char *name, uint32_t mask, void *ctx)
+ *   {
+ *       return scriptRunText("make", "watch") == 0 ? 0 : 1;
+ *   }
+ *   char *paths[] = {"src", NULL};
+ *   watchPaths(paths, WATCH_DEBOUNCE_MS, rebuild, NULL);
+ *
+ * @param paths The paths to watch, NULL-terminated.
+ * @param debounceMs Quiet period before a change is reported, or 0 to report every
+ *                   event as it comes.
+ * @param callback Called for every reported change.
+ * @param ctx Opaque pointer passed through to `callback`.
+ * @return 0 when interrupted or stopped by the callback, -1 with errno set if a
+ *         path could not be watched.
+ */
+int watchPaths(char **paths, int debounceMs, WatchCallback callback, void *ctx);
+
+/**
+ * Names an inotify event for display, e.g. "MODIFY" or "MOVED_TO".
+ *
+ * @param mask The event bits.
+ * @return A static string naming the most significant event in `mask`.
+ */
+const char *watchEventName(uint32_t mask);
+
+#endif // MYWATCH_H